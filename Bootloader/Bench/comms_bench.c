@@ -0,0 +1,761 @@
+/*
+
+# Comms Protocol Benchmark
+
+Host program (make bench) that runs the real comms.c, uart.c, timer wheel and SysTick code on top of the
+peripheral emulator (coresys/Host/Include/host_emu.h) and measures what the protocol actually delivers.
+
+The main thread is the device. It runs the same main loop as bootloader.c (comms_update, timer_wheel_update,
+power_idle) and, depending on the mode, either pushes numbered data packets through comms_write() (-m tx, the
+default) or collects them with comms_read() (-m rx).
+
+USART2 is attached to one end of a socketpair. A link thread owns the other end and simulates the cable and the
+PC in between:
+
+1. Line: every byte occupies the line for 10 bit times at the configured baud rate (start + 8 data + stop),
+then arrives after the one way latency. Both directions are independent, like TX and RX wires.
+
+2. Errors: each byte is lost with probability -L, and each bit of a delivered byte is flipped with probability
+-e (bit error rate). The random generator is seeded (-r), so a run is reproducible.
+
+3. Peer: the far end speaks the same protocol as comms.c: CRC check, ACK for good data packets, RETX for bad
+ones, resend of the last frame on RETX, ack timeout with COMMS_MAX_RETRANSMITS resends, and the byte timeout
+that resyncs the framing. It is written separately so that it never shares state with the device.
+
+Every data packet carries its sequence number in the first payload bytes and a pattern derived from it in
+the rest. The receiver counts new packets, duplicates (the ack got lost and the sender resent), missing
+packets (the sender gave up) and packets whose contents are wrong although their CRC matched.
+
+## Results
+
+- goodput: new payload bytes per second, also as a fraction of the raw line rate (baud / 10)
+- retransmissions on both sides, split into ack timeouts and RETX requests, plus CRC errors and byte timeouts
+- device CPU: CPU time of the main thread (firmware, interrupt handlers and emulated register accesses)
+  expressed in cycles of the emulated 16MHz core per payload byte. Every peripheral register access is a trap
+  into the emulator costing a few microseconds of host time, so the trap share is estimated and reported
+  separately; the count of register accesses per byte is exact and the most stable number to compare.
+
+Numbers are only comparable between runs on the same host. The emulated device is slower than the real one
+(every register access is a trap), which adds about a millisecond per packet round trip on top of the line;
+a run with -b 0 (unpaced line) measures that floor.
+
+## Examples
+
+    ./HostBinaries/comms_bench                              # 1000 packets device -> PC at 115200 baud
+    ./HostBinaries/comms_bench -m rx -l 5000 -e 1e-4        # upload with a 10ms round trip and noise
+    ./HostBinaries/comms_bench -s 4 -c                      # 4 byte payloads, one CSV row
+
+Different frame sizes need a rebuild: rm -rf HostBinaries/Bench && make bench BENCH_CFLAGS=-DPACKET_DATA_LENGTH=64
+
+*/
+
+#define _GNU_SOURCE
+#include "../../coresys/Host/Include/host_emu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include "../Include/comms.h"
+#include "../Include/uart.h"
+#include "../Include/crc8.h"
+#include "../../coresys/Drivers/Include/systick.h"
+#include "../../coresys/Drivers/Include/timer_wheel.h"
+#include "../../coresys/Drivers/Include/power.h"
+
+#define BENCH_LINK_QUEUE_SIZE (1U << 16) // bytes in flight per direction, must be a power of two
+#define BENCH_LINK_QUEUE_MASK (BENCH_LINK_QUEUE_SIZE - 1U)
+#define BENCH_MAX_WAIT_NS (10000000ULL)   // the link thread re-checks the stop flag at least this often
+#define BENCH_RUN_CHECK_MS (10U)          // the device polls for the end of an rx run this often
+#define BENCH_TRAP_CALIBRATION (20000U)   // register reads used to estimate the cost of one emulator trap
+#define BENCH_SEQ_BYTES (4U)
+
+#define NS_PER_MS (1000000ULL)
+#define NS_PER_S (1000000000ULL)
+
+typedef struct bench_config_
+{
+    bool device_sends; // tx: device comms_write() -> peer, rx: peer -> device comms_read()
+    uint32_t packets;
+    uint8_t payload; // bytes used of PACKET_DATA_LENGTH
+    uint32_t baud;   // 0: no line pacing, bytes move as fast as the host does
+    uint32_t latency_us;
+    double loss; // probability that a byte disappears
+    double ber;  // probability that a bit flips
+    uint64_t seed;
+    bool csv;
+} bench_config_t;
+
+// what a receiver saw, checked against the sequence numbers and the payload pattern
+typedef struct bench_delivery_
+{
+    uint32_t expected_seq;
+    uint32_t delivered;
+    uint32_t duplicates;
+    uint32_t missing;
+    uint32_t undetected; // CRC matched but the contents are wrong
+    uint64_t payload_bytes;
+} bench_delivery_t;
+
+typedef struct link_byte_
+{
+    uint64_t due_ns;
+    uint8_t value;
+} link_byte_t;
+
+// one direction of the cable
+typedef struct link_direction_
+{
+    link_byte_t queue[BENCH_LINK_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint64_t line_free_ns; // when the byte currently on the wire has been shifted out
+    uint64_t bytes;
+    uint64_t lost;
+    uint64_t corrupted;
+} link_direction_t;
+
+// the PC side of the protocol, mirroring comms.c
+typedef struct peer_
+{
+    uint8_t frame[PACKET_LENGTH];
+    uint16_t frame_count;
+    uint64_t last_byte_ns;
+
+    uint8_t last_transmitted[PACKET_LENGTH]; // a data packet or a control frame, resent on RETX
+    uint8_t last_transmitted_length;
+    comms_packet_t unacked;
+    bool ack_pending;
+    uint64_t ack_due_ns;
+    uint8_t retransmit_count;
+    uint32_t next_seq;
+
+    comms_stats_t stats;
+    bench_delivery_t delivery;
+} peer_t;
+
+static bench_config_t config = {
+    .device_sends = true,
+    .packets = 1000,
+    .payload = PACKET_DATA_LENGTH,
+    .baud = 115200,
+    .latency_us = 0,
+    .loss = 0.0,
+    .ber = 0.0,
+    .seed = 1,
+    .csv = false,
+};
+
+static int link_fd = -1;
+static link_direction_t link_up;   // device -> peer
+static link_direction_t link_down; // peer -> device
+static uint64_t link_byte_ns = 0;
+static uint64_t link_latency_ns = 0;
+static uint64_t rng_state = 0;
+
+static peer_t peer = {0};
+static atomic_bool link_stop = false;
+static atomic_bool peer_done = false;
+static atomic_uint_fast64_t peer_done_ns = 0;
+
+static bench_delivery_t device_delivery = {0};
+static soft_timer_t run_timer;
+static volatile bool run_finished = false;
+
+// the benchmark provides the line itself, no pty
+void host_emu_board_setup(void)
+{
+}
+
+static uint64_t bench_thread_cpu_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * NS_PER_S + (uint64_t)now.tv_nsec;
+}
+
+/* payload */
+
+static uint8_t bench_seq_bytes(void)
+{
+    return (config.payload < BENCH_SEQ_BYTES) ? config.payload : BENCH_SEQ_BYTES;
+}
+
+static uint32_t bench_seq_mask(void)
+{
+    uint8_t bytes = bench_seq_bytes();
+    return (bytes >= 4U) ? 0xFFFFFFFFU : ((1UL << (8U * bytes)) - 1U);
+}
+
+static uint8_t bench_pattern(uint32_t seq, uint8_t index)
+{
+    return (uint8_t)(seq * 31U + index * 7U);
+}
+
+static void bench_fill(comms_packet_t *packet, uint32_t seq)
+{
+    memset(packet, 0, sizeof(*packet)); // unused data bytes are zero on the wire
+    packet->length = config.payload;
+    for (uint8_t i = 0; i < config.payload; i++)
+    {
+        packet->data[i] = (i < bench_seq_bytes()) ? (uint8_t)(seq >> (8U * i)) : bench_pattern(seq, i);
+    }
+    packet->crc = calculate_crc8((uint8_t *)packet, PACKET_CRC_INPUT_LENGTH);
+}
+
+static void bench_account(bench_delivery_t *delivery, const comms_packet_t *packet)
+{
+    uint32_t seq = 0;
+    for (uint8_t i = 0; i < bench_seq_bytes(); i++)
+    {
+        seq |= (uint32_t)packet->data[i] << (8U * i);
+    }
+
+    bool intact = (packet->length == config.payload);
+    for (uint8_t i = bench_seq_bytes(); intact && i < PACKET_DATA_LENGTH; i++)
+    {
+        intact = (packet->data[i] == ((i < config.payload) ? bench_pattern(seq, i) : 0U));
+    }
+    if (!intact)
+    {
+        delivery->undetected++;
+        return;
+    }
+
+    uint32_t mask = bench_seq_mask();
+    uint32_t expected = delivery->expected_seq & mask;
+    if (seq == ((expected - 1U) & mask) && delivery->delivered)
+    {
+        // our ack got lost and the sender tried again; stop-and-wait can't tell, the application sees it twice
+        delivery->duplicates++;
+        return;
+    }
+
+    // anything between the expected packet and this one was given up on by the sender
+    delivery->missing += (seq - expected) & mask;
+    delivery->expected_seq += ((seq - expected) & mask) + 1U;
+    delivery->delivered++;
+    delivery->payload_bytes += config.payload;
+}
+
+/* link */
+
+static double link_random(void)
+{
+    // xorshift64*, plenty for coin flips and reproducible from the seed
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void link_send(link_direction_t *direction, uint8_t value, uint64_t now)
+{
+    // the byte occupies the line even if it gets lost on the way
+    uint64_t start = (direction->line_free_ns > now) ? direction->line_free_ns : now;
+    direction->line_free_ns = start + link_byte_ns;
+    direction->bytes++;
+
+    if (config.loss > 0.0 && link_random() < config.loss)
+    {
+        direction->lost++;
+        return;
+    }
+
+    uint8_t received = value;
+    if (config.ber > 0.0)
+    {
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            if (link_random() < config.ber)
+            {
+                received ^= (uint8_t)(1U << bit);
+            }
+        }
+    }
+    if (received != value)
+    {
+        direction->corrupted++;
+    }
+
+    if (direction->tail - direction->head == BENCH_LINK_QUEUE_SIZE)
+    {
+        direction->lost++;
+        return;
+    }
+
+    link_byte_t *slot = &direction->queue[direction->tail & BENCH_LINK_QUEUE_MASK];
+    slot->due_ns = direction->line_free_ns + link_latency_ns;
+    slot->value = received;
+    direction->tail++;
+}
+
+static bool link_next_due(const link_direction_t *direction, uint64_t *due_ns)
+{
+    if (direction->head == direction->tail)
+    {
+        return false;
+    }
+
+    *due_ns = direction->queue[direction->head & BENCH_LINK_QUEUE_MASK].due_ns;
+    return true;
+}
+
+/* peer */
+
+static void peer_transmit(const void *frame, uint8_t length, uint64_t now)
+{
+    const uint8_t *bytes = (const uint8_t *)frame;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        link_send(&link_down, bytes[i], now);
+    }
+
+    memmove(peer.last_transmitted, frame, length);
+    peer.last_transmitted_length = length;
+}
+
+static void peer_control(uint8_t type, uint64_t now)
+{
+    // built at run time on purpose, as a check on the frames comms.c has the compiler build
+    comms_control_t control = {.type = type, .seq = 0};
+    control.crc = calculate_crc8((uint8_t *)&control, PACKET_CONTROL_LENGTH - PACKET_CRC_BYTES);
+    peer_transmit(&control, PACKET_CONTROL_LENGTH, now);
+}
+
+static void peer_receive_control(uint64_t now)
+{
+    comms_control_t control;
+    memcpy(&control, peer.frame, PACKET_CONTROL_LENGTH);
+
+    if (control.crc != calculate_crc8((uint8_t *)&control, PACKET_CONTROL_LENGTH - PACKET_CRC_BYTES))
+    {
+        peer.stats.crc_errors++;
+        peer_control(PACKET_RETX_TYPE, now);
+        return;
+    }
+
+    if (control.type == PACKET_RETX_TYPE)
+    {
+        peer.stats.retx_retransmits++;
+        peer_transmit(peer.last_transmitted, peer.last_transmitted_length, now);
+        return;
+    }
+
+    if (control.type == PACKET_ACK_TYPE)
+    {
+        peer.ack_pending = false;
+    }
+}
+
+static void peer_receive(uint8_t value, uint64_t now)
+{
+    if (peer.frame_count && now - peer.last_byte_ns >= (uint64_t)COMMS_BYTE_TIMEOUT_MS * NS_PER_MS)
+    {
+        peer.frame_count = 0;
+        peer.stats.byte_timeouts++;
+    }
+    peer.last_byte_ns = now;
+
+    peer.frame[peer.frame_count++] = value;
+    bool control = (peer.frame[0] & PACKET_CONTROL_FLAG) != 0U;
+    if (peer.frame_count < (control ? PACKET_CONTROL_LENGTH : PACKET_LENGTH))
+    {
+        return;
+    }
+    peer.frame_count = 0;
+
+    if (control)
+    {
+        peer_receive_control(now);
+        return;
+    }
+
+    comms_packet_t packet;
+    memcpy(&packet, peer.frame, PACKET_LENGTH);
+
+    if (packet.crc != calculate_crc8((uint8_t *)&packet, PACKET_CRC_INPUT_LENGTH))
+    {
+        peer.stats.crc_errors++;
+        peer_control(PACKET_RETX_TYPE, now);
+        return;
+    }
+
+    peer.stats.packets_received++;
+    bench_account(&peer.delivery, &packet);
+    peer_control(PACKET_ACK_TYPE, now);
+}
+
+static void peer_poll(uint64_t now)
+{
+    if (peer.ack_pending && now >= peer.ack_due_ns)
+    {
+        if (peer.retransmit_count >= COMMS_MAX_RETRANSMITS)
+        {
+            peer.ack_pending = false;
+            peer.stats.packets_dropped++;
+        }
+        else
+        {
+            peer.retransmit_count++;
+            peer.stats.timeout_retransmits++;
+            peer.ack_due_ns += (uint64_t)COMMS_ACK_TIMEOUT_MS * NS_PER_MS;
+            peer_transmit(&peer.unacked, PACKET_LENGTH, now);
+        }
+    }
+
+    if (config.device_sends || peer.ack_pending || atomic_load(&peer_done))
+    {
+        return;
+    }
+
+    if (peer.next_seq == config.packets)
+    {
+        atomic_store(&peer_done_ns, now);
+        atomic_store(&peer_done, true);
+        return;
+    }
+
+    bench_fill(&peer.unacked, peer.next_seq++);
+    peer.stats.packets_sent++;
+    peer.retransmit_count = 0;
+    peer.ack_pending = true;
+    peer.ack_due_ns = now + (uint64_t)COMMS_ACK_TIMEOUT_MS * NS_PER_MS;
+    peer_transmit(&peer.unacked, PACKET_LENGTH, now);
+}
+
+static void *link_thread(void *context)
+{
+    (void)context;
+
+    // wake up close to the due time of the next byte instead of the default 50us slack
+    prctl(PR_SET_TIMERSLACK, 1UL);
+
+    while (!atomic_load(&link_stop))
+    {
+        uint64_t now = host_emu_time_ns();
+        uint64_t due;
+
+        while (link_next_due(&link_up, &due) && due <= now)
+        {
+            peer_receive(link_up.queue[link_up.head & BENCH_LINK_QUEUE_MASK].value, now);
+            link_up.head++;
+        }
+
+        peer_poll(now);
+
+        uint8_t chunk[256];
+        size_t count = 0;
+        while (count < sizeof(chunk) && link_down.head + count != link_down.tail &&
+               link_down.queue[(link_down.head + count) & BENCH_LINK_QUEUE_MASK].due_ns <= now)
+        {
+            chunk[count] = link_down.queue[(link_down.head + count) & BENCH_LINK_QUEUE_MASK].value;
+            count++;
+        }
+        if (count)
+        {
+            ssize_t written = write(link_fd, chunk, count);
+            if (written > 0)
+            {
+                link_down.head += (uint32_t)written;
+            }
+        }
+
+        uint64_t wake = now + BENCH_MAX_WAIT_NS;
+        if (link_next_due(&link_up, &due) && due < wake)
+        {
+            wake = due;
+        }
+        if (link_next_due(&link_down, &due) && due < wake)
+        {
+            wake = due;
+        }
+        if (peer.ack_pending && peer.ack_due_ns < wake)
+        {
+            wake = peer.ack_due_ns;
+        }
+
+        uint64_t wait = (wake > now) ? wake - now : 0U;
+        struct timespec timeout = {.tv_sec = (time_t)(wait / NS_PER_S), .tv_nsec = (long)(wait % NS_PER_S)};
+        struct pollfd line = {.fd = link_fd, .events = POLLIN};
+        if (ppoll(&line, 1, &timeout, NULL) <= 0 || !(line.revents & POLLIN))
+        {
+            continue;
+        }
+
+        uint8_t received[256];
+        ssize_t length;
+        now = host_emu_time_ns();
+        while ((length = read(link_fd, received, sizeof(received))) > 0)
+        {
+            for (ssize_t i = 0; i < length; i++)
+            {
+                link_send(&link_up, received[i], now);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* device */
+
+static void bench_run_check(void *context)
+{
+    (void)context;
+    run_finished = atomic_load(&peer_done);
+}
+
+static double bench_trap_ns(void)
+{
+    // a register read that has no side effects, to price the emulator's trap path
+    uint64_t start = bench_thread_cpu_ns();
+    for (uint32_t i = 0; i < BENCH_TRAP_CALIBRATION; i++)
+    {
+        (void)GPIOA->IDR;
+    }
+    return (double)(bench_thread_cpu_ns() - start) / BENCH_TRAP_CALIBRATION;
+}
+
+static void bench_usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-m tx|rx] [-n packets] [-s payload] [-b baud] [-l latency_us] [-L loss] [-e ber] [-r seed] [-c]\n"
+            "  -m  tx: device sends with comms_write() (default), rx: device receives with comms_read()\n"
+            "  -n  data packets to move (default %u)\n"
+            "  -s  payload bytes per packet, 1..%u (default %u)\n"
+            "  -b  line rate in baud, 0 for an unpaced line (default %u)\n"
+            "  -l  one way latency in microseconds (default 0)\n"
+            "  -L  probability that a byte is lost (default 0)\n"
+            "  -e  bit error rate (default 0)\n"
+            "  -r  random seed (default 1)\n"
+            "  -c  print a CSV header and one row instead of the report\n",
+            name, config.packets, PACKET_DATA_LENGTH, PACKET_DATA_LENGTH, config.baud);
+    exit(2);
+}
+
+static void bench_parse(int argc, char **argv)
+{
+    int option;
+    while ((option = getopt(argc, argv, "m:n:s:b:l:L:e:r:ch")) != -1)
+    {
+        switch (option)
+        {
+        case 'm':
+            if (strcmp(optarg, "tx") && strcmp(optarg, "rx"))
+            {
+                bench_usage(argv[0]);
+            }
+            config.device_sends = (strcmp(optarg, "tx") == 0);
+            break;
+        case 'n':
+            config.packets = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+        {
+            unsigned long payload = strtoul(optarg, NULL, 0);
+            if (payload < 1 || payload > PACKET_DATA_LENGTH)
+            {
+                bench_usage(argv[0]);
+            }
+            config.payload = (uint8_t)payload;
+            break;
+        }
+        case 'b':
+            config.baud = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            config.latency_us = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'L':
+            config.loss = strtod(optarg, NULL);
+            break;
+        case 'e':
+            config.ber = strtod(optarg, NULL);
+            break;
+        case 'r':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'c':
+            config.csv = true;
+            break;
+        default:
+            bench_usage(argv[0]);
+        }
+    }
+
+    if (config.packets == 0 || optind != argc)
+    {
+        bench_usage(argv[0]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_parse(argc, argv);
+
+    link_byte_ns = config.baud ? (10ULL * NS_PER_S) / config.baud : 0U;
+    link_latency_ns = (uint64_t)config.latency_us * 1000ULL;
+    rng_state = config.seed ? config.seed : 1U;
+
+    int line[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, line) < 0)
+    {
+        perror("comms_bench: socketpair");
+        return 1;
+    }
+    host_emu_uart_attach(line[0]);
+    link_fd = line[1];
+
+    systick_init();
+    timer_wheel_init();
+    comms_setup();
+    UART2_init();
+    power_init(is_data_available, UART2_tx_idle);
+
+    // rx runs end on the peer's side; this also keeps power_idle() from sleeping past the end
+    soft_timer_init(&run_timer, bench_run_check, NULL);
+    soft_timer_start(&run_timer, BENCH_RUN_CHECK_MS, BENCH_RUN_CHECK_MS);
+
+    double trap_ns = bench_trap_ns();
+
+    host_emu_stats_t emu_start;
+    host_emu_get_stats(&emu_start);
+    uint64_t cpu_start = bench_thread_cpu_ns();
+    uint64_t start_ns = host_emu_time_ns();
+
+    pthread_t link;
+    if (pthread_create(&link, NULL, link_thread, NULL) != 0)
+    {
+        fprintf(stderr, "comms_bench: can't start the link thread\n");
+        return 1;
+    }
+
+    comms_packet_t *packet;
+    uint32_t sent = 0;
+    uint64_t end_ns = 0;
+    while (!run_finished)
+    {
+        comms_update();
+        timer_wheel_update();
+
+        if (config.device_sends)
+        {
+            if (!comms_tx_pending())
+            {
+                if (sent == config.packets)
+                {
+                    end_ns = host_emu_time_ns();
+                    break;
+                }
+                packet = comms_packet_alloc();
+                if (packet)
+                {
+                    bench_fill(packet, sent++);
+                    comms_write(packet);
+                }
+            }
+        }
+        else
+        {
+            const comms_packet_t *received;
+            while ((received = comms_read_acquire()) != NULL)
+            {
+                bench_account(&device_delivery, received);
+                comms_read_release();
+            }
+        }
+
+        power_idle();
+    }
+
+    uint64_t cpu_ns = bench_thread_cpu_ns() - cpu_start;
+    host_emu_stats_t emu_end;
+    host_emu_get_stats(&emu_end);
+
+    atomic_store(&link_stop, true);
+    pthread_join(link, NULL);
+
+    if (!config.device_sends)
+    {
+        end_ns = atomic_load(&peer_done_ns);
+    }
+
+    comms_stats_t device_stats;
+    comms_get_stats(&device_stats);
+    pool_stats_t device_pool;
+    comms_get_pool_stats(&device_pool);
+
+    const bench_delivery_t *delivery = config.device_sends ? &peer.delivery : &device_delivery;
+    const comms_stats_t *sender = config.device_sends ? &device_stats : &peer.stats;
+    double seconds = (double)(end_ns - start_ns) / NS_PER_S;
+    double goodput = delivery->payload_bytes / seconds;
+    double line_rate = config.baud / 10.0;
+    double bytes = delivery->payload_bytes ? (double)delivery->payload_bytes : 1.0;
+    uint64_t traps = emu_end.register_accesses - emu_start.register_accesses;
+    uint64_t interrupts = emu_end.interrupts - emu_start.interrupts;
+    double cycles_per_ns = HOST_CORE_CLOCK / (double)NS_PER_S;
+    double cycles = cpu_ns * cycles_per_ns / bytes;
+    double trap_cycles = traps * trap_ns * cycles_per_ns / bytes;
+
+    if (config.csv)
+    {
+        printf("mode,packets,payload,frame,baud,latency_us,loss,ber,seed,seconds,goodput_Bps,efficiency,delivered,"
+               "duplicates,missing,undetected,timeout_retransmits,retx_retransmits,dropped,device_crc_errors,"
+               "peer_crc_errors,device_byte_timeouts,peer_byte_timeouts,cycles_per_byte,trap_cycles_per_byte,"
+               "register_accesses_per_byte,interrupts_per_byte\n");
+        printf("%s,%u,%u,%u,%u,%u,%g,%g,%llu,%.6f,%.1f,%.4f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%.1f,%.1f,%.2f,%.2f\n",
+               config.device_sends ? "tx" : "rx", config.packets, config.payload, PACKET_LENGTH, config.baud,
+               config.latency_us, config.loss, config.ber, (unsigned long long)config.seed, seconds, goodput,
+               config.baud ? goodput / line_rate : 0.0, delivery->delivered, delivery->duplicates, delivery->missing,
+               delivery->undetected, sender->timeout_retransmits, sender->retx_retransmits, sender->packets_dropped,
+               device_stats.crc_errors, peer.stats.crc_errors, device_stats.byte_timeouts, peer.stats.byte_timeouts,
+               cycles, trap_cycles, traps / bytes, interrupts / bytes);
+        return 0;
+    }
+
+    printf("comms benchmark: %s, %u packets of %u/%u payload bytes (%u byte frames, %u byte ACK/RETX)\n",
+           config.device_sends ? "device -> peer (comms_write)" : "peer -> device (comms_read)", config.packets,
+           config.payload, PACKET_DATA_LENGTH, PACKET_LENGTH, PACKET_CONTROL_LENGTH);
+    printf("link: %u baud, %u us one way, loss %g per byte, ber %g, seed %llu\n\n", config.baud, config.latency_us,
+           config.loss, config.ber, (unsigned long long)config.seed);
+
+    printf("elapsed          %.3f s\n", seconds);
+    if (config.baud)
+    {
+        printf("goodput          %.1f B/s, %.1f%% of the %.0f B/s line\n", goodput, 100.0 * goodput / line_rate,
+               line_rate);
+    }
+    else
+    {
+        printf("goodput          %.1f B/s\n", goodput);
+    }
+    printf("delivered        %u packets, %u duplicates, %u missing, %u corrupt with a good CRC\n",
+           delivery->delivered, delivery->duplicates, delivery->missing, delivery->undetected);
+    printf("retransmissions  device: %u on timeout, %u on request; peer: %u on timeout, %u on request\n",
+           device_stats.timeout_retransmits, device_stats.retx_retransmits, peer.stats.timeout_retransmits,
+           peer.stats.retx_retransmits);
+    printf("given up         %u packets\n", sender->packets_dropped);
+    printf("crc errors       device %u, peer %u\n", device_stats.crc_errors, peer.stats.crc_errors);
+    printf("byte timeouts    device %u, peer %u\n", device_stats.byte_timeouts, peer.stats.byte_timeouts);
+    printf("packet pool      peak %u of %u blocks in use, %u empty allocations, %u unacked for lack of room\n",
+           device_pool.peak_used, device_pool.block_count, device_pool.failures, device_stats.rx_overflows);
+    printf("line             device -> peer %llu bytes (%llu lost, %llu corrupted), "
+           "peer -> device %llu bytes (%llu lost, %llu corrupted)\n",
+           (unsigned long long)link_up.bytes, (unsigned long long)link_up.lost, (unsigned long long)link_up.corrupted,
+           (unsigned long long)link_down.bytes, (unsigned long long)link_down.lost,
+           (unsigned long long)link_down.corrupted);
+    printf("device cpu       %.0f cycles/byte at %u MHz, of which ~%.0f emulator traps\n", cycles,
+           HOST_CORE_CLOCK / 1000000U, trap_cycles);
+    printf("                 %.2f register accesses/byte, %.2f interrupts/byte\n", traps / bytes,
+           interrupts / bytes);
+
+    return 0;
+}
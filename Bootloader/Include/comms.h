@@ -3,17 +3,45 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "crc8.h"
+#include "../../coresys/Drivers/Include/pool.h"
 
-#define PACKET_DATA_LENGTH (16)
+#ifndef PACKET_DATA_LENGTH
+#define PACKET_DATA_LENGTH (16) // both ends must agree; the benchmark overrides it to compare frame sizes
+#endif
 #define PACKET_LENGTH_BYTES (1)
 #define PACKET_CRC_BYTES (1)
 #define PACKET_CRC_INPUT_LENGTH (PACKET_DATA_LENGTH + PACKET_LENGTH_BYTES)
 #define PACKET_LENGTH (PACKET_DATA_LENGTH + PACKET_LENGTH_BYTES + PACKET_CRC_BYTES)
 
-#define PACKET_RETX_DATA0 (0x19)
-#define PACKET_ACK_DATA0 (0x15)
-#define PACKET_RETX_DATA_LENGTH (1)
-#define PACKET_ACK_DATA_LENGTH (1)
+/*
+Two kinds of frames share the line. A data packet is PACKET_LENGTH bytes: its length byte, PACKET_DATA_LENGTH
+data bytes (unused ones zero) and a CRC-8 over the first two fields. ACK and RETX only need to say which of the
+two they are, so they are control frames of PACKET_CONTROL_LENGTH bytes: a type byte with PACKET_CONTROL_FLAG
+set, which no length byte has, a sequence byte and a CRC-8 over both. The receiver tells the two apart by the
+first byte.
+
+comms.c sends its control frames with sequence 0, so they never change: they are built by the compiler, CRC
+included, and sent straight from flash. The sequence byte is ignored on receipt; it is there for a peer that
+keeps more than one packet in flight.
+
+A bit error in the first byte of a frame turns it into the other kind. The frame then ends at the wrong byte,
+exactly as after a lost byte, and the byte timeout resynchronizes both sides.
+*/
+#define PACKET_CONTROL_FLAG (0x80)
+#define PACKET_ACK_TYPE (PACKET_CONTROL_FLAG | 0x15)
+#define PACKET_RETX_TYPE (PACKET_CONTROL_FLAG | 0x19)
+#define PACKET_CONTROL_LENGTH (3)
+
+#define COMMS_ACK_TIMEOUT_MS (100)  // resend an unacknowledged data packet after this long
+#define COMMS_MAX_RETRANSMITS (5)   // give up on a data packet after this many resends
+#define COMMS_BYTE_TIMEOUT_MS (20)  // drop a partially received packet if the line goes quiet for this long
+
+// packets in flight at once: the receive queue (15), the one being received, the unacked one, the last one sent
+// for a retx request, and a couple held by the application
+#ifndef COMMS_PACKET_POOL_SIZE
+#define COMMS_PACKET_POOL_SIZE (20)
+#endif
 
 typedef struct comms_packet_
 {
@@ -22,12 +50,55 @@ typedef struct comms_packet_
     uint8_t crc;
 } comms_packet_t;
 
+typedef struct comms_control_
+{
+    uint8_t type; // PACKET_ACK_TYPE or PACKET_RETX_TYPE
+    uint8_t seq;
+    uint8_t crc;
+} comms_control_t;
+
+// a control frame as a constant initializer, CRC worked out by the compiler
+#define COMMS_CONTROL_INIT(type, seq) {(type), (seq), CRC8_BYTE(CRC8_BYTE(type) ^ (seq))}
+
+typedef struct comms_stats_
+{
+    uint32_t packets_sent;        // data packets handed to comms_write()
+    uint32_t packets_received;    // good data packets queued for comms_read()
+    uint32_t packets_dropped;     // data packets given up on after COMMS_MAX_RETRANSMITS
+    uint32_t timeout_retransmits; // resends because the ack didn't arrive in time
+    uint32_t retx_retransmits;    // resends asked for by the other side
+    uint32_t crc_errors;          // received frames answered with a retx
+    uint32_t byte_timeouts;       // partial packets dropped by the byte timer
+    uint32_t rx_overflows;        // good data packets left unacked because the queue or the pool was full
+} comms_stats_t;
+
 void comms_setup(void);
 void comms_update(void);
 
+/*
+Packets are passed by ownership, never copied: get one from comms_packet_alloc() (NULL when the pool is empty),
+fill it in and give it to comms_write(), which keeps it until it has been acked or given up on and then returns
+it to the pool. comms_read() hands over a received packet (NULL if there is none), which goes back with
+comms_packet_free() once the caller is done with it.
+
+A reader that is done with each packet before looking at the next can leave it in the receive queue instead:
+comms_read_acquire() returns the oldest packet in place (NULL if there is none) and comms_read_release() drops
+it and returns it to the pool. Either way the packet is read from the same memory the USART2 interrupt
+received it into (UART2_receive_frame() in uart.h).
+*/
+comms_packet_t *comms_packet_alloc(void);
+void comms_packet_free(comms_packet_t *packet);
+
 bool comms_packet_available(void);
 void comms_write(comms_packet_t *packet);
-void comms_read(comms_packet_t *packet);
+comms_packet_t *comms_read(void);
+const comms_packet_t *comms_read_acquire(void);
+void comms_read_release(void);
 uint8_t comms_compute_crc(comms_packet_t *packet);
 
+// true from comms_write() until the packet is acked or given up on
+bool comms_tx_pending(void);
+void comms_get_stats(comms_stats_t *stats);
+void comms_get_pool_stats(pool_stats_t *stats);
+
 #endif /* FE21EE1A_0B0A_4546_9BD6_FA0425C87443 */
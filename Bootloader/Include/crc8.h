@@ -2,9 +2,17 @@
 #define B8438117_1D6A_4D81_8948_750EACBB2901
 
 #include <stdint.h>
+#include "../../coresys/Drivers/Include/ramfunc.h"
 
-#include <stdint.h>
+// a RAMFUNC: it runs over every received frame
+RAMFUNC uint8_t calculate_crc8(uint8_t *data, uint8_t length);
 
-uint8_t calculate_crc8(uint8_t *data, uint8_t length);
+// the CRC of the single byte x, as a constant expression so the compiler can work out the CRC of a frame that
+// never changes. The CRC is linear: it is the XOR of the CRCs of the bits set in x. For more bytes, feed the
+// CRC so far into the next one: CRC8_BYTE(CRC8_BYTE(a) ^ b) is the CRC of a followed by b
+#define CRC8_BYTE(x)                                                                                        \
+    ((uint8_t)((((x) & 0x01U) ? 0x07U : 0U) ^ (((x) & 0x02U) ? 0x0EU : 0U) ^ (((x) & 0x04U) ? 0x1CU : 0U) ^  \
+               (((x) & 0x08U) ? 0x38U : 0U) ^ (((x) & 0x10U) ? 0x70U : 0U) ^ (((x) & 0x20U) ? 0xE0U : 0U) ^  \
+               (((x) & 0x40U) ? 0xC7U : 0U) ^ (((x) & 0x80U) ? 0x89U : 0U)))
 
 #endif /* B8438117_1D6A_4D81_8948_750EACBB2901 */
@@ -7,8 +7,11 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include "../../coresys/Includes/STM32F401.h"
 #include "../../coresys/Includes/core/core_cm4.h"
+#include "../../coresys/Drivers/Include/pinmux.h"
+#include "../../coresys/Drivers/Include/ramfunc.h"
 
 /*
 
@@ -31,6 +34,12 @@ Similarly, data sent from the USART2 of STM32 can travel back to the computer th
 
 #define UART_BAUD_RATE 115200
 
+// PA2 (TX) and PA3 (RX) on AF7; the pull-up keeps RX idle-high while the ST-Link bridge is unplugged
+// boards combine this with their own table to check for pin conflicts (see pinmux.h)
+#define UART2_PINMUX(X, ctx)                                                                  \
+    X(ctx, A, 2, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 7U) \
+    X(ctx, A, 3, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_UP, 7U)
+
 /*
 
 The parity control bit sets the hardware parity control (generation and detection)/
@@ -45,6 +54,8 @@ and parity is checked on the received data */
 
 void UART2_init(void);
 bool is_data_available(void);
+bool UART2_tx_idle(void);
+uint8_t UART2_tx_free(void); // bytes UART2_write() can take right now
 
 uint8_t UART2_write(const uint8_t *str, uint8_t len);
 bool UART2_write_byte(const uint8_t *str);
@@ -52,6 +63,63 @@ bool UART2_write_byte(const uint8_t *str);
 bool UART2_read_byte(uint8_t *data);
 uint8_t UART2_read(uint8_t *data, uint8_t len);
 
+/*
+# Receiving a frame in place
+
+UART2_receive_frame() hands the receive interrupt a buffer for the next frame: the ISR stores the bytes straight
+into it instead of the RX ring, so the frame is written once, by the ISR, and read where it lies. The first
+byte goes through frame_length(), which says how long the whole frame is (at least 1); once that many bytes
+are in, the ISR lets go of the buffer and later bytes queue in the ring again until the next call. Bytes that
+were already in the ring when it is called are moved over first, so nothing is reordered.
+
+frame_length() runs in the ISR: it must be short, and a RAMFUNC like the handler. UART2_frame_received() is
+the count so far, is_data_available() is also true while a complete frame waits, and UART2_receive_frame()
+again (on the same buffer, to drop a partial frame) starts over. Reads from the ring still work in between.
+*/
+typedef uint8_t (*uart_frame_length_t)(uint8_t first);
+
+uint8_t UART2_receive_frame(uint8_t *frame, uart_frame_length_t frame_length); // returns UART2_frame_received()
+uint8_t UART2_frame_received(void);
+bool UART2_frame_complete(void);
+
+/*
+# printf over USART2
+
+newlib's printf() ends in _write() (coresys/PseudoSyscalls/syscalls.c), which hands the whole formatted span to
+__io_write() below; scanf()/getchar() end in _read() and __io_read() the same way. Both copy straight between the
+caller's buffer and the rings, at most two memcpy() calls (before and after the wrap) per call, so a printf()
+costs the formatting plus a copy, microseconds, instead of one character time (87us at 115200) per character.
+
+UART2_stdio_init() also turns off stdout's buffering: the TX ring already is a buffer, and newlib's line
+buffering would only add a second copy and hold output back until the next '\n'.
+
+What happens when the TX ring is full is up to the policy:
+UART_OVERFLOW_BLOCK      sleep (WFI) until the ISR has made room; the default. Falls back to DROP inside an
+                         interrupt handler or with interrupts masked, where waiting for the ISR would never end
+UART_OVERFLOW_DROP       queue what fits, drop the rest of the span
+UART_OVERFLOW_OVERWRITE  drop the oldest queued bytes instead, so the newest output always gets out
+Every dropped byte is counted in UART2_tx_dropped(). Note that DROP and OVERWRITE can cut up anything else
+queued with UART2_write(), such as a comms packet or a log record.
+
+Reads never wait under DROP and OVERWRITE: _read() then fails with EAGAIN while the RX ring is empty. Under
+BLOCK they wait for the first byte and return whatever has arrived by then.
+
+Like UART2_write(), these expect one writer at a time; don't printf() from the main loop and from a handler.
+*/
+typedef enum uart_overflow_
+{
+    UART_OVERFLOW_BLOCK,
+    UART_OVERFLOW_DROP,
+    UART_OVERFLOW_OVERWRITE,
+} uart_overflow_t;
+
+void UART2_stdio_init(uart_overflow_t policy);
+size_t UART2_write_stream(const uint8_t *data, size_t len); // applies the policy; always consumes all of len
+size_t UART2_read_stream(uint8_t *data, size_t len);
+uint32_t UART2_tx_dropped(void);
+int __io_write(const char *ptr, int len);
+int __io_read(char *ptr, int len);
+
 #endif
 
 /*
@@ -1,31 +1,97 @@
 #include <stdint.h>
 #include "../Include/comms.h"
 #include "../Include/uart.h"
+#include "../../coresys/Drivers/Include/systick.h"
+#include "../../coresys/Drivers/Include/timer_wheel.h"
+#include "../../coresys/Drivers/Include/power.h"
+#include "../../coresys/Drivers/Include/memstat.h"
 
 #define BOOTLOADER_SIZE (0x8000U)
 #define FLASH_BASE_BOOTLOADER (0x08000000U)
-#define MAIN_APP_START_ADDR (FLASH_BASE_BOOTLOADER + BOOTLOADER_SIZE)
+#define MAIN_APP_START_ADDR (FLASH_BASE_BOOTLOADER + BOOTLOADER_SIZE) // ORIGIN(FLASH) in coresys/LinkerScript/linker.ld
 #define MAIN_APP_RESET_VECTOR (MAIN_APP_START_ADDR + sizeof(uint32_t))
 
+#define UPLOAD_CHUNK (PACKET_DATA_LENGTH - 1U) // image bytes per upload packet, after the sequence byte
+
+// the upload so far (uart_reader upload): packets taken off the receive queue, and the end of the image as
+// far as it has arrived. Nothing programs flash yet; the consumer keeps the queue drained, so every packet is
+// acked and the uploader runs to the end
+static uint32_t upload_packets = 0;
+static uint32_t upload_end = 0;
+static uint32_t upload_next = 0; // one past the highest packet number seen
+
+static void upload_consume(void)
+{
+    const comms_packet_t *packet;
+    while ((packet = comms_read_acquire()) != NULL)
+    {
+        if (packet->length > 1U && packet->length <= PACKET_DATA_LENGTH)
+        {
+            // the packet number with this sequence byte that is closest to the ones seen so far; the
+            // uploader never runs more than 128 packets ahead
+            int32_t offset = (int8_t)(uint8_t)(packet->data[0] - (uint8_t)upload_next);
+            if (offset >= 0 || (uint32_t)(-offset) <= upload_next)
+            {
+                uint32_t number = upload_next + (uint32_t)offset;
+                uint32_t end = number * UPLOAD_CHUNK + packet->length - 1U;
+                upload_next = (number >= upload_next) ? number + 1U : upload_next;
+                upload_end = (end > upload_end) ? end : upload_end;
+                upload_packets++;
+            }
+        }
+        comms_read_release();
+    }
+}
+
 void jump_to_app(void)
 {
     // main app ke vector table ke reset handler ko call krna h
+    memstat_guard_disable(); // the app sets up its own MPU regions, if any
+#ifndef HOST_EMULATION
     typedef void (*func)(void);
-    func app_reset_handler = (func)(MAIN_APP_RESET_VECTOR);
+    // the first two words of the app's table are its initial stack pointer and its Reset_Handler
+    uint32_t app_stack = *(const volatile uint32_t *)MAIN_APP_START_ADDR;
+    func app_reset_handler = (func)(*(const volatile uint32_t *)MAIN_APP_RESET_VECTOR);
+    __disable_irq();
+    // nothing of the bootloader's may interrupt the app before it has set up its own handlers
+    SysTick->CTRL = 0;
+    for (uint32_t i = 0; i < sizeof(NVIC->ICER) / sizeof(NVIC->ICER[0]); i++)
+    {
+        NVIC->ICER[i] = 0xFFFFFFFFU;
+        NVIC->ICPR[i] = 0xFFFFFFFFU;
+    }
+    SCB->VTOR = MAIN_APP_START_ADDR;
+    __set_MSP(app_stack);
+    __enable_irq();
     app_reset_handler();
+#endif
 }
 
 int main(void)
 {
+    // trap a stack overflow instead of letting comms_update() plus the USART2 handler eat into .bss
+    memstat_guard_enable();
+    systick_init();
+    timer_wheel_init();
     comms_setup();
     UART2_init();
 
+    // sleep whenever the RX ring is empty; Stop only once the UART has drained, woken by a start bit on PA3 (RX).
+    // The byte that wakes us is lost, which the comms layer tolerates: Stop needs every soft timer stopped, so
+    // no frame is half received or waiting for its ACK, and the peer resends the frame that woke us
+    power_init(is_data_available, UART2_tx_idle);
+    power_set_stop_wakeup_pin(GPIO_PORT_A, 3);
+    power_allow_stop(true);
+
     comms_packet_t packet = {.length = 0x5A, .data = {0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50}};
     packet.crc = 0xb1; 
     while (true)
     {
         // comms_write(&packet);
         comms_update();
+        upload_consume();
+        timer_wheel_update();
+        power_idle();
     }
     jump_to_app();
     return 0;
@@ -1,83 +1,110 @@
 #include "../Include/comms.h"
 #include "../Include/uart.h"
 #include "../Include/crc8.h"
+#include "../../coresys/Drivers/Include/timer_wheel.h"
+#include "../../coresys/Drivers/Include/pool.h"
 
-typedef enum comms_state_
-{
-    CommsState_Length,
-    CommsState_Data,
-    CommsState_CRC,
-} comms_state_t;
+// on the wire a frame is exactly its struct, byte for byte, so it is received straight into a pool block
+_Static_assert(sizeof(comms_packet_t) == PACKET_LENGTH, "comms_packet_t must have no padding");
+_Static_assert(sizeof(comms_control_t) == PACKET_CONTROL_LENGTH, "comms_control_t must have no padding");
+_Static_assert(PACKET_DATA_LENGTH < PACKET_CONTROL_FLAG, "a length byte must never look like a control type");
+
+static uint8_t rx_count = 0; // bytes of the frame in rx_packet as of the last comms_update()
+
+// never change, so they live in flash; RAM only holds a pointer to the one sent last
+static const comms_control_t ack_frame = COMMS_CONTROL_INIT(PACKET_ACK_TYPE, 0U);
+static const comms_control_t retx_frame = COMMS_CONTROL_INIT(PACKET_RETX_TYPE, 0U);
 
-static comms_state_t state = CommsState_Length;
-static uint8_t data_byte_count = 0;
-static comms_packet_t temporary_packet = {0};
-static comms_packet_t retx_packet = {0};
-static comms_packet_t ack_packet = {0};
-static comms_packet_t last_transmitted_packet = {0};
+// data packets are pool blocks that change hands instead of being copied: the USART2 interrupt receives into
+// rx_packet (UART2_receive_frame()), which then moves to the receive queue and on to comms_read()'s caller; comms_write() takes the
+// caller's packet and keeps it as unacked_packet (and last_transmitted_packet) until it is no longer needed
+POOL_DEFINE(packet_pool, sizeof(comms_packet_t), COMMS_PACKET_POOL_SIZE);
+static comms_packet_t *rx_packet = NULL;
+static comms_packet_t *unacked_packet = NULL;
+
+// what a retx request resends: either a data packet or a control frame, the other one is NULL
+static comms_packet_t *last_transmitted_packet = NULL;
+static const comms_control_t *last_transmitted_control = NULL;
+
+static soft_timer_t ack_timer;
+static soft_timer_t byte_timer;
+static uint8_t retransmit_count = 0;
+static comms_stats_t stats = {0};
 
 #define PACKET_BUFFER_SIZE (16)
 #define PACKET_BUFFER_MASK (PACKET_BUFFER_SIZE - 1)
 
-static comms_packet_t packet_buffer[PACKET_BUFFER_SIZE];
+static comms_packet_t *packet_buffer[PACKET_BUFFER_SIZE];
 static uint8_t packet_buffer_read_index = 0;
 static uint8_t packet_buffer_write_index = 0;
 
-static void
-comms_packet_copy(const comms_packet_t *source, comms_packet_t *dest)
+// gives a pool packet back once neither the retransmit timer nor a retx request can still need it
+static void comms_release(comms_packet_t *packet)
 {
-    dest->length = source->length;
-    for (uint8_t i = 0; i < PACKET_DATA_LENGTH; i++)
+    if (packet && packet != unacked_packet && packet != last_transmitted_packet && pool_owns(&packet_pool, packet))
     {
-        dest->data[i] = source->data[i];
+        pool_free(&packet_pool, packet);
     }
-    dest->crc = source->crc;
 }
 
-static bool comms_is_ack_packet(const comms_packet_t *packet)
+static void comms_transmit(comms_packet_t *packet)
 {
-    if (packet->length != PACKET_ACK_DATA_LENGTH)
-    {
-        return false;
-    }
+    UART2_write((const uint8_t *)packet, PACKET_LENGTH);
 
-    if (packet->data[0] != PACKET_ACK_DATA0)
-    {
-        return false;
-    }
+    comms_packet_t *previous = last_transmitted_packet;
+    last_transmitted_packet = packet;
+    last_transmitted_control = NULL;
+    comms_release(previous);
+}
 
-    for (uint8_t i = 1; i < PACKET_DATA_LENGTH; i++)
-    {
-        if (packet->data[i] != 0xff)
-        {
-            return false;
-        }
-    }
+static void comms_transmit_control(const comms_control_t *control)
+{
+    UART2_write((const uint8_t *)control, PACKET_CONTROL_LENGTH);
 
-    return true;
+    comms_packet_t *previous = last_transmitted_packet;
+    last_transmitted_packet = NULL;
+    last_transmitted_control = control;
+    comms_release(previous);
 }
 
-static bool comms_is_retx_packet(const comms_packet_t *packet)
+static void comms_retire_unacked(void)
 {
-    if (packet->length != PACKET_RETX_DATA_LENGTH)
-    {
-        return false;
-    }
+    comms_packet_t *previous = unacked_packet;
+    unacked_packet = NULL;
+    comms_release(previous);
+}
 
-    if (packet->data[0] != PACKET_RETX_DATA0)
-    {
-        return false;
-    }
+static void comms_ack_timeout(void *context)
+{
+    (void)context;
 
-    for (uint8_t i = 1; i < PACKET_DATA_LENGTH; i++)
+    if (retransmit_count >= COMMS_MAX_RETRANSMITS)
     {
-        if (packet->data[i] != 0xff)
-        {
-            return false;
-        }
+        // the other side is gone; give up on this packet
+        soft_timer_stop(&ack_timer);
+        comms_retire_unacked();
+        stats.packets_dropped++;
+        return;
     }
 
-    return true;
+    retransmit_count++;
+    stats.timeout_retransmits++;
+    comms_transmit(unacked_packet); // ack_timer is periodic, so it re-arms itself
+}
+
+// the first byte of a frame says how long it is; runs in the USART2 interrupt, from SRAM like it
+RAMFUNC static uint8_t comms_frame_bytes(uint8_t first)
+{
+    return (first & PACKET_CONTROL_FLAG) ? PACKET_CONTROL_LENGTH : PACKET_LENGTH;
+}
+
+static void comms_byte_timeout(void *context)
+{
+    (void)context;
+
+    // a partial packet has been sitting in rx_packet for too long; drop it and resync on the next byte
+    stats.byte_timeouts++;
+    rx_count = UART2_receive_frame((uint8_t *)rx_packet, comms_frame_bytes);
 }
 
 uint8_t comms_compute_crc(comms_packet_t *packet)
@@ -87,87 +114,114 @@ uint8_t comms_compute_crc(comms_packet_t *packet)
 
 void comms_setup(void)
 {
-    retx_packet.length = PACKET_RETX_DATA_LENGTH;
-    retx_packet.data[0] = PACKET_RETX_DATA0;
-    for (uint8_t i = PACKET_RETX_DATA_LENGTH; i < PACKET_DATA_LENGTH; i++)
+    pool_init(&packet_pool);
+    rx_packet = pool_alloc(&packet_pool);
+    rx_count = UART2_receive_frame((uint8_t *)rx_packet, comms_frame_bytes);
+
+    soft_timer_init(&ack_timer, comms_ack_timeout, NULL);
+    soft_timer_init(&byte_timer, comms_byte_timeout, NULL);
+}
+
+// a complete control frame has arrived at the start of rx_packet
+static void comms_handle_control(void)
+{
+    const comms_control_t *control = (const comms_control_t *)rx_packet;
+    if (control->crc != calculate_crc8((uint8_t *)rx_packet, PACKET_CONTROL_LENGTH - PACKET_CRC_BYTES))
+    {
+        stats.crc_errors++;
+        comms_transmit_control(&retx_frame);
+        return;
+    }
+
+    if (control->type == PACKET_RETX_TYPE)
+    {
+        stats.retx_retransmits++;
+        if (last_transmitted_control)
+        {
+            comms_transmit_control(last_transmitted_control);
+        }
+        else if (last_transmitted_packet)
+        {
+            comms_transmit(last_transmitted_packet);
+        }
+        return;
+    }
+
+    if (control->type == PACKET_ACK_TYPE)
+    {
+        soft_timer_stop(&ack_timer);
+        comms_retire_unacked();
+    }
+}
+
+// a complete data packet has arrived in rx_packet
+static void comms_handle_packet(void)
+{
+    if (rx_packet->crc != comms_compute_crc(rx_packet))
     {
-        retx_packet.data[i] = 0xFF;
+        stats.crc_errors++;
+        comms_transmit_control(&retx_frame);
+        return;
     }
-    retx_packet.crc = comms_compute_crc(&retx_packet);
 
-    ack_packet.length = PACKET_ACK_DATA_LENGTH;
-    ack_packet.data[0] = PACKET_ACK_DATA0;
-    for (uint8_t i = PACKET_ACK_DATA_LENGTH; i < PACKET_DATA_LENGTH; i++)
+    // hand the packet over and receive the next one into a fresh block
+    comms_packet_t *next = NULL;
+    if (((packet_buffer_write_index + 1) & PACKET_BUFFER_MASK) != packet_buffer_read_index)
+    {
+        next = pool_alloc(&packet_pool);
+    }
+    if (!next)
     {
-        ack_packet.data[i] = 0xFF;
+        // no room: don't ack, so the sender retransmits once the reader has caught up
+        stats.rx_overflows++;
+        return;
     }
-    ack_packet.crc = comms_compute_crc(&ack_packet);
+
+    packet_buffer[packet_buffer_write_index] = rx_packet;
+    packet_buffer_write_index = (packet_buffer_write_index + 1) & PACKET_BUFFER_MASK;
+    rx_packet = next;
+    stats.packets_received++;
+    comms_transmit_control(&ack_frame);
 }
 
 void comms_update(void)
 {
-    while (is_data_available())
+    // the ISR has stored the frame in rx_packet already; all that is left is to act on it once it is complete
+    while (UART2_frame_complete())
     {
-        switch ((state))
-        {
-        case CommsState_Length:
+        bool data = !(rx_packet->length & PACKET_CONTROL_FLAG);
+        if (data)
         {
-            UART2_read_byte(&(temporary_packet.length));
-            state = CommsState_Data;
-            break;
+            comms_handle_packet();
         }
-
-        case CommsState_Data:
+        else
         {
-            UART2_read_byte(&(temporary_packet.data[data_byte_count++]));
-            if (data_byte_count == PACKET_DATA_LENGTH)
-            {
-                data_byte_count = 0;
-                state = CommsState_CRC;
-            }
-            break;
+            comms_handle_control();
         }
 
-        case CommsState_CRC:
+        // rx_packet is a fresh block if the packet was queued, else the same one again; bytes that came in
+        // meanwhile move over from the RX ring
+        rx_count = 0;
+        UART2_receive_frame((uint8_t *)rx_packet, comms_frame_bytes);
+        if (data)
         {
-            UART2_read_byte(&(temporary_packet.crc));
-
-            if (temporary_packet.crc != comms_compute_crc(&temporary_packet))
-            {
-                comms_write(&retx_packet);
-                state = CommsState_Length;
-                break;
-            }
-
-            if (comms_is_retx_packet(&temporary_packet))
-            {
-                comms_write(&last_transmitted_packet);
-                state = CommsState_Length;
-                break;
-            }
-
-            if (comms_is_ack_packet(&temporary_packet))
-            {
-                state = CommsState_Length;
-                break;
-            }
-
-            comms_packet_copy(&temporary_packet, &packet_buffer[packet_buffer_write_index]);
-            packet_buffer_write_index = (packet_buffer_write_index + 1) & PACKET_BUFFER_MASK;
-            comms_write(&ack_packet);
-
-            state = CommsState_Length;
-
+            // back to the main loop, whose reader has to keep up: a sender that keeps the line busy
+            // would otherwise hold us in here until the receive queue is full
             break;
         }
+    }
 
-        default:
-        {
-            state = CommsState_Length;
-            break;
-        }
-        }
+    // the byte timeout runs from the last byte that came in
+    uint8_t received = UART2_frame_received();
+    if (received == 0 || UART2_frame_complete())
+    {
+        soft_timer_stop(&byte_timer);
+    }
+    else if (received != rx_count)
+    {
+        soft_timer_start(&byte_timer, COMMS_BYTE_TIMEOUT_MS, 0);
     }
+    rx_count = received;
 }
 
 bool comms_packet_available(void)
@@ -175,14 +229,68 @@ bool comms_packet_available(void)
     return (packet_buffer_read_index != packet_buffer_write_index);
 }
 
+comms_packet_t *comms_packet_alloc(void)
+{
+    return pool_alloc(&packet_pool);
+}
+
+void comms_packet_free(comms_packet_t *packet)
+{
+    pool_free(&packet_pool, packet);
+}
+
 void comms_write(comms_packet_t *packet)
 {
-    UART2_write((uint8_t *)packet, PACKET_LENGTH);
-    comms_packet_copy(packet, &last_transmitted_packet);
+    // keep the data packet until the ack arrives; the retransmit timer resends it on timeout
+    comms_packet_t *previous = unacked_packet;
+    unacked_packet = packet;
+    comms_release(previous); // still held if it was the last one sent; comms_transmit() then lets it go
+
+    comms_transmit(packet);
+    retransmit_count = 0;
+    stats.packets_sent++;
+    soft_timer_start(&ack_timer, COMMS_ACK_TIMEOUT_MS, COMMS_ACK_TIMEOUT_MS);
 }
 
-void comms_read(comms_packet_t *packet)
+comms_packet_t *comms_read(void)
 {
-    comms_packet_copy(&(packet_buffer[packet_buffer_read_index]), packet);
+    if (!comms_packet_available())
+    {
+        return NULL;
+    }
+
+    comms_packet_t *packet = packet_buffer[packet_buffer_read_index];
     packet_buffer_read_index = (packet_buffer_read_index + 1) & PACKET_BUFFER_MASK;
-}
\ No newline at end of file
+    return packet;
+}
+
+const comms_packet_t *comms_read_acquire(void)
+{
+    if (!comms_packet_available())
+    {
+        return NULL;
+    }
+
+    return packet_buffer[packet_buffer_read_index];
+}
+
+void comms_read_release(void)
+{
+    comms_packet_t *packet = comms_read();
+    pool_free(&packet_pool, packet);
+}
+
+bool comms_tx_pending(void)
+{
+    return soft_timer_is_active(&ack_timer);
+}
+
+void comms_get_stats(comms_stats_t *out)
+{
+    *out = stats;
+}
+
+void comms_get_pool_stats(pool_stats_t *out)
+{
+    pool_get_stats(&packet_pool, out);
+}
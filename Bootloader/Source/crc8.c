@@ -3,7 +3,7 @@
 
 #include "../Include/crc8.h"
 
-uint8_t calculate_crc8(uint8_t *data, uint8_t length)
+RAMFUNC uint8_t calculate_crc8(uint8_t *data, uint8_t length)
 {
     uint8_t crc = 0x00;
 
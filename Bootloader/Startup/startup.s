@@ -5,7 +5,6 @@
 
 .global g_pfnVectors
 .global Default_Handler
-.global USART2_Handler
 
 // Stack and memory section pointers from linker script
 .word _sidata
@@ -20,6 +19,18 @@
 .weak Reset_Handler
 .type Reset_Handler, %function
 Reset_Handler:
+    // Start the DWT cycle counter first, so that startup_cycles (startup.h) covers everything up to main()
+    ldr r0, =0xE000EDFC         // CoreDebug DEMCR
+    ldr r1, [r0]
+    orr r1, r1, #0x01000000     // TRCENA: turns on the DWT
+    str r1, [r0]
+    ldr r0, =0xE0001000         // DWT CTRL, CYCCNT at +4
+    movs r1, #0
+    str r1, [r0, #4]
+    ldr r1, [r0]
+    orr r1, r1, #1              // CYCCNTENA
+    str r1, [r0]
+
     // Load and verify stack pointer
     ldr r0, =_estack
     ldr r1, =__stack_limit
@@ -27,43 +38,114 @@ Reset_Handler:
     bls StackError
     mov sp, r0
 
+    // Point VTOR at this image's table: the app is linked behind the bootloader (0x08008000), and the core
+    // comes out of reset using the one at 0x08000000
+    ldr r0, =0xE000ED08         // SCB VTOR
+    ldr r1, =g_pfnVectors
+    str r1, [r0]
+
     // Initialize system
     bl SystemInit
 
-    // Copy .data section to SRAM
+    // The three loops below move 8 words per ldm/stm (9 cycles each) and finish with single words. All the
+    // regions start and end on a word boundary (ALIGN(4) in the linker script).
+
+    // Copy .data (and .ramfunc code) from flash to SRAM
     ldr r0, =_sdata     // Destination
     ldr r1, =_edata     // End of destination
     ldr r2, =_sidata    // Source
-    
-    // Skip if no data to copy
-    cmp r0, r1
+    subs r3, r1, r0     // bytes to copy
+    subs r3, r3, #32
+    blo .L_copy_tail
+
+.L_copy_burst:
+    ldmia r2!, {r4-r11}
+    stmia r0!, {r4-r11}
+    subs r3, r3, #32
+    bhs .L_copy_burst
+
+.L_copy_tail:
+    adds r3, r3, #32    // 0 to 28 bytes left
     beq .L_bss_init
-    
-.L_copy_data:
-    ldr r3, [r2], #4
-    str r3, [r0], #4
-    cmp r0, r1
-    bne .L_copy_data
 
-.L_bss_init:    
+.L_copy_word:
+    ldr r4, [r2], #4
+    str r4, [r0], #4
+    subs r3, r3, #4
+    bne .L_copy_word
+
+.L_bss_init:
     // Zero .bss section
     ldr r0, =__bss_start__
     ldr r1, =__bss_end__
-    movs r2, #0
-    
-    // Skip if no BSS to clear
-    cmp r0, r1
+    movs r4, #0
+    movs r5, #0
+    movs r6, #0
+    movs r7, #0
+    mov r8, r4
+    mov r9, r4
+    mov r10, r4
+    mov r11, r4
+    subs r3, r1, r0
+    subs r3, r3, #32
+    blo .L_zero_tail
+
+.L_zero_burst:
+    stmia r0!, {r4-r11}
+    subs r3, r3, #32
+    bhs .L_zero_burst
+
+.L_zero_tail:
+    adds r3, r3, #32
+    beq .L_paint_stack
+
+.L_zero_word:
+    str r4, [r0], #4
+    subs r3, r3, #4
+    bne .L_zero_word
+
+.L_paint_stack:
+    // Fill the unused stack with MEMSTAT_STACK_PAINT (memstat.h); whatever still holds it later was never used
+    ldr r0, =__stack_limit
+    mov r1, sp
+    ldr r4, =0xA5A5A5A5
+    mov r5, r4
+    mov r6, r4
+    mov r7, r4
+    mov r8, r4
+    mov r9, r4
+    mov r10, r4
+    mov r11, r4
+    subs r3, r1, r0
+    subs r3, r3, #32
+    blo .L_paint_tail
+
+.L_paint_burst:
+    stmia r0!, {r4-r11}
+    subs r3, r3, #32
+    bhs .L_paint_burst
+
+.L_paint_tail:
+    adds r3, r3, #32
     beq .L_init_arrays
-    
-.L_zero_bss:
-    str r2, [r0], #4
-    cmp r0, r1
-    bne .L_zero_bss
 
-.L_init_arrays:    
-    // Call C++ static constructors
+.L_paint_word:
+    str r4, [r0], #4
+    subs r3, r3, #4
+    bne .L_paint_word
+
+.L_init_arrays:
+.ifdef STARTUP_LIBC_INIT
+    // Call C++ static constructors; only assembled in with -Wa,--defsym,STARTUP_LIBC_INIT=1 (see startup.h)
     bl __libc_init_array
-    
+.endif
+
+    // Reset to main() in core cycles
+    ldr r0, =0xE0001004         // DWT CYCCNT
+    ldr r0, [r0]
+    ldr r1, =startup_cycles
+    str r0, [r1]
+
     // Enter main
     bl main
 
@@ -73,6 +155,15 @@ StackError:
     
 .size Reset_Handler, .-Reset_Handler
 
+// Cycles from reset to the call of main(), from the DWT cycle counter (startup.h)
+.section .bss.startup_cycles,"aw",%nobits
+.align 2
+.global startup_cycles
+.type startup_cycles, %object
+startup_cycles:
+    .space 4
+.size startup_cycles, .-startup_cycles
+
 // Properly aligned default handler section
 .align 4
 .section .text.Default_Handler,"ax",%progbits
@@ -84,7 +175,6 @@ Default_Handler:
 .align 8
 .section .isr_vector,"a",%progbits
 .type g_pfnVectors, %object
-.size g_pfnVectors, .-g_pfnVectors
 g_pfnVectors:
     .word _estack
     .word Reset_Handler
@@ -103,16 +193,94 @@ g_pfnVectors:
     .word PendSV_Handler
     .word SysTick_Handler
     
-    // Remaining interrupt vectors
-    .rept 38
-    .word Default_Handler
-    .endr
-    
-    .word USART2_Handler
+    // device interrupts, IRQn in STM32F401.h; reserved slots stay 0
+    .word WWDG_Handler                // 0
+    .word PVD_Handler                 // 1
+    .word TAMP_STAMP_Handler          // 2
+    .word RTC_WKUP_Handler            // 3
+    .word FLASH_Handler               // 4
+    .word RCC_Handler                 // 5
+    .word EXTI0_Handler               // 6
+    .word EXTI1_Handler               // 7
+    .word EXTI2_Handler               // 8
+    .word EXTI3_Handler               // 9
+    .word EXTI4_Handler               // 10
+    .word DMA1_Stream0_Handler        // 11
+    .word DMA1_Stream1_Handler        // 12
+    .word DMA1_Stream2_Handler        // 13
+    .word DMA1_Stream3_Handler        // 14
+    .word DMA1_Stream4_Handler        // 15
+    .word DMA1_Stream5_Handler        // 16
+    .word DMA1_Stream6_Handler        // 17
+    .word ADC_Handler                 // 18
+    .word 0                           // 19 reserved
+    .word 0                           // 20 reserved
+    .word 0                           // 21 reserved
+    .word 0                           // 22 reserved
+    .word EXTI9_5_Handler             // 23
+    .word TIM1_BRK_TIM9_Handler       // 24
+    .word TIM1_UP_TIM10_Handler       // 25
+    .word TIM1_TRG_COM_TIM11_Handler  // 26
+    .word TIM1_CC_Handler             // 27
+    .word TIM2_Handler                // 28
+    .word TIM3_Handler                // 29
+    .word TIM4_Handler                // 30
+    .word I2C1_EV_Handler             // 31
+    .word I2C1_ER_Handler             // 32
+    .word I2C2_EV_Handler             // 33
+    .word I2C2_ER_Handler             // 34
+    .word SPI1_Handler                // 35
+    .word SPI2_Handler                // 36
+    .word USART1_Handler              // 37
+    .word USART2_Handler              // 38
+    .word 0                           // 39 reserved
+    .word EXTI15_10_Handler           // 40
+    .word RTC_Alarm_Handler           // 41
+    .word OTG_FS_WKUP_Handler         // 42
+    .word 0                           // 43 reserved
+    .word 0                           // 44 reserved
+    .word 0                           // 45 reserved
+    .word 0                           // 46 reserved
+    .word DMA1_Stream7_Handler        // 47
+    .word 0                           // 48 reserved
+    .word SDIO_Handler                // 49
+    .word TIM5_Handler                // 50
+    .word SPI3_Handler                // 51
+    .word 0                           // 52 reserved
+    .word 0                           // 53 reserved
+    .word 0                           // 54 reserved
+    .word 0                           // 55 reserved
+    .word DMA2_Stream0_Handler        // 56
+    .word DMA2_Stream1_Handler        // 57
+    .word DMA2_Stream2_Handler        // 58
+    .word DMA2_Stream3_Handler        // 59
+    .word DMA2_Stream4_Handler        // 60
+    .word 0                           // 61 reserved
+    .word 0                           // 62 reserved
+    .word 0                           // 63 reserved
+    .word 0                           // 64 reserved
+    .word 0                           // 65 reserved
+    .word 0                           // 66 reserved
+    .word OTG_FS_Handler              // 67
+    .word DMA2_Stream5_Handler        // 68
+    .word DMA2_Stream6_Handler        // 69
+    .word DMA2_Stream7_Handler        // 70
+    .word USART6_Handler              // 71
+    .word I2C3_EV_Handler             // 72
+    .word I2C3_ER_Handler             // 73
+    .word 0                           // 74 reserved
+    .word 0                           // 75 reserved
+    .word 0                           // 76 reserved
+    .word 0                           // 77 reserved
+    .word 0                           // 78 reserved
+    .word 0                           // 79 reserved
+    .word 0                           // 80 reserved
+    .word FPU_Handler                 // 81
+    .word 0                           // 82 reserved
+    .word 0                           // 83 reserved
+    .word SPI4_Handler                // 84
 
-    .rept 45
-    .word Default_Handler
-    .endr
+.size g_pfnVectors, .-g_pfnVectors
 
 // Default implementation for SystemInit
 .section .text.SystemInit
@@ -141,5 +309,117 @@ SystemInit:
 .thumb_set PendSV_Handler,Default_Handler
 .weak SysTick_Handler
 .thumb_set SysTick_Handler,Default_Handler
+
+// every device interrupt; a driver takes one over by defining the function
+.weak WWDG_Handler
+.thumb_set WWDG_Handler,Default_Handler
+.weak PVD_Handler
+.thumb_set PVD_Handler,Default_Handler
+.weak TAMP_STAMP_Handler
+.thumb_set TAMP_STAMP_Handler,Default_Handler
+.weak RTC_WKUP_Handler
+.thumb_set RTC_WKUP_Handler,Default_Handler
+.weak FLASH_Handler
+.thumb_set FLASH_Handler,Default_Handler
+.weak RCC_Handler
+.thumb_set RCC_Handler,Default_Handler
+.weak EXTI0_Handler
+.thumb_set EXTI0_Handler,Default_Handler
+.weak EXTI1_Handler
+.thumb_set EXTI1_Handler,Default_Handler
+.weak EXTI2_Handler
+.thumb_set EXTI2_Handler,Default_Handler
+.weak EXTI3_Handler
+.thumb_set EXTI3_Handler,Default_Handler
+.weak EXTI4_Handler
+.thumb_set EXTI4_Handler,Default_Handler
+.weak DMA1_Stream0_Handler
+.thumb_set DMA1_Stream0_Handler,Default_Handler
+.weak DMA1_Stream1_Handler
+.thumb_set DMA1_Stream1_Handler,Default_Handler
+.weak DMA1_Stream2_Handler
+.thumb_set DMA1_Stream2_Handler,Default_Handler
+.weak DMA1_Stream3_Handler
+.thumb_set DMA1_Stream3_Handler,Default_Handler
+.weak DMA1_Stream4_Handler
+.thumb_set DMA1_Stream4_Handler,Default_Handler
+.weak DMA1_Stream5_Handler
+.thumb_set DMA1_Stream5_Handler,Default_Handler
+.weak DMA1_Stream6_Handler
+.thumb_set DMA1_Stream6_Handler,Default_Handler
+.weak ADC_Handler
+.thumb_set ADC_Handler,Default_Handler
+.weak EXTI9_5_Handler
+.thumb_set EXTI9_5_Handler,Default_Handler
+.weak TIM1_BRK_TIM9_Handler
+.thumb_set TIM1_BRK_TIM9_Handler,Default_Handler
+.weak TIM1_UP_TIM10_Handler
+.thumb_set TIM1_UP_TIM10_Handler,Default_Handler
+.weak TIM1_TRG_COM_TIM11_Handler
+.thumb_set TIM1_TRG_COM_TIM11_Handler,Default_Handler
+.weak TIM1_CC_Handler
+.thumb_set TIM1_CC_Handler,Default_Handler
+.weak TIM2_Handler
+.thumb_set TIM2_Handler,Default_Handler
+.weak TIM3_Handler
+.thumb_set TIM3_Handler,Default_Handler
+.weak TIM4_Handler
+.thumb_set TIM4_Handler,Default_Handler
+.weak I2C1_EV_Handler
+.thumb_set I2C1_EV_Handler,Default_Handler
+.weak I2C1_ER_Handler
+.thumb_set I2C1_ER_Handler,Default_Handler
+.weak I2C2_EV_Handler
+.thumb_set I2C2_EV_Handler,Default_Handler
+.weak I2C2_ER_Handler
+.thumb_set I2C2_ER_Handler,Default_Handler
+.weak SPI1_Handler
+.thumb_set SPI1_Handler,Default_Handler
+.weak SPI2_Handler
+.thumb_set SPI2_Handler,Default_Handler
+.weak USART1_Handler
+.thumb_set USART1_Handler,Default_Handler
 .weak USART2_Handler
-.thumb_set USART2_Handler,Default_Handler
\ No newline at end of file
+.thumb_set USART2_Handler,Default_Handler
+.weak EXTI15_10_Handler
+.thumb_set EXTI15_10_Handler,Default_Handler
+.weak RTC_Alarm_Handler
+.thumb_set RTC_Alarm_Handler,Default_Handler
+.weak OTG_FS_WKUP_Handler
+.thumb_set OTG_FS_WKUP_Handler,Default_Handler
+.weak DMA1_Stream7_Handler
+.thumb_set DMA1_Stream7_Handler,Default_Handler
+.weak SDIO_Handler
+.thumb_set SDIO_Handler,Default_Handler
+.weak TIM5_Handler
+.thumb_set TIM5_Handler,Default_Handler
+.weak SPI3_Handler
+.thumb_set SPI3_Handler,Default_Handler
+.weak DMA2_Stream0_Handler
+.thumb_set DMA2_Stream0_Handler,Default_Handler
+.weak DMA2_Stream1_Handler
+.thumb_set DMA2_Stream1_Handler,Default_Handler
+.weak DMA2_Stream2_Handler
+.thumb_set DMA2_Stream2_Handler,Default_Handler
+.weak DMA2_Stream3_Handler
+.thumb_set DMA2_Stream3_Handler,Default_Handler
+.weak DMA2_Stream4_Handler
+.thumb_set DMA2_Stream4_Handler,Default_Handler
+.weak OTG_FS_Handler
+.thumb_set OTG_FS_Handler,Default_Handler
+.weak DMA2_Stream5_Handler
+.thumb_set DMA2_Stream5_Handler,Default_Handler
+.weak DMA2_Stream6_Handler
+.thumb_set DMA2_Stream6_Handler,Default_Handler
+.weak DMA2_Stream7_Handler
+.thumb_set DMA2_Stream7_Handler,Default_Handler
+.weak USART6_Handler
+.thumb_set USART6_Handler,Default_Handler
+.weak I2C3_EV_Handler
+.thumb_set I2C3_EV_Handler,Default_Handler
+.weak I2C3_ER_Handler
+.thumb_set I2C3_ER_Handler,Default_Handler
+.weak FPU_Handler
+.thumb_set FPU_Handler,Default_Handler
+.weak SPI4_Handler
+.thumb_set SPI4_Handler,Default_Handler
@@ -0,0 +1,28 @@
+# Builds a single image for a blank chip: the bootloader padded with 0xFF (erased flash) up to BOOTLOADER_SIZE,
+# followed by the application, ready for st-flash write <output> 0x08000000.
+# The application build itself no longer contains the bootloader; see coresys/LinkerScript/linker.ld.
+#
+# usage: python3 combine_image.py <bootloader.bin> <app.bin> <output.bin>
+
+import sys
+
+BOOTLOADER_SIZE = 0x8000 # keep in sync with bootloader.c and both linker scripts
+
+if len(sys.argv) != 4:
+    sys.exit("usage: combine_image.py <bootloader.bin> <app.bin> <output.bin>")
+
+bootloader_file, app_file, output_file = sys.argv[1:]
+
+with open(bootloader_file, "rb") as f:
+    bootloader = f.read()
+
+with open(app_file, "rb") as f:
+    app = f.read()
+
+if len(bootloader) > BOOTLOADER_SIZE:
+    sys.exit(f"{bootloader_file} is {len(bootloader)} bytes, more than the {BOOTLOADER_SIZE} reserved for it")
+
+padding = bytes(0xff for _ in range(BOOTLOADER_SIZE - len(bootloader)))
+
+with open(output_file, "wb") as f:
+    f.write(bootloader + padding + app)
@@ -2,46 +2,54 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "../../coresys/Includes/STM32F401.h"
+#include "../../coresys/Drivers/Include/systick.h"
+#include "../../coresys/Drivers/Include/timer_wheel.h"
+#include "../../coresys/Drivers/Include/power.h"
+#include "../../coresys/Drivers/Include/exti_input.h"
+#include "../../coresys/Drivers/Include/gpio.h"
+#include "../../coresys/Drivers/Include/pinmux.h"
 
 // Pin definitions
-#define GPIOA_EN_BIT 0
-#define GPIOC_EN_BIT 2
 #define LED_PIN 5
 #define BTN_PIN 13
+#define LED GPIO_PIN(A, LED_PIN)
 
-// Utility macros
-#define SET_BIT(reg, bit) ((reg) |= (1UL << (bit)))
-#define CLEAR_BIT(reg, bit) ((reg) &= ~(1UL << (bit)))
-#define READ_BIT(reg, bit) ((reg) & (1UL << (bit)))
+#define BTN_DEBOUNCE_MS 20
+
+// PA5 drives the LED; PC13 is the button (the Nucleo board has an external pull-up)
+#define BOARD_PINMUX(X, ctx)                                                                     \
+    X(ctx, A, LED_PIN, PINMUX_MODE_OUTPUT, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 0U) \
+    X(ctx, C, BTN_PIN, PINMUX_MODE_INPUT, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 0U)
+
+PINMUX_CHECK_CONFLICTS(BOARD_PINMUX);
 
 int main(void)
 {
-    // Enable clock access to GPIOA and GPIOC
-    SET_BIT(RCC->AHB1ENR, GPIOA_EN_BIT); // Enable GPIOA clock
-    SET_BIT(RCC->AHB1ENR, GPIOC_EN_BIT); // Enable GPIOC clock
+    // Enable GPIOA/GPIOC clocks, PA5 as output and PC13 as input; one write per register
+    PINMUX_APPLY(BOARD_PINMUX);
+
+    systick_init();
+    timer_wheel_init();
 
-    // Configure PA5 (LED) as output
-    // Clear bits first then set required bit
-    CLEAR_BIT(GPIOA->MODER, (LED_PIN * 2 + 1)); // Clear bit 11
-    SET_BIT(GPIOA->MODER, (LED_PIN * 2));       // Set bit 10
+    // Configure PC13 (Button) as an EXTI input on both edges; the Nucleo board has an external pull-up
+    exti_input_init(BTN_DEBOUNCE_MS);
+    exti_input_add(GPIO_PORT_C, BTN_PIN, EXTI_EDGE_BOTH, EXTI_PULL_NONE);
 
-    // Configure PC13 (Button) as input
-    // Input mode is 00, so just clear both bits
-    CLEAR_BIT(GPIOC->MODER, (BTN_PIN * 2));     // Clear bit 26
-    CLEAR_BIT(GPIOC->MODER, (BTN_PIN * 2 + 1)); // Clear bit 27
+    // sleep until a debounced button event is queued; the EXTI line wakes us from Stop as well, so nothing is
+    // lost there, but not while a debounce interval is running
+    power_init(exti_input_event_pending, exti_input_idle);
+    power_allow_stop(true);
 
+    exti_event_t event;
     while (true)
     {
-        // Button is active low
-        if (READ_BIT(GPIOC->IDR, BTN_PIN))
+        while (exti_input_read_event(&event))
         {
-            // Turn LED on by setting bit in BSRR lower half
-            SET_BIT(GPIOA->BSRR, LED_PIN);
-        }
-        else
-        {
-            // Turn LED off by setting bit in BSRR upper half
-            SET_BIT(GPIOA->BSRR, (LED_PIN + 16));
+            // Button is active low; the LED follows the released (high) level
+            // a single BSRR store: lower half sets, upper half resets
+            gpio_write(LED, event.level);
         }
+
+        power_idle();
     }
-}
\ No newline at end of file
+}
@@ -1,32 +1,59 @@
 // where is the LED connected?
 // Port: A
-// Pin: 5
+// Pin: 5, which is also TIM2_CH1 (AF1)
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include "../../coresys/Includes/STM32F401.h"
+#include "../../coresys/Drivers/Include/systick.h"
+#include "../../coresys/Drivers/Include/timer_wheel.h"
+#include "../../coresys/Drivers/Include/power.h"
+#include "../../coresys/Drivers/Include/pinmux.h"
+#include "../../coresys/Drivers/Include/tim.h"
 
-#define GPIOA_EN (1UL << 0) // first bit in the AHB1 enable register is for enabling GPIOA
-#define PIN5 (1UL << 5)     // 5th bit in the GPIOA output data register is for sending data to PIN5
-#define PIN5_OUT (01UL << 10)
+#define BOARD_PINMUX(X, ctx) \
+    X(ctx, A, 5, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 1U)
 
-#define __IO volatile
+PINMUX_CHECK_CONFLICTS(BOARD_PINMUX);
 
+#define BREATH_PWM_HZ 250U
+#define BREATH_STEPS 1000U
+#define BREATH_PERIOD_MS 2000U
+#define BREATH_UPDATES (BREATH_PWM_HZ * BREATH_PERIOD_MS / 1000U) // one duty per PWM period
+#define BREATH_HALF (BREATH_UPDATES / 2U)
+
+static uint32_t breath[BREATH_UPDATES];
+
+static void breath_fill(void)
+{
+    // brightness is perceived roughly as the square root of the duty, so a squared ramp looks linear
+    for (uint32_t i = 0; i < BREATH_HALF; i++)
+    {
+        uint32_t duty = (i * i * BREATH_STEPS) / (BREATH_HALF * BREATH_HALF);
+        breath[i] = duty;
+        breath[BREATH_UPDATES - 1U - i] = duty;
+    }
+}
 
 int main(void)
 {
-    // 1. enable clock access to GPIOA
-    RCC->AHB1ENR |= GPIOA_EN;
-    // 2. set PA5 as an output pin
-    GPIOA->MODER |= PIN5_OUT;
+    // 1. enable clock access to GPIOA and 2. hand PA5 over to TIM2; a single RCC and MODER write
+    PINMUX_APPLY(BOARD_PINMUX);
+
+    // 3. TIM2 runs the PWM and the DMA feeds it the next duty at every period; the CPU never touches the LED
+    breath_fill();
+    tim_pwm_init(TIM_ID_2, BREATH_PWM_HZ, BREATH_STEPS);
+    tim_pwm_start(TIM_ID_2, 1U, false);
+    tim_burst_start(TIM_ID_2, 1U, 1U, breath, BREATH_UPDATES, true);
+
+    systick_init();
+    timer_wheel_init();
+    power_init(NULL, NULL); // Sleep only: Stop mode would freeze the timer and the DMA
 
     while (true)
     {
-        // 4. Toggle PA5
-        // GPIOA_OD_R ^= PIN5
-        GPIOA->ODR ^= PIN5; // XOR just inverts the bit number in OD_R that is set to 1 in PIN5
-        for (volatile size_t i = 0; i < 1000000; i++)
-            ;
+        timer_wheel_update();
+        power_idle();
     }
 }
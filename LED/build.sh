@@ -12,6 +12,7 @@ OUTPUT_ELF="Binaries/$2.elf"
 OUTPUT_BIN="Binaries/$2.bin"
 LINKER_SCRIPT="../coresys/LinkerScript/linker.ld"
 MAP_FILE="Binaries/$2.map"
+DRIVER_SOURCES="../coresys/Drivers/Source/systick.c ../coresys/Drivers/Source/timer_wheel.c ../coresys/Drivers/Source/power.c ../coresys/Drivers/Source/tim.c ../coresys/Drivers/Source/dma.c ../coresys/Drivers/Source/vectors.c"
 
 # Compile and link the project with optimizations
 arm-none-eabi-gcc \
@@ -24,6 +25,7 @@ arm-none-eabi-gcc \
     -O2 -Os \
     -Wall \
     "$SOURCE_FILE" \
+    $DRIVER_SOURCES \
     ../coresys/Startup/startup.s \
     ../coresys/PseudoSyscalls/syscalls.c \
     ../coresys/PseudoSyscalls/sysmem.c \
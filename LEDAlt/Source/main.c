@@ -1,37 +1,69 @@
 // where is the LED connected?
 // Port: A
-// Pin: 5
+// Pin: 5, which is also TIM2_CH1 (AF1)
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include "../../coresys/Includes/STM32F401.h"
+#include "../../coresys/Drivers/Include/systick.h"
+#include "../../coresys/Drivers/Include/timer_wheel.h"
+#include "../../coresys/Drivers/Include/power.h"
+#include "../../coresys/Drivers/Include/pinmux.h"
+#include "../../coresys/Drivers/Include/tim.h"
 
-#define GPIOA_EN (1UL << 0) // first bit in the AHB1 enable register is for enabling GPIOA
-#define PIN5 (1UL << 5)     // 5th bit in the GPIOA output data register is for sending data to PIN5
-#define PIN5_OUT (01UL << 10)
+#define BOARD_PINMUX(X, ctx) \
+    X(ctx, A, 5, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 1U)
 
-#define __IO volatile
+PINMUX_CHECK_CONFLICTS(BOARD_PINMUX);
 
+#define LED_PWM_HZ 1000U
+#define LED_STEPS 1000U
+#define LED_FADE_IN_MS 250U
+#define LED_FADE_OUT_MS 750U
+#define LED_STEP_MS 10U
+
+static soft_timer_t led_timer;
+
+static void led_step(void *context)
+{
+    static uint32_t elapsed_ms = 0;
+    uint32_t level; // 0 to LED_STEPS, linear in time
+    (void)context;
+
+    // a quick fade in and a slow fade out: the same rhythm the on and off phases used to have
+    if (elapsed_ms < LED_FADE_IN_MS)
+    {
+        level = elapsed_ms * LED_STEPS / LED_FADE_IN_MS;
+    }
+    else
+    {
+        level = (LED_FADE_IN_MS + LED_FADE_OUT_MS - elapsed_ms) * LED_STEPS / LED_FADE_OUT_MS;
+    }
+    elapsed_ms = (elapsed_ms + LED_STEP_MS) % (LED_FADE_IN_MS + LED_FADE_OUT_MS);
+
+    // brightness is perceived roughly as the square root of the duty, so a squared ramp looks linear
+    tim_pwm_set(TIM_ID_2, 1U, level * level / LED_STEPS);
+}
 
 int main(void)
 {
-    // 1. enable clock access to GPIOA
-    RCC->AHB1ENR |= GPIOA_EN;
-    // 2. set PA5 as an output pin
-    GPIOA->MODER |= PIN5_OUT;
+    // 1. enable clock access to GPIOA and 2. hand PA5 over to TIM2; a single RCC and MODER write
+    PINMUX_APPLY(BOARD_PINMUX);
+
+    // 3. TIM2 makes the PWM edges; the CPU only picks a new duty every LED_STEP_MS
+    tim_pwm_init(TIM_ID_2, LED_PWM_HZ, LED_STEPS);
+    tim_pwm_start(TIM_ID_2, 1U, false);
+
+    systick_init();
+    timer_wheel_init();
+    power_init(NULL, NULL);
+    soft_timer_init(&led_timer, led_step, NULL);
+    soft_timer_start(&led_timer, 0, LED_STEP_MS);
 
     while (true)
     {
-        // 4. Toggle PA5
-        // GPIOA_OD_R ^= PIN5
-        // GPIOA->ODR ^= PIN5; // XOR just inverts the bit number in OD_R that is set to 1 in PIN5
-        GPIOA->BSRR = PIN5;
-        for (volatile size_t i = 0; i < 1000000; i++)
-            ;
-
-        GPIOA->BSRR = (1UL << 21);
-        for (volatile size_t i = 0; i < 1000000; i++)
-            ;
+        timer_wheel_update();
+        power_idle(); // tickless sleep until the next duty update
     }
 }
@@ -2,15 +2,97 @@
 #define LED_PIN PIN5
 
 #include "../Include/uart.h"
+#include "../../coresys/Drivers/Include/systick.h"
+#include "../../coresys/Drivers/Include/timer_wheel.h"
+#include "../../coresys/Drivers/Include/power.h"
+#include "../../coresys/Drivers/Include/gpio.h"
+#include "../../coresys/Drivers/Include/dlog.h"
+#include "../../coresys/Drivers/Include/memstat.h"
+#include "../../coresys/Drivers/Include/startup.h"
+#include "../../coresys/Drivers/Include/dma_copy.h"
+
+#define LED_PINMUX(X, ctx) \
+    X(ctx, A, LED_PIN, PINMUX_MODE_OUTPUT, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 0U)
+
+// the LED and USART2 share GPIOA; fail the build if they ever claim the same pin
+#define BOARD_PINMUX(X, ctx) UART2_PINMUX(X, ctx) LED_PINMUX(X, ctx)
+PINMUX_CHECK_CONFLICTS(BOARD_PINMUX);
+
+// hand whole log records to the TX ring; never a partial one, so echoed bytes can't land inside a record
+static void flush_log(void)
+{
+    uint8_t record[DLOG_MAX_RECORD];
+    uint8_t length;
+    while ((length = dlog_read_record(record, UART2_tx_free())) > 0)
+    {
+        UART2_write(record, length);
+    }
+}
+
+#ifdef DMA_COPY_BENCH
+#ifndef HOST_EMULATION
+#define BENCH_FLASH_SOURCE ((const void *)FLASH_BASE)
+#else
+#define BENCH_FLASH_SOURCE ((const void *)bench_source) // no flash on the host
+#endif
+
+static uint8_t bench_source[1024] __attribute__((aligned(16)));
+static uint8_t bench_destination[1024] __attribute__((aligned(16)));
+
+// times CPU and DMA copies from RAM and from flash; DMA_COPY_THRESHOLD comes from the crossovers logged here.
+// Blocks the boot and takes 2K of RAM, so only in a build with DMA_COPY_BENCH defined
+static void bench_copies(void)
+{
+    static const uint32_t sizes[] = {16U, 64U, 256U, 1024U};
+    dma_copy_bench_t results[sizeof(sizes) / sizeof(sizes[0])];
+    const uint8_t count = sizeof(sizes) / sizeof(sizes[0]);
+
+    uint32_t crossover = dma_copy_bench(bench_destination, bench_source, sizes, results, count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        DLOG("RAM copy %u bytes: cpu %u, dma %u cycles, %u of them on the cpu", results[i].bytes,
+             results[i].cpu_cycles, results[i].dma_cycles, results[i].share_cycles);
+    }
+    DLOG("RAM copy crossover %u bytes", crossover);
+
+    crossover = dma_copy_bench(bench_destination, BENCH_FLASH_SOURCE, sizes, results, count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        DLOG("flash copy %u bytes: cpu %u, dma %u cycles, %u of them on the cpu", results[i].bytes,
+             results[i].cpu_cycles, results[i].dma_cycles, results[i].share_cycles);
+    }
+    DLOG("flash copy crossover %u bytes", crossover);
+}
+#endif
+
+static bool work_pending(void)
+{
+    uint8_t next_record = dlog_next_length();
+    return is_data_available() || (next_record && next_record <= UART2_tx_free());
+}
 
 int main(void)
 {
+    memstat_guard_enable();
+    systick_init();
+    timer_wheel_init();
     UART2_init();
+    // Sleep only: a byte typed at the console is never resent, and Stop would lose the first one
+    power_init(work_pending, UART2_tx_idle);
 
     // configure LED pin
-    SET_BIT(GPIOA->MODER, 2 * LED_PIN);
-    CLEAR_BIT(GPIOA->MODER, 2 * LED_PIN + 1);
+    PINMUX_APPLY(LED_PINMUX);
+
+    // decode with: uart_reader log Binaries/output.elf
+    DLOG("UARTDriver up, core at %u Hz, %u baud", SYS_CLOCK, 115200U);
+    DLOG("reset to main in %u cycles", startup_cycles);
 
+#ifdef DMA_COPY_BENCH
+    dma_copy_init();
+    bench_copies();
+#endif
+
+    uint32_t toggles = 0;
     uint8_t received_byte;
     while (true)
     {
@@ -18,10 +100,14 @@ int main(void)
         {
             if (received_byte == '1')
             {
-                TOGGLE_PIN(GPIOA->ODR, LED_PIN);
-                const uint8_t str[] = "\r\nLED Toggled!\r\n";
-                while (!UART2_write(str, (uint8_t)strlen(str)))
-                    ;
+                gpio_toggle(GPIO_PIN(A, LED_PIN));
+                toggles++;
+                DLOG("LED toggled, PA5 now %u, %u toggles", gpio_read(GPIO_PIN(A, LED_PIN)), toggles);
+
+                memstat_t mem;
+                memstat_get(&mem);
+                DLOG("stack peak %u of %u bytes, heap %u of %u", mem.stack_peak, mem.stack_size, mem.heap_peak,
+                     mem.heap_size);
             }
             else
             {
@@ -32,6 +118,12 @@ int main(void)
                     ;
             }
         }
+        else
+        {
+            power_idle();
+        }
+
+        flush_log();
     }
 
     return 0;
@@ -4,9 +4,6 @@
 #define UE_BIT 13
 #define M_BIT 12
 #define STOP_BIT 12
-#define TX_PIN 2
-#define RX_PIN 3
-#define GPIOA_EN 0
 #define USART2_EN 17
 #define OVER8 15
 #define ONEBIT 11
@@ -44,32 +41,61 @@ typedef struct
 static TxBuffer tx_buffer = {0};
 static RxBuffer rx_buffer = {0};
 
+static uart_overflow_t overflow_policy = UART_OVERFLOW_BLOCK;
+static volatile uint32_t tx_dropped = 0;
+
 // buffer management functions
-static bool tx_buffer_is_full(void)
-{
-    uint8_t next_write = (tx_buffer.write_index + 1) & (TX_BUFFER_SIZE - 1);
-    return (tx_buffer.read_index == next_write);
-}
 
-static uint8_t tx_buffer_write(const uint8_t *str, uint8_t len)
+// copies as much of str as fits in at most two memcpy spans (before and after the wrap), then hands all of it
+// to the ISR with a single index store
+static size_t tx_buffer_write(const uint8_t *str, size_t len)
 {
-    if (!str || len == 0 || len > TX_BUFFER_SIZE)
+    if (!str || len == 0)
     {
         return 0;
     }
 
-    uint8_t actual_written = 0;
-    uint8_t current_write_index;
+    uint8_t write_index = tx_buffer.write_index;
+    size_t count = UART2_tx_free();
+    if (count > len)
+    {
+        count = len;
+    }
+
+    size_t first = TX_BUFFER_SIZE - write_index;
+    if (first > count)
+    {
+        first = count;
+    }
+    memcpy((uint8_t *)&tx_buffer.data[write_index], str, first);
+    memcpy((uint8_t *)&tx_buffer.data[0], str + first, count - first);
+
+    __DMB(); // the bytes must be in the ring before the ISR can see the new index
+    tx_buffer.write_index = (write_index + count) & (TX_BUFFER_SIZE - 1);
+    return count;
+}
 
-    while (!tx_buffer_is_full() && actual_written < len) // we constantly use the new values to check since data may be going out of the buffer as we are adding to it
+static void tx_start(void)
+{
+    // Enable TX interrupts (atomically; the ISR clears them when the buffer drains)
+    BITBAND_PERIPH(USART2->CR1, TXEIE) = 1;
+    BITBAND_PERIPH(USART2->CR1, TCIE) = 1;
+}
+
+// UART_OVERFLOW_OVERWRITE: throw away the oldest queued bytes until len more fit
+static void tx_make_room(size_t len)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq(); // read_index belongs to the ISR
+
+    size_t room = UART2_tx_free();
+    if (room < len)
     {
-        current_write_index = tx_buffer.write_index;
-        tx_buffer.data[current_write_index] = (uint8_t)str[actual_written];
-        actual_written++;
-        tx_buffer.write_index = (current_write_index + 1) & (TX_BUFFER_SIZE - 1);
+        tx_buffer.read_index = (tx_buffer.read_index + (len - room)) & (TX_BUFFER_SIZE - 1);
+        tx_dropped += len - room;
     }
 
-    return actual_written;
+    __set_PRIMASK(primask);
 }
 
 bool is_data_available(void)
@@ -77,13 +103,25 @@ bool is_data_available(void)
     return rx_buffer.read_index != rx_buffer.write_index;
 }
 
-static bool rx_buffer_is_full(void)
+bool UART2_tx_idle(void)
+{
+    // nothing queued and the last frame has left the shift register
+    return (tx_buffer.read_index == tx_buffer.write_index) && IS_SET(USART2->SR, TC);
+}
+
+uint8_t UART2_tx_free(void)
+{
+    // one slot always stays empty to tell a full ring from an empty one
+    return (uint8_t)((tx_buffer.read_index - tx_buffer.write_index - 1U) & (TX_BUFFER_SIZE - 1));
+}
+
+static inline __attribute__((always_inline)) bool rx_buffer_is_full(void)
 {
     uint8_t next_write = (rx_buffer.write_index + 1) & (RX_BUFFER_SIZE - 1);
     return next_write == rx_buffer.read_index;
 }
 
-static bool rx_buffer_write(uint8_t data)
+static inline __attribute__((always_inline)) bool rx_buffer_write(uint8_t data)
 {
     if (rx_buffer_is_full())
     {
@@ -95,19 +133,32 @@ static bool rx_buffer_write(uint8_t data)
     return true;
 }
 
-static bool rx_buffer_read(uint8_t *data)
+// the RX counterpart of tx_buffer_write: two spans at most, one index store to give the slots back
+static size_t rx_buffer_read(uint8_t *data, size_t len)
 {
-    if (!is_data_available())
+    uint8_t read_index = rx_buffer.read_index;
+    size_t count = (rx_buffer.write_index - read_index) & (RX_BUFFER_SIZE - 1);
+    if (count > len)
     {
-        return false;
+        count = len;
     }
 
-    *data = rx_buffer.data[rx_buffer.read_index];
-    rx_buffer.read_index = (rx_buffer.read_index + 1) & (RX_BUFFER_SIZE - 1);
-    return true;
+    size_t first = RX_BUFFER_SIZE - read_index;
+    if (first > count)
+    {
+        first = count;
+    }
+    memcpy(data, (const uint8_t *)&rx_buffer.data[read_index], first);
+    memcpy(data + first, (const uint8_t *)&rx_buffer.data[0], count - first);
+
+    __DMB(); // done with the slots before the ISR may refill them
+    rx_buffer.read_index = (read_index + count) & (RX_BUFFER_SIZE - 1);
+    return count;
 }
 
-void USART2_Handler(void)
+// runs from SRAM (ramfunc.h) so that reception goes on during a flash erase; the ring helpers it uses are
+// always_inline, so no call goes back to flash at any optimization level
+RAMFUNC void USART2_Handler(void)
 {
     if (IS_SET(USART2->SR, TXE))
     {
@@ -124,8 +175,9 @@ void USART2_Handler(void)
                 // wait for transmission complete
             }
 
-            CLEAR_BIT(USART2->CR1, TXEIE);
-            CLEAR_BIT(USART2->CR1, TCIE);
+            // bit-band stores: UART2_write() sets these from the main loop, so a read-modify-write here could race with it
+            BITBAND_PERIPH(USART2->CR1, TXEIE) = 0;
+            BITBAND_PERIPH(USART2->CR1, TCIE) = 0;
         }
     }
 
@@ -141,10 +193,8 @@ void USART2_Handler(void)
 
 uint8_t UART2_write(const uint8_t *str, uint8_t len)
 {
-    uint8_t return_val = tx_buffer_write(str, len);
-    // Enable TX interrupts
-    SET_BIT(USART2->CR1, TXEIE);
-    SET_BIT(USART2->CR1, TCIE);
+    uint8_t return_val = (uint8_t)tx_buffer_write(str, len);
+    tx_start();
     return return_val;
 }
 
@@ -155,45 +205,121 @@ bool UART2_write_byte(const uint8_t *str)
 
 bool UART2_read_byte(uint8_t *data)
 {
-    return rx_buffer_read(data);
+    return rx_buffer_read(data, 1) == 1;
 }
 
 uint8_t UART2_read(uint8_t *data, uint8_t len)
 {
-    uint8_t actual_read = 0;
-    for (uint8_t i = 0; i < len; i++)
+    return (uint8_t)rx_buffer_read(data, len);
+}
+
+static bool in_handler_or_masked(void)
+{
+    // the TX/RX interrupt can't run here, so waiting for it would never end
+    return __get_IPSR() != 0U || __get_PRIMASK() != 0U;
+}
+
+static bool tx_has_room(void)
+{
+    return UART2_tx_free() != 0U;
+}
+
+// sleeps until ready() holds. The check is made with interrupts masked: a masked interrupt that becomes pending
+// still ends the WFI, whereas one that ran between an unmasked check and the WFI would leave us asleep
+static void wait_for(bool (*ready)(void))
+{
+    while (true)
     {
-        if (UART2_read_byte(&(data[actual_read])))
+        __disable_irq();
+        if (ready())
         {
-            actual_read++;
+            __enable_irq();
+            return;
         }
+        __WFI();
+        __enable_irq(); // the pending interrupt runs here
     }
+}
 
-    return actual_read;
+size_t UART2_write_stream(const uint8_t *data, size_t len)
+{
+    uart_overflow_t policy = overflow_policy;
+    if (policy == UART_OVERFLOW_BLOCK && in_handler_or_masked())
+    {
+        policy = UART_OVERFLOW_DROP;
+    }
+
+    size_t consumed = len;
+    if (policy == UART_OVERFLOW_OVERWRITE)
+    {
+        // only the newest bytes can survive anyway
+        if (len > TX_BUFFER_SIZE - 1U)
+        {
+            tx_dropped += len - (TX_BUFFER_SIZE - 1U);
+            data += len - (TX_BUFFER_SIZE - 1U);
+            len = TX_BUFFER_SIZE - 1U;
+        }
+        tx_make_room(len);
+    }
+
+    size_t written = tx_buffer_write(data, len);
+    tx_start();
+
+    while (written < len)
+    {
+        if (policy != UART_OVERFLOW_BLOCK)
+        {
+            tx_dropped += len - written;
+            break;
+        }
+
+        // sleep until the ISR has made room, then copy the next span
+        wait_for(tx_has_room);
+        written += tx_buffer_write(data + written, len - written);
+        tx_start();
+    }
+
+    return consumed;
+}
+
+size_t UART2_read_stream(uint8_t *data, size_t len)
+{
+    if (overflow_policy == UART_OVERFLOW_BLOCK && len > 0 && !in_handler_or_masked())
+    {
+        wait_for(is_data_available);
+    }
+
+    return rx_buffer_read(data, len);
+}
+
+uint32_t UART2_tx_dropped(void)
+{
+    return tx_dropped;
+}
+
+void UART2_stdio_init(uart_overflow_t policy)
+{
+    overflow_policy = policy;
+
+    // the TX ring already is the buffer: no second copy through newlib's, and nothing held back until a newline
+    setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+// the hooks _write() and _read() in coresys/PseudoSyscalls/syscalls.c pass whole spans to
+int __io_write(const char *ptr, int len)
+{
+    return (int)UART2_write_stream((const uint8_t *)ptr, (size_t)len);
+}
+
+int __io_read(char *ptr, int len)
+{
+    return (int)UART2_read_stream((uint8_t *)ptr, (size_t)len);
 }
 
 void UART2_init(void)
 {
-    // GPIOA configuration
-    SET_BIT(RCC->AHB1ENR, GPIOA_EN);
-
-    // Configure TX pin
-    CLEAR_BIT(GPIOA->MODER, TX_PIN * 2);
-    SET_BIT(GPIOA->MODER, TX_PIN * 2 + 1);
-    SET_BIT(GPIOA->AFR[0], TX_PIN * 4);
-    SET_BIT(GPIOA->AFR[0], TX_PIN * 4 + 1);
-    SET_BIT(GPIOA->AFR[0], TX_PIN * 4 + 2);
-    CLEAR_BIT(GPIOA->AFR[0], TX_PIN * 4 + 3);
-
-    // Configure RX pin
-    CLEAR_BIT(GPIOA->MODER, RX_PIN * 2);
-    SET_BIT(GPIOA->MODER, RX_PIN * 2 + 1);
-    SET_BIT(GPIOA->AFR[0], RX_PIN * 4);
-    SET_BIT(GPIOA->AFR[0], RX_PIN * 4 + 1);
-    SET_BIT(GPIOA->AFR[0], RX_PIN * 4 + 2);
-    CLEAR_BIT(GPIOA->AFR[0], RX_PIN * 4 + 3);
-    SET_BIT(GPIOA->PUPDR, RX_PIN * 2);
-    CLEAR_BIT(GPIOA->PUPDR, RX_PIN * 2 + 1);
+    // TX/RX pins: folded into one masked write per GPIOA register
+    PINMUX_APPLY(UART2_PINMUX);
 
     // USART2 configuration
     SET_BIT(RCC->APB1ENR, USART2_EN);
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include "../../coresys/Includes/STM32F401.h"
+#include "../../coresys/Drivers/Include/pinmux.h"
 
 /*
 
@@ -18,8 +19,6 @@ Similarly, data sent from the USART2 of STM32 can travel back to the computer th
 
 // USART2 is connected to the APB1 bus
 #define USART2_EN_BIT 17
-// GPIOA is connected to the AHB1 bus
-#define GPIOA_EN_BIT 0
 
 #define SYS_CLOCK 16000000 // the default system clock (if clock tree not configured) on stm32 is 16MHz
 // In the clock tree, the system clock is taken and then divided by a value; and then what is derived after this division
@@ -30,7 +29,9 @@ Similarly, data sent from the USART2 of STM32 can travel back to the computer th
 
 #define UART_BAUD_RATE 115200
 
-#define TX_PIN 2
+// PA2 on AF7 (UART_TX); AF07 is 0111
+#define UART2_TX_PINMUX(X, ctx) \
+    X(ctx, A, 2, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 7U)
 
 #define WORD_LENGTH_BIT 12
 #define PARITY_CONTROL_BIT 10
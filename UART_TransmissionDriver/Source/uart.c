@@ -1,4 +1,7 @@
 #include "../Include/uart.h"
+#include "../../coresys/Drivers/Include/systick.h"
+
+#define HELLO_PERIOD_MS 500
 
 void UART2_write_string(const char *str)
 {
@@ -6,11 +9,6 @@ void UART2_write_string(const char *str)
     for (size_t i = 0; i < len; i++)
     {
         UART2_write_char(str[i]);
-        volatile size_t x = 0;
-        for (volatile size_t i = 0; i < 10000; i++)
-        {
-            x += i;
-        }
     }
 }
 
@@ -26,17 +24,8 @@ static inline void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t periph_cloc
 
 void UART2_tx_init(void)
 {
-    // configuring UART2 GPIO TX pin
-    // enable clock access to GPIOA
-    SET_BIT(RCC->AHB1ENR, GPIOA_EN_BIT);
-    // set PA2 to alternate function mode
-    CLEAR_BIT(GPIOA->MODER, TX_PIN * 2);
-    SET_BIT(GPIOA->MODER, TX_PIN * 2 + 1);
-    // set PA2 alternate function type to AF07 (UART_TX); AF07 is 0111
-    SET_BIT(GPIOA->AFR[0], 4 * TX_PIN);
-    SET_BIT(GPIOA->AFR[0], 4 * TX_PIN + 1);
-    SET_BIT(GPIOA->AFR[0], 4 * TX_PIN + 2);
-    CLEAR_BIT(GPIOA->AFR[0], 4 * TX_PIN + 3);
+    // configuring UART2 GPIO TX pin; enables the GPIOA clock and sets AFR, MODER in one write each
+    PINMUX_APPLY(UART2_TX_PINMUX);
 
     // configuring UART2 module
     // enable clock access to UART2
@@ -71,14 +60,11 @@ void UART2_write_char(char chr)
 
 int main(void)
 {
+    systick_init();
     UART2_tx_init();
     while (true)
     {
         UART2_write_string("hello world\n\r");
-        volatile size_t x = 0;
-        for (volatile size_t i = 0; i < 100000; i++)
-        {
-            x += i;
-        }
+        systick_delay_ms(HELLO_PERIOD_MS);
     }
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef E25C7A91_3D48_4B6F_8C02_7F91A4E6D3B8
+#define E25C7A91_3D48_4B6F_8C02_7F91A4E6D3B8
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# ADC1 Scan with DMA
+
+TIM3's update event (TRGO) starts a scan of the configured channels at a fixed rate, with no jitter from
+whatever the CPU happens to be doing (TIM3 is claimed from tim.h, so a PWM can't take it over meanwhile).
+ADC1 converts the channels one after the other and a DMA2 stream (claimed from dma.h: stream 0, or 4 if
+SPI1 holds 0) moves every result into a circular buffer of two halves:
+
+    buffer: | half 0: scans_per_half scans | half 1: scans_per_half scans |
+              ^ half transfer interrupt      ^ transfer complete interrupt
+
+The DMA raises its half transfer interrupt when half 0 is full and keeps filling half 1, so the callback
+can work on half 0 while half 1 fills, and the other way round at transfer complete. The CPU does nothing
+per sample; it runs once per half buffer. Each scan is channel_count samples in sequence order, and a half
+is handed over as scans_per_half consecutive scans, ready for decimate.h.
+
+The callback has one half buffer time to finish. If it takes longer, the DMA overwrites the half it is
+still reading; adc_late_callbacks() counts how often a half filled before the previous callback returned.
+
+## Rates
+
+A conversion takes the sample time plus 12 ADC clocks (at 12 bits). ADCCLK is APB2 / 2 at most and must
+stay at or below 36 MHz:
+
+    APB2 16 MHz (HSI)   ADCCLK 8 MHz    3 cycle sample time: 533 ksps in total
+    APB2 84 MHz         ADCCLK 21 MHz   3 cycle sample time: 1.4 Msps in total
+
+The total rate is scan_rate_hz * channel_count and has to stay below that. The sample time has to be long
+enough for the source impedance to charge the sampling capacitor (see the datasheet's R_AIN formula); 3
+cycles only suits a buffered, low impedance source. An overrun (a conversion finishing before the DMA took
+the previous one) stops the ADC; the interrupt counts it (adc_overruns()) and restarts the scan.
+
+Channels 0-7 are PA0-PA7, 8-9 PB0-PB1 and 10-15 PC0-PC5; adc_start() switches those pins to analog mode.
+PA2/PA3 carry USART2 and PA5 the Nucleo LED, so leave channels 2, 3 and 5 alone on a Nucleo.
+
+*/
+
+#ifndef ADC_PCLK
+#define ADC_PCLK 16000000U // APB2, for the ADC prescaler
+#endif
+#ifndef ADC_TIMER_CLOCK
+#define ADC_TIMER_CLOCK 16000000U // TIM3 on APB1; twice APB1 if APB1 is divided
+#endif
+#ifndef ADC_MAX_CLOCK
+#define ADC_MAX_CLOCK 36000000U
+#endif
+
+#define ADC_MAX_CHANNELS (16U)
+
+// SMPR codes: ADC clock cycles the input is sampled for
+#define ADC_SAMPLE_3 (0U)
+#define ADC_SAMPLE_15 (1U)
+#define ADC_SAMPLE_28 (2U)
+#define ADC_SAMPLE_56 (3U)
+#define ADC_SAMPLE_84 (4U)
+#define ADC_SAMPLE_112 (5U)
+#define ADC_SAMPLE_144 (6U)
+#define ADC_SAMPLE_480 (7U)
+
+// half: scans_per_half scans of channel_count samples; runs in the DMA interrupt
+typedef void (*adc_callback_t)(const uint16_t *half, uint16_t scans, void *context);
+
+typedef struct adc_config_
+{
+    const uint8_t *channels;  // ADC1 inputs in scan order, 0-18 (16: temperature sensor, 17: VREFINT)
+    uint8_t channel_count;    // 1 to ADC_MAX_CHANNELS
+    uint8_t sample_time;      // ADC_SAMPLE_x, for all channels
+    uint32_t scan_rate_hz;    // scans per second
+    uint16_t *buffer;         // 2 * scans_per_half * channel_count samples
+    uint16_t scans_per_half;  // 2 * scans_per_half * channel_count must fit in 0xFFFF (NDTR)
+    adc_callback_t callback;
+    void *context;
+} adc_config_t;
+
+// false if the configuration doesn't fit the hardware, TIM3 is in use or no DMA stream is free; the scans
+// start right away
+bool adc_start(const adc_config_t *config);
+void adc_stop(void);
+
+// the scan rate TIM3 really runs at (its clock divided by an integer)
+uint32_t adc_scan_rate(void);
+uint32_t adc_overruns(void);
+uint32_t adc_late_callbacks(void);
+
+#endif /* E25C7A91_3D48_4B6F_8C02_7F91A4E6D3B8 */
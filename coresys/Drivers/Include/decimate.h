@@ -0,0 +1,73 @@
+#ifndef A39E5B07_6C18_4F2D_9A74_E1B8D05C3F96
+#define A39E5B07_6C18_4F2D_9A74_E1B8D05C3F96
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+
+# Decimation
+
+Sampling fast and averaging down trades bandwidth for resolution and pushes the anti-aliasing work into
+software: averaging R samples of white noise improves the SNR by sqrt(R), i.e. half a bit per doubling of R.
+Both filters here work on interleaved blocks, as the ADC DMA delivers them (scan 0 channel 0, scan 0 channel
+1, ..., scan 1 channel 0, ...), keep their state between blocks, so a block boundary doesn't have to fall on
+an output sample, and write one interleaved output scan for every `factor` input scans.
+
+## Boxcar
+
+Sums `factor` scans per channel and divides: one add per sample, one divide per output. Its frequency
+response is a sinc with nulls at multiples of the output rate, which is fine for slowly varying signals.
+
+## CIC
+
+A cascaded integrator-comb filter of order N is N boxcars in a row, done cheaply: N integrators run at the
+input rate, the output is taken every `factor` samples, and N combs (differences with the previous
+output) run at the output rate. No multiplies, and each added order deepens the stop band attenuation. The
+gain is factor^N, which is divided out so the output has the input's scale.
+
+The integrators overflow, on purpose: with wrapping unsigned arithmetic, the combs' differences still come
+out right as long as the true output fits in the register width, i.e. 12 + N * log2(factor) <= 32 bits for
+12 bit input. decimate_cic_init() refuses combinations that don't fit.
+
+Nothing here touches the hardware, so both filters build and run the same in a host program; make check in
+coresys/Host tests them against known answers (Check/decimate_check.c).
+
+*/
+
+#define DECIMATE_MAX_CHANNELS (16U) // the length of an ADC regular sequence
+#define DECIMATE_MAX_ORDER (5U)
+#define DECIMATE_INPUT_BITS (12U)   // ADC resolution; the CIC width limit depends on it
+
+typedef struct decimate_boxcar_
+{
+    uint8_t channels;
+    uint16_t factor;
+    uint16_t count; // input scans summed so far
+    uint32_t sums[DECIMATE_MAX_CHANNELS];
+} decimate_boxcar_t;
+
+typedef struct decimate_cic_
+{
+    uint8_t channels;
+    uint8_t order;
+    uint16_t factor;
+    uint16_t count; // input scans since the last output
+    uint32_t gain;  // factor^order
+    uint32_t integrators[DECIMATE_MAX_CHANNELS][DECIMATE_MAX_ORDER];
+    uint32_t delays[DECIMATE_MAX_CHANNELS][DECIMATE_MAX_ORDER]; // the combs' previous inputs
+} decimate_cic_t;
+
+// false if channels or factor is 0 or channels is above DECIMATE_MAX_CHANNELS
+bool decimate_boxcar_init(decimate_boxcar_t *filter, uint8_t channels, uint16_t factor);
+
+// false also if order is above DECIMATE_MAX_ORDER or the filter would need more than 32 bits
+bool decimate_cic_init(decimate_cic_t *filter, uint8_t channels, uint8_t order, uint16_t factor);
+
+// filter `scans` interleaved scans from input into output; returns the number of output scans written, at most
+// (scans + factor - 1) / factor
+size_t decimate_boxcar(decimate_boxcar_t *filter, const uint16_t *input, size_t scans, uint16_t *output);
+size_t decimate_cic(decimate_cic_t *filter, const uint16_t *input, size_t scans, uint16_t *output);
+
+#endif /* A39E5B07_6C18_4F2D_9A74_E1B8D05C3F96 */
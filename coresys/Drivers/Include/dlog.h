@@ -0,0 +1,120 @@
+#ifndef C2E8A4F1_5B3D_4E7A_9F16_0D8B2C7E4A93
+#define C2E8A4F1_5B3D_4E7A_9F16_0D8B2C7E4A93
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# Deferred Logging
+
+printf-style diagnostics are expensive on a microcontroller: the format string has to be stored in flash,
+parsed at runtime, every number converted to decimal digits one division at a time, and then every single
+character pushed through the UART, at 87us per byte at 115200 baud. Most of that work is wasted, because
+the PC on the other end already knows the format string if it has the ELF file.
+
+So DLOG() only sends what the PC can't know:
+
+    DLOG("adc %u, temperature %d", raw, celsius);
+
+1. The format string goes into the .dlog section. The linker script places that section at address 0 as an
+INFO section: it is kept in the ELF file but never loaded into flash, so it costs no flash at all. The address
+of the string inside the section becomes its ID.
+
+2. At runtime a record is built from the ID, the current millis() and the arguments, each as a LEB128 varint
+(7 bits per byte, high bit set on all but the last byte), so small numbers take one byte and a 32-bit value
+at most five. Every argument is converted to uint32_t; %d arguments are sent as their two's complement and
+sign-extended again on the PC, so negative numbers cost five bytes.
+
+3. The record is COBS-encoded (which removes all 0x00 bytes from it) and wrapped in 0x00 delimiters, so the
+reader can find record boundaries anywhere in the stream, even when other bytes share the same UART.
+
+The PC side (uart_reader log <elf> [port]) reads the .dlog section from the ELF, splits the stream at 0x00
+bytes, looks up each ID and does the formatting there. Anything between delimiters that doesn't decode as a
+record is shown as plain text.
+
+A typical message ("adc %u, temperature %d" with two small values) takes about 10 bytes on the wire instead of
+about 25 characters, and the firmware spends a few hundred cycles on shifts and a copy instead of running a
+printf implementation and then waiting for every character.
+
+## Supported conversions
+
+%d %i %u %x %X %c %%, with optional flags (0, -), width and the length modifiers h, hh, l (which are ignored,
+everything is 32 bits). Pass integers and characters only, at most DLOG_MAX_ARGS of them; %s, %p and floating
+point are not supported because the argument bytes would have to be sent anyway.
+
+## Buffering
+
+DLOG() can be called from the main loop and from interrupt handlers. The record is encoded on the caller's
+stack, then copied into the log ring with interrupts masked for the duration of the copy (a few dozen
+cycles). If the ring is full the record is dropped and counted; the next record that fits is preceded by a
+"messages dropped" record.
+
+The masking is there because the ring has many producers. The UART rings get by without it since each side
+has one writer, which publishes its index after the bytes; here the main loop and every interrupt that logs
+share write_index, so a record can be interrupted half-copied by another one that starts at the same index.
+Reserving space with LDREX/STREX instead would need a second, commit index: a preempted producer leaves a
+reserved but unwritten gap that the consumer has to stop at, and the records behind it wait until the
+producer resumes. Masking adds a few dozen cycles to other interrupts' latency; the reservation would cost
+about as much in bookkeeping and add that stall on top. The drop notice and the stats are updated in the
+same masked section, which is also why dlog_get_stats() masks for its copy.
+
+The consumer side is lock-free, like the UART rings: there is one consumer, which alone advances read_index
+and publishes it after it has copied the record out.
+
+The ring is drained record by record with dlog_read_record(), so a record always reaches the transport in one
+piece: a project that also sends other bytes over the same UART never ends up with them in the middle of a
+record. A typical main loop hands whole records to the UART driver whenever its TX ring has room:
+
+    uint8_t record[DLOG_MAX_RECORD];
+    uint8_t length;
+    while ((length = dlog_read_record(record, UART2_tx_free())) > 0)
+    {
+        UART2_write(record, length);
+    }
+
+*/
+
+#ifndef DLOG_BUFFER_SIZE
+#define DLOG_BUFFER_SIZE (256U) // must be a power of two
+#endif
+
+#define DLOG_MAX_ARGS (8U)
+#define DLOG_VARINT_MAX (5U) // a uint32_t takes at most 5 LEB128 bytes
+#define DLOG_RAW_MAX ((2U + DLOG_MAX_ARGS) * DLOG_VARINT_MAX)
+// leading delimiter, COBS overhead byte, encoded record, trailing delimiter
+#define DLOG_MAX_RECORD (DLOG_RAW_MAX + 3U)
+
+#define DLOG_FORMAT_SECTION ".dlog"
+
+// format: string literal; arguments: integers or characters
+#define DLOG(format, ...)                                                                                   \
+    do                                                                                                      \
+    {                                                                                                       \
+        __attribute__((section(DLOG_FORMAT_SECTION), used)) static const char dlog_format_[] = format;      \
+        const uint32_t dlog_args_[] = {0U, ##__VA_ARGS__};                                                  \
+        _Static_assert(sizeof(dlog_args_) / sizeof(dlog_args_[0]) - 1U <= DLOG_MAX_ARGS, "too many args");  \
+        dlog_write(dlog_format_, &dlog_args_[1], (uint8_t)(sizeof(dlog_args_) / sizeof(dlog_args_[0]) - 1U)); \
+    } while (0)
+
+typedef struct dlog_stats_
+{
+    uint32_t records;       // records queued
+    uint32_t dropped;       // records lost because the ring was full
+    uint32_t bytes;         // bytes queued, delimiters included
+    uint32_t peak_used;     // highest ring fill in bytes
+} dlog_stats_t;
+
+void dlog_write(const char *format, const uint32_t *args, uint8_t count);
+
+// length of the next complete record in the ring, 0 if there is none
+uint8_t dlog_next_length(void);
+// copies the next record into dest if it is at most max bytes long; returns its length or 0
+uint8_t dlog_read_record(uint8_t *dest, size_t max);
+
+void dlog_get_stats(dlog_stats_t *stats);
+
+#endif /* C2E8A4F1_5B3D_4E7A_9F16_0D8B2C7E4A93 */
@@ -0,0 +1,187 @@
+#ifndef F83B26D1_4A7C_4E05_9D1B_C6E2A07F5B93
+#define F83B26D1_4A7C_4E05_9D1B_C6E2A07F5B93
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# DMA Streams
+
+The two DMA controllers have eight streams each, and every stream serves a fixed set of peripheral requests,
+one per channel (CHSEL), as listed in the reference manual's request mapping tables. A request is usually
+wired to one or two streams, and streams are shared between requests: DMA2 stream 0 is either ADC1 or
+SPI1_RX, DMA1 stream 6 either USART2_TX, I2C1_TX or TIM4_UP. Two drivers picking the same stream both
+appear to work until they run at the same time.
+
+So drivers don't pick streams; they claim a request:
+
+    dma_stream_t rx = dma_claim(DMA_REQ_SPI1_RX, spi_rx_event, NULL);
+
+dma_claim() walks that request's entry in the mapping table (dma.c) and takes the first stream nobody holds
+yet, or returns DMA_STREAM_NONE if they are all held: a conflict turns into an error at init instead of two
+drivers overwriting each other's stream. dma_release() hands it back. dma_claimed() is the mask of held
+streams, bit n for dma_stream_t n (DMA1 streams 0-7, then DMA2 streams 0-7).
+
+## Transfers
+
+dma_configure() takes a dma_transfer_t descriptor and writes the whole stream: addresses, count, direction,
+widths, increments, circular or double buffer mode, priority, FIFO threshold and burst size, and the
+interrupts. dma_enable() then starts it. A driver that restarts the same kind of transfer over and over can
+configure once and afterwards only rewrite M0AR / NDTR / CR through dma_regs(), as spi.c does per transfer.
+
+Some constraints of the hardware, checked by dma_configure():
+- Memory to memory needs DMA2 (DMA1's peripheral port doesn't reach the memories), can't be circular and
+  needs the FIFO; peripheral is the source and memory the destination.
+- Bursts need the FIFO, and a burst must not cross a 1 KB boundary (not checked).
+- Double buffer mode alternates between memory and memory1 at each transfer complete and is circular by
+  nature; dma_current_buffer() says which of the two the DMA is filling.
+
+## Events
+
+A claimed stream's interrupt goes through the vector table to a small per-stream handler installed with
+vectors_set_handler() (vectors.h), which reads the stream's flags, clears them and calls the claimer's
+callback with them as DMA_EVENT_x bits. A stream claimed without a callback keeps its interrupt disabled;
+its owner polls dma_busy() or dma_events() instead.
+
+*/
+
+typedef uint8_t dma_stream_t; // 0-7: DMA1 stream 0-7, 8-15: DMA2 stream 0-7
+
+#define DMA_STREAM_COUNT (16U)
+#define DMA_STREAM_NONE ((dma_stream_t)0xFFU)
+
+// the stream flags, shifted down to stream 0's position in LISR
+#define DMA_EVENT_FIFO_ERROR (0x01UL)
+#define DMA_EVENT_DIRECT_ERROR (0x04UL)
+#define DMA_EVENT_ERROR (0x08UL) // transfer error: a bus error on either port; the stream has stopped
+#define DMA_EVENT_HALF (0x10UL)
+#define DMA_EVENT_COMPLETE (0x20UL)
+#define DMA_EVENT_ALL (0x3DUL)
+
+#define DMA_MAX_COUNT (0xFFFFU) // NDTR is 16 bits
+
+typedef enum dma_request_
+{
+    DMA_REQ_MEMORY = 0, // memory to memory, any DMA2 stream
+    DMA_REQ_ADC1,
+    DMA_REQ_SPI1_RX,
+    DMA_REQ_SPI1_TX,
+    DMA_REQ_SPI2_RX,
+    DMA_REQ_SPI2_TX,
+    DMA_REQ_SPI3_RX,
+    DMA_REQ_SPI3_TX,
+    DMA_REQ_SPI4_RX,
+    DMA_REQ_SPI4_TX,
+    DMA_REQ_I2C1_RX,
+    DMA_REQ_I2C1_TX,
+    DMA_REQ_I2C2_RX,
+    DMA_REQ_I2C2_TX,
+    DMA_REQ_I2C3_RX,
+    DMA_REQ_I2C3_TX,
+    DMA_REQ_USART1_RX,
+    DMA_REQ_USART1_TX,
+    DMA_REQ_USART2_RX,
+    DMA_REQ_USART2_TX,
+    DMA_REQ_USART6_RX,
+    DMA_REQ_USART6_TX,
+    DMA_REQ_SDIO,
+    DMA_REQ_TIM1_UP,
+    DMA_REQ_TIM2_UP,
+    DMA_REQ_TIM3_UP,
+    DMA_REQ_TIM4_UP,
+    DMA_REQ_TIM5_UP,
+    DMA_REQ_COUNT,
+} dma_request_t;
+
+typedef enum dma_direction_
+{
+    DMA_PERIPH_TO_MEMORY = 0,
+    DMA_MEMORY_TO_PERIPH = 1,
+    DMA_MEMORY_TO_MEMORY = 2,
+} dma_direction_t;
+
+typedef enum dma_width_
+{
+    DMA_WIDTH_8 = 0,
+    DMA_WIDTH_16 = 1,
+    DMA_WIDTH_32 = 2,
+} dma_width_t;
+
+typedef enum dma_priority_
+{
+    DMA_PRIORITY_LOW = 0,
+    DMA_PRIORITY_MEDIUM = 1,
+    DMA_PRIORITY_HIGH = 2,
+    DMA_PRIORITY_VERY_HIGH = 3,
+} dma_priority_t;
+
+typedef enum dma_fifo_
+{
+    DMA_FIFO_DIRECT = 0, // no FIFO: each request moves one item straight through
+    DMA_FIFO_QUARTER = 1,
+    DMA_FIFO_HALF = 2,
+    DMA_FIFO_THREE_QUARTERS = 3,
+    DMA_FIFO_FULL = 4,
+} dma_fifo_t;
+
+typedef enum dma_burst_
+{
+    DMA_BURST_SINGLE = 0,
+    DMA_BURST_4 = 1,
+    DMA_BURST_8 = 2,
+    DMA_BURST_16 = 3,
+} dma_burst_t;
+
+// events: the DMA_EVENT_x flags that were set; runs in the stream's interrupt
+typedef void (*dma_callback_t)(void *context, uint32_t events);
+
+typedef struct dma_transfer_
+{
+    dma_direction_t direction;
+    volatile void *peripheral; // PAR: the peripheral's data register, or the source of a memory copy
+    volatile void *memory;     // M0AR
+    volatile void *memory1;    // M1AR: non-NULL turns on double buffer mode
+    uint16_t count;            // items of peripheral_width, 1 to DMA_MAX_COUNT
+    dma_width_t peripheral_width;
+    dma_width_t memory_width; // must equal peripheral_width in direct mode
+    bool peripheral_increment;
+    bool memory_increment;
+    bool circular;
+    dma_priority_t priority;
+    dma_fifo_t fifo;
+    dma_burst_t burst; // memory side; both sides for a memory copy
+    uint32_t events;   // DMA_EVENT_x that raise the interrupt; needs a callback
+} dma_transfer_t;
+
+// DMA_STREAM_NONE if every stream that serves the request is held. callback may be NULL
+dma_stream_t dma_claim(dma_request_t request, dma_callback_t callback, void *context);
+// stops the stream and disables its interrupt
+void dma_release(dma_stream_t stream);
+uint32_t dma_claimed(void);
+
+// stops the stream, clears its flags and writes the whole transfer; false (nothing written) if the hardware
+// can't do it. Doesn't start it
+bool dma_configure(dma_stream_t stream, const dma_transfer_t *transfer);
+void dma_enable(dma_stream_t stream);
+// waits for the stream to finish its current beat and stop
+void dma_disable(dma_stream_t stream);
+
+bool dma_busy(dma_stream_t stream);
+uint16_t dma_remaining(dma_stream_t stream);
+// 0 or 1: the buffer (memory or memory1) a double buffer transfer is using now
+uint8_t dma_current_buffer(dma_stream_t stream);
+
+// the DMA_EVENT_x flags set and not cleared yet
+uint32_t dma_events(dma_stream_t stream);
+void dma_clear(dma_stream_t stream, uint32_t events);
+
+DMA_Stream_TypeDef *dma_regs(dma_stream_t stream);
+IRQn_Type dma_irq(dma_stream_t stream);
+// the CHSEL bits the claimed request needs in the stream's CR
+uint32_t dma_channel_bits(dma_stream_t stream);
+
+#endif /* F83B26D1_4A7C_4E05_9D1B_C6E2A07F5B93 */
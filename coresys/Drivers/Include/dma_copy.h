@@ -0,0 +1,99 @@
+#ifndef B51E07A4_C83D_4F6A_9E20_7D4A1C96F3E8
+#define B51E07A4_C83D_4F6A_9E20_7D4A1C96F3E8
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+#include "dma.h"
+
+/*
+
+# DMA Memory Copies
+
+DMA2 can copy memory to memory: the stream reads the source through its peripheral port, collects the data
+in its FIFO and writes it out through its memory port, from flash or RAM into RAM. The CPU only sets the
+stream up and takes one interrupt at the end, and is free to do other work in between.
+
+    dma_copy_init();
+    ...
+    dma_memcpy(frame, staging, sizeof(frame), frame_ready, NULL);
+
+dma_copy_init() claims DMA_COPY_STREAMS memory streams (dma.h) and every dma_memcpy() / dma_memset() takes
+one that is idle. The copy runs at low priority, so the peripheral streams on DMA2 (SPI1, ADC1) win the
+arbitration; it still competes with the CPU for the bus matrix and the SRAM.
+
+## Sizes
+
+Setting up a stream and taking its completion interrupt costs the CPU a fixed number of cycles, which a
+short copy doesn't earn back: below DMA_COPY_THRESHOLD bytes, or when every claimed stream is busy, the copy
+runs on the CPU instead (dma_copy_cpu(), a word loop unrolled four times) before the call returns.
+
+The DMA moves words when source and destination are both word aligned, in bursts of four words when both are
+16 byte aligned, and single bytes otherwise, which takes four times the bus transactions. A burst has to
+end on a burst boundary, so the last few bytes that don't make a whole word (or burst) are copied by the CPU
+right away. A copy longer than one stream transfer (DMA_MAX_COUNT items) is chained from the interrupt.
+
+## Completion
+
+callback runs exactly once, with ok false if the stream hit a bus error (an address that isn't memory).
+For a copy that ran on the CPU it runs before dma_memcpy() returns, and the call returns false; for a DMA
+copy it runs later, from the stream's interrupt, and the call returns true. Until then neither buffer may be
+touched. callback may be NULL; dma_copy_busy() says whether any copy is still running.
+
+Stop mode halts the DMA along with the core: a board that allows it (power_allow_stop()) and idles while a
+copy is in flight keeps it from finishing, so it should report the copy as pending work.
+
+## Crossover
+
+dma_copy_bench() finds the threshold on the board. For each size it times the CPU copy, the DMA copy from
+the call to the callback, and the DMA copy's share of the CPU: a spin loop that outlasts the copy, timed
+once on its own and once with the copy running under it. The difference is the setup, the interrupt and the
+cycles the core stalled on the bus. The crossover is the smallest size where that share is below the CPU
+copy. UARTDriver built with DMA_COPY_BENCH (make APP_CFLAGS=-DDMA_COPY_BENCH) runs it at boot, from RAM and
+from flash, and logs the figures. It has not been run on a board yet: the 256 bytes DMA_COPY_THRESHOLD
+defaults to is a guess, not a measurement, until it is set from those figures.
+
+make check in coresys/Host runs the copies against the emulator's memory to memory streams, which checks
+the results and the callbacks but says nothing about the timing (Check/dma_copy_check.c).
+
+*/
+
+#ifndef DMA_COPY_STREAMS
+#define DMA_COPY_STREAMS (1U) // memory streams held for copies; each one more is a stream less for peripherals
+#endif
+#ifndef DMA_COPY_THRESHOLD
+#define DMA_COPY_THRESHOLD (256U) // bytes; shorter copies run on the CPU. Unmeasured, see Crossover
+#endif
+
+// ok: false if the DMA stopped on a bus error; runs in the stream's interrupt for a DMA copy
+typedef void (*dma_copy_callback_t)(void *context, bool ok);
+
+typedef struct dma_copy_bench_
+{
+    uint32_t bytes;
+    uint32_t cpu_cycles;   // dma_copy_cpu()
+    uint32_t dma_cycles;   // dma_memcpy() to its callback
+    uint32_t share_cycles; // the CPU cycles the DMA copy took away: setup, interrupt and bus stalls
+} dma_copy_bench_t;
+
+// returns the number of streams claimed; with none, every copy runs on the CPU
+uint8_t dma_copy_init(void);
+
+// dst and src must not overlap. true if the copy is running on the DMA, false if it is already done
+bool dma_memcpy(void *dst, const void *src, size_t bytes, dma_copy_callback_t callback, void *context);
+bool dma_memset(void *dst, uint8_t value, size_t bytes, dma_copy_callback_t callback, void *context);
+bool dma_copy_busy(void);
+
+// the CPU copies below the threshold
+void dma_copy_cpu(void *dst, const void *src, size_t bytes);
+void dma_copy_cpu_set(void *dst, uint8_t value, size_t bytes);
+
+// copies src to dst once per size, on the CPU and on the DMA, and returns the crossover in bytes (0 if the
+// DMA never pays off, or dma_copy_init() claimed no stream). Needs the DWT cycle counter (startup.s starts
+// it) and interrupts enabled, and no other copy may be running
+uint32_t dma_copy_bench(void *dst, const void *src, const uint32_t *sizes, dma_copy_bench_t *results,
+                        uint8_t count);
+
+#endif /* B51E07A4_C83D_4F6A_9E20_7D4A1C96F3E8 */
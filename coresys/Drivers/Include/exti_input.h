@@ -0,0 +1,84 @@
+#ifndef D3F1A6C2_8E47_4B9A_9C05_7A21E4B6F8D1
+#define D3F1A6C2_8E47_4B9A_9C05_7A21E4B6F8D1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+#include "gpio.h"
+
+/*
+
+# EXTI Input Driver
+
+Every GPIO pin can be routed to the EXTI line with the same number: line n is shared by pin n of all ports,
+and SYSCFG->EXTICR selects which port drives it. So PA13 and PC13 can't both be interrupt inputs at the
+same time, but PA0, PB1 and PC13 can.
+
+Lines 0 to 4 have their own NVIC vector; lines 5-9 share EXTI9_5 and lines 10-15 share EXTI15_10.
+
+## Debouncing
+
+A mechanical button bounces for a few milliseconds, producing a burst of edges. Instead of polling, we:
+
+1. take the first edge in the EXTI interrupt, mask that line (so the bounces are ignored) and start TIM11
+in one-pulse mode for the debounce interval; further edges on other lines restart the same interval.
+2. when TIM11 overflows, its interrupt samples every line that saw an edge, and if the settled level differs
+from the last stable level (and matches the configured edge), pushes an event into the queue.
+3. the lines are unmasked again, ready for the next press.
+
+The reaction time is therefore always the debounce interval after the first edge, independent of what the
+main loop is doing, and the CPU does nothing at all while the pin is idle. exti_input_init() claims TIM11
+from tim.h for good, so a PWM or a one pulse there fails instead of breaking the debounce.
+
+## Event Queue
+
+The TIM11 interrupt is the only producer and the main loop the only consumer, so the queue is a
+single-producer single-consumer ring that needs no locking.
+
+*/
+
+#define EXTI_LINES (16U)
+#define EXTI_EVENT_QUEUE_SIZE (16U) // must be a power of two
+
+#ifndef EXTI_TIMER_CLOCK
+#define EXTI_TIMER_CLOCK 16000000U // TIM11 sits on APB2, which runs from the undivided HSI by default
+#endif
+
+typedef enum exti_edge_
+{
+    EXTI_EDGE_RISING = 1,
+    EXTI_EDGE_FALLING = 2,
+    EXTI_EDGE_BOTH = 3,
+} exti_edge_t;
+
+typedef enum exti_pull_
+{
+    EXTI_PULL_NONE = 0,
+    EXTI_PULL_UP = 1,
+    EXTI_PULL_DOWN = 2,
+} exti_pull_t;
+
+typedef struct exti_event_
+{
+    uint8_t port; // GPIO_PORT_x
+    uint8_t pin;
+    bool level;            // settled pin level after the debounce interval
+    uint32_t timestamp_ms; // millis() when the level was sampled
+} exti_event_t;
+
+// false if TIM11 is in use elsewhere (tim.h); it stays claimed from then on
+bool exti_input_init(uint16_t debounce_ms);
+
+// false if the pin is out of range or its EXTI line is already claimed by another port
+bool exti_input_add(uint8_t port, uint8_t pin, exti_edge_t edge, exti_pull_t pull);
+void exti_input_remove(uint8_t pin);
+
+bool exti_input_event_pending(void);
+bool exti_input_read_event(exti_event_t *event);
+uint32_t exti_input_dropped_events(void);
+
+// true while no debounce interval is running (TIM11 is not clocked in Stop mode)
+bool exti_input_idle(void);
+
+#endif /* D3F1A6C2_8E47_4B9A_9C05_7A21E4B6F8D1 */
@@ -0,0 +1,57 @@
+#ifndef F3B92D68_0C47_4A1E_8E35_D4A6170C9B2E
+#define F3B92D68_0C47_4A1E_8E35_D4A6170C9B2E
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+#include "ramfunc.h"
+
+/*
+
+# Flash Programming
+
+The STM32F401RE has 512K of flash in eight sectors of different sizes:
+
+    sector  0-3   16K each  0x08000000 - 0x0800FFFF
+    sector  4     64K       0x08010000 - 0x0801FFFF
+    sector  5-7  128K each  0x08020000 - 0x0807FFFF
+
+Flash can only be erased a whole sector at a time (every byte becomes 0xFF) and programming can only clear
+bits, so rewriting anything means erasing its sector first. The control register is locked after reset;
+flash_unlock() writes the key sequence and flash_lock() locks it again.
+
+While an erase or program operation is running, every read of the flash (and so every instruction fetch from
+it) stalls until the operation is over. flash_erase_sector() and flash_program() are RAMFUNC (ramfunc.h), so
+the busy wait itself runs from SRAM. Interrupts stay enabled throughout: a handler that is a RAMFUNC too and
+whose vector comes from the SRAM table (vectors_relocate() in vectors.h) keeps running during a sector erase.
+Any other handler just runs late, and so does the main loop, which waits in flash_erase_sector() throughout.
+
+Programming is done a word at a time (PSIZE x32, which needs a supply of 2.7 V or more, as on the Nucleo), with
+single bytes for an unaligned start or end. Both functions return false on an error; flash_errors() tells
+which one (the FLASH_SR error flags).
+
+No image uses this yet. Neither the Bootloader nor UARTDriver lists flash in its DRIVERS, and the Bootloader
+links no vectors either: it receives packets without writing them anywhere. Its USART2_Handler is a RAMFUNC,
+and so is comms_frame_bytes(), which the handler calls; the comms state machine is not, since it runs in the
+main loop, which is stuck in flash_erase_sector() during an erase anyway. An image that programs flash has to
+link flash and vectors and call vectors_relocate() before the first erase, or USART2 stops with the rest.
+
+*/
+
+#define FLASH_SECTOR_COUNT (8U)
+
+void flash_unlock(void);
+void flash_lock(void);
+
+// sector holding address, or -1 if the address is not in main flash
+int8_t flash_sector_of(uint32_t address);
+
+RAMFUNC bool flash_erase_sector(uint8_t sector);
+RAMFUNC bool flash_program(uint32_t address, const void *data, size_t length);
+
+// FLASH_SR error flags of the last operation that failed
+uint32_t flash_errors(void);
+
+#endif /* F3B92D68_0C47_4A1E_8E35_D4A6170C9B2E */
@@ -0,0 +1,116 @@
+#ifndef E7B2C4D9_3A51_4F08_B6E3_92D1C0A4F5E7
+#define E7B2C4D9_3A51_4F08_B6E3_92D1C0A4F5E7
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../Includes/STM32F401.h"
+
+/*
+
+# Atomic GPIO Access
+
+`GPIOA->ODR ^= PIN5` compiles to LDR, EOR, STR. If an interrupt changes another pin of the same port between
+the LDR and the STR, the STR writes the stale value back and silently undoes the interrupt's change. The
+same applies to `SET_BIT(GPIOA->BSRR, ...)`, which additionally reads BSRR (always reads as 0) for nothing.
+
+There are two ways to touch a single pin without a read-modify-write:
+
+1. BSRR: a write-only register; writing 1 to bit n sets ODR bit n, writing 1 to bit n + 16 resets it, and
+zeros have no effect. Any combination of pins of one port can be set and reset with a single store.
+
+2. Bit-banding: the Cortex-M4 maps every bit of the peripheral region (0x40000000 - 0x400FFFFF) to its own
+word in the alias region starting at 0x42000000:
+
+    alias = PERIPH_BB_BASE + (register_address - PERIPH_BASE) * 32 + bit * 4
+
+A store to the alias word writes just that bit (the bus performs the read-modify-write atomically), and a
+load from it returns 0 or 1. This is what we use for single bit reads, toggles and for control register bits
+that are written from both an interrupt and the main loop (like USART CR1 TXEIE).
+
+A toggle still has to read the current level, so two contexts toggling the *same* pin at the same time can
+cancel each other out; it never disturbs any other pin.
+
+## Pin Descriptors
+
+GPIO_PIN(A, 5) builds a gpio_pin_t from constants only, so when it is passed to the inline functions below
+the whole address calculation folds away and each operation is a single STR (or LDR) to a constant address.
+
+*/
+
+#define GPIO_PORT_A (0U) // port index; also the SYSCFG_EXTICR code and the RCC AHB1ENR bit
+#define GPIO_PORT_B (1U)
+#define GPIO_PORT_C (2U)
+#define GPIO_PORT_D (3U)
+#define GPIO_PORT_E (4U)
+#define GPIO_PORT_H (7U)
+
+#define GPIO_PORT_STRIDE (0x400UL)
+#define GPIO_PORT_BASE(index) (GPIOA_BASE + (uint32_t)(index) * GPIO_PORT_STRIDE)
+#define GPIO_PORT_INDEX(base) ((uint8_t)(((base) - GPIOA_BASE) / GPIO_PORT_STRIDE))
+
+// word in the bit-band alias region that mirrors bit `bit` of the peripheral register at `reg_addr`
+#define BITBAND_PERIPH_ADDR(reg_addr, bit) (PERIPH_BB_BASE + (((uint32_t)(reg_addr) - PERIPH_BASE) * 32UL) + ((uint32_t)(bit) * 4UL))
+#define BITBAND_PERIPH(reg, bit) (*(volatile uint32_t *)BITBAND_PERIPH_ADDR(&(reg), (bit)))
+
+typedef struct gpio_pin_
+{
+    uint32_t port_base;
+    uint8_t pin;
+} gpio_pin_t;
+
+#define GPIO_PIN(PORT, PIN) ((gpio_pin_t){.port_base = GPIO##PORT##_BASE, .pin = (PIN)})
+
+static inline GPIO_TypeDef *gpio_port(gpio_pin_t p)
+{
+    return (GPIO_TypeDef *)p.port_base;
+}
+
+static inline void gpio_set(gpio_pin_t p)
+{
+    gpio_port(p)->BSRR = (1UL << p.pin);
+}
+
+static inline void gpio_clear(gpio_pin_t p)
+{
+    gpio_port(p)->BSRR = (1UL << (p.pin + 16U));
+}
+
+static inline void gpio_write(gpio_pin_t p, bool level)
+{
+    // set bit n or reset bit n + 16; still a single store
+    gpio_port(p)->BSRR = (1UL << p.pin) << (level ? 0U : 16U);
+}
+
+static inline void gpio_toggle(gpio_pin_t p)
+{
+    volatile uint32_t *odr_bit = (volatile uint32_t *)BITBAND_PERIPH_ADDR(&gpio_port(p)->ODR, p.pin);
+    *odr_bit = !*odr_bit;
+}
+
+static inline bool gpio_read(gpio_pin_t p)
+{
+    return *(volatile uint32_t *)BITBAND_PERIPH_ADDR(&gpio_port(p)->IDR, p.pin);
+}
+
+static inline bool gpio_read_output(gpio_pin_t p)
+{
+    return *(volatile uint32_t *)BITBAND_PERIPH_ADDR(&gpio_port(p)->ODR, p.pin);
+}
+
+// drives every pin in mask to the matching bit of value in one store; pins outside mask are untouched
+static inline void gpio_port_write_masked(GPIO_TypeDef *port, uint16_t mask, uint16_t value)
+{
+    port->BSRR = ((uint32_t)(~value & mask) << 16U) | (uint32_t)(value & mask);
+}
+
+static inline void gpio_port_set_mask(GPIO_TypeDef *port, uint16_t mask)
+{
+    port->BSRR = mask;
+}
+
+static inline void gpio_port_clear_mask(GPIO_TypeDef *port, uint16_t mask)
+{
+    port->BSRR = (uint32_t)mask << 16U;
+}
+
+#endif /* E7B2C4D9_3A51_4F08_B6E3_92D1C0A4F5E7 */
@@ -0,0 +1,114 @@
+#ifndef C4D26E81_9B3F_4A57_8E10_5F7A93B2C6D4
+#define C4D26E81_9B3F_4A57_8E10_5F7A93B2C6D4
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+#include "gpio.h"
+#include "pinmux.h"
+
+/*
+
+# I2C Master
+
+A sensor register read is START, address + W, register, repeated START, address + R, the data, STOP. At
+100 kHz that is about 0.1 ms per byte on the wire, and a polled driver spins on SR1 for every step of it,
+so the main loop stops for the whole transaction. Here every step is an interrupt instead, and the main loop
+only queues transactions and gets a callback when they are done.
+
+## Transactions
+
+i2c_read_reg() and i2c_write_reg() queue one register access on I2C1 or I2C3 (I2C_QUEUE_SIZE per bus) and
+return false if the queue is full. The event interrupt walks the transaction through its steps:
+
+    SB    -> address + W                  ADDR -> register byte, then the write data
+    BTF   -> repeated START (read) or STOP (write)
+    SB    -> address + R                  ADDR -> set up the receive as below
+
+Writes of up to I2C_INLINE_WRITE bytes are copied into the queue entry and sent from the TXE interrupt;
+longer writes are sent by DMA straight from the caller's buffer, which must stay valid until the callback.
+Reads follow the reference manual's three cases: one byte (NACK and STOP before the byte arrives), two
+bytes (POS, read both at BTF) and more, by DMA with LAST so the hardware NACKs the last byte and the DMA
+transfer complete interrupt sets STOP. Nothing but the interrupts touches the bus once a transaction runs.
+
+    bus    pins (AF4)              DMA1 RX               DMA1 TX
+    I2C1   PB8 SCL, PB9 SDA        stream 0 or 5, ch 1   stream 7 or 6, ch 1
+    I2C3   PA8 SCL, PC9 SDA        stream 2, ch 3        stream 4, ch 3
+
+i2c_init() claims the streams from dma.h, the first free one of each pair, and fails if another driver
+holds both (I2C1's second choices, streams 5 and 6, are USART2's). The pins are open drain with the
+internal pull-ups, which are too weak for 400 kHz on anything but a short bus; fit external ones.
+
+## Errors and bus recovery
+
+A NACK (AF) ends the transaction with I2C_NACK and a STOP. A bus error or lost arbitration ends it with
+I2C_BUS_ERROR. A slave that stops responding mid-transfer would leave the transaction hanging forever, so
+i2c_update() (call it from the main loop) ends a transaction that moved no byte for I2C_TIMEOUT_MS with
+I2C_TIMEOUT; a long transfer that keeps moving never times out.
+
+Both cases recover the bus: a slave that was reset or confused in the middle of a read can hold SDA low,
+waiting for clocks that will never come, and the peripheral then sees the bus as busy forever. Recovery
+switches SCL to a plain GPIO and clocks it up to nine times until the slave lets go of SDA, generates a STOP
+by hand, then resets the peripheral (SWRST) and sets it up again. i2c_init() does the same if it finds SDA
+held low.
+
+Callbacks run in the interrupt that completed the transaction (i2c_update() for timeouts) and may queue the
+next one.
+
+*/
+
+#ifndef I2C_PCLK
+#define I2C_PCLK 16000000U // APB1, undivided HSI by default; 2 MHz minimum, 4 MHz for 400 kHz
+#endif
+
+#define I2C_QUEUE_SIZE (8U)    // per bus; must be a power of two
+#define I2C_INLINE_WRITE (2U)  // writes up to this long are copied and need no DMA
+#define I2C_TIMEOUT_MS (10U)   // a transaction stalled this long is abandoned by i2c_update()
+
+// boards combine these with their own table to check for pin conflicts (see pinmux.h)
+#define I2C1_PINMUX(X, ctx)                                                                      \
+    X(ctx, B, 8, PINMUX_MODE_AF, PINMUX_OPENDRAIN, PINMUX_SPEED_MEDIUM, PINMUX_PULL_UP, 4U) \
+    X(ctx, B, 9, PINMUX_MODE_AF, PINMUX_OPENDRAIN, PINMUX_SPEED_MEDIUM, PINMUX_PULL_UP, 4U)
+
+#define I2C3_PINMUX(X, ctx)                                                                      \
+    X(ctx, A, 8, PINMUX_MODE_AF, PINMUX_OPENDRAIN, PINMUX_SPEED_MEDIUM, PINMUX_PULL_UP, 4U) \
+    X(ctx, C, 9, PINMUX_MODE_AF, PINMUX_OPENDRAIN, PINMUX_SPEED_MEDIUM, PINMUX_PULL_UP, 4U)
+
+typedef enum i2c_bus_
+{
+    I2C_BUS_1 = 0,
+    I2C_BUS_3 = 1,
+    I2C_BUS_COUNT = 2,
+} i2c_bus_t;
+
+typedef enum i2c_status_
+{
+    I2C_OK = 0,
+    I2C_NACK = 1,      // the slave didn't acknowledge its address or a byte
+    I2C_BUS_ERROR = 2, // misplaced START/STOP or lost arbitration; the bus was recovered
+    I2C_TIMEOUT = 3,   // no progress for I2C_TIMEOUT_MS; the bus was recovered
+} i2c_status_t;
+
+typedef void (*i2c_callback_t)(void *context, i2c_status_t status);
+
+// speed_hz up to 100000 is standard mode, up to 400000 fast mode
+// false if the bus's DMA streams are held by other drivers
+bool i2c_init(i2c_bus_t bus, uint32_t speed_hz);
+
+// address is the 7 bit slave address; length 1 to 0xFFFF, data must stay valid until the callback
+bool i2c_read_reg(i2c_bus_t bus, uint8_t address, uint8_t reg, uint8_t *data, uint16_t length,
+                  i2c_callback_t callback, void *context);
+// length may be 0 (the register byte alone, e.g. a command)
+bool i2c_write_reg(i2c_bus_t bus, uint8_t address, uint8_t reg, const uint8_t *data, uint16_t length,
+                   i2c_callback_t callback, void *context);
+
+// times out stuck transactions; call it from the main loop
+void i2c_update(void);
+
+bool i2c_busy(i2c_bus_t bus);
+uint32_t i2c_errors(i2c_bus_t bus);     // transactions that ended with anything but I2C_OK
+uint32_t i2c_recoveries(i2c_bus_t bus); // times the bus had to be recovered
+
+#endif /* C4D26E81_9B3F_4A57_8E10_5F7A93B2C6D4 */
@@ -0,0 +1,84 @@
+#ifndef D51F8B3E_7C24_4A96_B0E3_6A9F2D14C857
+#define D51F8B3E_7C24_4A96_B0E3_6A9F2D14C857
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# Stack and Heap Usage
+
+The linker script reserves __Min_Stack_Size bytes at the top of RAM for the main stack and __Min_Heap_Size
+bytes for the heap, and the numbers are guesses: nothing says how deep comms_update() plus an interrupt handler
+on top of it really goes. Too small and the stack silently grows down into the heap and .bss, corrupting
+whatever variables live there; too large and the RAM is wasted instead of going to buffers.
+
+## Measuring
+
+Reset_Handler (startup.s) paints the whole stack reservation with MEMSTAT_STACK_PAINT before main() runs. The
+stack only ever overwrites that pattern, so the lowest word that no longer holds it marks the deepest point
+the stack has reached since reset. memstat_get() finds it by scanning up from __stack_limit, which takes a few
+cycles per unused word, so call it from the main loop now and then, not from an interrupt handler.
+
+Heap use comes from _sbrk() (sysmem.c): the heap never shrinks, so how far it has been extended is its peak.
+
+Run the firmware through its worst case (full comms traffic, every interrupt firing) and the peaks tell how
+much of each reservation is really needed.
+
+## Guard
+
+Measuring only shows an overflow after the fact. memstat_guard_enable() also makes the __Stack_Guard_Size
+bytes right below the stack (__stack_guard in the linker script) inaccessible through the MPU:
+
+             RAM end -> +------------------+ _estack
+                        |      stack       |   grows down
+                        +------------------+ __stack_limit
+                        |  guard (256 B)   |   MPU: no access, MemManage fault on any access
+                        +------------------+ __stack_guard = __heap_limit
+                        |      heap        |
+                        +------------------+
+                        |.data/.bss/.noinit|
+
+A push that would run past __stack_limit now faults instead of corrupting the heap. The stack itself can't be
+used any more at that point, so MemManage_Handler puts the stack pointer back to _estack (whatever was on the
+stack is lost), calls memstat_on_fault() - weak and empty, override it to note the fault somewhere - and
+resets the chip. The MPU's default memory map stays active for everything else (PRIVDEFENA), so the guard is
+the only change.
+
+That only works if the first access below __stack_limit lands in the guard. A function opens its whole frame
+with a single sub sp and may write anywhere in it first, so a frame larger than the guard can step over it
+and write into the heap unnoticed. The guard is 256 bytes (__Stack_Guard_Size; the linker script checks the
+alignment the MPU needs), above the largest frames in the coresys drivers and the apps: dlog_write() holds two
+DLOG_MAX_RECORD arrays, flush_log() in UARTDriver one. A function with a bigger local array needs a bigger
+guard, or the array moved off the stack.
+
+Disable the guard (memstat_guard_disable()) before jumping to another image that doesn't expect the MPU.
+
+The host build (make host) has neither the painted stack nor an MPU; there memstat_get() reports zeros and
+the guard functions do nothing.
+
+*/
+
+#define MEMSTAT_STACK_PAINT (0xA5A5A5A5U) // keep in sync with startup.s
+#define MEMSTAT_GUARD_REGION (7U)         // the highest numbered MPU region wins where regions overlap
+
+typedef struct memstat_
+{
+    uint32_t stack_size; // bytes reserved for the main stack
+    uint32_t stack_peak; // deepest the stack has been since reset
+    uint32_t heap_size;  // bytes between the end of .noinit and the guard
+    uint32_t heap_peak;  // how far _sbrk() has extended the heap
+} memstat_t;
+
+void memstat_get(memstat_t *stats);
+
+void memstat_guard_enable(void);
+void memstat_guard_disable(void);
+
+// called from MemManage_Handler on a fresh stack, right before the reset; cfsr and mmfar as read from the SCB
+void memstat_on_fault(uint32_t cfsr, uint32_t mmfar);
+
+#endif /* D51F8B3E_7C24_4A96_B0E3_6A9F2D14C857 */
@@ -0,0 +1,129 @@
+#ifndef F1C8E5A3_6D29_4B7E_A0F4_3E9B7C2D8A61
+#define F1C8E5A3_6D29_4B7E_A0F4_3E9B7C2D8A61
+
+#include <stdint.h>
+#include "../../Includes/STM32F401.h"
+#include "gpio.h"
+
+/*
+
+# Compile-Time Pin Multiplexing
+
+Configuring a pin by hand takes one read-modify-write per bit: UART2_init() used to spend 16 SET_BIT /
+CLEAR_BIT calls on MODER, AFR and PUPDR for just PA2 and PA3. Instead, a board describes its pins once
+as a table:
+
+    #define UART2_PINMUX(X, ctx)                                                                          \
+        X(ctx, A, 2, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_NONE, 7) // TX AF7  \
+        X(ctx, A, 3, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_LOW, PINMUX_PULL_UP, 7)   // RX AF7
+
+i.e. X(ctx, port, pin, mode, output type, speed, pull, alternate function). Tables are just macros, so
+several of them can be concatenated into one board table:
+
+    #define BOARD_PINMUX(X, ctx) UART2_PINMUX(X, ctx) LED_PINMUX(X, ctx)
+
+PINMUX_APPLY(TABLE) expands the table once per register and per port into integer constant expressions
+(a mask and a value), so the compiler folds every one of them into immediates. What is left at runtime is
+one masked write per register that is actually touched, a single RCC store enabling all used ports, and
+nothing at all for ports the table doesn't mention.
+
+The registers are written in the order AFR, OTYPER, OSPEEDR, PUPDR and MODER last, so a pin never
+switches to its new mode before its alternate function and pull are in place.
+
+PINMUX_CHECK_CONFLICTS(TABLE) is a compile-time check (placed at file scope): if two entries claim the
+same port and pin, the build fails. Applied to a composed board table, this catches two peripherals
+fighting over one pin.
+
+*/
+
+#define PINMUX_MODE_INPUT (0U)
+#define PINMUX_MODE_OUTPUT (1U)
+#define PINMUX_MODE_AF (2U)
+#define PINMUX_MODE_ANALOG (3U)
+
+#define PINMUX_PUSHPULL (0U)
+#define PINMUX_OPENDRAIN (1U)
+
+#define PINMUX_SPEED_LOW (0U)
+#define PINMUX_SPEED_MEDIUM (1U)
+#define PINMUX_SPEED_FAST (2U)
+#define PINMUX_SPEED_HIGH (3U)
+
+#define PINMUX_PULL_NONE (0U)
+#define PINMUX_PULL_UP (1U)
+#define PINMUX_PULL_DOWN (2U)
+
+// per-entry expanders; `port` is the GPIO_PORT_x the expression is being built for
+#define PINMUX_SEL(port, P) ((port) == GPIO_PORT_##P)
+#define PINMUX_IS_AF_LOW(N, MODE) (((MODE) == PINMUX_MODE_AF) && ((N) < 8U))
+#define PINMUX_IS_AF_HIGH(N, MODE) (((MODE) == PINMUX_MODE_AF) && ((N) >= 8U))
+
+#define PINMUX_X_PORTS(port, P, N, MODE, OTYPE, SPEED, PULL, AF) | (1UL << GPIO_PORT_##P)
+#define PINMUX_X_MASK1(port, P, N, MODE, OTYPE, SPEED, PULL, AF) | (PINMUX_SEL(port, P) ? (1UL << (N)) : 0UL)
+#define PINMUX_X_MASK2(port, P, N, MODE, OTYPE, SPEED, PULL, AF) | (PINMUX_SEL(port, P) ? (0x3UL << ((N) * 2U)) : 0UL)
+#define PINMUX_X_PIN_SUM(port, P, N, MODE, OTYPE, SPEED, PULL, AF) + (PINMUX_SEL(port, P) ? (1UL << (N)) : 0UL)
+#define PINMUX_X_MODER(port, P, N, MODE, OTYPE, SPEED, PULL, AF) | (PINMUX_SEL(port, P) ? ((uint32_t)(MODE) << ((N) * 2U)) : 0UL)
+#define PINMUX_X_OTYPER(port, P, N, MODE, OTYPE, SPEED, PULL, AF) | (PINMUX_SEL(port, P) ? ((uint32_t)(OTYPE) << (N)) : 0UL)
+#define PINMUX_X_OSPEEDR(port, P, N, MODE, OTYPE, SPEED, PULL, AF) | (PINMUX_SEL(port, P) ? ((uint32_t)(SPEED) << ((N) * 2U)) : 0UL)
+#define PINMUX_X_PUPDR(port, P, N, MODE, OTYPE, SPEED, PULL, AF) | (PINMUX_SEL(port, P) ? ((uint32_t)(PULL) << ((N) * 2U)) : 0UL)
+#define PINMUX_X_AFRL_MASK(port, P, N, MODE, OTYPE, SPEED, PULL, AF) \
+    | ((PINMUX_SEL(port, P) && PINMUX_IS_AF_LOW(N, MODE)) ? (0xFUL << (((N) & 7U) * 4U)) : 0UL)
+#define PINMUX_X_AFRL(port, P, N, MODE, OTYPE, SPEED, PULL, AF) \
+    | ((PINMUX_SEL(port, P) && PINMUX_IS_AF_LOW(N, MODE)) ? ((uint32_t)(AF) << (((N) & 7U) * 4U)) : 0UL)
+#define PINMUX_X_AFRH_MASK(port, P, N, MODE, OTYPE, SPEED, PULL, AF) \
+    | ((PINMUX_SEL(port, P) && PINMUX_IS_AF_HIGH(N, MODE)) ? (0xFUL << (((N) & 7U) * 4U)) : 0UL)
+#define PINMUX_X_AFRH(port, P, N, MODE, OTYPE, SPEED, PULL, AF) \
+    | ((PINMUX_SEL(port, P) && PINMUX_IS_AF_HIGH(N, MODE)) ? ((uint32_t)(AF) << (((N) & 7U) * 4U)) : 0UL)
+
+// constant expressions for one register of one port
+#define PINMUX_EXPR(TABLE, X, port) (0UL TABLE(X, port))
+
+#define PINMUX_WRITE_REG(reg, mask, value)         \
+    do                                             \
+    {                                              \
+        if (mask)                                  \
+        {                                          \
+            (reg) = ((reg) & ~(mask)) | (value);   \
+        }                                          \
+    } while (0)
+
+#define PINMUX_APPLY_PORT(TABLE, port)                                                                                              \
+    do                                                                                                                              \
+    {                                                                                                                               \
+        if (PINMUX_EXPR(TABLE, PINMUX_X_MASK1, port))                                                                               \
+        {                                                                                                                           \
+            GPIO_TypeDef *const pinmux_gpio = (GPIO_TypeDef *)GPIO_PORT_BASE(port);                                                 \
+            PINMUX_WRITE_REG(pinmux_gpio->AFR[0], PINMUX_EXPR(TABLE, PINMUX_X_AFRL_MASK, port), PINMUX_EXPR(TABLE, PINMUX_X_AFRL, port)); \
+            PINMUX_WRITE_REG(pinmux_gpio->AFR[1], PINMUX_EXPR(TABLE, PINMUX_X_AFRH_MASK, port), PINMUX_EXPR(TABLE, PINMUX_X_AFRH, port)); \
+            PINMUX_WRITE_REG(pinmux_gpio->OTYPER, PINMUX_EXPR(TABLE, PINMUX_X_MASK1, port), PINMUX_EXPR(TABLE, PINMUX_X_OTYPER, port));   \
+            PINMUX_WRITE_REG(pinmux_gpio->OSPEEDR, PINMUX_EXPR(TABLE, PINMUX_X_MASK2, port), PINMUX_EXPR(TABLE, PINMUX_X_OSPEEDR, port)); \
+            PINMUX_WRITE_REG(pinmux_gpio->PUPDR, PINMUX_EXPR(TABLE, PINMUX_X_MASK2, port), PINMUX_EXPR(TABLE, PINMUX_X_PUPDR, port));     \
+            PINMUX_WRITE_REG(pinmux_gpio->MODER, PINMUX_EXPR(TABLE, PINMUX_X_MASK2, port), PINMUX_EXPR(TABLE, PINMUX_X_MODER, port));     \
+        }                                                                                                                           \
+    } while (0)
+
+#define PINMUX_APPLY(TABLE)                                                \
+    do                                                                     \
+    {                                                                      \
+        RCC->AHB1ENR |= PINMUX_EXPR(TABLE, PINMUX_X_PORTS, 0U);            \
+        PINMUX_APPLY_PORT(TABLE, GPIO_PORT_A);                             \
+        PINMUX_APPLY_PORT(TABLE, GPIO_PORT_B);                             \
+        PINMUX_APPLY_PORT(TABLE, GPIO_PORT_C);                             \
+        PINMUX_APPLY_PORT(TABLE, GPIO_PORT_D);                             \
+        PINMUX_APPLY_PORT(TABLE, GPIO_PORT_E);                             \
+        PINMUX_APPLY_PORT(TABLE, GPIO_PORT_H);                             \
+    } while (0)
+
+// a pin listed twice makes the sum of the pin bits larger than their OR
+#define PINMUX_CHECK_PORT(TABLE, port, name) \
+    _Static_assert(PINMUX_EXPR(TABLE, PINMUX_X_PIN_SUM, port) == PINMUX_EXPR(TABLE, PINMUX_X_MASK1, port), "pinmux: a pin on port " name " is claimed twice")
+
+#define PINMUX_CHECK_CONFLICTS(TABLE)              \
+    PINMUX_CHECK_PORT(TABLE, GPIO_PORT_A, "A");    \
+    PINMUX_CHECK_PORT(TABLE, GPIO_PORT_B, "B");    \
+    PINMUX_CHECK_PORT(TABLE, GPIO_PORT_C, "C");    \
+    PINMUX_CHECK_PORT(TABLE, GPIO_PORT_D, "D");    \
+    PINMUX_CHECK_PORT(TABLE, GPIO_PORT_E, "E");    \
+    PINMUX_CHECK_PORT(TABLE, GPIO_PORT_H, "H")
+
+#endif /* F1C8E5A3_6D29_4B7E_A0F4_3E9B7C2D8A61 */
@@ -0,0 +1,116 @@
+#ifndef A7D3E5C2_94B1_4F0E_8C6A_2E51F7B9D048
+#define A7D3E5C2_94B1_4F0E_8C6A_2E51F7B9D048
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# Fixed-Block Memory Pools
+
+malloc() on top of _sbrk (coresys/PseudoSyscalls/sysmem.c) is a poor fit for a microcontroller: how long an
+allocation takes depends on the state of the heap, the heap only ever grows, and after a while of mixed sizes
+the free memory is cut into pieces too small to use. A pool gives up on variable sizes instead:
+
+1. All blocks of a pool have the same size and live in one static array, so the memory is reserved at link
+time and shows up in the map file like any other variable.
+
+2. Free blocks form a singly linked list threaded through the blocks themselves (the first word of a free
+block points to the next free one), so the pool needs no memory besides the blocks.
+
+3. pool_alloc() pops the head of that list and pool_free() pushes the block back: O(1), a handful of
+instructions, and no fragmentation, because any free block fits any request.
+
+Both take a few cycles with interrupts masked, so blocks can be allocated in an interrupt handler and freed in
+the main loop or the other way round.
+
+## Size classes
+
+Different kinds of objects (packets, DMA descriptors, log records) get a pool each, sized for them. A set of
+pools sorted by block size can also be used like a small malloc: pool_class_alloc() takes a block from the
+smallest pool whose blocks are big enough, moving on to the next larger pool when that one is empty, and
+pool_class_free() finds the owning pool from the address.
+
+    POOL_DEFINE(small_pool, 16, 8);
+    POOL_DEFINE(large_pool, 64, 4);
+    static pool_t *const classes[] = {&small_pool, &large_pool};
+
+    pool_init(&small_pool);
+    pool_init(&large_pool);
+    uint8_t *buffer = pool_class_alloc(classes, 2, 40); // a 64 byte block
+    pool_class_free(classes, 2, buffer);
+
+## Statistics
+
+Every pool counts the blocks in use and the highest that count has ever been (peak_used), so after a test run
+the pool can be sized to what was really needed instead of a guess. A pool that ran out counts the failed
+allocations; a pool_free() of something that isn't one of its blocks is counted and otherwise ignored.
+
+So is a double free: pool_free() of a block that is free already would link it into the free list a second
+time and hand it out twice. Catching that takes a walk of the free list, up to block_count steps with
+interrupts masked, on every free; a pool that is known to be used correctly can build with
+POOL_DOUBLE_FREE_CHECK 0 to get the O(1) free back. A double free that is missed here (the block was
+allocated again in between) is a use after free, which no pool can tell from a normal free.
+
+*/
+
+#ifndef POOL_DOUBLE_FREE_CHECK
+#define POOL_DOUBLE_FREE_CHECK (1) // 0: pool_free() doesn't look for the block on the free list
+#endif
+
+// blocks hold the free list pointer while free, so they are at least one pointer long and pointer aligned
+#define POOL_BLOCK_SIZE(size) (((size) + sizeof(void *) - 1U) & ~(sizeof(void *) - 1U))
+
+// defines a pool of count blocks of at least size bytes with static storage; call pool_init() before use
+#define POOL_DEFINE(name, size, count)                                                              \
+    static void *name##_storage_[(POOL_BLOCK_SIZE(size) / sizeof(void *)) * (count)];              \
+    static pool_t name = {                                                                          \
+        .storage = (uint8_t *)name##_storage_,                                                      \
+        .block_size = POOL_BLOCK_SIZE(size),                                                        \
+        .block_count = (count),                                                                     \
+    }
+
+typedef struct pool_block_
+{
+    struct pool_block_ *next;
+} pool_block_t;
+
+typedef struct pool_
+{
+    uint8_t *storage;
+    uint16_t block_size;
+    uint16_t block_count;
+    pool_block_t *free_list;
+    uint16_t used;
+    uint16_t peak_used;
+    uint32_t failures;  // allocations that found the pool empty
+    uint32_t bad_frees; // pool_free() of a pointer that isn't a block of this pool, or of a free one
+} pool_t;
+
+typedef struct pool_stats_
+{
+    uint16_t block_size;
+    uint16_t block_count;
+    uint16_t used;
+    uint16_t peak_used;
+    uint32_t failures;
+    uint32_t bad_frees;
+} pool_stats_t;
+
+void pool_init(pool_t *pool);
+
+// NULL if the pool is empty
+void *pool_alloc(pool_t *pool);
+void pool_free(pool_t *pool, void *block);
+bool pool_owns(const pool_t *pool, const void *block);
+
+// classes: pools sorted by ascending block size
+void *pool_class_alloc(pool_t *const *classes, uint8_t count, size_t size);
+void pool_class_free(pool_t *const *classes, uint8_t count, void *block);
+
+void pool_get_stats(const pool_t *pool, pool_stats_t *stats);
+
+#endif /* A7D3E5C2_94B1_4F0E_8C6A_2E51F7B9D048 */
@@ -0,0 +1,83 @@
+#ifndef CA599742_5229_462B_B353_1E85AA4C6BA8
+#define CA599742_5229_462B_B353_1E85AA4C6BA8
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+#include "gpio.h"
+
+/*
+
+# Low-Power Idle
+
+power_idle() is meant to be the last call of every main loop iteration. It masks interrupts, asks the
+application whether there is still work to do, and if there isn't, puts the core to sleep until the next
+interrupt or the next soft timer expiry, whichever comes first.
+
+Interrupts stay masked (PRIMASK = 1) across the whole decision and the sleep itself. A pending interrupt
+still wakes WFI/WFE even while masked, so a byte that arrives right after the "is there work?" check is not
+missed; its handler simply runs as soon as we unmask on the way out.
+
+## Sleep mode (WFI)
+
+The default. Only the core clock stops; all peripherals (USART, timers, DMA) keep running and any enabled
+interrupt wakes us up within a few cycles. The SysTick is suppressed for the whole idle period (see
+systick.h), so the core really sleeps until the next timer expiry instead of waking up every millisecond.
+
+## Stop mode (SLEEPDEEP + WFE)
+
+Off unless the board opts in with power_allow_stop(true). Then it is used when no soft timer is running,
+nothing has happened for POWER_STOP_QUIET_MS and stop_allowed() agrees. All clocks in the 1.2V domain stop
+(HSI, PLL, peripheral clocks, SysTick); SRAM and registers are retained. We keep the main regulator on and
+the flash powered (LPDS = 0, FPDS = 0) which gives the shortest wake-up time of the Stop variants, at
+roughly a tenth of the Run current at 16MHz.
+
+Peripherals can't raise interrupts in Stop, so the only wake-up sources are EXTI lines. Since the USART
+itself is clocked off, the RX pin is also routed to an EXTI line in event mode (no handler needed): the
+falling edge of the first start bit wakes the core. Waking up takes longer than a bit at 115200 baud (the
+regulator and the HSI have to start), and the USART is not clocked meanwhile, so that first byte is lost.
+No wake-up is fast enough to avoid that, so Stop is for boards that can lose it: the bootloader, whose comms
+layer resends an unacknowledged frame, or a board whose only wake-up source is an EXTI input, which works
+in Stop as it does in Run. A board that has to catch every received byte leaves Stop off and sleeps, and
+Sleep wakes within a few cycles of the start bit.
+
+Stop time is not counted in millis() since the SysTick is halted; only the number of Stop entries is kept.
+
+## Residency statistics
+
+power_get_stats() reports how many times we slept and how long we spent sleeping, so the idle fraction
+of the CPU can be read out at runtime.
+
+*/
+
+#ifndef POWER_STOP_QUIET_MS
+#define POWER_STOP_QUIET_MS (2000U) // no work for this long before Stop mode is considered
+#endif
+
+// called with interrupts masked; must be short and must not block
+typedef bool (*power_check_t)(void);
+
+typedef struct power_stats_
+{
+    uint32_t uptime_ms;    // time since power_init() or power_reset_stats()
+    uint32_t sleep_ms;     // time spent in Sleep mode
+    uint32_t sleep_count;  // number of Sleep mode entries
+    uint32_t stop_count;   // number of Stop mode entries
+    uint32_t busy_count;   // number of power_idle() calls that found work pending
+} power_stats_t;
+
+// work_pending: true keeps the core awake (e.g. unread RX bytes)
+// stop_allowed: false while a peripheral still needs its clock (e.g. UART transmitting); may be NULL
+void power_init(power_check_t work_pending, power_check_t stop_allowed);
+void power_idle(void);
+
+// Stop mode is off until a board that can lose the first byte received after it allows it
+void power_allow_stop(bool allow);
+// routes port (GPIO_PORT_x) / pin to an EXTI line in falling-edge event mode so that it wakes the core from Stop
+void power_set_stop_wakeup_pin(uint8_t port, uint8_t pin);
+
+void power_get_stats(power_stats_t *stats);
+void power_reset_stats(void);
+
+#endif /* CA599742_5229_462B_B353_1E85AA4C6BA8 */
@@ -0,0 +1,46 @@
+#ifndef E6A1C94D_3B58_4F27_9D0E_71C2B8F45A93
+#define E6A1C94D_3B58_4F27_9D0E_71C2B8F45A93
+
+/*
+
+# Functions in SRAM
+
+Code normally runs straight from flash. At 16 MHz (HSI) flash keeps up with the core, but from 30 MHz on every
+fetch needs wait states (5 at 84 MHz on 3.3 V) and only the ART accelerator's small instruction cache hides
+them; an interrupt handler that has been evicted from the cache pays for them on every instruction. Worse, while
+the flash is being erased or programmed, any fetch from it stalls the bus until the operation is done: a
+sector erase takes up to a couple of seconds, and a UART handler in flash misses every byte in between.
+
+RAMFUNC puts a function into the .ramfunc section instead. The linker script places .ramfunc at the start of
+.data, so Reset_Handler copies it from flash to SRAM together with the initialized variables and it runs from
+there, at zero wait states and independent of the flash:
+
+    RAMFUNC void USART2_Handler(void)
+    {
+        ...
+    }
+
+1. Only the function itself moves. Whatever it calls (memcpy, a driver function without RAMFUNC) still runs
+from flash, so a handler that has to keep running during a flash operation may only call RAMFUNC functions
+and static inline ones. The linker inserts a veneer where a call between flash and SRAM is out of branch range.
+
+2. The exception entry fetches the handler address from the vector table, which is in flash as well. For a
+handler to run while the flash is busy, the table has to be in SRAM too: call vectors_relocate() (vectors.h)
+first. Handlers that are still in flash then just run late, once the flash operation is over.
+
+3. SRAM is the scarcer memory (96K against 512K), and each RAMFUNC costs its size in both. Use it for interrupt
+handlers, inner loops and the flash programming code (flash.h), not as a general speed-up.
+
+4. SystemInit() runs before the copy and must not be a RAMFUNC.
+
+The host build (make host) runs everything from ordinary memory; there RAMFUNC expands to nothing.
+
+*/
+
+#ifndef HOST_EMULATION
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif /* E6A1C94D_3B58_4F27_9D0E_71C2B8F45A93 */
@@ -0,0 +1,107 @@
+#ifndef B7917559_0215_483C_A08F_DFFC44880329
+#define B7917559_0215_483C_A08F_DFFC44880329
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+#include "gpio.h"
+#include "pinmux.h"
+
+/*
+
+# SPI1 Master with DMA
+
+SPI is full duplex: every byte clocked out on MOSI clocks one in on MISO, so a transfer always moves the same
+number of bytes in both directions. Feeding DR from the CPU means one TXE wait and one RXNE wait per byte; at
+8 MHz SCK a byte takes 16 cycles of a 16 MHz core, less than the loop around DR itself, and the CPU can do
+nothing else meanwhile.
+
+Instead, two DMA2 streams do the byte work, claimed from dma.h (stream 2 and 3 unless something else holds
+them):
+
+    SPI1_RX  DR -> rx buffer (or a single sink byte if rx is NULL)
+    SPI1_TX  tx buffer -> DR (or a single SPI_TX_FILL byte if tx is NULL)
+
+A transfer lowers its chip select, enables the RX stream and then the TX stream; the TX stream fills DR as
+soon as TXE is set and the RX stream empties it at every RXNE, so the CPU is not involved again until the RX
+stream's transfer complete interrupt. RX is the stream that finishes last (the last byte has been clocked in
+when it arrives), so that interrupt raises the chip select, calls the transfer's callback and starts the
+next queued transfer right away. A queue of transfers therefore runs back to back with one interrupt per
+transfer, not per byte.
+
+## Queue
+
+spi_submit() copies the transfer into a ring of SPI_QUEUE_SIZE entries and returns false if the ring is full.
+The buffers are not copied: tx and rx must stay valid until the callback has run. Callbacks run in the DMA
+interrupt and may submit the next transfer themselves (e.g. a read that depends on a status byte).
+
+## Clock
+
+SPI1 sits on APB2. SCK is APB2 / 2, 4, ..., 256; spi_init() picks the fastest one not above max_hz. APB2 is
+SPI_PCLK (the 16 MHz HSI by default, so at most 8 MHz); with APB2 at its 84 MHz maximum SPI1 reaches 42 MHz,
+which needs PINMUX_SPEED_HIGH on the pins (as in SPI1_PINMUX).
+
+Chip select pins are plain GPIO outputs, idle high; configure them in the board's pin table. A transfer
+with cs.port_base == 0 leaves chip select alone (SPI_NO_CS).
+
+## Host build
+
+The host emulator (host_emu.h) models SPI1 and the DMA2 streams; link dma.c and vectors.c along with spi.c.
+A transfer completes the moment its TX stream is enabled, against the device attached with
+host_emu_spi_attach() (MISO mirrors MOSI by default). The model reads and writes the buffers through their
+32 bit addresses, which the host build's -no-pie keeps valid for static buffers only, not for ones on the
+stack. make check in coresys/Host runs the driver that way (Check/spi_check.c).
+
+*/
+
+#ifndef SPI_PCLK
+#define SPI_PCLK 16000000U // APB2, undivided HSI by default
+#endif
+
+#define SPI_QUEUE_SIZE (8U) // must be a power of two
+#define SPI_TX_FILL (0xFFU) // sent when a transfer has no tx buffer
+#define SPI_MAX_LENGTH (0xFFFFU) // NDTR is 16 bits
+
+#define SPI_NO_CS ((gpio_pin_t){.port_base = 0U, .pin = 0U})
+
+// PB3 (SCK), PB4 (MISO) and PB5 (MOSI) on AF5; PA5 is taken by the Nucleo LED
+// boards combine this with their own table to check for pin conflicts (see pinmux.h)
+#define SPI1_PINMUX(X, ctx)                                                                    \
+    X(ctx, B, 3, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_HIGH, PINMUX_PULL_NONE, 5U) \
+    X(ctx, B, 4, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_HIGH, PINMUX_PULL_UP, 5U)   \
+    X(ctx, B, 5, PINMUX_MODE_AF, PINMUX_PUSHPULL, PINMUX_SPEED_HIGH, PINMUX_PULL_NONE, 5U)
+
+typedef enum spi_mode_
+{
+    SPI_MODE_0 = 0, // CPOL 0, CPHA 0
+    SPI_MODE_1 = 1, // CPOL 0, CPHA 1
+    SPI_MODE_2 = 2, // CPOL 1, CPHA 0
+    SPI_MODE_3 = 3, // CPOL 1, CPHA 1
+} spi_mode_t;
+
+// ok is false if a DMA stream reported an error; rx then holds whatever had arrived
+typedef void (*spi_callback_t)(void *context, bool ok);
+
+typedef struct spi_transfer_
+{
+    gpio_pin_t cs;           // driven low for the whole transfer, or SPI_NO_CS
+    const uint8_t *tx;       // NULL: send SPI_TX_FILL
+    uint8_t *rx;             // NULL: discard what comes in
+    uint16_t length;         // bytes in each direction, 1 to SPI_MAX_LENGTH
+    spi_callback_t callback; // may be NULL; runs in the DMA interrupt
+    void *context;           // passed to callback
+} spi_transfer_t;
+
+// returns the SCK frequency it chose, or 0 if the DMA streams are held by other drivers
+uint32_t spi_init(uint32_t max_hz, spi_mode_t mode);
+
+// false if the queue is full or the transfer is empty
+bool spi_submit(const spi_transfer_t *transfer);
+
+// true while a transfer is running or queued
+bool spi_busy(void);
+uint32_t spi_errors(void);
+
+#endif /* B7917559_0215_483C_A08F_DFFC44880329 */
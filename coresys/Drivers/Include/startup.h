@@ -0,0 +1,73 @@
+#ifndef A84E2F63_1D9C_4B70_93E5_C6F07A2B5D18
+#define A84E2F63_1D9C_4B70_93E5_C6F07A2B5D18
+
+#include <stdint.h>
+
+/*
+
+# Startup
+
+Reset_Handler (coresys/Startup/startup.s) runs before main() and does, in order:
+
+1. starts the DWT cycle counter from 0
+2. sets the stack pointer and calls SystemInit()
+3. copies .data (with the RAMFUNC code, see ramfunc.h) from flash to SRAM
+4. zeroes .bss
+5. paints the stack for memstat.h
+6. stores the cycle counter in startup_cycles and calls main()
+
+Steps 3 to 5 touch every word of .data, .bss and the stack, so they are most of the boot time. They move
+8 words per LDM/STM pair, about 1.5 cycles per word for the stores and 3 for the copy, against 5 to 7 for the
+one word at a time loops they replace, and finish with single words.
+
+## Measuring
+
+startup_cycles holds the core cycles from reset to the call of main(), read from the DWT cycle counter.
+Divide by SYS_CLOCK for the time. It counts from the first instruction of Reset_Handler, so the time the chip
+spends in reset before that (power-on reset delay, option byte loading) isn't included.
+
+## libc initialization
+
+__libc_init_array() runs the C++ static constructors and functions marked __attribute__((constructor)). The
+images here are plain C without either, so Reset_Handler skips it. To call it anyway, assemble startup.s with
+-Wa,--defsym,STARTUP_LIBC_INIT=1, and keep .init_array in the linker script (--gc-sections drops it now).
+
+## Variables that survive a reset
+
+Reset_Handler only initializes .data and .bss; a variable marked NOINIT goes into the .noinit section, which
+it leaves alone. After a soft reset (NVIC_SystemReset(), the watchdog, the reset button) such a variable still
+holds what it held before, which makes it the place for a crash record or the state of a firmware update.
+After power-on its contents are random, so always store a magic value next to the data:
+
+    typedef struct crash_log_
+    {
+        uint32_t magic;
+        uint32_t cfsr;
+        uint32_t mmfar;
+    } crash_log_t;
+
+    NOINIT static crash_log_t crash_log;
+
+    void memstat_on_fault(uint32_t cfsr, uint32_t mmfar)
+    {
+        crash_log.cfsr = cfsr;
+        crash_log.mmfar = mmfar;
+        crash_log.magic = CRASH_LOG_MAGIC;
+    }
+
+and check it (then clear it) after the next boot. A NOINIT variable can't have an initializer.
+
+The host build (make host) has no Reset_Handler: there startup_cycles is 0 and NOINIT variables start out
+zeroed like any other.
+
+*/
+
+#ifndef HOST_EMULATION
+#define NOINIT __attribute__((section(".noinit")))
+#else
+#define NOINIT
+#endif
+
+extern uint32_t startup_cycles;
+
+#endif /* A84E2F63_1D9C_4B70_93E5_C6F07A2B5D18 */
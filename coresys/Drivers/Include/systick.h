@@ -0,0 +1,61 @@
+#ifndef A529D6B5_6774_47D7_AE4E_5B234D86298E
+#define A529D6B5_6774_47D7_AE4E_5B234D86298E
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# SysTick Timebase
+
+The SysTick is a 24-bit down counter inside the Cortex-M4 core. When it is enabled, it counts down from
+the value in SysTick->LOAD to zero, reloads LOAD on the next clock and raises the SysTick exception.
+
+We clock it from the processor clock (CLKSOURCE = 1) and program LOAD so that it wraps exactly once every
+millisecond. The exception handler only increments a 32-bit millisecond counter; everything else (timer
+wheel processing, timeouts) runs in main context by comparing against that counter.
+
+The millisecond counter wraps after ~49.7 days; all comparisons must be done with unsigned subtraction,
+i.e. (millis() - start >= timeout), never (millis() >= start + timeout).
+
+micros() combines the millisecond counter with the current SysTick->VAL to get sub-millisecond resolution
+without any extra interrupts.
+
+## Tickless idle
+
+Waking up every millisecond just to increment a counter defeats the point of sleeping. Before a long sleep
+the idle code calls systick_suppress_ticks(ms), which reprograms LOAD so that the next SysTick exception
+only fires on the ms-th millisecond boundary. After waking up (either from that exception or from any other
+interrupt), systick_resume_ticks() works out how many whole milliseconds actually passed, adds them to the
+millisecond counter and restarts the normal 1ms period so that it stays aligned with the original grid.
+
+LOAD is a 24-bit register, so one suppressed period is limited to SYSTICK_MAX_SUPPRESS_MS.
+
+Both functions must be called with interrupts masked (PRIMASK set).
+
+*/
+
+#ifndef SYSTICK_CORE_CLOCK
+#define SYSTICK_CORE_CLOCK 16000000U // the default system clock (HSI) if the clock tree is not configured
+#endif
+
+#define SYSTICK_TICK_RATE_HZ 1000U
+#define SYSTICK_RELOAD_VALUE (SYSTICK_CORE_CLOCK / SYSTICK_TICK_RATE_HZ)
+#define SYSTICK_MAX_SUPPRESS_MS (SysTick_LOAD_RELOAD_Msk / SYSTICK_RELOAD_VALUE)
+
+void systick_init(void);
+
+uint32_t millis(void);
+uint32_t micros(void);
+
+// sleeps (WFI) between ticks until at least ms milliseconds have passed
+void systick_delay_ms(uint32_t ms);
+
+// returns the number of ms the tick was suppressed for, or 0 if the tick was left running
+uint32_t systick_suppress_ticks(uint32_t ms);
+// returns the number of core clock cycles that passed while the tick was suppressed
+uint32_t systick_resume_ticks(void);
+
+#endif /* A529D6B5_6774_47D7_AE4E_5B234D86298E */
@@ -0,0 +1,149 @@
+#ifndef D6A40F3C_82E1_4C59_B7D3_19E5F0A6C4B2
+#define D6A40F3C_82E1_4C59_B7D3_19E5F0A6C4B2
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# General Purpose Timers
+
+Toggling a pin from a delay loop or a timer callback costs CPU time on every edge, and the edges jitter by
+whatever else the CPU was doing. The timers produce the same waveforms in hardware: once configured, a PWM
+output or a pulse measurement needs no CPU at all. This driver covers TIM1-TIM5 and TIM9-TIM11 in four
+modes; a timer runs one mode at a time.
+
+    timer   bus    counter   channels   capture   DMA burst (TIMx_UP)
+    TIM1    APB2   16 bit    4          yes       DMA2 stream 5
+    TIM2    APB1   32 bit    4          yes       DMA1 stream 1 or 7
+    TIM3    APB1   16 bit    4          yes       DMA1 stream 2
+    TIM4    APB1   16 bit    4          yes       DMA1 stream 6
+    TIM5    APB1   32 bit    4          yes       DMA1 stream 0 or 6
+    TIM9    APB2   16 bit    2          yes       -
+    TIM10   APB2   16 bit    1          no        -
+    TIM11   APB2   16 bit    1          no        -
+
+A burst claims its stream from dma.h and holds it until tim_burst_stop(), so it fails rather than collide
+with I2C3 (DMA1 stream 2) or USART2 TX (DMA1 stream 6).
+
+The pins are the board's business: put the channel's pin in the board's pin table as PINMUX_MODE_AF with
+the timer's alternate function (AF1 for TIM1/TIM2, AF2 for TIM3-TIM5, AF3 for TIM9-TIM11). On the Nucleo,
+PA5 (the LED) is TIM2_CH1 on AF1.
+
+## Claims
+
+Two other drivers program a timer's registers themselves: adc.c runs TIM3 as its scan trigger from
+adc_start() to adc_stop(), and exti_input.c runs TIM11 as its debounce interval from exti_input_init() on.
+They take the timer with tim_claim() first, like a DMA stream (dma.h), and tim_release() hands it back.
+While a timer is claimed, every init and start here refuses it, and tim_stop() and tim_burst_stop() leave
+it alone; tim_claim() in turn fails on a timer that runs one of the modes here until tim_stop().
+tim_claimed() is the mask of timers in use either way, bit n for tim_id_t n. tim_pwm_set(),
+tim_capture_read() and tim_one_pulse_fire() don't check: they are only meant for a timer set up here.
+
+## PWM
+
+tim_pwm_init() sets the counter to count `steps` ticks per period, at the prescaler that comes closest to
+frequency_hz, and tim_pwm_start() turns a channel on. tim_pwm_set() takes a duty from 0 (always inactive)
+to steps (always active). The compare registers are preloaded, so a new duty takes effect at the next
+period boundary and never cuts a period short.
+
+## Input capture
+
+tim_capture_init() measures a signal on channel 1 or 2 in PWM input mode: the channel's input drives two
+capture registers, one on the rising edge and one on the falling edge, and the rising edge also resets the
+counter (slave reset mode). Every period, the hardware leaves the period and the high time in the two
+registers; tim_capture_read() just reads them. tick_hz sets the resolution and the range: the longest
+period it can measure is one counter overflow (65536 ticks on a 16 bit timer), and a slower or stopped
+signal makes tim_capture_read() return false. The measurements are to within a tick of the input
+synchroniser's delay.
+
+## One pulse
+
+tim_one_pulse_init() prepares a single pulse of width_ticks, delay_ticks after tim_one_pulse_fire(); the
+counter stops by itself at the end of the pulse (one pulse mode), so firing it again repeats it. The delay
+is at least one tick: the output is the inactive level while the counter is stopped.
+
+## DMA burst
+
+A timer's update event can request a DMA burst that writes several consecutive registers through DMAR.
+tim_burst_start() points the burst at CCR(first_channel) onwards and streams a table into it: every PWM
+period takes the next `channels` duties from the table, so a waveform (an LED fade, a servo sequence, a
+tone envelope) plays back with no interrupts and no CPU. The table is uint32_t duties, `channels` per
+update; with circular set it repeats until tim_burst_stop(). A burst needs tim_pwm_init() and
+tim_pwm_start() first, and the duties have to stay within steps.
+
+The duties are words even on the 16 bit timers: the APB bridge turns a half word write into a word with the
+half word in both halves, so a 32 bit timer (TIM2, TIM5) would read a 16 bit duty d as d | d << 16.
+
+The CPU keeps running, and in power_idle()'s sleep the timers and the DMA keep running too. Stop mode halts
+both, so a board that wants its waveform to carry on while idle must not allow it (power_allow_stop()).
+
+*/
+
+#ifndef TIM_APB1_CLOCK
+#define TIM_APB1_CLOCK 16000000U // TIM2-TIM5; twice APB1 if APB1 is divided
+#endif
+#ifndef TIM_APB2_CLOCK
+#define TIM_APB2_CLOCK 16000000U // TIM1, TIM9-TIM11; twice APB2 if APB2 is divided
+#endif
+
+#define TIM_MAX_PRESCALER (0x10000UL)
+
+typedef enum tim_id_
+{
+    TIM_ID_1 = 0,
+    TIM_ID_2 = 1,
+    TIM_ID_3 = 2,
+    TIM_ID_4 = 3,
+    TIM_ID_5 = 4,
+    TIM_ID_9 = 5,
+    TIM_ID_10 = 6,
+    TIM_ID_11 = 7,
+    TIM_ID_COUNT = 8,
+} tim_id_t;
+
+typedef struct tim_capture_
+{
+    uint32_t period; // ticks from one rising edge to the next
+    uint32_t high;   // ticks from the rising edge to the falling edge
+} tim_capture_t;
+
+// returns the PWM frequency it really runs at, or 0 if steps doesn't fit the timer at that frequency or
+// another driver has claimed it
+uint32_t tim_pwm_init(tim_id_t tim, uint32_t frequency_hz, uint16_t steps);
+// active_low inverts the output: duty then counts the low time
+bool tim_pwm_start(tim_id_t tim, uint8_t channel, bool active_low);
+// duty 0 to steps
+void tim_pwm_set(tim_id_t tim, uint8_t channel, uint32_t duty);
+
+// channel 1 or 2; returns the tick rate it really runs at, or 0 if the timer can't capture, or is claimed
+uint32_t tim_capture_init(tim_id_t tim, uint8_t channel, uint32_t tick_hz);
+// false if no full period was captured since the last call, or the signal is too slow for the counter
+bool tim_capture_read(tim_id_t tim, tim_capture_t *capture);
+
+// returns the tick rate it really runs at, or 0 if the delay and the pulse don't fit the counter or it is
+// claimed
+uint32_t tim_one_pulse_init(tim_id_t tim, uint8_t channel, uint32_t tick_hz, uint32_t delay_ticks,
+                            uint32_t width_ticks);
+void tim_one_pulse_fire(tim_id_t tim);
+
+// table: updates * channels duties, which must stay valid while the burst runs; false if the timer has no
+// update DMA request, is claimed, or its streams are held by other drivers
+bool tim_burst_start(tim_id_t tim, uint8_t first_channel, uint8_t channels, const uint32_t *table,
+                     uint16_t updates, bool circular);
+void tim_burst_stop(tim_id_t tim);
+// true while a one shot burst still has updates to go (always, for a circular one)
+bool tim_burst_busy(tim_id_t tim);
+
+// stops the counter and all of its outputs, captures and bursts, and frees the timer for tim_claim()
+void tim_stop(tim_id_t tim);
+
+// for drivers that program the timer themselves; false if it is claimed or runs one of the modes here
+bool tim_claim(tim_id_t tim);
+void tim_release(tim_id_t tim);
+uint32_t tim_claimed(void);
+
+#endif /* D6A40F3C_82E1_4C59_B7D3_19E5F0A6C4B2 */
@@ -0,0 +1,55 @@
+#ifndef C64AC513_6E3E_484C_AE00_DAE6590B660D
+#define C64AC513_6E3E_484C_AE00_DAE6590B660D
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+
+# Hashed Timer Wheel
+
+The wheel is an array of TIMER_WHEEL_SLOTS buckets, each holding an intrusive doubly linked list of timers.
+A timer that expires at tick T lives in bucket (T & TIMER_WHEEL_MASK). Timers further away than one
+revolution simply stay in their bucket and are skipped until their exact expiry tick comes around.
+
+1. Starting a timer is O(1): compute the bucket and push it at the head of the list.
+2. Stopping a timer is O(1): unlink it using its own prev/next pointers.
+3. Every elapsed millisecond visits exactly one bucket, so the cost per tick depends only on how many
+timers hash into that bucket, not on the total number of timers.
+
+The timers are owned by the caller (usually static variables), so there is no allocation involved.
+
+Callbacks run from timer_wheel_update(), i.e. in main context and never inside the SysTick interrupt.
+Timers must only be started and stopped from main context (callbacks included).
+
+*/
+
+#define TIMER_WHEEL_SLOTS (64U) // must be a power of two
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1U)
+
+typedef void (*soft_timer_callback_t)(void *context);
+
+typedef struct soft_timer_
+{
+    struct soft_timer_ *next;
+    struct soft_timer_ *prev;
+    uint32_t expiry; // absolute tick (millis) at which the timer fires
+    uint32_t period; // reload interval in ms; 0 for a one-shot timer
+    soft_timer_callback_t callback;
+    void *context;
+    bool active;
+} soft_timer_t;
+
+void timer_wheel_init(void);
+void timer_wheel_update(void);
+
+// returns false if no timer is running; otherwise the number of ms until the next expiry (0 if already due)
+bool timer_wheel_next_expiry(uint32_t *ms_until_expiry);
+
+void soft_timer_init(soft_timer_t *timer, soft_timer_callback_t callback, void *context);
+void soft_timer_start(soft_timer_t *timer, uint32_t delay_ms, uint32_t period_ms);
+void soft_timer_stop(soft_timer_t *timer);
+bool soft_timer_is_active(const soft_timer_t *timer);
+
+#endif /* C64AC513_6E3E_484C_AE00_DAE6590B660D */
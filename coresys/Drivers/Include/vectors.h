@@ -0,0 +1,52 @@
+#ifndef C2F84A17_6D3B_4E95_A1C8_5B07E93D2F61
+#define C2F84A17_6D3B_4E95_A1C8_5B07E93D2F61
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# Vector Table
+
+startup.s has a slot in g_pfnVectors for every STM32F401 interrupt, each pointing to a weak <name>_Handler
+(the IRQn names of STM32F401.h without the _IRQn) that falls back to Default_Handler. A driver takes an
+interrupt over just by defining that function, e.g. void DMA2_Stream0_Handler(void), with no change to the
+assembly.
+
+That table is in flash, so which function handles an interrupt is fixed at link time. Some code wants to
+decide at run time instead: a DMA stream handed out to whichever driver asks for it, or a test that swaps a
+handler for a counting one. vectors_relocate() copies the table the core uses now (wherever SCB->VTOR points,
+so it also works for an image started by the bootloader) to ram_vectors in SRAM and points VTOR at the copy.
+After that vectors_set_handler() replaces single entries.
+
+A table in SRAM is also fetched without flash wait states. At 16 MHz (HSI) flash has none, so this only pays
+off once the core runs from a faster clock.
+
+## Alignment
+
+VTOR needs the table aligned to its size rounded up to a power of two: 101 words (16 core exceptions and
+85 interrupts) take 404 bytes, so 512. The linker script puts the .ram_vectors section first in RAM, where that
+alignment costs nothing; an image that never calls vectors_relocate() doesn't link ram_vectors at all.
+
+The host build (make host) dispatches interrupts itself; there vectors_set_handler() goes to
+host_emu_set_handler(), since a table of 32 bit words can't hold host function pointers.
+
+*/
+
+#define VECTORS_COUNT (16U + (uint32_t)SPI4_IRQn + 1U) // core exceptions, then IRQn 0 to the last one
+#define VECTORS_ALIGN (512U)
+
+typedef void (*vectors_handler_t)(void);
+
+// copies the active table to SRAM and points VTOR at it; does nothing if that has already happened
+void vectors_relocate(void);
+bool vectors_in_ram(void);
+
+// irq: any IRQn_Type, core exceptions included; relocates the table first if needed. Returns the handler that
+// was installed before, so a wrapper can chain to it
+vectors_handler_t vectors_set_handler(IRQn_Type irq, vectors_handler_t handler);
+vectors_handler_t vectors_get_handler(IRQn_Type irq);
+
+#endif /* C2F84A17_6D3B_4E95_A1C8_5B07E93D2F61 */
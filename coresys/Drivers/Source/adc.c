@@ -0,0 +1,215 @@
+#include "../Include/adc.h"
+#include "../Include/gpio.h"
+#include "../Include/dma.h"
+#include "../Include/tim.h"
+
+#define ADC_EXTSEL_TIM3_TRGO (8UL)
+#define ADC_PIN_CHANNELS (16U) // 16-18 are internal
+#define ADC_CONVERSION_CYCLES (12U) // at 12 bit resolution, on top of the sample time
+
+static const uint16_t sample_cycles[8] = {3U, 15U, 28U, 56U, 84U, 112U, 144U, 480U};
+
+static adc_config_t active;
+static uint32_t scan_rate = 0;
+static volatile uint32_t overruns = 0;
+static volatile uint32_t late_callbacks = 0;
+static dma_stream_t stream = DMA_STREAM_NONE;
+static bool timer_claimed = false; // TIM3, see tim.h
+
+static void adc_pin_analog(uint8_t channel)
+{
+    uint8_t port = (channel < 8U) ? GPIO_PORT_A : (channel < 10U) ? GPIO_PORT_B : GPIO_PORT_C;
+    uint8_t pin = (channel < 8U) ? channel : (channel < 10U) ? (uint8_t)(channel - 8U) : (uint8_t)(channel - 10U);
+
+    RCC->AHB1ENR |= (1UL << port);
+    ((GPIO_TypeDef *)GPIO_PORT_BASE(port))->MODER |= (0x3UL << (pin * 2U));
+}
+
+static void adc_dma_start(void)
+{
+    dma_transfer_t transfer = {
+        .direction = DMA_PERIPH_TO_MEMORY,
+        .peripheral = &ADC1->DR,
+        .memory = active.buffer,
+        .count = (uint16_t)(2U * active.scans_per_half * active.channel_count),
+        .peripheral_width = DMA_WIDTH_16,
+        .memory_width = DMA_WIDTH_16,
+        .memory_increment = true,
+        .circular = true,
+        .priority = DMA_PRIORITY_HIGH,
+        .fifo = DMA_FIFO_DIRECT,
+        .events = DMA_EVENT_HALF | DMA_EVENT_COMPLETE,
+    };
+
+    dma_configure(stream, &transfer);
+    dma_enable(stream);
+}
+
+// TIM3 update every 1 / rate; returns the rate it really runs at
+static uint32_t adc_timer_start(uint32_t rate)
+{
+    uint32_t ticks = ADC_TIMER_CLOCK / rate;
+    uint32_t prescaler = (ticks - 1U) / 0x10000U;
+    uint32_t reload = ticks / (prescaler + 1U) - 1U;
+
+    RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+    TIM3->CR1 = 0;
+    TIM3->PSC = prescaler;
+    TIM3->ARR = reload;
+    TIM3->CNT = 0;
+    TIM3->EGR = TIM_EGR_UG; // load PSC now, not at the first overflow
+    TIM3->SR = 0;
+    TIM3->CR2 = TIM_CR2_MMS_1; // TRGO on update
+    TIM3->CR1 = TIM_CR1_CEN;
+
+    return ADC_TIMER_CLOCK / ((prescaler + 1U) * (reload + 1U));
+}
+
+static void adc_dma_event(void *context, uint32_t events)
+{
+    uint32_t half_samples = (uint32_t)active.scans_per_half * active.channel_count;
+    (void)context;
+
+    // both halves filled before we got here: the previous callback ran over
+    late_callbacks += ((events & DMA_EVENT_HALF) && (events & DMA_EVENT_COMPLETE)) ? 1U : 0U;
+
+    if (events & DMA_EVENT_HALF)
+    {
+        active.callback(active.buffer, active.scans_per_half, active.context);
+        // half 1 already full: the DMA has moved on into the half the next callback will be reading
+        late_callbacks += (dma_events(stream) & DMA_EVENT_COMPLETE) ? 1U : 0U;
+    }
+    if (events & DMA_EVENT_COMPLETE)
+    {
+        active.callback(active.buffer + half_samples, active.scans_per_half, active.context);
+        late_callbacks += (dma_events(stream) & DMA_EVENT_HALF) ? 1U : 0U;
+    }
+}
+
+void ADC_Handler(void)
+{
+    if (ADC1->SR & ADC_SR_OVR)
+    {
+        // the ADC stopped making DMA requests; re-arm both and go on from the start of the buffer
+        overruns++;
+        ADC1->CR2 &= ~ADC_CR2_DMA;
+        adc_dma_start();
+        ADC1->SR = (uint32_t)~ADC_SR_OVR; // rc_w0
+        ADC1->CR2 |= ADC_CR2_DMA;
+    }
+}
+
+bool adc_start(const adc_config_t *config)
+{
+    if (!config || !config->channels || !config->buffer || !config->callback || config->channel_count == 0U ||
+        config->channel_count > ADC_MAX_CHANNELS || config->sample_time > ADC_SAMPLE_480 ||
+        config->scans_per_half == 0U || config->scan_rate_hz == 0U ||
+        2UL * config->scans_per_half * config->channel_count > 0xFFFFUL)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < config->channel_count; i++)
+    {
+        if (config->channels[i] > 18U)
+        {
+            return false;
+        }
+    }
+
+    // the smallest divider (APB2 / 2, 4, 6, 8) that keeps ADCCLK in range
+    uint32_t prescaler = 0;
+    while (prescaler < 3U && ADC_PCLK / (2U * (prescaler + 1U)) > ADC_MAX_CLOCK)
+    {
+        prescaler++;
+    }
+    uint32_t adc_clock = ADC_PCLK / (2U * (prescaler + 1U));
+
+    // every scan has to be done before the next trigger
+    uint32_t scan_cycles = (sample_cycles[config->sample_time] + ADC_CONVERSION_CYCLES) * config->channel_count;
+    if (config->scan_rate_hz > adc_clock / scan_cycles || config->scan_rate_hz > ADC_TIMER_CLOCK)
+    {
+        return false;
+    }
+
+    adc_stop();
+    if (!tim_claim(TIM_ID_3))
+    {
+        return false;
+    }
+    timer_claimed = true;
+    stream = dma_claim(DMA_REQ_ADC1, adc_dma_event, NULL);
+    if (stream == DMA_STREAM_NONE)
+    {
+        adc_stop();
+        return false;
+    }
+    active = *config;
+
+    RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+
+    uint32_t sqr[3] = {0};
+    uint32_t smpr[2] = {0};
+    bool internal = false;
+    for (uint8_t i = 0; i < config->channel_count; i++)
+    {
+        uint8_t channel = config->channels[i];
+        if (channel < ADC_PIN_CHANNELS)
+        {
+            adc_pin_analog(channel);
+        }
+        internal |= (channel >= ADC_PIN_CHANNELS);
+
+        // SQR3 holds ranks 1-6, SQR2 7-12, SQR1 13-16; SMPR2 channels 0-9, SMPR1 10-18
+        sqr[i / 6U] |= (uint32_t)channel << ((i % 6U) * 5U);
+        smpr[channel / 10U] |= (uint32_t)config->sample_time << ((channel % 10U) * 3U);
+    }
+
+    ADC1_COMMON->CCR = (prescaler << ADC_CCR_ADCPRE_Pos) | (internal ? ADC_CCR_TSVREFE : 0U);
+    ADC1->CR1 = ADC_CR1_SCAN | ADC_CR1_OVRIE; // 12 bit
+    ADC1->SQR3 = sqr[0];
+    ADC1->SQR2 = sqr[1];
+    ADC1->SQR1 = sqr[2] | ((uint32_t)(config->channel_count - 1U) << ADC_SQR1_L_Pos);
+    ADC1->SMPR2 = smpr[0];
+    ADC1->SMPR1 = smpr[1];
+
+    adc_dma_start();
+
+    // DDS: keep requesting DMA after the last transfer, which the circular stream needs
+    ADC1->SR = 0;
+    ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_EXTEN_0 | (ADC_EXTSEL_TIM3_TRGO << ADC_CR2_EXTSEL_Pos);
+
+    NVIC_EnableIRQ(ADC_IRQn);
+
+    scan_rate = adc_timer_start(config->scan_rate_hz);
+    return true;
+}
+
+void adc_stop(void)
+{
+    if (timer_claimed)
+    {
+        TIM3->CR1 &= ~TIM_CR1_CEN;
+        tim_release(TIM_ID_3);
+        timer_claimed = false;
+    }
+    ADC1->CR2 = 0;
+    NVIC_DisableIRQ(ADC_IRQn);
+    dma_release(stream);
+    stream = DMA_STREAM_NONE;
+    scan_rate = 0;
+}
+
+uint32_t adc_scan_rate(void)
+{
+    return scan_rate;
+}
+
+uint32_t adc_overruns(void)
+{
+    return overruns;
+}
+
+uint32_t adc_late_callbacks(void)
+{
+    return late_callbacks;
+}
@@ -0,0 +1,104 @@
+#include <string.h>
+#include "../Include/decimate.h"
+
+bool decimate_boxcar_init(decimate_boxcar_t *filter, uint8_t channels, uint16_t factor)
+{
+    if (channels == 0U || channels > DECIMATE_MAX_CHANNELS || factor == 0U)
+    {
+        return false;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+    filter->channels = channels;
+    filter->factor = factor;
+    return true;
+}
+
+size_t decimate_boxcar(decimate_boxcar_t *filter, const uint16_t *input, size_t scans, uint16_t *output)
+{
+    size_t produced = 0;
+
+    for (size_t scan = 0; scan < scans; scan++)
+    {
+        for (uint8_t channel = 0; channel < filter->channels; channel++)
+        {
+            filter->sums[channel] += *input++;
+        }
+
+        if (++filter->count == filter->factor)
+        {
+            for (uint8_t channel = 0; channel < filter->channels; channel++)
+            {
+                *output++ = (uint16_t)(filter->sums[channel] / filter->factor);
+                filter->sums[channel] = 0;
+            }
+            filter->count = 0;
+            produced++;
+        }
+    }
+    return produced;
+}
+
+bool decimate_cic_init(decimate_cic_t *filter, uint8_t channels, uint8_t order, uint16_t factor)
+{
+    if (channels == 0U || channels > DECIMATE_MAX_CHANNELS || factor == 0U || order == 0U || order > DECIMATE_MAX_ORDER)
+    {
+        return false;
+    }
+
+    // the output grows to DECIMATE_INPUT_BITS + order * log2(factor) bits, which must fit the registers
+    uint64_t gain = 1;
+    for (uint8_t stage = 0; stage < order; stage++)
+    {
+        gain *= factor;
+    }
+    if (gain * ((1UL << DECIMATE_INPUT_BITS) - 1U) > UINT32_MAX)
+    {
+        return false;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+    filter->channels = channels;
+    filter->order = order;
+    filter->factor = factor;
+    filter->gain = (uint32_t)gain;
+    return true;
+}
+
+size_t decimate_cic(decimate_cic_t *filter, const uint16_t *input, size_t scans, uint16_t *output)
+{
+    size_t produced = 0;
+
+    for (size_t scan = 0; scan < scans; scan++)
+    {
+        for (uint8_t channel = 0; channel < filter->channels; channel++)
+        {
+            uint32_t *integrator = filter->integrators[channel];
+            uint32_t value = *input++;
+            for (uint8_t stage = 0; stage < filter->order; stage++)
+            {
+                integrator[stage] += value; // wraps on purpose, see decimate.h
+                value = integrator[stage];
+            }
+        }
+
+        if (++filter->count == filter->factor)
+        {
+            for (uint8_t channel = 0; channel < filter->channels; channel++)
+            {
+                uint32_t *delay = filter->delays[channel];
+                uint32_t value = filter->integrators[channel][filter->order - 1U];
+                for (uint8_t stage = 0; stage < filter->order; stage++)
+                {
+                    uint32_t difference = value - delay[stage];
+                    delay[stage] = value;
+                    value = difference;
+                }
+                *output++ = (uint16_t)(value / filter->gain);
+            }
+            filter->count = 0;
+            produced++;
+        }
+    }
+    return produced;
+}
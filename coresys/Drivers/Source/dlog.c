@@ -0,0 +1,164 @@
+#include "../Include/dlog.h"
+#include "../Include/systick.h"
+
+#define DLOG_BUFFER_MASK (DLOG_BUFFER_SIZE - 1U)
+
+// each entry in the ring is a length byte followed by that many bytes of the framed record
+static uint8_t buffer[DLOG_BUFFER_SIZE];
+static volatile uint32_t write_index = 0; // free running, only advanced with interrupts masked
+static volatile uint32_t read_index = 0;  // free running, only advanced by the consumer
+static uint32_t unreported_drops = 0;
+static dlog_stats_t stats = {0};
+
+__attribute__((section(DLOG_FORMAT_SECTION), used)) static const char dlog_dropped_format[] = "dlog: %u messages dropped";
+
+static uint8_t dlog_put_varint(uint8_t *dest, uint32_t value)
+{
+    uint8_t length = 0;
+    while (value >= 0x80U)
+    {
+        dest[length++] = (uint8_t)(value | 0x80U);
+        value >>= 7;
+    }
+    dest[length++] = (uint8_t)value;
+    return length;
+}
+
+// COBS: every 0x00 is replaced by the distance to the next one, so the frame itself never contains a zero
+static uint8_t dlog_cobs_encode(const uint8_t *source, uint8_t length, uint8_t *dest)
+{
+    uint8_t code_index = 0;
+    uint8_t out = 1;
+    uint8_t code = 1;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        if (source[i] == 0U)
+        {
+            dest[code_index] = code;
+            code_index = out++;
+            code = 1;
+        }
+        else
+        {
+            dest[out++] = source[i];
+            code++;
+        }
+    }
+    dest[code_index] = code; // records are far shorter than 254 bytes, so one code byte per zero is enough
+
+    return out;
+}
+
+static uint8_t dlog_encode(uint8_t *record, const char *format, const uint32_t *args, uint8_t count)
+{
+    uint8_t raw[DLOG_RAW_MAX];
+    uint8_t length = 0;
+
+    // the string's address inside the never-loaded .dlog section is its id
+    length += dlog_put_varint(&raw[length], (uint32_t)(uintptr_t)format);
+    length += dlog_put_varint(&raw[length], millis());
+    for (uint8_t i = 0; i < count; i++)
+    {
+        length += dlog_put_varint(&raw[length], args[i]);
+    }
+
+    record[0] = 0x00;
+    length = 1U + dlog_cobs_encode(raw, length, &record[1]);
+    record[length++] = 0x00;
+    return length;
+}
+
+// call with interrupts masked
+static bool dlog_push(const uint8_t *record, uint8_t length)
+{
+    uint32_t used = write_index - read_index;
+    if (used + 1U + length > DLOG_BUFFER_SIZE)
+    {
+        return false;
+    }
+
+    uint32_t index = write_index;
+    buffer[index++ & DLOG_BUFFER_MASK] = length;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        buffer[index++ & DLOG_BUFFER_MASK] = record[i];
+    }
+    __DMB(); // the record must be in the ring before the consumer can see the new index
+    write_index = index;
+
+    used += 1U + length;
+    if (used > stats.peak_used)
+    {
+        stats.peak_used = used;
+    }
+    stats.records++;
+    stats.bytes += length;
+    return true;
+}
+
+void dlog_write(const char *format, const uint32_t *args, uint8_t count)
+{
+    uint8_t record[DLOG_MAX_RECORD];
+    uint8_t length = dlog_encode(record, format, args, count);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (unreported_drops)
+    {
+        uint8_t notice[DLOG_MAX_RECORD];
+        uint8_t notice_length = dlog_encode(notice, dlog_dropped_format, &unreported_drops, 1U);
+        if (dlog_push(notice, notice_length))
+        {
+            unreported_drops = 0;
+        }
+    }
+
+    if (unreported_drops || !dlog_push(record, length))
+    {
+        // keep the order: once something was dropped, nothing newer goes out before the notice
+        unreported_drops++;
+        stats.dropped++;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+uint8_t dlog_next_length(void)
+{
+    if (read_index == write_index)
+    {
+        return 0;
+    }
+
+    __DMB(); // read the length byte only after the index that published it
+    return buffer[read_index & DLOG_BUFFER_MASK];
+}
+
+uint8_t dlog_read_record(uint8_t *dest, size_t max)
+{
+    uint8_t length = dlog_next_length();
+    if (length == 0U || length > max)
+    {
+        return 0;
+    }
+
+    uint32_t index = read_index + 1U;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        dest[i] = buffer[index++ & DLOG_BUFFER_MASK];
+    }
+    __DMB(); // done with the bytes before a producer may overwrite them
+    read_index = index; // hands the space back to the producers
+
+    return length;
+}
+
+void dlog_get_stats(dlog_stats_t *out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out = stats;
+    __set_PRIMASK(primask);
+}
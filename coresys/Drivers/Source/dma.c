@@ -0,0 +1,308 @@
+#include "../Include/dma.h"
+#include "../Include/vectors.h"
+
+#define DMA1_S(n) ((dma_stream_t)(n))
+#define DMA2_S(n) ((dma_stream_t)(8U + (n)))
+
+#define DMA_STREAM_BIT(stream) (1UL << (stream))
+
+typedef struct dma_route_
+{
+    dma_request_t request;
+    dma_stream_t stream;
+    uint8_t channel;
+} dma_route_t;
+
+typedef struct dma_owner_
+{
+    dma_callback_t callback;
+    void *context;
+    uint32_t channel_bits; // CHSEL of the request the stream was claimed for
+} dma_owner_t;
+
+// the request mapping tables of RM0368 (DMA1 and DMA2 request mapping); a request's routes in the order
+// dma_claim() tries them, so that the usual owner of a shared stream finds it free
+static const dma_route_t routes[] = {
+    {DMA_REQ_MEMORY, DMA2_S(1), 0U},
+    {DMA_REQ_MEMORY, DMA2_S(4), 0U},
+    {DMA_REQ_MEMORY, DMA2_S(6), 0U},
+    {DMA_REQ_MEMORY, DMA2_S(7), 0U},
+    {DMA_REQ_MEMORY, DMA2_S(3), 0U},
+    {DMA_REQ_MEMORY, DMA2_S(2), 0U},
+    {DMA_REQ_MEMORY, DMA2_S(0), 0U},
+    {DMA_REQ_MEMORY, DMA2_S(5), 0U},
+    {DMA_REQ_ADC1, DMA2_S(0), 0U},
+    {DMA_REQ_ADC1, DMA2_S(4), 0U},
+    {DMA_REQ_SPI1_RX, DMA2_S(2), 3U},
+    {DMA_REQ_SPI1_RX, DMA2_S(0), 3U},
+    {DMA_REQ_SPI1_TX, DMA2_S(3), 3U},
+    {DMA_REQ_SPI1_TX, DMA2_S(5), 3U},
+    {DMA_REQ_SPI2_RX, DMA1_S(3), 0U},
+    {DMA_REQ_SPI2_TX, DMA1_S(4), 0U},
+    {DMA_REQ_SPI3_RX, DMA1_S(0), 0U},
+    {DMA_REQ_SPI3_RX, DMA1_S(2), 0U},
+    {DMA_REQ_SPI3_TX, DMA1_S(5), 0U},
+    {DMA_REQ_SPI3_TX, DMA1_S(7), 0U},
+    {DMA_REQ_SPI4_RX, DMA2_S(0), 4U},
+    {DMA_REQ_SPI4_RX, DMA2_S(3), 5U},
+    {DMA_REQ_SPI4_TX, DMA2_S(1), 4U},
+    {DMA_REQ_SPI4_TX, DMA2_S(4), 5U},
+    {DMA_REQ_I2C1_RX, DMA1_S(0), 1U},
+    {DMA_REQ_I2C1_RX, DMA1_S(5), 1U},
+    {DMA_REQ_I2C1_TX, DMA1_S(7), 1U},
+    {DMA_REQ_I2C1_TX, DMA1_S(6), 1U},
+    {DMA_REQ_I2C2_RX, DMA1_S(2), 7U},
+    {DMA_REQ_I2C2_RX, DMA1_S(3), 7U},
+    {DMA_REQ_I2C2_TX, DMA1_S(7), 7U},
+    {DMA_REQ_I2C3_RX, DMA1_S(2), 3U},
+    {DMA_REQ_I2C3_TX, DMA1_S(4), 3U},
+    {DMA_REQ_USART1_RX, DMA2_S(2), 4U},
+    {DMA_REQ_USART1_RX, DMA2_S(5), 4U},
+    {DMA_REQ_USART1_TX, DMA2_S(7), 4U},
+    {DMA_REQ_USART2_RX, DMA1_S(5), 4U},
+    {DMA_REQ_USART2_TX, DMA1_S(6), 4U},
+    {DMA_REQ_USART6_RX, DMA2_S(1), 5U},
+    {DMA_REQ_USART6_RX, DMA2_S(2), 5U},
+    {DMA_REQ_USART6_TX, DMA2_S(6), 5U},
+    {DMA_REQ_USART6_TX, DMA2_S(7), 5U},
+    {DMA_REQ_SDIO, DMA2_S(3), 4U},
+    {DMA_REQ_SDIO, DMA2_S(6), 4U},
+    {DMA_REQ_TIM1_UP, DMA2_S(5), 6U},
+    {DMA_REQ_TIM2_UP, DMA1_S(1), 3U},
+    {DMA_REQ_TIM2_UP, DMA1_S(7), 3U},
+    {DMA_REQ_TIM3_UP, DMA1_S(2), 5U},
+    {DMA_REQ_TIM4_UP, DMA1_S(6), 2U},
+    {DMA_REQ_TIM5_UP, DMA1_S(0), 6U},
+    {DMA_REQ_TIM5_UP, DMA1_S(6), 6U},
+};
+
+static const IRQn_Type stream_irqs[DMA_STREAM_COUNT] = {
+    DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+    DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn,
+    DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+    DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn,
+};
+
+// of each stream's flags in LISR / HISR
+static const uint8_t flag_shifts[4] = {0U, 6U, 16U, 22U};
+
+static dma_owner_t owners[DMA_STREAM_COUNT];
+static volatile uint32_t claimed = 0;
+
+static DMA_TypeDef *dma_controller(dma_stream_t stream)
+{
+    return (stream < 8U) ? DMA1 : DMA2;
+}
+
+static uint32_t dma_flag_shift(dma_stream_t stream)
+{
+    return flag_shifts[stream & 3U];
+}
+
+static void dma_dispatch(dma_stream_t stream)
+{
+    uint32_t events = dma_events(stream);
+    dma_clear(stream, events);
+
+    if (owners[stream].callback)
+    {
+        owners[stream].callback(owners[stream].context, events);
+    }
+}
+
+// one entry per stream for the vector table, which can't pass the stream number along
+#define DMA_STREAMS(X) X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15)
+#define DMA_HANDLER_DEFINE(n)                  \
+    static void dma_stream_##n##_handler(void) \
+    {                                          \
+        dma_dispatch(n);                       \
+    }
+#define DMA_HANDLER_ENTRY(n) dma_stream_##n##_handler,
+
+DMA_STREAMS(DMA_HANDLER_DEFINE)
+
+static const vectors_handler_t stream_handlers[DMA_STREAM_COUNT] = {DMA_STREAMS(DMA_HANDLER_ENTRY)};
+
+dma_stream_t dma_claim(dma_request_t request, dma_callback_t callback, void *context)
+{
+    dma_stream_t stream = DMA_STREAM_NONE;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq(); // drivers may claim from interrupts too
+
+    for (uint32_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++)
+    {
+        if (routes[i].request == request && !(claimed & DMA_STREAM_BIT(routes[i].stream)))
+        {
+            stream = routes[i].stream;
+            claimed |= DMA_STREAM_BIT(stream);
+            owners[stream].callback = callback;
+            owners[stream].context = context;
+            owners[stream].channel_bits = (uint32_t)routes[i].channel << DMA_SxCR_CHSEL_Pos;
+            break;
+        }
+    }
+
+    __set_PRIMASK(primask);
+
+    if (stream == DMA_STREAM_NONE)
+    {
+        return DMA_STREAM_NONE;
+    }
+
+    RCC->AHB1ENR |= (stream < 8U) ? RCC_AHB1ENR_DMA1EN : RCC_AHB1ENR_DMA2EN;
+    dma_disable(stream);
+    dma_clear(stream, DMA_EVENT_ALL);
+
+    if (callback)
+    {
+        vectors_set_handler(stream_irqs[stream], stream_handlers[stream]);
+        NVIC_ClearPendingIRQ(stream_irqs[stream]);
+        NVIC_EnableIRQ(stream_irqs[stream]);
+    }
+    return stream;
+}
+
+void dma_release(dma_stream_t stream)
+{
+    if (stream >= DMA_STREAM_COUNT || !(claimed & DMA_STREAM_BIT(stream)))
+    {
+        return;
+    }
+
+    NVIC_DisableIRQ(stream_irqs[stream]);
+    dma_disable(stream);
+    dma_clear(stream, DMA_EVENT_ALL);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    owners[stream].callback = NULL;
+    owners[stream].context = NULL;
+    claimed &= ~DMA_STREAM_BIT(stream);
+    __set_PRIMASK(primask);
+}
+
+uint32_t dma_claimed(void)
+{
+    return claimed;
+}
+
+bool dma_configure(dma_stream_t stream, const dma_transfer_t *transfer)
+{
+    if (stream >= DMA_STREAM_COUNT || !transfer || transfer->count == 0U)
+    {
+        return false;
+    }
+
+    bool memory_copy = (transfer->direction == DMA_MEMORY_TO_MEMORY);
+    bool double_buffer = (transfer->memory1 != NULL);
+    bool direct = (transfer->fifo == DMA_FIFO_DIRECT);
+
+    if ((memory_copy && (stream < 8U || transfer->circular || double_buffer || direct)) ||
+        (direct && (transfer->burst != DMA_BURST_SINGLE || transfer->memory_width != transfer->peripheral_width)) ||
+        (transfer->events && !owners[stream].callback))
+    {
+        return false;
+    }
+
+    uint32_t cr = owners[stream].channel_bits | ((uint32_t)transfer->burst << DMA_SxCR_MBURST_Pos) |
+                  ((uint32_t)transfer->priority << DMA_SxCR_PL_Pos) |
+                  ((uint32_t)transfer->memory_width << DMA_SxCR_MSIZE_Pos) |
+                  ((uint32_t)transfer->peripheral_width << DMA_SxCR_PSIZE_Pos) |
+                  ((uint32_t)transfer->direction << DMA_SxCR_DIR_Pos);
+
+    cr |= memory_copy ? ((uint32_t)transfer->burst << DMA_SxCR_PBURST_Pos) : 0U;
+    cr |= double_buffer ? (DMA_SxCR_DBM | DMA_SxCR_CIRC) : 0U;
+    cr |= transfer->circular ? DMA_SxCR_CIRC : 0U;
+    cr |= transfer->memory_increment ? DMA_SxCR_MINC : 0U;
+    cr |= transfer->peripheral_increment ? DMA_SxCR_PINC : 0U;
+    cr |= (transfer->events & DMA_EVENT_COMPLETE) ? DMA_SxCR_TCIE : 0U;
+    cr |= (transfer->events & DMA_EVENT_HALF) ? DMA_SxCR_HTIE : 0U;
+    cr |= (transfer->events & DMA_EVENT_ERROR) ? DMA_SxCR_TEIE : 0U;
+    cr |= (transfer->events & DMA_EVENT_DIRECT_ERROR) ? DMA_SxCR_DMEIE : 0U;
+
+    // FTH is 0 for a quarter, 3 for a full FIFO
+    uint32_t fcr = direct ? 0U : (DMA_SxFCR_DMDIS | ((uint32_t)(transfer->fifo - 1U) << DMA_SxFCR_FTH_Pos));
+    fcr |= (transfer->events & DMA_EVENT_FIFO_ERROR) ? DMA_SxFCR_FEIE : 0U;
+
+    DMA_Stream_TypeDef *regs = dma_regs(stream);
+    dma_disable(stream);
+    dma_clear(stream, DMA_EVENT_ALL);
+
+    regs->PAR = (uint32_t)(uintptr_t)transfer->peripheral;
+    regs->M0AR = (uint32_t)(uintptr_t)transfer->memory;
+    regs->M1AR = (uint32_t)(uintptr_t)transfer->memory1;
+    regs->NDTR = transfer->count;
+    regs->FCR = fcr;
+    regs->CR = cr;
+    return true;
+}
+
+void dma_enable(dma_stream_t stream)
+{
+    dma_regs(stream)->CR |= DMA_SxCR_EN;
+}
+
+void dma_disable(dma_stream_t stream)
+{
+    DMA_Stream_TypeDef *regs = dma_regs(stream);
+
+    regs->CR &= ~DMA_SxCR_EN;
+    while (regs->CR & DMA_SxCR_EN)
+    {
+    }
+}
+
+bool dma_busy(dma_stream_t stream)
+{
+    return (dma_regs(stream)->CR & DMA_SxCR_EN) != 0U;
+}
+
+uint16_t dma_remaining(dma_stream_t stream)
+{
+    return (uint16_t)dma_regs(stream)->NDTR;
+}
+
+uint8_t dma_current_buffer(dma_stream_t stream)
+{
+    return (dma_regs(stream)->CR & DMA_SxCR_CT) ? 1U : 0U;
+}
+
+uint32_t dma_events(dma_stream_t stream)
+{
+    DMA_TypeDef *dma = dma_controller(stream);
+    uint32_t isr = ((stream & 7U) < 4U) ? dma->LISR : dma->HISR;
+
+    return (isr >> dma_flag_shift(stream)) & DMA_EVENT_ALL;
+}
+
+void dma_clear(dma_stream_t stream, uint32_t events)
+{
+    DMA_TypeDef *dma = dma_controller(stream);
+    uint32_t flags = (events & DMA_EVENT_ALL) << dma_flag_shift(stream);
+
+    if ((stream & 7U) < 4U)
+    {
+        dma->LIFCR = flags;
+    }
+    else
+    {
+        dma->HIFCR = flags;
+    }
+}
+
+DMA_Stream_TypeDef *dma_regs(dma_stream_t stream)
+{
+    uintptr_t base = (stream < 8U) ? DMA1_Stream0_BASE : DMA2_Stream0_BASE;
+    return (DMA_Stream_TypeDef *)(base + (stream & 7U) * sizeof(DMA_Stream_TypeDef));
+}
+
+IRQn_Type dma_irq(dma_stream_t stream)
+{
+    return stream_irqs[stream];
+}
+
+uint32_t dma_channel_bits(dma_stream_t stream)
+{
+    return owners[stream].channel_bits;
+}
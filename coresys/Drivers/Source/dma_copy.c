@@ -0,0 +1,305 @@
+#include "../Include/dma_copy.h"
+
+#define DMA_COPY_CHUNK (DMA_MAX_COUNT & ~3UL) // items per stream transfer, whole bursts
+
+// word access to buffers of any type
+typedef uint32_t __attribute__((may_alias)) dma_copy_word_t;
+
+typedef struct dma_copy_slot_
+{
+    dma_stream_t stream;
+    volatile bool busy;
+    uint8_t *dst;
+    const uint8_t *src; // NULL for a memset, which reads pattern
+    uint32_t pattern;
+    uint32_t remaining; // bytes not handed to the stream yet
+    dma_width_t width;
+    dma_burst_t burst;
+    dma_copy_callback_t callback;
+    void *context;
+} dma_copy_slot_t;
+
+static dma_copy_slot_t slots[DMA_COPY_STREAMS];
+static uint8_t slot_count = 0;
+
+static volatile bool bench_done;
+static volatile uint32_t bench_done_at;
+
+static void dma_copy_chunk(dma_copy_slot_t *slot)
+{
+    uint32_t item = 1UL << slot->width;
+    uint32_t bytes = (slot->remaining < DMA_COPY_CHUNK * item) ? slot->remaining : DMA_COPY_CHUNK * item;
+
+    dma_transfer_t transfer = {
+        .direction = DMA_MEMORY_TO_MEMORY,
+        .peripheral = slot->src ? (volatile void *)slot->src : (volatile void *)&slot->pattern,
+        .memory = slot->dst,
+        .count = (uint16_t)(bytes / item),
+        .peripheral_width = slot->width,
+        .memory_width = slot->width,
+        .peripheral_increment = (slot->src != NULL),
+        .memory_increment = true,
+        .priority = DMA_PRIORITY_LOW,
+        .fifo = DMA_FIFO_FULL,
+        .burst = slot->burst,
+        .events = DMA_EVENT_COMPLETE | DMA_EVENT_ERROR,
+    };
+
+    slot->dst += bytes;
+    slot->src = slot->src ? slot->src + bytes : NULL;
+    slot->remaining -= bytes;
+
+    dma_configure(slot->stream, &transfer);
+    dma_enable(slot->stream);
+}
+
+static void dma_copy_event(void *context, uint32_t events)
+{
+    dma_copy_slot_t *slot = context;
+    bool ok = !(events & DMA_EVENT_ERROR);
+
+    if (ok && slot->remaining)
+    {
+        dma_copy_chunk(slot);
+        return;
+    }
+
+    // free the slot first: the callback may start the next copy
+    dma_copy_callback_t callback = slot->callback;
+    void *callback_context = slot->context;
+    slot->busy = false;
+    if (callback)
+    {
+        callback(callback_context, ok);
+    }
+}
+
+static dma_copy_slot_t *dma_copy_take(void)
+{
+    dma_copy_slot_t *slot = NULL;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t i = 0; i < slot_count && !slot; i++)
+    {
+        if (!slots[i].busy)
+        {
+            slot = &slots[i];
+            slot->busy = true;
+        }
+    }
+    __set_PRIMASK(primask);
+    return slot;
+}
+
+// src NULL: fill with value
+static bool dma_copy_submit(uint8_t *dst, const uint8_t *src, uint8_t value, size_t bytes,
+                            dma_copy_callback_t callback, void *context, size_t threshold)
+{
+    uintptr_t alignment = (uintptr_t)dst | (src ? (uintptr_t)src : 0U);
+    dma_width_t width = (alignment & 3U) ? DMA_WIDTH_8 : DMA_WIDTH_32;
+    dma_burst_t burst = (alignment & 15U) ? DMA_BURST_SINGLE : DMA_BURST_4;
+    size_t unit = (burst == DMA_BURST_4) ? 16U : (width == DMA_WIDTH_32) ? 4U : 1U;
+    size_t dma_bytes = bytes & ~(unit - 1U);
+
+    dma_copy_slot_t *slot = (bytes < threshold || dma_bytes == 0U) ? NULL : dma_copy_take();
+    if (!slot)
+    {
+        if (src)
+        {
+            dma_copy_cpu(dst, src, bytes);
+        }
+        else
+        {
+            dma_copy_cpu_set(dst, value, bytes);
+        }
+        if (callback)
+        {
+            callback(context, true);
+        }
+        return false;
+    }
+
+    // the tail that doesn't fill a whole item or burst
+    if (src)
+    {
+        dma_copy_cpu(dst + dma_bytes, src + dma_bytes, bytes - dma_bytes);
+    }
+    else
+    {
+        dma_copy_cpu_set(dst + dma_bytes, value, bytes - dma_bytes);
+    }
+
+    slot->dst = dst;
+    slot->src = src;
+    slot->pattern = value * 0x01010101UL;
+    slot->remaining = dma_bytes;
+    slot->width = width;
+    slot->burst = burst;
+    slot->callback = callback;
+    slot->context = context;
+    dma_copy_chunk(slot);
+    return true;
+}
+
+uint8_t dma_copy_init(void)
+{
+    while (slot_count < DMA_COPY_STREAMS)
+    {
+        dma_copy_slot_t *slot = &slots[slot_count];
+        slot->stream = dma_claim(DMA_REQ_MEMORY, dma_copy_event, slot);
+        if (slot->stream == DMA_STREAM_NONE)
+        {
+            break;
+        }
+        slot->busy = false;
+        slot_count++;
+    }
+    return slot_count;
+}
+
+bool dma_memcpy(void *dst, const void *src, size_t bytes, dma_copy_callback_t callback, void *context)
+{
+    return dma_copy_submit(dst, src, 0U, bytes, callback, context, DMA_COPY_THRESHOLD);
+}
+
+bool dma_memset(void *dst, uint8_t value, size_t bytes, dma_copy_callback_t callback, void *context)
+{
+    return dma_copy_submit(dst, NULL, value, bytes, callback, context, DMA_COPY_THRESHOLD);
+}
+
+bool dma_copy_busy(void)
+{
+    for (uint8_t i = 0; i < slot_count; i++)
+    {
+        if (slots[i].busy)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void dma_copy_cpu(void *dst, const void *src, size_t bytes)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+
+    if ((((uintptr_t)d | (uintptr_t)s) & 3U) == 0U)
+    {
+        dma_copy_word_t *dw = (dma_copy_word_t *)d;
+        const dma_copy_word_t *sw = (const dma_copy_word_t *)s;
+        for (; bytes >= 16U; bytes -= 16U, dw += 4, sw += 4)
+        {
+            dw[0] = sw[0];
+            dw[1] = sw[1];
+            dw[2] = sw[2];
+            dw[3] = sw[3];
+        }
+        for (; bytes >= 4U; bytes -= 4U)
+        {
+            *dw++ = *sw++;
+        }
+        d = (uint8_t *)dw;
+        s = (const uint8_t *)sw;
+    }
+    while (bytes--)
+    {
+        *d++ = *s++;
+    }
+}
+
+void dma_copy_cpu_set(void *dst, uint8_t value, size_t bytes)
+{
+    uint8_t *d = dst;
+
+    for (; bytes && ((uintptr_t)d & 3U); bytes--)
+    {
+        *d++ = value;
+    }
+
+    uint32_t pattern = value * 0x01010101UL;
+    dma_copy_word_t *dw = (dma_copy_word_t *)d;
+    for (; bytes >= 16U; bytes -= 16U, dw += 4)
+    {
+        dw[0] = pattern;
+        dw[1] = pattern;
+        dw[2] = pattern;
+        dw[3] = pattern;
+    }
+    for (; bytes >= 4U; bytes -= 4U)
+    {
+        *dw++ = pattern;
+    }
+
+    d = (uint8_t *)dw;
+    while (bytes--)
+    {
+        *d++ = value;
+    }
+}
+
+static void dma_copy_bench_done(void *context, bool ok)
+{
+    (void)context;
+    (void)ok;
+    bench_done_at = DWT->CYCCNT;
+    bench_done = true;
+}
+
+static void dma_copy_bench_spin(uint32_t loops)
+{
+    for (volatile uint32_t i = 0; i < loops; i++)
+    {
+    }
+}
+
+// returns the cycles from the call until the copy is done, with a spin loop of loops running under it
+static uint32_t dma_copy_bench_run(void *dst, const void *src, uint32_t bytes, uint32_t loops)
+{
+    bench_done = false;
+    uint32_t start = DWT->CYCCNT;
+    dma_copy_submit(dst, src, 0U, bytes, dma_copy_bench_done, NULL, 0U);
+    dma_copy_bench_spin(loops);
+    while (!bench_done)
+    {
+    }
+    return (loops ? DWT->CYCCNT : bench_done_at) - start;
+}
+
+uint32_t dma_copy_bench(void *dst, const void *src, const uint32_t *sizes, dma_copy_bench_t *results,
+                        uint8_t count)
+{
+    uint32_t crossover = 0;
+
+    if (slot_count == 0U)
+    {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        dma_copy_bench_t *result = &results[i];
+        result->bytes = sizes[i];
+
+        uint32_t start = DWT->CYCCNT;
+        dma_copy_cpu(dst, src, sizes[i]);
+        result->cpu_cycles = DWT->CYCCNT - start;
+
+        result->dma_cycles = dma_copy_bench_run(dst, src, sizes[i], 0U);
+
+        // every spin takes at least a cycle, so this many outlast the copy
+        uint32_t loops = result->dma_cycles + 1U;
+        start = DWT->CYCCNT;
+        dma_copy_bench_spin(loops);
+        uint32_t alone = DWT->CYCCNT - start;
+        uint32_t shared = dma_copy_bench_run(dst, src, sizes[i], loops);
+        result->share_cycles = (shared > alone) ? shared - alone : 0U;
+
+        if (crossover == 0U && result->share_cycles < result->cpu_cycles)
+        {
+            crossover = sizes[i];
+        }
+    }
+    return crossover;
+}
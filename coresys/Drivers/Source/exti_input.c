@@ -0,0 +1,264 @@
+#include "../Include/exti_input.h"
+#include "../Include/systick.h"
+#include "../Include/tim.h"
+
+#define EXTI_QUEUE_MASK (EXTI_EVENT_QUEUE_SIZE - 1U)
+
+typedef struct exti_line_
+{
+    uint8_t port;
+    exti_edge_t edge;
+    bool stable_level;
+    bool in_use;
+} exti_line_t;
+
+static exti_line_t lines[EXTI_LINES];
+static volatile uint32_t debouncing_lines = 0; // lines masked while waiting for TIM11
+static bool timer_claimed = false;              // TIM11, see tim.h; held from the first exti_input_init() on
+
+static exti_event_t event_queue[EXTI_EVENT_QUEUE_SIZE];
+static volatile uint8_t event_write_index = 0;
+static volatile uint8_t event_read_index = 0;
+static volatile uint32_t dropped_events = 0;
+
+static GPIO_TypeDef *exti_gpio(uint8_t port)
+{
+    return (GPIO_TypeDef *)GPIO_PORT_BASE(port);
+}
+
+static bool exti_read_level(uint8_t pin)
+{
+    return BITBAND_PERIPH(exti_gpio(lines[pin].port)->IDR, pin);
+}
+
+static IRQn_Type exti_irqn(uint8_t pin)
+{
+    if (pin <= 4U)
+    {
+        return (IRQn_Type)(EXTI0_IRQn + pin);
+    }
+
+    return (pin <= 9U) ? EXTI9_5_IRQn : EXTI15_10_IRQn;
+}
+
+static void exti_queue_push(uint8_t pin, bool level)
+{
+    uint8_t next_write = (event_write_index + 1U) & EXTI_QUEUE_MASK;
+    if (next_write == event_read_index)
+    {
+        dropped_events++;
+        return;
+    }
+
+    exti_event_t *event = &event_queue[event_write_index];
+    event->port = lines[pin].port;
+    event->pin = pin;
+    event->level = level;
+    event->timestamp_ms = millis();
+    event_write_index = next_write;
+}
+
+static void exti_handle_edges(void)
+{
+    uint32_t pending = EXTI->PR & EXTI->IMR;
+    if (!pending)
+    {
+        return;
+    }
+
+    // ignore the bounces: mask the lines until the debounce interval has passed
+    EXTI->IMR &= ~pending;
+    EXTI->PR = pending;
+    debouncing_lines |= pending;
+
+    // (re)start the one-pulse debounce interval
+    TIM11->CNT = 0;
+    TIM11->CR1 |= TIM_CR1_CEN;
+}
+
+void EXTI0_Handler(void)
+{
+    exti_handle_edges();
+}
+
+void EXTI1_Handler(void)
+{
+    exti_handle_edges();
+}
+
+void EXTI2_Handler(void)
+{
+    exti_handle_edges();
+}
+
+void EXTI3_Handler(void)
+{
+    exti_handle_edges();
+}
+
+void EXTI4_Handler(void)
+{
+    exti_handle_edges();
+}
+
+void EXTI9_5_Handler(void)
+{
+    exti_handle_edges();
+}
+
+void EXTI15_10_Handler(void)
+{
+    exti_handle_edges();
+}
+
+void TIM1_TRG_COM_TIM11_Handler(void)
+{
+    if (!(TIM11->SR & TIM_SR_UIF))
+    {
+        return;
+    }
+    TIM11->SR = (uint32_t)~TIM_SR_UIF;
+
+    uint32_t settled = debouncing_lines;
+    debouncing_lines = 0;
+
+    for (uint8_t pin = 0; pin < EXTI_LINES; pin++)
+    {
+        if (!(settled & (1UL << pin)) || !lines[pin].in_use)
+        {
+            continue;
+        }
+
+        bool level = exti_read_level(pin);
+        if (level == lines[pin].stable_level)
+        {
+            continue; // a glitch that bounced back to where it was
+        }
+        lines[pin].stable_level = level;
+
+        if ((level && (lines[pin].edge & EXTI_EDGE_RISING)) || (!level && (lines[pin].edge & EXTI_EDGE_FALLING)))
+        {
+            exti_queue_push(pin, level);
+        }
+    }
+
+    // drop the edges that were latched while masked; the level we just sampled already accounts for them
+    EXTI->PR = settled;
+    for (uint8_t pin = 0; pin < EXTI_LINES; pin++)
+    {
+        if ((settled & (1UL << pin)) && lines[pin].in_use)
+        {
+            EXTI->IMR |= (1UL << pin);
+        }
+    }
+}
+
+bool exti_input_init(uint16_t debounce_ms)
+{
+    if (!timer_claimed && !tim_claim(TIM_ID_11))
+    {
+        return false;
+    }
+    timer_claimed = true;
+
+    for (uint8_t pin = 0; pin < EXTI_LINES; pin++)
+    {
+        lines[pin].in_use = false;
+    }
+    event_write_index = 0;
+    event_read_index = 0;
+    dropped_events = 0;
+    debouncing_lines = 0;
+
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    RCC->APB2ENR |= RCC_APB2ENR_TIM11EN;
+
+    // TIM11 counts milliseconds and stops by itself after debounce_ms (one-pulse mode)
+    TIM11->CR1 = TIM_CR1_OPM | TIM_CR1_URS; // URS: only an overflow raises the update interrupt, not UG
+    TIM11->PSC = (EXTI_TIMER_CLOCK / 1000U) - 1U;
+    TIM11->ARR = (debounce_ms ? debounce_ms : 1U) - 1U;
+    TIM11->EGR = TIM_EGR_UG; // load the prescaler
+    TIM11->SR = 0;
+    TIM11->DIER = TIM_DIER_UIE;
+
+    NVIC_EnableIRQ(TIM1_TRG_COM_TIM11_IRQn);
+    return true;
+}
+
+bool exti_input_add(uint8_t port, uint8_t pin, exti_edge_t edge, exti_pull_t pull)
+{
+    if (pin >= EXTI_LINES)
+    {
+        return false;
+    }
+
+    if (lines[pin].in_use && lines[pin].port != port)
+    {
+        return false; // EXTI line n can only listen to one port at a time
+    }
+
+    GPIO_TypeDef *gpio = exti_gpio(port);
+    uint32_t shift = (pin & 0x3U) * 4U;
+
+    // port clock, input mode (00) and the requested pull
+    RCC->AHB1ENR |= (1UL << port);
+    gpio->MODER &= ~(0x3UL << (pin * 2U));
+    gpio->PUPDR = (gpio->PUPDR & ~(0x3UL << (pin * 2U))) | ((uint32_t)pull << (pin * 2U));
+
+    SYSCFG->EXTICR[pin >> 2] = (SYSCFG->EXTICR[pin >> 2] & ~(0xFUL << shift)) | ((uint32_t)port << shift);
+
+    lines[pin].port = port;
+    lines[pin].edge = edge;
+    lines[pin].in_use = true;
+    lines[pin].stable_level = exti_read_level(pin);
+
+    // both edges trigger the debounce; the edge filter is applied to the settled level
+    EXTI->RTSR |= (1UL << pin);
+    EXTI->FTSR |= (1UL << pin);
+    EXTI->PR = (1UL << pin);
+    EXTI->IMR |= (1UL << pin);
+
+    NVIC_EnableIRQ(exti_irqn(pin));
+    return true;
+}
+
+void exti_input_remove(uint8_t pin)
+{
+    if (pin >= EXTI_LINES || !lines[pin].in_use)
+    {
+        return;
+    }
+
+    EXTI->IMR &= ~(1UL << pin);
+    EXTI->RTSR &= ~(1UL << pin);
+    EXTI->FTSR &= ~(1UL << pin);
+    EXTI->PR = (1UL << pin);
+    lines[pin].in_use = false;
+}
+
+bool exti_input_event_pending(void)
+{
+    return event_read_index != event_write_index;
+}
+
+bool exti_input_read_event(exti_event_t *event)
+{
+    if (!exti_input_event_pending())
+    {
+        return false;
+    }
+
+    *event = event_queue[event_read_index];
+    event_read_index = (event_read_index + 1U) & EXTI_QUEUE_MASK;
+    return true;
+}
+
+uint32_t exti_input_dropped_events(void)
+{
+    return dropped_events;
+}
+
+bool exti_input_idle(void)
+{
+    return debouncing_lines == 0;
+}
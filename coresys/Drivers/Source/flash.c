@@ -0,0 +1,145 @@
+#include "../Include/flash.h"
+
+#define FLASH_KEY1 (0x45670123UL)
+#define FLASH_KEY2 (0xCDEF89ABUL)
+#define FLASH_SR_ERRORS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR | FLASH_SR_RDERR)
+
+static const uint32_t sector_base[FLASH_SECTOR_COUNT + 1] = {
+    0x08000000UL, 0x08004000UL, 0x08008000UL, 0x0800C000UL, 0x08010000UL,
+    0x08020000UL, 0x08040000UL, 0x08060000UL, 0x08080000UL, // end of the last sector
+};
+
+static volatile uint32_t last_errors = 0;
+
+void flash_unlock(void)
+{
+    if (FLASH->CR & FLASH_CR_LOCK)
+    {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+void flash_lock(void)
+{
+    FLASH->CR |= FLASH_CR_LOCK;
+}
+
+int8_t flash_sector_of(uint32_t address)
+{
+    for (uint8_t sector = 0; sector < FLASH_SECTOR_COUNT; sector++)
+    {
+        if (address >= sector_base[sector] && address < sector_base[sector + 1])
+        {
+            return (int8_t)sector;
+        }
+    }
+
+    return -1;
+}
+
+uint32_t flash_errors(void)
+{
+    return last_errors;
+}
+
+// everything from here on runs while the flash is busy, so it must not touch flash: no calls into functions
+// in flash and no constants from .rodata
+
+RAMFUNC static bool flash_wait(void)
+{
+    while (FLASH->SR & FLASH_SR_BSY)
+    {
+    }
+
+    uint32_t errors = FLASH->SR & FLASH_SR_ERRORS;
+    if (errors)
+    {
+        last_errors = errors;
+        FLASH->SR = errors; // write 1 to clear
+        return false;
+    }
+    return true;
+}
+
+RAMFUNC static bool flash_program_unit(uint32_t address, uint32_t value, uint32_t psize)
+{
+    FLASH->CR = (FLASH->CR & ~FLASH_CR_PSIZE) | psize | FLASH_CR_PG;
+    if (psize == FLASH_CR_PSIZE_1)
+    {
+        *(volatile uint32_t *)address = value;
+    }
+    else
+    {
+        *(volatile uint8_t *)address = (uint8_t)value;
+    }
+    __DSB();
+
+    bool ok = flash_wait();
+    FLASH->CR &= ~FLASH_CR_PG;
+    return ok;
+}
+
+RAMFUNC bool flash_erase_sector(uint8_t sector)
+{
+    if (sector >= FLASH_SECTOR_COUNT || !flash_wait())
+    {
+        return false;
+    }
+
+    FLASH->CR = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SNB)) | FLASH_CR_PSIZE_1 | FLASH_CR_SER |
+                ((uint32_t)sector << FLASH_CR_SNB_Pos);
+    FLASH->CR |= FLASH_CR_STRT;
+    __DSB();
+
+    bool ok = flash_wait();
+    FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+
+    // the data cache may still hold what the sector contained before
+    if (FLASH->ACR & FLASH_ACR_DCEN)
+    {
+        FLASH->ACR &= ~FLASH_ACR_DCEN;
+        FLASH->ACR |= FLASH_ACR_DCRST;
+        FLASH->ACR &= ~FLASH_ACR_DCRST;
+        FLASH->ACR |= FLASH_ACR_DCEN;
+    }
+    return ok;
+}
+
+RAMFUNC bool flash_program(uint32_t address, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    if (!flash_wait())
+    {
+        return false;
+    }
+
+    while (length > 0U)
+    {
+        bool ok;
+        if ((address & 3U) == 0U && length >= 4U)
+        {
+            // the source may be unaligned; assemble the word by hand instead of calling memcpy
+            uint32_t word = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) |
+                            ((uint32_t)bytes[3] << 24);
+            ok = flash_program_unit(address, word, FLASH_CR_PSIZE_1);
+            address += 4U;
+            bytes += 4;
+            length -= 4U;
+        }
+        else
+        {
+            ok = flash_program_unit(address, bytes[0], 0U);
+            address++;
+            bytes++;
+            length--;
+        }
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
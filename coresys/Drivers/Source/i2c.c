@@ -0,0 +1,621 @@
+#include "../Include/i2c.h"
+#include "../Include/systick.h"
+#include "../Include/dma.h"
+
+#define I2C_QUEUE_MASK (I2C_QUEUE_SIZE - 1U)
+
+#define I2C_RECOVERY_CLOCKS (9U)
+#define I2C_RECOVERY_DELAY (I2C_PCLK / 400000U) // NOP loops; a bit more than half a 100 kHz clock period
+#define I2C_STOP_WAIT (I2C_PCLK / 10000U)       // polls of CR1, well over the time a STOP takes
+
+
+#define I2C_ERROR_FLAGS (I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR | I2C_SR1_TIMEOUT)
+
+typedef enum i2c_phase_
+{
+    I2C_PHASE_START,        // waiting for SB, then address + W
+    I2C_PHASE_ADDRESS,      // waiting for ADDR, then the register byte
+    I2C_PHASE_TRANSMIT,     // register byte and write data going out, ends at BTF
+    I2C_PHASE_RESTART,      // waiting for SB, then address + R
+    I2C_PHASE_READ_ADDRESS, // waiting for ADDR, then the receive set up for the length
+    I2C_PHASE_RECEIVE,      // waiting for RXNE (1 byte), BTF (2 bytes) or the DMA (more)
+} i2c_phase_t;
+
+typedef struct i2c_transaction_
+{
+    uint8_t address;
+    uint8_t reg;
+    bool read;
+    uint16_t length;
+    uint8_t *rx;
+    const uint8_t *tx; // long writes only; short ones are in inline_data
+    uint8_t inline_data[I2C_INLINE_WRITE];
+    i2c_callback_t callback;
+    void *context;
+} i2c_transaction_t;
+
+typedef struct i2c_hw_
+{
+    I2C_TypeDef *regs;
+    gpio_pin_t scl;
+    gpio_pin_t sda;
+    uint32_t rcc_enable;  // RCC APB1ENR bit
+    dma_request_t rx_request;
+    dma_request_t tx_request;
+    IRQn_Type event_irq;
+    IRQn_Type error_irq;
+} i2c_hw_t;
+
+typedef struct i2c_state_
+{
+    i2c_transaction_t queue[I2C_QUEUE_SIZE];
+    volatile uint8_t queue_write;
+    volatile uint8_t queue_read; // the running transaction, if any
+    volatile bool running;
+    i2c_phase_t phase;
+    uint16_t sent; // register byte included
+    uint32_t progress;    // i2c_progress() when i2c_update() last saw it change
+    uint32_t progress_ms; // and when that was
+    uint32_t speed_hz;
+    volatile uint32_t errors;
+    volatile uint32_t recoveries;
+    dma_stream_t rx_stream; // its interrupt ends DMA reads
+    dma_stream_t tx_stream; // no interrupt: BTF marks the end of a write
+    bool claimed;
+} i2c_state_t;
+
+static const i2c_hw_t i2c_hw[I2C_BUS_COUNT] = {
+    [I2C_BUS_1] = {
+        .regs = I2C1,
+        .scl = {.port_base = GPIOB_BASE, .pin = 8U},
+        .sda = {.port_base = GPIOB_BASE, .pin = 9U},
+        .rcc_enable = RCC_APB1ENR_I2C1EN,
+        .rx_request = DMA_REQ_I2C1_RX,
+        .tx_request = DMA_REQ_I2C1_TX,
+        .event_irq = I2C1_EV_IRQn,
+        .error_irq = I2C1_ER_IRQn,
+    },
+    [I2C_BUS_3] = {
+        .regs = I2C3,
+        .scl = {.port_base = GPIOA_BASE, .pin = 8U},
+        .sda = {.port_base = GPIOC_BASE, .pin = 9U},
+        .rcc_enable = RCC_APB1ENR_I2C3EN,
+        .rx_request = DMA_REQ_I2C3_RX,
+        .tx_request = DMA_REQ_I2C3_TX,
+        .event_irq = I2C3_EV_IRQn,
+        .error_irq = I2C3_ER_IRQn,
+    },
+};
+
+static i2c_state_t i2c_state[I2C_BUS_COUNT];
+
+static const uint8_t *i2c_tx_data(const i2c_transaction_t *transaction)
+{
+    return (transaction->length <= I2C_INLINE_WRITE) ? transaction->inline_data : transaction->tx;
+}
+
+// bytes the transmit phase sends: the register, plus the data of a write
+static uint32_t i2c_tx_total(const i2c_transaction_t *transaction)
+{
+    return 1U + (transaction->read ? 0U : transaction->length);
+}
+
+static void i2c_configure(i2c_bus_t bus)
+{
+    I2C_TypeDef *regs = i2c_hw[bus].regs;
+    uint32_t speed = i2c_state[bus].speed_hz;
+    uint32_t freq = I2C_PCLK / 1000000U;
+
+    // SWRST also clears a BUSY flag left stuck by a glitch on the lines
+    regs->CR1 = I2C_CR1_SWRST;
+    regs->CR1 = 0;
+    regs->CR2 = freq | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+
+    uint32_t ccr;
+    if (speed <= 100000U)
+    {
+        // standard mode: SCL low and high for CCR PCLK cycles each; rise time up to 1000 ns
+        ccr = I2C_PCLK / (2U * speed);
+        ccr = (ccr < 4U) ? 4U : ccr;
+        regs->TRISE = freq + 1U;
+    }
+    else
+    {
+        // fast mode, duty 2:1: low 2 * CCR, high CCR; rise time up to 300 ns
+        ccr = I2C_PCLK / (3U * speed);
+        ccr = ((ccr < 1U) ? 1U : ccr) | I2C_CCR_FS;
+        regs->TRISE = (freq * 300U) / 1000U + 1U;
+    }
+    regs->CCR = ccr;
+    regs->CR1 = I2C_CR1_PE;
+}
+
+static void i2c_pin_mode(gpio_pin_t p, uint32_t mode)
+{
+    GPIO_TypeDef *port = gpio_port(p);
+    port->MODER = (port->MODER & ~(0x3UL << (p.pin * 2U))) | (mode << (p.pin * 2U));
+}
+
+static void i2c_delay(void)
+{
+    for (uint32_t i = 0; i < I2C_RECOVERY_DELAY; i++)
+    {
+        __NOP();
+    }
+}
+
+// clocks SCL by hand until the slave holding SDA low has shifted out its byte, then sends a STOP
+static void i2c_recover(i2c_bus_t bus)
+{
+    const i2c_hw_t *hw = &i2c_hw[bus];
+
+    hw->regs->CR1 = 0;
+
+    // the pins stay open drain; a high output just releases the line
+    gpio_set(hw->scl);
+    gpio_set(hw->sda);
+    i2c_pin_mode(hw->scl, PINMUX_MODE_OUTPUT);
+    i2c_pin_mode(hw->sda, PINMUX_MODE_OUTPUT);
+    i2c_delay();
+
+    for (uint32_t i = 0; i < I2C_RECOVERY_CLOCKS && !gpio_read(hw->sda); i++)
+    {
+        gpio_clear(hw->scl);
+        i2c_delay();
+        gpio_set(hw->scl);
+        i2c_delay();
+    }
+
+    // STOP: SDA rises while SCL is high
+    gpio_clear(hw->scl);
+    i2c_delay();
+    gpio_clear(hw->sda);
+    i2c_delay();
+    gpio_set(hw->scl);
+    i2c_delay();
+    gpio_set(hw->sda);
+    i2c_delay();
+
+    i2c_pin_mode(hw->scl, PINMUX_MODE_AF);
+    i2c_pin_mode(hw->sda, PINMUX_MODE_AF);
+    i2c_configure(bus);
+    i2c_state[bus].recoveries++;
+}
+
+static void i2c_dma_start(dma_stream_t stream, uint32_t cr, const volatile void *memory, uint16_t length)
+{
+    DMA_Stream_TypeDef *regs = dma_regs(stream);
+
+    cr |= dma_channel_bits(stream);
+    dma_clear(stream, DMA_EVENT_ALL);
+    regs->M0AR = (uint32_t)(uintptr_t)memory;
+    regs->NDTR = length;
+    regs->CR = cr;
+    regs->CR = cr | DMA_SxCR_EN;
+}
+
+// changes whenever a byte moves: the phase and the bytes sent only go up, the streams' NDTR only down
+static uint32_t i2c_progress(const i2c_state_t *state)
+{
+    return ((uint32_t)state->phase << 17) + state->sent + (DMA_MAX_COUNT - dma_remaining(state->rx_stream)) +
+           (DMA_MAX_COUNT - dma_remaining(state->tx_stream));
+}
+
+static void i2c_start(i2c_bus_t bus)
+{
+    const i2c_hw_t *hw = &i2c_hw[bus];
+    i2c_state_t *state = &i2c_state[bus];
+
+    // the previous transaction's STOP may still be going out, and CR1 must not be written until it has
+    for (uint32_t i = 0; (hw->regs->CR1 & I2C_CR1_STOP) && i < I2C_STOP_WAIT; i++)
+    {
+    }
+
+    state->phase = I2C_PHASE_START;
+    state->sent = 0;
+    state->progress = i2c_progress(state);
+    state->progress_ms = millis();
+
+    hw->regs->CR2 = (hw->regs->CR2 & I2C_CR2_FREQ) | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN | I2C_CR2_ITBUFEN;
+    hw->regs->CR1 = I2C_CR1_PE | I2C_CR1_ACK | I2C_CR1_START; // also clears POS
+}
+
+static void i2c_finish(i2c_bus_t bus, i2c_status_t status)
+{
+    const i2c_hw_t *hw = &i2c_hw[bus];
+    i2c_state_t *state = &i2c_state[bus];
+
+    dma_regs(state->rx_stream)->CR &= ~DMA_SxCR_EN;
+    dma_regs(state->tx_stream)->CR &= ~DMA_SxCR_EN;
+    hw->regs->CR2 &= ~(I2C_CR2_DMAEN | I2C_CR2_LAST | I2C_CR2_ITBUFEN);
+
+    if (status != I2C_OK)
+    {
+        state->errors++;
+    }
+
+    // free the slot before the callback, so that it can queue even if the queue was full
+    const i2c_transaction_t *transaction = &state->queue[state->queue_read];
+    i2c_callback_t callback = transaction->callback;
+    void *context = transaction->context;
+    state->queue_read = (state->queue_read + 1U) & I2C_QUEUE_MASK;
+
+    if (callback)
+    {
+        callback(context, status);
+    }
+
+    if (state->queue_read != state->queue_write)
+    {
+        i2c_start(bus);
+    }
+    else
+    {
+        state->running = false;
+    }
+}
+
+static void i2c_abort(i2c_bus_t bus, i2c_status_t status)
+{
+    dma_regs(i2c_state[bus].rx_stream)->CR &= ~DMA_SxCR_EN;
+    dma_regs(i2c_state[bus].tx_stream)->CR &= ~DMA_SxCR_EN;
+    i2c_recover(bus);
+    i2c_finish(bus, status);
+}
+
+static void i2c_event(i2c_bus_t bus)
+{
+    const i2c_hw_t *hw = &i2c_hw[bus];
+    i2c_state_t *state = &i2c_state[bus];
+    I2C_TypeDef *regs = hw->regs;
+    uint32_t sr1 = regs->SR1;
+
+    if (!state->running)
+    {
+        // BTF of the last transaction lingers until its STOP is out; i2c_start() enables the events again
+        regs->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+        return;
+    }
+
+    const i2c_transaction_t *transaction = &state->queue[state->queue_read];
+    switch (state->phase)
+    {
+    case I2C_PHASE_START:
+        if (sr1 & I2C_SR1_SB)
+        {
+            regs->DR = (uint32_t)transaction->address << 1;
+            state->phase = I2C_PHASE_ADDRESS;
+        }
+        break;
+
+    case I2C_PHASE_ADDRESS:
+        if (sr1 & I2C_SR1_ADDR)
+        {
+            (void)regs->SR2; // SR1 then SR2 clears ADDR, after which TXE is set
+            regs->DR = transaction->reg;
+            state->sent = 1U;
+            state->phase = I2C_PHASE_TRANSMIT;
+
+            if (!transaction->read && transaction->length > I2C_INLINE_WRITE)
+            {
+                i2c_dma_start(state->tx_stream, DMA_SxCR_DIR_0 | DMA_SxCR_MINC, transaction->tx,
+                              transaction->length);
+                regs->CR2 = (regs->CR2 & ~I2C_CR2_ITBUFEN) | I2C_CR2_DMAEN;
+                state->sent = (uint16_t)i2c_tx_total(transaction);
+            }
+            else if (state->sent == i2c_tx_total(transaction))
+            {
+                regs->CR2 &= ~I2C_CR2_ITBUFEN; // only BTF matters now
+            }
+        }
+        break;
+
+    case I2C_PHASE_TRANSMIT:
+        if ((sr1 & I2C_SR1_TXE) && state->sent < i2c_tx_total(transaction))
+        {
+            regs->DR = i2c_tx_data(transaction)[state->sent - 1U];
+            state->sent++;
+            if (state->sent == i2c_tx_total(transaction))
+            {
+                regs->CR2 &= ~I2C_CR2_ITBUFEN;
+            }
+        }
+        else if (sr1 & I2C_SR1_BTF)
+        {
+            // everything, register byte included, has left the shift register
+            regs->CR2 &= ~I2C_CR2_DMAEN;
+            if (transaction->read)
+            {
+                regs->CR1 |= I2C_CR1_START;
+                state->phase = I2C_PHASE_RESTART;
+            }
+            else
+            {
+                regs->CR1 |= I2C_CR1_STOP;
+                i2c_finish(bus, I2C_OK);
+            }
+        }
+        break;
+
+    case I2C_PHASE_RESTART:
+        if (sr1 & I2C_SR1_SB)
+        {
+            regs->DR = ((uint32_t)transaction->address << 1) | 1U;
+            state->phase = I2C_PHASE_READ_ADDRESS;
+        }
+        break;
+
+    case I2C_PHASE_READ_ADDRESS:
+        if (sr1 & I2C_SR1_ADDR)
+        {
+            if (transaction->length == 1U)
+            {
+                // NACK the only byte and have the STOP follow it
+                regs->CR1 &= ~I2C_CR1_ACK;
+                (void)regs->SR2;
+                regs->CR1 |= I2C_CR1_STOP;
+                regs->CR2 |= I2C_CR2_ITBUFEN;
+            }
+            else if (transaction->length == 2U)
+            {
+                // POS moves the NACK to the second byte; both are read once BTF says they have arrived
+                regs->CR1 = (regs->CR1 & ~I2C_CR1_ACK) | I2C_CR1_POS;
+                (void)regs->SR2;
+            }
+            else
+            {
+                // LAST NACKs the final byte the DMA takes
+                i2c_dma_start(state->rx_stream, DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE,
+                              transaction->rx, transaction->length);
+                regs->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
+                (void)regs->SR2;
+            }
+            state->phase = I2C_PHASE_RECEIVE;
+        }
+        break;
+
+    case I2C_PHASE_RECEIVE:
+        if (transaction->length == 1U && (sr1 & I2C_SR1_RXNE))
+        {
+            transaction->rx[0] = (uint8_t)regs->DR;
+            i2c_finish(bus, I2C_OK);
+        }
+        else if (transaction->length == 2U && (sr1 & I2C_SR1_BTF))
+        {
+            regs->CR1 |= I2C_CR1_STOP;
+            transaction->rx[0] = (uint8_t)regs->DR;
+            transaction->rx[1] = (uint8_t)regs->DR;
+            i2c_finish(bus, I2C_OK);
+        }
+        break;
+    }
+}
+
+static void i2c_error(i2c_bus_t bus)
+{
+    I2C_TypeDef *regs = i2c_hw[bus].regs;
+    uint32_t flags = regs->SR1 & I2C_ERROR_FLAGS;
+    regs->SR1 = ~flags; // rc_w0
+
+    if (!i2c_state[bus].running || !flags)
+    {
+        return;
+    }
+
+    if (flags == I2C_SR1_AF)
+    {
+        regs->CR1 |= I2C_CR1_STOP;
+        i2c_finish(bus, I2C_NACK);
+    }
+    else
+    {
+        i2c_abort(bus, I2C_BUS_ERROR);
+    }
+}
+
+static void i2c_dma_rx(void *context, uint32_t events)
+{
+    i2c_bus_t bus = (i2c_bus_t)(uintptr_t)context;
+
+    if (!i2c_state[bus].running)
+    {
+        return;
+    }
+
+    if (events & DMA_EVENT_ERROR)
+    {
+        i2c_abort(bus, I2C_BUS_ERROR);
+    }
+    else if (events & DMA_EVENT_COMPLETE)
+    {
+        // the last byte is in memory and was NACKed (LAST)
+        i2c_hw[bus].regs->CR1 |= I2C_CR1_STOP;
+        i2c_finish(bus, I2C_OK);
+    }
+}
+
+void I2C1_EV_Handler(void)
+{
+    i2c_event(I2C_BUS_1);
+}
+
+void I2C1_ER_Handler(void)
+{
+    i2c_error(I2C_BUS_1);
+}
+
+void I2C3_EV_Handler(void)
+{
+    i2c_event(I2C_BUS_3);
+}
+
+void I2C3_ER_Handler(void)
+{
+    i2c_error(I2C_BUS_3);
+}
+
+bool i2c_init(i2c_bus_t bus, uint32_t speed_hz)
+{
+    const i2c_hw_t *hw = &i2c_hw[bus];
+    i2c_state_t *state = &i2c_state[bus];
+
+    if (!state->claimed)
+    {
+        state->rx_stream = dma_claim(hw->rx_request, i2c_dma_rx, (void *)(uintptr_t)bus);
+        state->tx_stream = dma_claim(hw->tx_request, NULL, NULL);
+        if (state->rx_stream == DMA_STREAM_NONE || state->tx_stream == DMA_STREAM_NONE)
+        {
+            dma_release(state->rx_stream);
+            dma_release(state->tx_stream);
+            return false;
+        }
+        state->claimed = true;
+    }
+
+    RCC->APB1ENR |= hw->rcc_enable;
+    if (bus == I2C_BUS_1)
+    {
+        PINMUX_APPLY(I2C1_PINMUX);
+    }
+    else
+    {
+        PINMUX_APPLY(I2C3_PINMUX);
+    }
+
+    state->speed_hz = speed_hz;
+
+    dma_regs(state->rx_stream)->PAR = (uint32_t)(uintptr_t)&hw->regs->DR;
+    dma_regs(state->tx_stream)->PAR = (uint32_t)(uintptr_t)&hw->regs->DR;
+    dma_regs(state->rx_stream)->FCR = 0; // direct mode
+    dma_regs(state->tx_stream)->FCR = 0;
+
+    // a slave reset halfway through a read may still be holding SDA low
+    if (!gpio_read(hw->sda))
+    {
+        i2c_recover(bus);
+    }
+    else
+    {
+        i2c_configure(bus);
+    }
+
+    NVIC_EnableIRQ(hw->event_irq);
+    NVIC_EnableIRQ(hw->error_irq);
+    return true;
+}
+
+static bool i2c_submit(i2c_bus_t bus, const i2c_transaction_t *transaction)
+{
+    i2c_state_t *state = &i2c_state[bus];
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq(); // callbacks queue from the interrupts, which also start the queued transactions
+
+    uint8_t next_write = (state->queue_write + 1U) & I2C_QUEUE_MASK;
+    bool queued = (next_write != state->queue_read);
+    if (queued)
+    {
+        state->queue[state->queue_write] = *transaction;
+        state->queue_write = next_write;
+        if (!state->running)
+        {
+            state->running = true;
+            i2c_start(bus);
+        }
+    }
+
+    __set_PRIMASK(primask);
+    return queued;
+}
+
+bool i2c_read_reg(i2c_bus_t bus, uint8_t address, uint8_t reg, uint8_t *data, uint16_t length,
+                  i2c_callback_t callback, void *context)
+{
+    if (bus >= I2C_BUS_COUNT || !data || length == 0U)
+    {
+        return false;
+    }
+
+    i2c_transaction_t transaction = {
+        .address = address,
+        .reg = reg,
+        .read = true,
+        .length = length,
+        .rx = data,
+        .callback = callback,
+        .context = context,
+    };
+    return i2c_submit(bus, &transaction);
+}
+
+bool i2c_write_reg(i2c_bus_t bus, uint8_t address, uint8_t reg, const uint8_t *data, uint16_t length,
+                   i2c_callback_t callback, void *context)
+{
+    if (bus >= I2C_BUS_COUNT || (!data && length > 0U))
+    {
+        return false;
+    }
+
+    i2c_transaction_t transaction = {
+        .address = address,
+        .reg = reg,
+        .read = false,
+        .length = length,
+        .tx = data,
+        .callback = callback,
+        .context = context,
+    };
+    for (uint16_t i = 0; i < length && i < I2C_INLINE_WRITE; i++)
+    {
+        transaction.inline_data[i] = data[i];
+    }
+    return i2c_submit(bus, &transaction);
+}
+
+void i2c_update(void)
+{
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++)
+    {
+        const i2c_hw_t *hw = &i2c_hw[bus];
+        i2c_state_t *state = &i2c_state[bus];
+        if (!state->running)
+        {
+            continue;
+        }
+
+        // only this bus's interrupts: the recovery takes ~100 us, too long to hold off USART2
+        NVIC_DisableIRQ(hw->event_irq);
+        NVIC_DisableIRQ(hw->error_irq);
+        NVIC_DisableIRQ(dma_irq(state->rx_stream));
+
+        uint32_t progress = i2c_progress(state);
+        if (progress != state->progress)
+        {
+            state->progress = progress;
+            state->progress_ms = millis();
+        }
+        else if (state->running && (millis() - state->progress_ms) > I2C_TIMEOUT_MS)
+        {
+            i2c_abort((i2c_bus_t)bus, I2C_TIMEOUT);
+        }
+
+        NVIC_EnableIRQ(hw->event_irq);
+        NVIC_EnableIRQ(hw->error_irq);
+        NVIC_EnableIRQ(dma_irq(state->rx_stream));
+    }
+}
+
+bool i2c_busy(i2c_bus_t bus)
+{
+    return i2c_state[bus].running;
+}
+
+uint32_t i2c_errors(i2c_bus_t bus)
+{
+    return i2c_state[bus].errors;
+}
+
+uint32_t i2c_recoveries(i2c_bus_t bus)
+{
+    return i2c_state[bus].recoveries;
+}
@@ -0,0 +1,87 @@
+#include "../Include/memstat.h"
+
+size_t sysmem_heap_used(void); // sysmem.c
+
+#ifndef HOST_EMULATION
+
+// linker script symbols; only their addresses mean anything
+extern uint32_t __stack_limit;
+extern uint32_t _estack;
+extern uint32_t __stack_guard;
+extern uint32_t __Stack_Guard_Size;
+extern uint8_t __heap_base;
+extern uint8_t __heap_limit;
+
+void memstat_get(memstat_t *stats)
+{
+    const uint32_t *word = &__stack_limit;
+    while (word < &_estack && *word == MEMSTAT_STACK_PAINT)
+    {
+        word++;
+    }
+
+    stats->stack_size = (uint32_t)((uintptr_t)&_estack - (uintptr_t)&__stack_limit);
+    stats->stack_peak = (uint32_t)((uintptr_t)&_estack - (uintptr_t)word);
+    stats->heap_size = (uint32_t)(&__heap_limit - &__heap_base);
+    stats->heap_peak = (uint32_t)sysmem_heap_used();
+}
+
+void memstat_guard_enable(void)
+{
+    // RASR SIZE is log2(bytes) - 1
+    uint32_t size = 31U - __CLZ((uint32_t)(uintptr_t)&__Stack_Guard_Size) - 1U;
+
+    ARM_MPU_Disable();
+    ARM_MPU_SetRegionEx(MEMSTAT_GUARD_REGION, ARM_MPU_RBAR(MEMSTAT_GUARD_REGION, (uint32_t)(uintptr_t)&__stack_guard),
+                        ARM_MPU_RASR(1U, ARM_MPU_AP_NONE, 0U, 1U, 1U, 0U, 0U, size));
+    ARM_MPU_Enable(MPU_CTRL_PRIVDEFENA_Msk); // also enables the MemManage fault
+}
+
+void memstat_guard_disable(void)
+{
+    ARM_MPU_Disable();
+    ARM_MPU_ClrRegion(MEMSTAT_GUARD_REGION);
+}
+
+// the stack pointer is inside the guard (or was about to be), so nothing here may push before sp is moved
+__attribute__((naked)) void MemManage_Handler(void)
+{
+    __asm volatile(
+        "ldr r0, =_estack   \n"
+        "mov sp, r0         \n"
+        "b memstat_fault    \n");
+}
+
+__attribute__((noreturn, used)) void memstat_fault(void)
+{
+    uint32_t cfsr = SCB->CFSR;
+    uint32_t mmfar = SCB->MMFAR;
+    memstat_on_fault(cfsr, mmfar);
+    NVIC_SystemReset();
+}
+
+#else
+
+void memstat_get(memstat_t *stats)
+{
+    stats->stack_size = 0;
+    stats->stack_peak = 0;
+    stats->heap_size = 0;
+    stats->heap_peak = 0;
+}
+
+void memstat_guard_enable(void)
+{
+}
+
+void memstat_guard_disable(void)
+{
+}
+
+#endif
+
+__attribute__((weak)) void memstat_on_fault(uint32_t cfsr, uint32_t mmfar)
+{
+    (void)cfsr;
+    (void)mmfar;
+}
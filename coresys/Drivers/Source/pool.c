@@ -0,0 +1,146 @@
+#include "../Include/pool.h"
+
+void pool_init(pool_t *pool)
+{
+    // thread the free list through the blocks, lowest address first
+    pool_block_t *head = NULL;
+    for (uint16_t i = pool->block_count; i > 0U; i--)
+    {
+        pool_block_t *block = (pool_block_t *)(pool->storage + (size_t)(i - 1U) * pool->block_size);
+        block->next = head;
+        head = block;
+    }
+
+    pool->free_list = head;
+    pool->used = 0;
+    pool->peak_used = 0;
+    pool->failures = 0;
+    pool->bad_frees = 0;
+}
+
+void *pool_alloc(pool_t *pool)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    pool_block_t *block = pool->free_list;
+    if (block)
+    {
+        pool->free_list = block->next;
+        pool->used++;
+        if (pool->used > pool->peak_used)
+        {
+            pool->peak_used = pool->used;
+        }
+    }
+    else
+    {
+        pool->failures++;
+    }
+
+    __set_PRIMASK(primask);
+    return block;
+}
+
+bool pool_owns(const pool_t *pool, const void *block)
+{
+    uintptr_t offset = (uintptr_t)block - (uintptr_t)pool->storage;
+    // one unsigned compare covers addresses below the storage as well
+    return offset < (uintptr_t)pool->block_size * pool->block_count && (offset % pool->block_size) == 0U;
+}
+
+#if POOL_DOUBLE_FREE_CHECK
+// a block that is on the free list already; called with interrupts masked
+static bool pool_is_free(const pool_t *pool, const void *block)
+{
+    for (const pool_block_t *free = pool->free_list; free; free = free->next)
+    {
+        if (free == block)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+void pool_free(pool_t *pool, void *block)
+{
+    if (!block)
+    {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    bool bad = !pool_owns(pool, block) || pool->used == 0U;
+#if POOL_DOUBLE_FREE_CHECK
+    // pushing it again would put it on the list twice, and two pool_alloc() calls would return it
+    bad = bad || pool_is_free(pool, block);
+#endif
+    if (bad)
+    {
+        pool->bad_frees++;
+    }
+    else
+    {
+        ((pool_block_t *)block)->next = pool->free_list;
+        pool->free_list = (pool_block_t *)block;
+        pool->used--;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void *pool_class_alloc(pool_t *const *classes, uint8_t count, size_t size)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (classes[i]->block_size < size)
+        {
+            continue;
+        }
+
+        void *block = pool_alloc(classes[i]);
+        if (block)
+        {
+            return block;
+        }
+    }
+
+    return NULL;
+}
+
+void pool_class_free(pool_t *const *classes, uint8_t count, void *block)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (pool_owns(classes[i], block))
+        {
+            pool_free(classes[i], block);
+            return;
+        }
+    }
+
+    // not from any of the classes; let the smallest pool count it
+    if (block && count > 0U)
+    {
+        pool_free(classes[0], block);
+    }
+}
+
+void pool_get_stats(const pool_t *pool, pool_stats_t *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    stats->block_size = pool->block_size;
+    stats->block_count = pool->block_count;
+    stats->used = pool->used;
+    stats->peak_used = pool->peak_used;
+    stats->failures = pool->failures;
+    stats->bad_frees = pool->bad_frees;
+
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,160 @@
+#include "../Include/power.h"
+#include "../Include/systick.h"
+#include "../Include/timer_wheel.h"
+
+#define SYSTICK_CYCLES_PER_US (SYSTICK_CORE_CLOCK / 1000000U)
+
+static power_check_t work_pending = NULL;
+static power_check_t stop_allowed = NULL;
+static bool stop_enabled = false; // opt-in: Stop loses the first byte received after it
+static uint32_t stop_wakeup_lines = 0;
+static uint32_t last_activity_ms = 0;
+
+static uint32_t stats_start_ms = 0;
+static uint64_t sleep_us = 0;
+static uint32_t sleep_count = 0;
+static uint32_t stop_count = 0;
+static uint32_t busy_count = 0;
+
+static bool power_irq_pending(void)
+{
+    // an enabled interrupt that is already pending would not generate a new wake-up event for WFE
+    for (uint32_t i = 0; i < 3U; i++)
+    {
+        if (NVIC->ISPR[i] & NVIC->ISER[i])
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void power_enter_sleep(uint32_t ms)
+{
+    uint32_t start_us = micros();
+    uint32_t suppressed = systick_suppress_ticks(ms);
+
+    __DSB();
+    __WFI();
+
+    if (suppressed)
+    {
+        sleep_us += systick_resume_ticks() / SYSTICK_CYCLES_PER_US;
+    }
+    else
+    {
+        sleep_us += micros() - start_us;
+    }
+
+    sleep_count++;
+}
+
+static void power_enter_stop(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+
+    // main regulator on, flash powered: the shortest Stop wake-up time
+    PWR->CR &= ~(PWR_CR_PDDS | PWR_CR_LPDS | PWR_CR_FPDS);
+
+    // the SysTick is halted in Stop anyway; keep a tick that lands right before entry from waking us straight back up
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __DSB();
+    __SEV();
+    __WFE(); // clears the event register
+    __WFE(); // enters Stop
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+    // we only ever run from the HSI, which is what the core wakes up on, so there is no clock tree to restore
+    EXTI->PR = stop_wakeup_lines;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    stop_count++;
+}
+
+void power_init(power_check_t work_pending_check, power_check_t stop_allowed_check)
+{
+    work_pending = work_pending_check;
+    stop_allowed = stop_allowed_check;
+
+    // pending interrupts (even masked ones) raise a WFE wake-up event
+    SCB->SCR |= SCB_SCR_SEVONPEND_Msk;
+
+    last_activity_ms = millis();
+    power_reset_stats();
+}
+
+void power_idle(void)
+{
+    __disable_irq();
+
+    if ((work_pending && work_pending()) || power_irq_pending())
+    {
+        last_activity_ms = millis();
+        busy_count++;
+        __enable_irq();
+        return;
+    }
+
+    uint32_t idle_ms = SYSTICK_MAX_SUPPRESS_MS;
+    bool timer_running = timer_wheel_next_expiry(&idle_ms);
+
+    if (timer_running && idle_ms == 0)
+    {
+        // a timer is due; let timer_wheel_update() run it
+        __enable_irq();
+        return;
+    }
+
+    bool quiet = (millis() - last_activity_ms) >= POWER_STOP_QUIET_MS;
+    if (!timer_running && quiet && stop_enabled && (!stop_allowed || stop_allowed()))
+    {
+        power_enter_stop();
+        last_activity_ms = millis(); // whatever woke us up is the start of new activity
+    }
+    else
+    {
+        power_enter_sleep(idle_ms);
+    }
+
+    __enable_irq();
+}
+
+void power_allow_stop(bool allow)
+{
+    stop_enabled = allow;
+}
+
+void power_set_stop_wakeup_pin(uint8_t port, uint8_t pin)
+{
+    uint32_t shift = (pin & 0x3U) * 4U;
+
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[pin >> 2] = (SYSCFG->EXTICR[pin >> 2] & ~(0xFUL << shift)) | ((uint32_t)port << shift);
+
+    // event mode only: wakes WFE without needing an EXTI handler in the vector table
+    EXTI->FTSR |= (1UL << pin);
+    EXTI->EMR |= (1UL << pin);
+
+    stop_wakeup_lines |= (1UL << pin);
+}
+
+void power_get_stats(power_stats_t *stats)
+{
+    stats->uptime_ms = millis() - stats_start_ms;
+    stats->sleep_ms = (uint32_t)(sleep_us / 1000U);
+    stats->sleep_count = sleep_count;
+    stats->stop_count = stop_count;
+    stats->busy_count = busy_count;
+}
+
+void power_reset_stats(void)
+{
+    stats_start_ms = millis();
+    sleep_us = 0;
+    sleep_count = 0;
+    stop_count = 0;
+    busy_count = 0;
+}
@@ -0,0 +1,199 @@
+#include "../Include/spi.h"
+#include "../Include/dma.h"
+
+#define SPI_QUEUE_MASK (SPI_QUEUE_SIZE - 1U)
+
+// byte wide on both sides, direct mode; RX gets the higher priority so DR is always emptied before it is refilled
+#define SPI_RX_CR (DMA_SxCR_PL_1 | DMA_SxCR_PL_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE)
+#define SPI_TX_CR (DMA_SxCR_PL_1 | DMA_SxCR_DIR_0 | DMA_SxCR_TEIE)
+
+static spi_transfer_t queue[SPI_QUEUE_SIZE];
+static volatile uint8_t queue_write = 0;
+static volatile uint8_t queue_read = 0; // the running transfer, if any
+static volatile bool running = false;
+static volatile uint32_t errors = 0;
+
+static dma_stream_t rx_stream = DMA_STREAM_NONE;
+static dma_stream_t tx_stream = DMA_STREAM_NONE;
+static DMA_Stream_TypeDef *rx_regs;
+static DMA_Stream_TypeDef *tx_regs;
+static uint32_t rx_cr; // SPI_RX_CR / SPI_TX_CR with the channel of the stream dma_claim() picked
+static uint32_t tx_cr;
+
+// fixed source / destination for transfers without a tx or rx buffer (no MINC)
+static const uint8_t tx_fill = SPI_TX_FILL;
+static uint8_t rx_sink;
+
+static bool spi_has_cs(gpio_pin_t cs)
+{
+    return cs.port_base != 0U;
+}
+
+// both streams are disabled here: they switch themselves off at the end of a transfer
+static void spi_start(const spi_transfer_t *transfer)
+{
+    dma_clear(rx_stream, DMA_EVENT_ALL);
+    dma_clear(tx_stream, DMA_EVENT_ALL);
+
+    rx_regs->M0AR = transfer->rx ? (uint32_t)(uintptr_t)transfer->rx : (uint32_t)(uintptr_t)&rx_sink;
+    rx_regs->NDTR = transfer->length;
+    rx_regs->CR = rx_cr | (transfer->rx ? DMA_SxCR_MINC : 0U);
+
+    tx_regs->M0AR = transfer->tx ? (uint32_t)(uintptr_t)transfer->tx : (uint32_t)(uintptr_t)&tx_fill;
+    tx_regs->NDTR = transfer->length;
+    tx_regs->CR = tx_cr | (transfer->tx ? DMA_SxCR_MINC : 0U);
+
+    if (spi_has_cs(transfer->cs))
+    {
+        gpio_clear(transfer->cs);
+    }
+
+    // RX first, so it is waiting before the first byte goes out; TXE is already set, so TX starts at once
+    rx_regs->CR |= DMA_SxCR_EN;
+    tx_regs->CR |= DMA_SxCR_EN;
+}
+
+static void spi_finish(bool ok)
+{
+    if (!ok)
+    {
+        dma_disable(tx_stream);
+        dma_disable(rx_stream);
+        dma_clear(rx_stream, DMA_EVENT_ALL); // the error flag would keep the interrupt pending
+        dma_clear(tx_stream, DMA_EVENT_ALL);
+        // drop a byte left in DR and clear OVR (DR read after SR read)
+        (void)SPI1->DR;
+        (void)SPI1->SR;
+        errors++;
+    }
+
+    const spi_transfer_t *transfer = &queue[queue_read];
+    if (spi_has_cs(transfer->cs))
+    {
+        gpio_set(transfer->cs);
+    }
+
+    // free the slot before the callback, so that it can submit even if the queue was full
+    spi_callback_t callback = transfer->callback;
+    void *context = transfer->context;
+    queue_read = (queue_read + 1U) & SPI_QUEUE_MASK;
+
+    if (callback)
+    {
+        callback(context, ok);
+    }
+
+    if (queue_read != queue_write)
+    {
+        spi_start(&queue[queue_read]);
+    }
+    else
+    {
+        running = false;
+    }
+}
+
+static void spi_rx_event(void *context, uint32_t events)
+{
+    (void)context;
+    if (events & DMA_EVENT_ERROR)
+    {
+        spi_finish(false);
+    }
+    else if (events & DMA_EVENT_COMPLETE)
+    {
+        // the last byte has been clocked in, so SCK has stopped
+        spi_finish(true);
+    }
+}
+
+static void spi_tx_event(void *context, uint32_t events)
+{
+    // only enabled for errors; the RX stream reports the end of a transfer
+    (void)context;
+    if (events & DMA_EVENT_ERROR)
+    {
+        spi_finish(false);
+    }
+}
+
+uint32_t spi_init(uint32_t max_hz, spi_mode_t mode)
+{
+    if (rx_stream == DMA_STREAM_NONE)
+    {
+        rx_stream = dma_claim(DMA_REQ_SPI1_RX, spi_rx_event, NULL);
+    }
+    if (tx_stream == DMA_STREAM_NONE)
+    {
+        tx_stream = dma_claim(DMA_REQ_SPI1_TX, spi_tx_event, NULL);
+    }
+    if (rx_stream == DMA_STREAM_NONE || tx_stream == DMA_STREAM_NONE)
+    {
+        return 0;
+    }
+    rx_regs = dma_regs(rx_stream);
+    tx_regs = dma_regs(tx_stream);
+    rx_cr = dma_channel_bits(rx_stream) | SPI_RX_CR;
+    tx_cr = dma_channel_bits(tx_stream) | SPI_TX_CR;
+
+    PINMUX_APPLY(SPI1_PINMUX);
+
+    RCC->APB2ENR |= RCC_APB2ENR_SPI1EN;
+
+    // SCK = SPI_PCLK / 2^(BR + 1)
+    uint32_t br = 0;
+    while (br < 7U && (SPI_PCLK >> (br + 1U)) > max_hz)
+    {
+        br++;
+    }
+
+    // master, 8 bit, MSB first; NSS is managed in software (SSI keeps the master from faulting itself)
+    SPI1->CR1 = 0;
+    SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | (br << SPI_CR1_BR_Pos) | (uint32_t)mode;
+    SPI1->CR2 = SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+
+    rx_regs->PAR = (uint32_t)(uintptr_t)&SPI1->DR;
+    tx_regs->PAR = (uint32_t)(uintptr_t)&SPI1->DR;
+    rx_regs->FCR = 0; // direct mode
+    tx_regs->FCR = 0;
+
+    SPI1->CR1 |= SPI_CR1_SPE;
+    return SPI_PCLK >> (br + 1U);
+}
+
+bool spi_submit(const spi_transfer_t *transfer)
+{
+    if (!transfer || transfer->length == 0U)
+    {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq(); // callbacks submit from the DMA interrupt, which also starts the queued transfers
+
+    uint8_t next_write = (queue_write + 1U) & SPI_QUEUE_MASK;
+    bool queued = (next_write != queue_read);
+    if (queued)
+    {
+        queue[queue_write] = *transfer;
+        queue_write = next_write;
+        if (!running)
+        {
+            running = true;
+            spi_start(&queue[queue_read]);
+        }
+    }
+
+    __set_PRIMASK(primask);
+    return queued;
+}
+
+bool spi_busy(void)
+{
+    return running;
+}
+
+uint32_t spi_errors(void)
+{
+    return errors;
+}
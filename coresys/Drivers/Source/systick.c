@@ -0,0 +1,140 @@
+#include "../Include/systick.h"
+
+static volatile uint32_t systick_millis = 0;
+
+static uint32_t suppressed_ms = 0;      // length of the current tickless period; 0 while ticking normally
+static uint32_t suppressed_ticks = 0;   // core clock cycles programmed for the tickless period
+static uint32_t suppressed_offset = 0;  // cycles left until the next 1ms boundary when the tick was suppressed
+
+void SysTick_Handler(void)
+{
+    systick_millis++;
+}
+
+void systick_init(void)
+{
+    systick_millis = 0;
+
+    // loads LOAD, clears VAL, selects the processor clock, enables the tick interrupt at the lowest priority
+    SysTick_Config(SYSTICK_RELOAD_VALUE);
+}
+
+uint32_t millis(void)
+{
+    return systick_millis;
+}
+
+uint32_t micros(void)
+{
+    uint32_t ms;
+    uint32_t val;
+
+    // re-read if the tick interrupt ran between the two reads
+    do
+    {
+        ms = systick_millis;
+        val = SysTick->VAL;
+    } while (ms != systick_millis);
+
+    // the counter wrapped but the handler has not run yet (we are in a higher priority context or interrupts are masked);
+    // a large VAL means the wrap happened before we sampled it
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && (val > (SYSTICK_RELOAD_VALUE / 2U)))
+    {
+        ms++;
+    }
+
+    uint32_t elapsed_ticks = (SYSTICK_RELOAD_VALUE - 1U) - val;
+    return (ms * 1000U) + (elapsed_ticks / (SYSTICK_RELOAD_VALUE / 1000U));
+}
+
+void systick_delay_ms(uint32_t ms)
+{
+    uint32_t start = millis();
+    while ((millis() - start) < ms)
+    {
+        __WFI(); // the tick interrupt wakes us up at least once every millisecond
+    }
+}
+
+uint32_t systick_suppress_ticks(uint32_t ms)
+{
+    if (ms > SYSTICK_MAX_SUPPRESS_MS)
+    {
+        ms = SYSTICK_MAX_SUPPRESS_MS;
+    }
+
+    if (ms < 2U)
+    {
+        return 0; // the normal tick already wakes us up on the next boundary
+    }
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        // a tick is already waiting to be counted; don't lose it
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        return 0;
+    }
+
+    // VAL counts down to the next boundary; 0 means the boundary is one full period away
+    uint32_t val = SysTick->VAL;
+    suppressed_offset = val ? val : SYSTICK_RELOAD_VALUE;
+    suppressed_ticks = suppressed_offset + (ms - 1U) * SYSTICK_RELOAD_VALUE;
+    suppressed_ms = ms;
+
+    SysTick->LOAD = suppressed_ticks - 1U;
+    SysTick->VAL = 0; // forces a reload from LOAD on the next clock
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    // LOAD is only sampled on a wrap, so the normal period is already in place for when the long one ends
+    SysTick->LOAD = SYSTICK_RELOAD_VALUE - 1U;
+
+    return ms;
+}
+
+uint32_t systick_resume_ticks(void)
+{
+    if (!suppressed_ms)
+    {
+        return 0;
+    }
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t val = SysTick->VAL;
+    uint32_t elapsed;
+
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        // the whole period ran out; the counter has already reloaded with the normal period and the pending
+        // handler will count the last millisecond once interrupts are unmasked
+        systick_millis += suppressed_ms - 1U;
+        elapsed = suppressed_ticks + (SYSTICK_RELOAD_VALUE - 1U - val);
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    }
+    else
+    {
+        // woken early by another interrupt; count the boundaries we crossed and realign to the 1ms grid
+        elapsed = (suppressed_ticks - 1U) - val;
+
+        uint32_t next_boundary;
+        if (elapsed >= suppressed_offset)
+        {
+            uint32_t past_first = elapsed - suppressed_offset;
+            systick_millis += 1U + past_first / SYSTICK_RELOAD_VALUE;
+            next_boundary = SYSTICK_RELOAD_VALUE - (past_first % SYSTICK_RELOAD_VALUE);
+        }
+        else
+        {
+            next_boundary = suppressed_offset - elapsed;
+        }
+
+        SysTick->LOAD = next_boundary - 1U;
+        SysTick->VAL = 0;
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        SysTick->LOAD = SYSTICK_RELOAD_VALUE - 1U;
+    }
+
+    suppressed_ms = 0;
+    return elapsed;
+}
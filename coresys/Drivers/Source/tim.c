@@ -0,0 +1,446 @@
+#include "../Include/tim.h"
+#include "../Include/dma.h"
+
+#define TIM_DBA_CCR1 (offsetof(TIM_TypeDef, CCR1) / 4U) // DCR counts registers from CR1
+
+#define TIM_OC_PWM1 (0x68UL) // OCxM 110 (active while CNT < CCR) and OCxPE, for channel 1; shifted for 2
+#define TIM_OC_PWM2 (0x70UL) // OCxM 111 (active while CNT >= CCR), no preload
+
+#define TIM_BIT(tim) (1UL << (uint32_t)(tim))
+
+typedef struct tim_hw_
+{
+    TIM_TypeDef *regs;
+    bool apb2;
+    uint32_t rcc_enable; // RCC APB1ENR / APB2ENR bit
+    uint32_t max_count;  // ARR limit: 16 or 32 bit counter
+    uint8_t channels;
+    bool slave; // has the slave mode controller that PWM input needs
+    bool burst; // has an update DMA request (TIMx_UP)
+    dma_request_t burst_request;
+} tim_hw_t;
+
+static const tim_hw_t tim_hw[TIM_ID_COUNT] = {
+    [TIM_ID_1] = {
+        .regs = TIM1,
+        .apb2 = true,
+        .rcc_enable = RCC_APB2ENR_TIM1EN,
+        .max_count = 0xFFFFUL,
+        .channels = 4U,
+        .slave = true,
+        .burst = true,
+        .burst_request = DMA_REQ_TIM1_UP,
+    },
+    [TIM_ID_2] = {
+        .regs = TIM2,
+        .apb2 = false,
+        .rcc_enable = RCC_APB1ENR_TIM2EN,
+        .max_count = 0xFFFFFFFFUL,
+        .channels = 4U,
+        .slave = true,
+        .burst = true,
+        .burst_request = DMA_REQ_TIM2_UP,
+    },
+    [TIM_ID_3] = {
+        .regs = TIM3,
+        .apb2 = false,
+        .rcc_enable = RCC_APB1ENR_TIM3EN,
+        .max_count = 0xFFFFUL,
+        .channels = 4U,
+        .slave = true,
+        .burst = true,
+        .burst_request = DMA_REQ_TIM3_UP,
+    },
+    [TIM_ID_4] = {
+        .regs = TIM4,
+        .apb2 = false,
+        .rcc_enable = RCC_APB1ENR_TIM4EN,
+        .max_count = 0xFFFFUL,
+        .channels = 4U,
+        .slave = true,
+        .burst = true,
+        .burst_request = DMA_REQ_TIM4_UP,
+    },
+    [TIM_ID_5] = {
+        .regs = TIM5,
+        .apb2 = false,
+        .rcc_enable = RCC_APB1ENR_TIM5EN,
+        .max_count = 0xFFFFFFFFUL,
+        .channels = 4U,
+        .slave = true,
+        .burst = true,
+        .burst_request = DMA_REQ_TIM5_UP,
+    },
+    [TIM_ID_9] = {
+        .regs = TIM9,
+        .apb2 = true,
+        .rcc_enable = RCC_APB2ENR_TIM9EN,
+        .max_count = 0xFFFFUL,
+        .channels = 2U,
+        .slave = true,
+    },
+    [TIM_ID_10] = {
+        .regs = TIM10,
+        .apb2 = true,
+        .rcc_enable = RCC_APB2ENR_TIM10EN,
+        .max_count = 0xFFFFUL,
+        .channels = 1U,
+        .slave = false,
+    },
+    [TIM_ID_11] = {
+        .regs = TIM11,
+        .apb2 = true,
+        .rcc_enable = RCC_APB2ENR_TIM11EN,
+        .max_count = 0xFFFFUL,
+        .channels = 1U,
+        .slave = false,
+    },
+};
+
+static uint8_t capture_channel[TIM_ID_COUNT];
+static uint32_t claims = 0; // bit per tim_id_t: held by another driver (tim_claim())
+static uint32_t modes = 0;  // bit per tim_id_t: running one of the modes here
+static dma_stream_t burst_stream[TIM_ID_COUNT] = {
+    DMA_STREAM_NONE, DMA_STREAM_NONE, DMA_STREAM_NONE, DMA_STREAM_NONE,
+    DMA_STREAM_NONE, DMA_STREAM_NONE, DMA_STREAM_NONE, DMA_STREAM_NONE,
+};
+
+static uint32_t tim_clock(const tim_hw_t *hw)
+{
+    return hw->apb2 ? TIM_APB2_CLOCK : TIM_APB1_CLOCK;
+}
+
+// the clock divider (1 to TIM_MAX_PRESCALER) closest to tick_hz, or 0 if there is none
+static uint32_t tim_divider(const tim_hw_t *hw, uint64_t tick_hz)
+{
+    uint32_t clock = tim_clock(hw);
+
+    if (tick_hz == 0U || tick_hz > clock)
+    {
+        return 0;
+    }
+
+    uint64_t divider = (clock + tick_hz / 2U) / tick_hz;
+    return (divider > TIM_MAX_PRESCALER) ? 0U : (uint32_t)divider;
+}
+
+static bool tim_channel_valid(const tim_hw_t *hw, uint8_t channel)
+{
+    return channel >= 1U && channel <= hw->channels;
+}
+
+static bool tim_is_claimed(tim_id_t tim)
+{
+    return (claims & TIM_BIT(tim)) != 0U;
+}
+
+// the counter and all of its outputs, captures and bursts off
+static void tim_halt(tim_id_t tim)
+{
+    TIM_TypeDef *regs = tim_hw[tim].regs;
+
+    tim_burst_stop(tim);
+    regs->CR1 = 0;
+    regs->DIER = 0;
+    regs->CCER = 0;
+    regs->DCR = 0;
+    if (regs == TIM1)
+    {
+        regs->BDTR = 0;
+    }
+}
+
+// a stopped timer with every mode cleared, counting at clock / divider; false if another driver holds it
+static bool tim_reset(tim_id_t tim, uint32_t divider)
+{
+    const tim_hw_t *hw = &tim_hw[tim];
+    TIM_TypeDef *regs = hw->regs;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool free = !tim_is_claimed(tim);
+    modes |= free ? TIM_BIT(tim) : 0U;
+    __set_PRIMASK(primask);
+    if (!free)
+    {
+        return false;
+    }
+
+    if (hw->apb2)
+    {
+        RCC->APB2ENR |= hw->rcc_enable;
+    }
+    else
+    {
+        RCC->APB1ENR |= hw->rcc_enable;
+    }
+
+    tim_halt(tim);
+    regs->CR2 = 0;
+    regs->SMCR = 0;
+    regs->CCMR1 = 0;
+    regs->CCMR2 = 0;
+    regs->CNT = 0;
+    regs->PSC = divider - 1U;
+    regs->ARR = hw->max_count;
+    regs->EGR = TIM_EGR_UG; // load PSC now, not at the first overflow
+    regs->SR = 0;
+    capture_channel[tim] = 0;
+    return true;
+}
+
+static void tim_output_mode(TIM_TypeDef *regs, uint8_t channel, uint32_t mode)
+{
+    volatile uint32_t *ccmr = (channel <= 2U) ? &regs->CCMR1 : &regs->CCMR2;
+    uint32_t shift = ((channel - 1U) & 1U) * 8U;
+
+    *ccmr = (*ccmr & ~(0xFFUL << shift)) | (mode << shift);
+}
+
+static void tim_output_enable(const tim_hw_t *hw, uint8_t channel, bool active_low)
+{
+    uint32_t shift = (channel - 1U) * 4U;
+
+    hw->regs->CCER = (hw->regs->CCER & ~(TIM_CCER_CC1P << shift)) |
+                     ((TIM_CCER_CC1E | (active_low ? TIM_CCER_CC1P : 0U)) << shift);
+    if (hw->regs == TIM1)
+    {
+        hw->regs->BDTR |= TIM_BDTR_MOE; // the advanced timer gates all of its outputs on top of CCxE
+    }
+}
+
+uint32_t tim_pwm_init(tim_id_t tim, uint32_t frequency_hz, uint16_t steps)
+{
+    const tim_hw_t *hw = &tim_hw[tim];
+    uint32_t divider = tim_divider(hw, (uint64_t)frequency_hz * steps);
+
+    if (steps == 0U || divider == 0U || !tim_reset(tim, divider))
+    {
+        return 0;
+    }
+
+    hw->regs->ARR = steps - 1U;
+    hw->regs->EGR = TIM_EGR_UG;
+    hw->regs->SR = 0;
+    hw->regs->CR1 = TIM_CR1_ARPE | TIM_CR1_CEN;
+
+    return tim_clock(hw) / (divider * steps);
+}
+
+bool tim_pwm_start(tim_id_t tim, uint8_t channel, bool active_low)
+{
+    const tim_hw_t *hw = &tim_hw[tim];
+
+    if (!tim_channel_valid(hw, channel) || tim_is_claimed(tim))
+    {
+        return false;
+    }
+
+    tim_output_mode(hw->regs, channel, TIM_OC_PWM1);
+    tim_output_enable(hw, channel, active_low);
+    return true;
+}
+
+void tim_pwm_set(tim_id_t tim, uint8_t channel, uint32_t duty)
+{
+    // CCR1-CCR4 are consecutive; preloaded, so the new duty starts with the next period
+    (&tim_hw[tim].regs->CCR1)[channel - 1U] = duty;
+}
+
+uint32_t tim_capture_init(tim_id_t tim, uint8_t channel, uint32_t tick_hz)
+{
+    const tim_hw_t *hw = &tim_hw[tim];
+    uint32_t divider = tim_divider(hw, tick_hz);
+
+    if (!hw->slave || (channel != 1U && channel != 2U) || divider == 0U || !tim_reset(tim, divider))
+    {
+        return 0;
+    }
+
+    TIM_TypeDef *regs = hw->regs;
+
+    if (channel == 1U)
+    {
+        // IC1 on TI1 rising (the period), IC2 on TI1 falling (the high time); TI1FP1 resets the counter
+        regs->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_1;
+        regs->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC2P;
+        regs->SMCR = TIM_SMCR_TS_2 | TIM_SMCR_TS_0 | TIM_SMCR_SMS_2;
+    }
+    else
+    {
+        // the same, mirrored: IC2 on TI2 rising, IC1 on TI2 falling, TI2FP2 resets the counter
+        regs->CCMR1 = TIM_CCMR1_CC2S_0 | TIM_CCMR1_CC1S_1;
+        regs->CCER = TIM_CCER_CC2E | TIM_CCER_CC1E | TIM_CCER_CC1P;
+        regs->SMCR = TIM_SMCR_TS_2 | TIM_SMCR_TS_1 | TIM_SMCR_SMS_2;
+    }
+
+    // URS: the resets by the input don't set UIF, so UIF means a whole counter range went by without an edge
+    capture_channel[tim] = channel;
+    regs->CR1 = TIM_CR1_URS | TIM_CR1_CEN;
+
+    return tim_clock(hw) / divider;
+}
+
+bool tim_capture_read(tim_id_t tim, tim_capture_t *capture)
+{
+    TIM_TypeDef *regs = tim_hw[tim].regs;
+    uint8_t channel = capture_channel[tim];
+    uint32_t period_flag = (channel == 1U) ? TIM_SR_CC1IF : TIM_SR_CC2IF;
+    uint32_t status = regs->SR;
+
+    if (channel == 0U)
+    {
+        return false;
+    }
+    if (status & TIM_SR_UIF)
+    {
+        regs->SR = (uint32_t)~TIM_SR_UIF; // rc_w0
+        return false;
+    }
+    if (!(status & period_flag))
+    {
+        return false;
+    }
+
+    // reading the period register clears its flag
+    capture->period = (channel == 1U) ? regs->CCR1 : regs->CCR2;
+    capture->high = (channel == 1U) ? regs->CCR2 : regs->CCR1;
+    return true;
+}
+
+uint32_t tim_one_pulse_init(tim_id_t tim, uint8_t channel, uint32_t tick_hz, uint32_t delay_ticks,
+                            uint32_t width_ticks)
+{
+    const tim_hw_t *hw = &tim_hw[tim];
+    uint32_t divider = tim_divider(hw, tick_hz);
+    uint64_t last = (uint64_t)delay_ticks + width_ticks - 1U;
+
+    if (!tim_channel_valid(hw, channel) || divider == 0U || delay_ticks == 0U || width_ticks == 0U ||
+        last > hw->max_count || !tim_reset(tim, divider))
+    {
+        return 0;
+    }
+
+    TIM_TypeDef *regs = hw->regs;
+
+    // PWM mode 2: inactive below CCR, active from CCR to ARR; the update at ARR stops the counter (OPM)
+    regs->ARR = (uint32_t)last;
+    (&regs->CCR1)[channel - 1U] = delay_ticks;
+    tim_output_mode(regs, channel, TIM_OC_PWM2);
+    tim_output_enable(hw, channel, false);
+    regs->CR1 = TIM_CR1_OPM;
+
+    return tim_clock(hw) / divider;
+}
+
+void tim_one_pulse_fire(tim_id_t tim)
+{
+    tim_hw[tim].regs->CR1 |= TIM_CR1_CEN;
+}
+
+bool tim_burst_start(tim_id_t tim, uint8_t first_channel, uint8_t channels, const uint32_t *table,
+                     uint16_t updates, bool circular)
+{
+    const tim_hw_t *hw = &tim_hw[tim];
+
+    if (!hw->burst || tim_is_claimed(tim) || !table || channels == 0U || updates == 0U || !tim_channel_valid(hw, first_channel) ||
+        first_channel + channels - 1U > hw->channels || (uint32_t)updates * channels > DMA_MAX_COUNT)
+    {
+        return false;
+    }
+
+    tim_burst_stop(tim);
+    dma_stream_t stream = dma_claim(hw->burst_request, NULL, NULL);
+    if (stream == DMA_STREAM_NONE)
+    {
+        return false;
+    }
+
+    // words both ways: the APB bridge copies a half word write into both halves of the register, which a
+    // 32 bit timer's CCR (TIM2, TIM5) would take as duty | duty << 16. The 16 bit timers ignore the top half
+    dma_transfer_t transfer = {
+        .direction = DMA_MEMORY_TO_PERIPH,
+        .peripheral = &hw->regs->DMAR,
+        .memory = (volatile void *)(uintptr_t)table,
+        .count = (uint16_t)(updates * channels),
+        .peripheral_width = DMA_WIDTH_32,
+        .memory_width = DMA_WIDTH_32,
+        .memory_increment = true,
+        .circular = circular,
+        .fifo = DMA_FIFO_DIRECT,
+    };
+    dma_configure(stream, &transfer);
+    dma_enable(stream);
+    burst_stream[tim] = stream;
+
+    // every update event asks for `channels` transfers into DMAR, which lands them in CCR(first) onwards
+    hw->regs->DCR = ((uint32_t)(channels - 1U) << TIM_DCR_DBL_Pos) | (TIM_DBA_CCR1 + first_channel - 1U);
+    hw->regs->DIER |= TIM_DIER_UDE;
+    return true;
+}
+
+void tim_burst_stop(tim_id_t tim)
+{
+    if (tim_is_claimed(tim))
+    {
+        return;
+    }
+
+    tim_hw[tim].regs->DIER &= ~TIM_DIER_UDE;
+    dma_release(burst_stream[tim]);
+    burst_stream[tim] = DMA_STREAM_NONE;
+}
+
+bool tim_burst_busy(tim_id_t tim)
+{
+    return burst_stream[tim] != DMA_STREAM_NONE && dma_busy(burst_stream[tim]);
+}
+
+void tim_stop(tim_id_t tim)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool running = (modes & TIM_BIT(tim)) != 0U;
+    modes &= ~TIM_BIT(tim);
+    __set_PRIMASK(primask);
+    if (!running)
+    {
+        return; // never started here, or another driver's: not ours to stop
+    }
+
+    tim_halt(tim);
+}
+
+bool tim_claim(tim_id_t tim)
+{
+    if (tim >= TIM_ID_COUNT)
+    {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq(); // drivers may claim from interrupts too
+    bool free = !((claims | modes) & TIM_BIT(tim));
+    claims |= free ? TIM_BIT(tim) : 0U;
+    __set_PRIMASK(primask);
+
+    return free;
+}
+
+void tim_release(tim_id_t tim)
+{
+    if (tim >= TIM_ID_COUNT)
+    {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    claims &= ~TIM_BIT(tim);
+    __set_PRIMASK(primask);
+}
+
+uint32_t tim_claimed(void)
+{
+    return claims | modes;
+}
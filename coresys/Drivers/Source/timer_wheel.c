@@ -0,0 +1,179 @@
+#include "../Include/timer_wheel.h"
+#include "../Include/systick.h"
+
+static soft_timer_t *wheel[TIMER_WHEEL_SLOTS];
+static uint32_t wheel_tick = 0; // next tick the wheel has not processed yet
+static uint32_t active_timers = 0;
+static bool in_update = false; // timer_wheel_update() is running the callbacks of wheel_tick's bucket
+
+static void timer_link(soft_timer_t *timer)
+{
+    soft_timer_t **slot = &wheel[timer->expiry & TIMER_WHEEL_MASK];
+
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot)
+    {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+}
+
+static void timer_unlink(soft_timer_t *timer)
+{
+    if (timer->prev)
+    {
+        timer->prev->next = timer->next;
+    }
+    else
+    {
+        wheel[timer->expiry & TIMER_WHEEL_MASK] = timer->next;
+    }
+
+    if (timer->next)
+    {
+        timer->next->prev = timer->prev;
+    }
+
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+void timer_wheel_init(void)
+{
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+    {
+        wheel[i] = NULL;
+    }
+
+    active_timers = 0;
+    wheel_tick = millis();
+}
+
+void timer_wheel_update(void)
+{
+    uint32_t now = millis();
+
+    in_update = true;
+    while ((int32_t)(now - wheel_tick) >= 0)
+    {
+        uint32_t slot = wheel_tick & TIMER_WHEEL_MASK;
+        soft_timer_t *timer = wheel[slot];
+
+        while (timer)
+        {
+            if (timer->expiry != wheel_tick)
+            {
+                // hashed into this bucket but due on a later revolution
+                timer = timer->next;
+                continue;
+            }
+
+            timer_unlink(timer);
+            if (timer->period)
+            {
+                // relink before the callback so that it is allowed to stop its own timer
+                timer->expiry += timer->period;
+                timer_link(timer);
+            }
+            else
+            {
+                timer->active = false;
+                active_timers--;
+            }
+
+            if (timer->callback)
+            {
+                timer->callback(timer->context);
+            }
+
+            // the callback may have started or stopped timers in this bucket, so rescan it from the head
+            timer = wheel[slot];
+        }
+
+        wheel_tick++;
+    }
+    in_update = false;
+}
+
+bool timer_wheel_next_expiry(uint32_t *ms_until_expiry)
+{
+    if (!active_timers)
+    {
+        return false;
+    }
+
+    uint32_t now = millis();
+    int32_t nearest = INT32_MAX;
+
+    // walks every running timer, so this is O(n); it is only meant to be called right before sleeping
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+    {
+        for (soft_timer_t *timer = wheel[i]; timer; timer = timer->next)
+        {
+            int32_t remaining = (int32_t)(timer->expiry - now);
+            if (remaining < nearest)
+            {
+                nearest = remaining;
+            }
+        }
+    }
+
+    *ms_until_expiry = (nearest > 0) ? (uint32_t)nearest : 0;
+    return true;
+}
+
+void soft_timer_init(soft_timer_t *timer, soft_timer_callback_t callback, void *context)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expiry = 0;
+    timer->period = 0;
+    timer->callback = callback;
+    timer->context = context;
+    timer->active = false;
+}
+
+void soft_timer_start(soft_timer_t *timer, uint32_t delay_ms, uint32_t period_ms)
+{
+    if (timer->active)
+    {
+        timer_unlink(timer);
+        active_timers--;
+    }
+
+    timer->expiry = millis() + delay_ms;
+    if ((int32_t)(timer->expiry - wheel_tick) < 0)
+    {
+        // that tick has already been processed; fire on the next update instead of one full wrap later
+        timer->expiry = wheel_tick;
+    }
+    if (in_update && timer->expiry == wheel_tick)
+    {
+        // started from a callback of the bucket being processed, which rescans it: a timer that restarts
+        // itself with no delay would fire again and again and never let the update finish
+        timer->expiry = wheel_tick + 1U;
+    }
+
+    timer->period = period_ms;
+    timer->active = true;
+    active_timers++;
+    timer_link(timer);
+}
+
+void soft_timer_stop(soft_timer_t *timer)
+{
+    if (!timer->active)
+    {
+        return;
+    }
+
+    timer_unlink(timer);
+    timer->active = false;
+    active_timers--;
+}
+
+bool soft_timer_is_active(const soft_timer_t *timer)
+{
+    return timer->active;
+}
@@ -0,0 +1,90 @@
+#include "../Include/vectors.h"
+
+#ifndef HOST_EMULATION
+
+_Static_assert(VECTORS_ALIGN >= VECTORS_COUNT * 4U, "VECTORS_ALIGN is smaller than the table");
+
+static uint32_t ram_vectors[VECTORS_COUNT] __attribute__((section(".ram_vectors"), aligned(VECTORS_ALIGN)));
+
+static uint32_t vectors_slot(IRQn_Type irq)
+{
+    return (uint32_t)((int32_t)irq + 16);
+}
+
+bool vectors_in_ram(void)
+{
+    return SCB->VTOR == (uint32_t)(uintptr_t)ram_vectors;
+}
+
+void vectors_relocate(void)
+{
+    if (vectors_in_ram())
+    {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    const volatile uint32_t *active = (const volatile uint32_t *)(uintptr_t)SCB->VTOR;
+    for (uint32_t i = 0; i < VECTORS_COUNT; i++)
+    {
+        ram_vectors[i] = active[i];
+    }
+
+    __DSB(); // the copy must be complete before the core can fetch from it
+    SCB->VTOR = (uint32_t)(uintptr_t)ram_vectors;
+    __DSB();
+    __ISB();
+
+    __set_PRIMASK(primask);
+}
+
+vectors_handler_t vectors_set_handler(IRQn_Type irq, vectors_handler_t handler)
+{
+    vectors_relocate();
+
+    uint32_t slot = vectors_slot(irq);
+    vectors_handler_t previous = (vectors_handler_t)(uintptr_t)ram_vectors[slot];
+    ram_vectors[slot] = (uint32_t)(uintptr_t)handler;
+    __DSB(); // the next exception entry has to see the new entry
+    return previous;
+}
+
+vectors_handler_t vectors_get_handler(IRQn_Type irq)
+{
+    const volatile uint32_t *active = (const volatile uint32_t *)(uintptr_t)SCB->VTOR;
+    return (vectors_handler_t)(uintptr_t)active[vectors_slot(irq)];
+}
+
+#else
+
+#include "../../Host/Include/host_emu.h"
+
+static bool relocated = false;
+
+bool vectors_in_ram(void)
+{
+    return relocated;
+}
+
+void vectors_relocate(void)
+{
+    relocated = true;
+}
+
+vectors_handler_t vectors_set_handler(IRQn_Type irq, vectors_handler_t handler)
+{
+    vectors_relocate();
+
+    vectors_handler_t previous = host_emu_get_handler(irq);
+    host_emu_set_handler(irq, handler);
+    return previous;
+}
+
+vectors_handler_t vectors_get_handler(IRQn_Type irq)
+{
+    return host_emu_get_handler(irq);
+}
+
+#endif
@@ -0,0 +1,103 @@
+// adc.h: the configurations adc_start() refuses, its DMA claim with the fallback stream, the scan rate TIM3
+// really runs at, and adc_stop() handing the stream back. The emulator has no ADC model, so no samples arrive
+
+#include "check.h"
+#include "../../Drivers/Include/adc.h"
+#include "../../Drivers/Include/dma.h"
+
+static uint16_t buffer[2U * 4U * 2U];
+static const uint8_t channels[] = {16U, 17U};
+static const uint8_t bad_channel[] = {19U};
+
+static void scans_done(const uint16_t *half, uint16_t scans, void *context)
+{
+    (void)half;
+    (void)scans;
+    (void)context;
+}
+
+static adc_config_t valid_config(void)
+{
+    adc_config_t config = {
+        .channels = channels,
+        .channel_count = sizeof(channels),
+        .sample_time = ADC_SAMPLE_3,
+        .scan_rate_hz = 1000U,
+        .buffer = buffer,
+        .scans_per_half = 4U,
+        .callback = scans_done,
+        .context = NULL,
+    };
+    return config;
+}
+
+static void check_refused(void)
+{
+    adc_config_t config = valid_config();
+    config.channel_count = 0U;
+    bool refused = !adc_start(&config);
+
+    config = valid_config();
+    config.channels = bad_channel;
+    config.channel_count = 1U;
+    refused = refused && !adc_start(&config);
+
+    // 2 * scans_per_half * channels samples must fit NDTR
+    config = valid_config();
+    config.scans_per_half = 0x8000U;
+    refused = refused && !adc_start(&config);
+
+    config = valid_config();
+    config.callback = NULL;
+    refused = refused && !adc_start(&config);
+    check(refused && dma_claimed() == 0U, "bad configurations are refused and claim nothing");
+
+    // two channels at 480 + 12 cycles of an 8 MHz ADCCLK take 123 us, so 10 kHz can't keep up
+    config = valid_config();
+    config.sample_time = ADC_SAMPLE_480;
+    config.scan_rate_hz = 10000U;
+    check(!adc_start(&config) && dma_claimed() == 0U, "a scan rate faster than the conversions is refused");
+}
+
+static void check_claims(void)
+{
+    adc_config_t config = valid_config();
+    check(adc_start(&config) && dma_claimed() == CHECK_STREAM_BIT(2U, 0U), "adc_start claims DMA2 stream 0");
+    check(adc_scan_rate() == 1000U, "TIM3 runs at 1 kHz exactly from 16 MHz");
+
+    // starting again stops the running scans first and reuses their stream
+    config.scan_rate_hz = 7U;
+    check(adc_start(&config) && dma_claimed() == CHECK_STREAM_BIT(2U, 0U),
+          "a second adc_start replaces the first one's claim");
+    check(adc_scan_rate() >= 6U && adc_scan_rate() <= 7U, "7 Hz needs the prescaler and comes out within 1 Hz");
+
+    adc_stop();
+    check(dma_claimed() == 0U && adc_scan_rate() == 0U, "adc_stop releases the stream");
+
+    // SPI1_RX takes stream 2 first, then 0
+    dma_stream_t spi = dma_claim(DMA_REQ_SPI1_RX, NULL, NULL);
+    dma_stream_t spi_second = dma_claim(DMA_REQ_SPI1_RX, NULL, NULL);
+    check(adc_start(&config) && (dma_claimed() & CHECK_STREAM_BIT(2U, 4U)),
+          "with stream 0 held, adc1 takes stream 4");
+    adc_stop();
+
+    dma_stream_t memory = dma_claim(DMA_REQ_MEMORY, NULL, NULL); // DMA2 stream 1, 4 comes next
+    dma_stream_t memory_second = dma_claim(DMA_REQ_MEMORY, NULL, NULL);
+    uint32_t before = dma_claimed();
+    check(!adc_start(&config) && dma_claimed() == before, "with streams 0 and 4 held, adc_start fails");
+
+    dma_release(spi);
+    dma_release(spi_second);
+    dma_release(memory);
+    dma_release(memory_second);
+}
+
+int main(void)
+{
+    __enable_irq();
+
+    check_refused();
+    check_claims();
+
+    return check_done();
+}
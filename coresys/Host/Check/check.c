@@ -0,0 +1,21 @@
+#include "check.h"
+#include <stdio.h>
+
+static uint32_t failures = 0;
+
+// the checks talk to the drivers only, no pty for USART2
+void host_emu_board_setup(void)
+{
+}
+
+void check(bool passed, const char *what)
+{
+    printf("%-4s %s\n", passed ? "ok" : "FAIL", what);
+    failures += passed ? 0U : 1U;
+}
+
+int check_done(void)
+{
+    printf("%lu failed\n", (unsigned long)failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#ifndef D2A6F0B8_71C4_4E93_B5D8_3F9E6C1A24B7
+#define D2A6F0B8_71C4_4E93_B5D8_3F9E6C1A24B7
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../Include/host_emu.h"
+
+/*
+
+# Driver Checks
+
+Host programs (make check in coresys/Host) that run the coresys drivers on top of the peripheral emulator
+(host_emu.h) and compare what they do with known answers. Each one is Check/<name>_check.c, linked with
+check.c, the emulator and the drivers it lists in the Makefile, and calls check() once per answer:
+
+    check(dma_claimed() == 0x0100, "spi1 rx takes DMA2 stream 0");
+    ...
+    return check_done();
+
+check() prints one line per answer; check_done() prints the count of wrong ones and returns the exit status,
+1 if any was wrong. make check builds every program and runs them all, and fails if one of them did.
+
+*/
+
+// dma_claimed() bit of a stream (dma.h): DMA1 streams 0-7, DMA2 streams 8-15
+#define CHECK_STREAM_BIT(dma, stream) (1UL << (((dma) - 1U) * 8U + (stream)))
+
+void check(bool passed, const char *what);
+int check_done(void);
+
+#endif /* D2A6F0B8_71C4_4E93_B5D8_3F9E6C1A24B7 */
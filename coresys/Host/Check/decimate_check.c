@@ -0,0 +1,222 @@
+// decimate.h: known answers for the boxcar and CIC filters. DC settles to the DC value, the gain is divided
+// out exactly, the state carries across block boundaries, interleaved channels don't mix, and an order 5 CIC
+// at the widest factor it accepts matches a 64 bit reference while its integrators wrap
+
+#include "check.h"
+#include <string.h>
+#include "../../Drivers/Include/decimate.h"
+
+#define CHANNELS (3U)
+#define SCANS (4096U)
+#define FULL_SCALE ((1U << DECIMATE_INPUT_BITS) - 1U)
+
+static uint16_t input[SCANS * CHANNELS];
+static uint16_t single[SCANS];
+static uint16_t output[SCANS * CHANNELS];
+static uint16_t chunked[SCANS * CHANNELS];
+static uint16_t reference[SCANS];
+static uint64_t stages[DECIMATE_MAX_ORDER + 1U][SCANS];
+static uint32_t random_state = 1;
+
+static uint16_t random_sample(void)
+{
+    random_state = random_state * 1664525U + 1013904223U;
+    return (uint16_t)((random_state >> 16) % (FULL_SCALE + 1U));
+}
+
+static void fill_random(uint16_t *samples, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        samples[i] = random_sample();
+    }
+}
+
+// order moving sums of factor samples from a zero state, taken at every factor-th input like the CIC
+static size_t cic_reference(const uint16_t *samples, size_t scans, uint8_t order, uint16_t factor)
+{
+    uint64_t gain = 1;
+    for (size_t i = 0; i < scans; i++)
+    {
+        stages[0][i] = samples[i];
+    }
+    for (uint8_t stage = 1; stage <= order; stage++)
+    {
+        gain *= factor;
+        for (size_t i = 0; i < scans; i++)
+        {
+            uint64_t sum = 0;
+            for (size_t j = 0; j < factor && j <= i; j++)
+            {
+                sum += stages[stage - 1U][i - j];
+            }
+            stages[stage][i] = sum;
+        }
+    }
+
+    size_t produced = 0;
+    for (size_t i = factor - 1U; i < scans; i += factor)
+    {
+        reference[produced++] = (uint16_t)(stages[order][i] / gain);
+    }
+    return produced;
+}
+
+static void check_init(void)
+{
+    decimate_boxcar_t boxcar;
+    decimate_cic_t cic;
+
+    check(!decimate_boxcar_init(&boxcar, 0U, 4U) &&
+              !decimate_boxcar_init(&boxcar, DECIMATE_MAX_CHANNELS + 1U, 4U) &&
+              !decimate_boxcar_init(&boxcar, 1U, 0U),
+          "boxcar refuses no channels, too many channels and factor 0");
+    check(!decimate_cic_init(&cic, 1U, 0U, 4U) && !decimate_cic_init(&cic, 1U, DECIMATE_MAX_ORDER + 1U, 2U),
+          "cic refuses order 0 and orders above DECIMATE_MAX_ORDER");
+    // 12 + 5 * log2(16) = 32 bits fits, factor 17 doesn't
+    check(decimate_cic_init(&cic, 1U, 5U, 16U) && !decimate_cic_init(&cic, 1U, 5U, 17U),
+          "order 5 takes factor 16, the widest that fits 32 bits, and refuses 17");
+}
+
+static void check_dc(void)
+{
+    static const uint16_t dc[CHANNELS] = {0U, 1234U, FULL_SCALE};
+    for (size_t i = 0; i < SCANS * CHANNELS; i++)
+    {
+        input[i] = dc[i % CHANNELS];
+    }
+
+    decimate_boxcar_t boxcar;
+    decimate_boxcar_init(&boxcar, CHANNELS, 10U);
+    size_t produced = decimate_boxcar(&boxcar, input, 100U, output);
+    bool settled = (produced == 10U);
+    for (size_t i = 0; i < produced * CHANNELS; i++)
+    {
+        settled = settled && output[i] == dc[i % CHANNELS];
+    }
+    check(settled, "boxcar: DC comes out as the same DC from the first output, gain 1");
+
+    // an order 3 CIC fills its delay line in 3 outputs; before that it ramps up
+    decimate_cic_t cic;
+    decimate_cic_init(&cic, CHANNELS, 3U, 8U);
+    produced = decimate_cic(&cic, input, 80U, output);
+    settled = (produced == 10U) && output[0 * CHANNELS + 2U] < FULL_SCALE;
+    for (size_t i = 2U * CHANNELS; i < produced * CHANNELS; i++)
+    {
+        settled = settled && output[i] == dc[i % CHANNELS];
+    }
+    check(settled, "cic: DC settles to the same DC after order outputs, gain factor^order divided out");
+}
+
+static bool same_in_chunks(bool cic_filter, uint8_t order, uint16_t factor)
+{
+    decimate_boxcar_t boxcar;
+    decimate_cic_t cic;
+    static const size_t chunk_sizes[] = {1U, 7U, 13U, 64U, 3U, 250U};
+
+    decimate_boxcar_init(&boxcar, CHANNELS, factor);
+    decimate_cic_init(&cic, CHANNELS, order, factor);
+    size_t whole = cic_filter ? decimate_cic(&cic, input, SCANS, output)
+                              : decimate_boxcar(&boxcar, input, SCANS, output);
+
+    decimate_boxcar_init(&boxcar, CHANNELS, factor);
+    decimate_cic_init(&cic, CHANNELS, order, factor);
+    size_t scan = 0;
+    size_t produced = 0;
+    for (size_t chunk = 0; scan < SCANS; chunk++)
+    {
+        size_t scans = chunk_sizes[chunk % (sizeof(chunk_sizes) / sizeof(chunk_sizes[0]))];
+        scans = (scans > SCANS - scan) ? SCANS - scan : scans;
+        const uint16_t *in = input + scan * CHANNELS;
+        uint16_t *out = chunked + produced * CHANNELS;
+        produced += cic_filter ? decimate_cic(&cic, in, scans, out) : decimate_boxcar(&boxcar, in, scans, out);
+        scan += scans;
+    }
+
+    return produced == whole && memcmp(chunked, output, whole * CHANNELS * sizeof(uint16_t)) == 0;
+}
+
+static void check_blocks(void)
+{
+    fill_random(input, SCANS * CHANNELS);
+    check(same_in_chunks(false, 0U, 10U), "boxcar: blocks of odd sizes give the same output as one block");
+    check(same_in_chunks(true, 4U, 10U), "cic: blocks of odd sizes give the same output as one block");
+}
+
+static void check_interleaved(void)
+{
+    fill_random(input, SCANS * CHANNELS);
+
+    decimate_boxcar_t boxcar;
+    decimate_cic_t cic;
+    decimate_boxcar_init(&boxcar, CHANNELS, 6U);
+    size_t boxcar_produced = decimate_boxcar(&boxcar, input, SCANS, output);
+    memcpy(chunked, output, boxcar_produced * CHANNELS * sizeof(uint16_t));
+    decimate_cic_init(&cic, CHANNELS, 3U, 6U);
+    size_t cic_produced = decimate_cic(&cic, input, SCANS, output);
+
+    bool boxcar_ok = true;
+    bool cic_ok = true;
+    for (uint8_t channel = 0; channel < CHANNELS; channel++)
+    {
+        for (size_t i = 0; i < SCANS; i++)
+        {
+            single[i] = input[i * CHANNELS + channel];
+        }
+
+        decimate_boxcar_init(&boxcar, 1U, 6U);
+        size_t produced = decimate_boxcar(&boxcar, single, SCANS, reference);
+        boxcar_ok = boxcar_ok && produced == boxcar_produced;
+        for (size_t i = 0; i < produced; i++)
+        {
+            boxcar_ok = boxcar_ok && chunked[i * CHANNELS + channel] == reference[i];
+        }
+
+        decimate_cic_init(&cic, 1U, 3U, 6U);
+        produced = decimate_cic(&cic, single, SCANS, reference);
+        cic_ok = cic_ok && produced == cic_produced;
+        for (size_t i = 0; i < produced; i++)
+        {
+            cic_ok = cic_ok && output[i * CHANNELS + channel] == reference[i];
+        }
+    }
+    check(boxcar_ok, "boxcar: each interleaved channel matches the channel filtered alone");
+    check(cic_ok, "cic: each interleaved channel matches the channel filtered alone");
+}
+
+static void check_order_5(void)
+{
+    decimate_cic_t cic;
+
+    // full scale DC: the integrators wrap around within a few dozen inputs
+    for (size_t i = 0; i < SCANS; i++)
+    {
+        single[i] = FULL_SCALE;
+    }
+    decimate_cic_init(&cic, 1U, 5U, 16U);
+    size_t produced = decimate_cic(&cic, single, SCANS, output);
+    bool settled = (produced == SCANS / 16U);
+    for (size_t i = 4U; i < produced; i++)
+    {
+        settled = settled && output[i] == FULL_SCALE;
+    }
+    check(settled, "order 5, factor 16: full scale DC stays full scale while the integrators wrap");
+
+    fill_random(single, SCANS);
+    decimate_cic_init(&cic, 1U, 5U, 16U);
+    produced = decimate_cic(&cic, single, SCANS, output);
+    size_t expected = cic_reference(single, SCANS, 5U, 16U);
+    check(produced == expected && memcmp(output, reference, produced * sizeof(uint16_t)) == 0,
+          "order 5, factor 16: random full range input matches the 64 bit reference");
+}
+
+int main(void)
+{
+    check_init();
+    check_dc();
+    check_blocks();
+    check_interleaved();
+    check_order_5();
+
+    return check_done();
+}
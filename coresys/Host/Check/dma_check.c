@@ -0,0 +1,106 @@
+// dma.h: stream claims against the request mapping table, and a memory to memory transfer through a
+// descriptor with its completion callback
+
+#include "check.h"
+#include <string.h>
+#include "../../Drivers/Include/dma.h"
+
+#define COPY_WORDS (64U)
+
+static uint32_t copy_src[COPY_WORDS];
+static uint32_t copy_dst[COPY_WORDS];
+static volatile uint32_t copy_events = 0;
+static volatile uint32_t copy_callbacks = 0;
+
+static void copy_done(void *context, uint32_t events)
+{
+    *(volatile uint32_t *)context = 1U;
+    copy_events |= events;
+    copy_callbacks++;
+}
+
+static void check_claims(void)
+{
+    // ADC1 is served by DMA2 stream 0 or 4, SPI1_RX by stream 2 or 0, in that order of preference
+    dma_stream_t adc = dma_claim(DMA_REQ_ADC1, NULL, NULL);
+    check(dma_claimed() == CHECK_STREAM_BIT(2U, 0U), "adc1 takes its first stream, DMA2 stream 0");
+
+    dma_stream_t spi = dma_claim(DMA_REQ_SPI1_RX, NULL, NULL);
+    dma_stream_t spi_second = dma_claim(DMA_REQ_SPI1_RX, NULL, NULL);
+    check(spi != DMA_STREAM_NONE && spi_second == DMA_STREAM_NONE &&
+              dma_claimed() == (CHECK_STREAM_BIT(2U, 0U) | CHECK_STREAM_BIT(2U, 2U)),
+          "a second spi1 rx claim is refused, streams 2 and 0 held");
+
+    dma_release(adc);
+    spi_second = dma_claim(DMA_REQ_SPI1_RX, NULL, NULL);
+    check(spi_second == adc, "the stream adc1 released goes to spi1 rx");
+
+    adc = dma_claim(DMA_REQ_ADC1, NULL, NULL);
+    check(dma_claimed() == (CHECK_STREAM_BIT(2U, 0U) | CHECK_STREAM_BIT(2U, 2U) | CHECK_STREAM_BIT(2U, 4U)),
+          "adc1 falls back to DMA2 stream 4");
+
+    // TIM2_UP only has DMA1 stream 1 and 7
+    dma_stream_t tim = dma_claim(DMA_REQ_TIM2_UP, NULL, NULL);
+    check(tim != DMA_STREAM_NONE && (dma_claimed() & CHECK_STREAM_BIT(1U, 1U)), "tim2 up takes DMA1 stream 1");
+
+    dma_release(adc);
+    dma_release(spi);
+    dma_release(spi_second);
+    dma_release(tim);
+    check(dma_claimed() == 0U, "every stream is free again after the releases");
+}
+
+static void check_memory_transfer(void)
+{
+    for (uint32_t i = 0; i < COPY_WORDS; i++)
+    {
+        copy_src[i] = i * 0x01010101UL + 7U;
+    }
+
+    volatile uint32_t done = 0;
+    dma_stream_t stream = dma_claim(DMA_REQ_MEMORY, copy_done, (void *)&done);
+    check(stream != DMA_STREAM_NONE && stream >= 8U, "memory claims take a DMA2 stream");
+
+    dma_transfer_t transfer = {
+        .direction = DMA_MEMORY_TO_MEMORY,
+        .peripheral = copy_src,
+        .memory = copy_dst,
+        .count = COPY_WORDS,
+        .peripheral_width = DMA_WIDTH_32,
+        .memory_width = DMA_WIDTH_32,
+        .peripheral_increment = true,
+        .memory_increment = true,
+        .priority = DMA_PRIORITY_LOW,
+        .fifo = DMA_FIFO_FULL,
+        .burst = DMA_BURST_4,
+        .events = DMA_EVENT_COMPLETE | DMA_EVENT_ERROR,
+    };
+
+    transfer.circular = true;
+    check(!dma_configure(stream, &transfer), "a circular memory to memory transfer is refused");
+    transfer.circular = false;
+    transfer.fifo = DMA_FIFO_DIRECT;
+    check(!dma_configure(stream, &transfer), "a memory to memory transfer without the FIFO is refused");
+    transfer.fifo = DMA_FIFO_FULL;
+
+    bool configured = dma_configure(stream, &transfer);
+    dma_enable(stream);
+    while (configured && !done)
+    {
+    }
+    check(configured && copy_callbacks == 1U && copy_events == DMA_EVENT_COMPLETE && !dma_busy(stream) &&
+              memcmp(copy_dst, copy_src, sizeof(copy_src)) == 0,
+          "a memory to memory transfer copies and calls back once with complete");
+
+    dma_release(stream);
+}
+
+int main(void)
+{
+    __enable_irq();
+
+    check_claims();
+    check_memory_transfer();
+
+    return check_done();
+}
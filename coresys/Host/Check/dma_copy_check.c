@@ -0,0 +1,86 @@
+// dma_copy.h: copies and fills at every alignment, sizes around the threshold and past one stream transfer,
+// with the callback run exactly once either way, and the claimed memory stream
+
+#include "check.h"
+#include <string.h>
+#include "../../Drivers/Include/dma_copy.h"
+
+#define BUFFER_BYTES (200000U) // past DMA_MAX_COUNT words, so the copy is chained
+#define FILL_VALUE (0x5AU)
+
+static uint8_t source[BUFFER_BYTES] __attribute__((aligned(16)));
+static uint8_t destination[BUFFER_BYTES] __attribute__((aligned(16)));
+static uint8_t expected[BUFFER_BYTES];
+static volatile uint32_t callbacks = 0;
+static volatile bool callbacks_ok = true;
+
+static void copy_done(void *context, bool ok)
+{
+    (void)context;
+    callbacks_ok = callbacks_ok && ok;
+    callbacks++;
+}
+
+// returns true if the DMA ran the copy
+static bool run(bool fill, size_t source_offset, size_t destination_offset, size_t bytes, bool *correct)
+{
+    memset(destination, 0xEE, sizeof(destination));
+    memcpy(expected, destination, sizeof(expected));
+    if (fill)
+    {
+        memset(expected + destination_offset, FILL_VALUE, bytes);
+    }
+    else
+    {
+        memcpy(expected + destination_offset, source + source_offset, bytes);
+    }
+
+    callbacks = 0;
+    bool on_dma = fill ? dma_memset(destination + destination_offset, FILL_VALUE, bytes, copy_done, NULL)
+                       : dma_memcpy(destination + destination_offset, source + source_offset, bytes, copy_done, NULL);
+    while (callbacks == 0U)
+    {
+    }
+    *correct = *correct && callbacks == 1U && memcmp(destination, expected, sizeof(expected)) == 0;
+    return on_dma;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = {0U, 1U, 5U, 100U, DMA_COPY_THRESHOLD - 1U, DMA_COPY_THRESHOLD,
+                                   DMA_COPY_THRESHOLD + 3U, 4099U, 70001U, BUFFER_BYTES - 8U};
+
+    __enable_irq();
+    check(dma_copy_init() == DMA_COPY_STREAMS && dma_claimed() == CHECK_STREAM_BIT(2U, 1U),
+          "dma_copy_init claims DMA2 stream 1 for copies");
+
+    for (size_t i = 0; i < BUFFER_BYTES; i++)
+    {
+        source[i] = (uint8_t)(i * 7U + 3U);
+    }
+
+    bool copies = true;
+    bool fills = true;
+    bool threshold = true;
+    for (size_t source_offset = 0; source_offset < 5U; source_offset++)
+    {
+        for (size_t destination_offset = 0; destination_offset < 5U; destination_offset++)
+        {
+            for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            {
+                size_t bytes = sizes[i];
+                bool on_dma = run(false, source_offset, destination_offset, bytes, &copies);
+                run(true, 0U, destination_offset, bytes, &fills);
+                // at or above the threshold an aligned copy goes to the stream, below it never does
+                bool aligned = (source_offset % 4U) == 0U && (destination_offset % 4U) == 0U;
+                threshold = threshold && (bytes < DMA_COPY_THRESHOLD ? !on_dma : (on_dma || !aligned));
+            }
+        }
+    }
+    check(copies, "dma_memcpy copies every size at every alignment, with one callback each");
+    check(fills, "dma_memset fills every size at every alignment, with one callback each");
+    check(threshold, "copies below DMA_COPY_THRESHOLD stay on the CPU, aligned ones above it use the DMA");
+    check(callbacks_ok && !dma_copy_busy(), "every callback reported ok and no copy is left running");
+
+    return check_done();
+}
@@ -0,0 +1,81 @@
+// i2c.h: stream claims with I2C1's fallback streams, the transaction queue, and the timeout of a transaction
+// that never moves. The emulator has no I2C model, so a started transaction waits for events that never come:
+// exactly the stuck slave i2c_update() is there for
+
+#include "check.h"
+#include "../../Drivers/Include/i2c.h"
+#include "../../Drivers/Include/dma.h"
+#include "../../Drivers/Include/systick.h"
+
+#define WAIT_MS (1000U)
+
+static uint8_t rx[4];
+static volatile uint32_t callbacks = 0;
+static volatile uint32_t timeouts = 0;
+static volatile uint32_t order_errors = 0;
+static volatile uint32_t first_timeout_ms = 0;
+
+static void transaction_done(void *context, i2c_status_t status)
+{
+    order_errors += ((uintptr_t)context != callbacks) ? 1U : 0U;
+    if (callbacks == 0U)
+    {
+        first_timeout_ms = millis();
+    }
+    callbacks++;
+    timeouts += (status == I2C_TIMEOUT) ? 1U : 0U;
+}
+
+static void check_claims(void)
+{
+    // I2C3 has one stream each way (DMA1 stream 2 RX, 4 TX); with RX held it must fail and keep nothing
+    dma_stream_t held = dma_claim(DMA_REQ_I2C3_RX, NULL, NULL);
+    uint32_t before = dma_claimed();
+    check(!i2c_init(I2C_BUS_3, 100000U) && dma_claimed() == before,
+          "i2c_init fails on a held stream and gives back the one it got");
+    dma_release(held);
+
+    // I2C1 RX falls back from DMA1 stream 0 to 5
+    held = dma_claim(DMA_REQ_I2C1_RX, NULL, NULL);
+    check(i2c_init(I2C_BUS_1, 100000U) &&
+              dma_claimed() == (CHECK_STREAM_BIT(1U, 0U) | CHECK_STREAM_BIT(1U, 5U) | CHECK_STREAM_BIT(1U, 7U)),
+          "i2c_init on I2C1 takes DMA1 stream 5 when 0 is held");
+    dma_release(held);
+}
+
+static void check_queue(void)
+{
+    check(!i2c_read_reg(I2C_BUS_1, 0x50U, 0U, rx, 0U, NULL, NULL), "a read of no bytes is refused");
+    check(!i2c_write_reg(I2C_BUS_1, 0x50U, 0U, NULL, 1U, NULL, NULL), "a write without data is refused");
+
+    // one slot stays empty to tell a full queue from an empty one
+    uint32_t queued = 0;
+    uint32_t start_ms = millis();
+    while (queued < I2C_QUEUE_SIZE &&
+           i2c_read_reg(I2C_BUS_1, 0x50U, 0U, rx, sizeof(rx), transaction_done, (void *)(uintptr_t)queued))
+    {
+        queued++;
+    }
+    check(queued == I2C_QUEUE_SIZE - 1U && i2c_busy(I2C_BUS_1), "the queue takes I2C_QUEUE_SIZE - 1 transactions");
+
+    while (callbacks < queued && millis() - start_ms < WAIT_MS)
+    {
+        i2c_update();
+    }
+    check(callbacks == queued && timeouts == queued && order_errors == 0U,
+          "every stuck transaction ends with I2C_TIMEOUT, in order");
+    check(first_timeout_ms - start_ms >= I2C_TIMEOUT_MS, "not before I2C_TIMEOUT_MS without progress");
+    check(i2c_errors(I2C_BUS_1) == queued && i2c_recoveries(I2C_BUS_1) == queued && !i2c_busy(I2C_BUS_1),
+          "each timeout counts as an error and recovers the bus");
+}
+
+int main(void)
+{
+    systick_init();
+    __enable_irq();
+
+    check_claims();
+    check_queue();
+
+    return check_done();
+}
@@ -0,0 +1,96 @@
+// tim.h: timer claims. The modes here and tim_claim() exclude each other, and the two drivers that run a
+// timer themselves, adc.c (TIM3) and exti_input.c (TIM11), hold theirs against tim.c's modes
+
+#include "check.h"
+#include "../../Drivers/Include/tim.h"
+#include "../../Drivers/Include/adc.h"
+#include "../../Drivers/Include/exti_input.h"
+
+#define TIM_BIT(tim) (1UL << (uint32_t)(tim))
+
+static uint16_t buffer[2U * 4U];
+static const uint8_t channels[] = {16U};
+
+static void scans_done(const uint16_t *half, uint16_t scans, void *context)
+{
+    (void)half;
+    (void)scans;
+    (void)context;
+}
+
+static void check_claims(void)
+{
+    check(tim_pwm_init(TIM_ID_2, 1000U, 100U) == 1000U && tim_claimed() == TIM_BIT(TIM_ID_2),
+          "a pwm marks TIM2 in use");
+    check(!tim_claim(TIM_ID_2), "tim_claim refuses a timer running a mode here");
+
+    tim_stop(TIM_ID_2);
+    check(tim_claimed() == 0U && tim_claim(TIM_ID_2), "after tim_stop the timer can be claimed");
+    check(!tim_claim(TIM_ID_2), "a claimed timer can't be claimed twice");
+
+    // the claimer's own setup must survive every call here
+    TIM2->CR1 = TIM_CR1_CEN;
+    TIM2->ARR = 1234U;
+    bool refused = tim_pwm_init(TIM_ID_2, 1000U, 100U) == 0U && !tim_pwm_start(TIM_ID_2, 1U, false) &&
+                   tim_capture_init(TIM_ID_2, 1U, 1000000U) == 0U &&
+                   tim_one_pulse_init(TIM_ID_2, 1U, 1000000U, 10U, 10U) == 0U;
+    check(refused, "every init and start refuses a claimed timer");
+    tim_stop(TIM_ID_2);
+    tim_burst_stop(TIM_ID_2);
+    check(TIM2->CR1 == TIM_CR1_CEN && TIM2->ARR == 1234U,
+          "tim_stop and tim_burst_stop leave a claimed timer alone");
+
+    tim_release(TIM_ID_2);
+    check(tim_claimed() == 0U && tim_pwm_init(TIM_ID_2, 1000U, 100U) == 1000U,
+          "after tim_release the modes here take the timer again");
+    tim_stop(TIM_ID_2);
+}
+
+static void check_adc(void)
+{
+    adc_config_t config = {
+        .channels = channels,
+        .channel_count = sizeof(channels),
+        .sample_time = ADC_SAMPLE_3,
+        .scan_rate_hz = 1000U,
+        .buffer = buffer,
+        .scans_per_half = 4U,
+        .callback = scans_done,
+        .context = NULL,
+    };
+
+    check(adc_start(&config) && tim_claimed() == TIM_BIT(TIM_ID_3), "adc_start claims TIM3");
+    uint32_t reload = TIM3->ARR;
+    check(tim_pwm_init(TIM_ID_3, 1000U, 100U) == 0U && TIM3->ARR == reload && (TIM3->CR1 & TIM_CR1_CEN),
+          "a pwm on TIM3 is refused while the adc scans, and the trigger keeps running");
+    adc_stop();
+    check(tim_claimed() == 0U, "adc_stop releases TIM3");
+
+    check(tim_pwm_init(TIM_ID_3, 1000U, 100U) != 0U && !adc_start(&config),
+          "adc_start fails while TIM3 runs a pwm");
+    check(tim_claimed() == TIM_BIT(TIM_ID_3) && TIM3->ARR == 99U, "the failed adc_start left the pwm alone");
+    tim_stop(TIM_ID_3);
+    check(adc_start(&config), "adc_start works again once the pwm stopped");
+    adc_stop();
+}
+
+static void check_exti(void)
+{
+    check(exti_input_init(20U) && (tim_claimed() & TIM_BIT(TIM_ID_11)), "exti_input_init claims TIM11");
+    uint32_t reload = TIM11->ARR;
+    check(tim_one_pulse_init(TIM_ID_11, 1U, 1000000U, 10U, 10U) == 0U && TIM11->ARR == reload,
+          "a one pulse on TIM11 is refused and the debounce interval stays");
+    check(exti_input_init(30U) && TIM11->ARR == 29U,
+          "exti_input_init again keeps its claim and sets the interval");
+}
+
+int main(void)
+{
+    __enable_irq();
+
+    check_claims();
+    check_adc();
+    check_exti();
+
+    return check_done();
+}
@@ -0,0 +1,141 @@
+#ifndef B4E07C19_2F6A_4D83_9E51_C8A3D27F0B64
+#define B4E07C19_2F6A_4D83_9E51_C8A3D27F0B64
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <signal.h>
+#include "../../Includes/STM32F401.h"
+#include "../../Includes/core/core_cm4.h"
+
+/*
+
+# Host Peripheral Emulation
+
+The drivers talk to the hardware through the structs in STM32F401.h, i.e. plain loads and stores to fixed
+addresses like USART2->DR at 0x40004404. For a host build (make host, compiled with -DHOST_EMULATION) we keep
+that code exactly as it is and emulate the hardware underneath it:
+
+1. The peripheral region (0x40000000), its bit-band alias (0x42000000) and the private peripheral bus
+(0xE0000000: SysTick, NVIC, SCB) are mmap'ed at their real addresses inside the Linux process. All of them are
+below 4GB, so the uint32_t address arithmetic in the headers still works on a 64-bit host.
+
+2. Registers without side effects (timers, EXTI, PWR, ...) are ordinary memory. Pages holding a modelled
+peripheral (USART2, GPIO, RCC, SysTick/NVIC/SCB and the whole bit-band alias) are mapped PROT_NONE.
+
+3. An access to a protected page raises SIGSEGV. The handler lets the model refresh the register (e.g. the
+current SysTick VAL or the USART SR flags), unprotects the page and sets the x86 trap flag, so the faulting
+instruction executes exactly once and SIGTRAP follows. The SIGTRAP handler re-protects the page and hands the
+result to the model: a write to BSRR updates ODR, a write to DR transmits a byte, a read of DR clears RXNE.
+Whether the access was a write comes from the page fault error code. The model keeps its own view of the
+same memory (a second mapping of one memfd), so it never faults itself.
+
+4. Interrupts are a POSIX signal (HOST_IRQ_SIGNAL) delivered to the main thread, which is exactly the
+asynchronous preemption an interrupt is. The signal handler picks the pending and enabled interrupt with the
+highest priority and calls its handler (USART2_Handler, SysTick_Handler, ...). __disable_irq() blocks the
+signal, __enable_irq() unblocks it, and WFI/WFE block in sigtimedwait() until something is pending, so an idle
+firmware really uses no host CPU. Handlers run to completion; nesting by priority is not modelled.
+
+5. A service thread does the blocking work: it moves bytes between the USART2 model and a file descriptor
+(by default the master side of a pty, so uart_reader can open the slave like a real serial port) and wakes
+the main thread when a byte arrives or the next SysTick is due.
+
+Time is host time: SysTick counts the host CLOCK_MONOTONIC clock at HOST_CORE_CLOCK, and the USART moves
+bytes as fast as the other end takes them, independent of BRR.
+
+Besides the apps' host builds, make check in coresys/Host runs the drivers on their own against known answers
+(Check/check.h).
+
+## What is modelled
+
+- USART2: SR/DR with RXNE, TXE, TC and their interrupts, UE/TE/RE gating. Bytes are never lost; if the
+  firmware doesn't read DR, reception stalls instead of overrunning.
+- GPIOA..E, H: BSRR sets/resets ODR, IDR returns ODR for outputs and host_emu_gpio_set_input() levels for
+  inputs (which float high by default). HOST_EMU_TRACE_GPIO=1 prints every ODR change.
+- RCC: the ready flags follow their enable bits and SWS follows SW, so clock switch polling loops terminate.
+- SPI1 (master only) and the DMA2 streams serving it (channel 3: RX on 0/2, TX on 3/5): a byte written to DR,
+  or a whole DMA transfer once its TX stream is enabled, is exchanged at once with host_emu_spi_attach()'s
+  device, which loops MOSI back to MISO by default. The streams then report transfer complete (LISR/HISR, their
+  interrupts) and switch themselves off.
+- DMA2 memory to memory streams (dma_copy.h): the whole copy happens when the stream is enabled, then it
+  completes like the SPI1 streams. DMA2 streams serving anything else do nothing.
+- SysTick, NVIC (enable, pending, priorities, STIR), SCB ICSR (PENDSTSET/PENDSVSET), AIRCR system reset
+  (terminates the process).
+
+*/
+
+#ifndef HOST_CORE_CLOCK
+#define HOST_CORE_CLOCK (16000000U) // the emulated core runs from the 16MHz HSI, like the real one after reset
+#endif
+
+#define HOST_IRQ_SIGNAL SIGUSR1
+#define HOST_UART_RING_SIZE (4096U) // must be a power of two
+
+typedef struct host_emu_stats_
+{
+    uint64_t register_accesses; // trapped loads and stores
+    uint64_t interrupts;        // handlers dispatched
+    uint64_t sleep_ns;          // time spent blocked in WFI/WFE
+    uint64_t uart_tx_bytes;
+    uint64_t uart_rx_bytes;
+} host_emu_stats_t;
+
+// called once before main(); the weak default opens a pty for USART2 (see host_pty.c)
+void host_emu_board_setup(void);
+
+// the far end of USART2: bytes written to DR go out on fd, bytes read from fd arrive in DR
+// fd must be non-blocking; may be called again to replace the line
+void host_emu_uart_attach(int fd);
+
+// opens a pty in raw mode and attaches its master side; returns the slave path (e.g. /dev/pts/3) or NULL
+const char *host_pty_open(void);
+
+// drives an input pin; takes effect on the next IDR read
+void host_emu_gpio_set_input(uint8_t port, uint8_t pin, bool level);
+uint16_t host_emu_gpio_output(uint8_t port);
+
+// the device on the far end of SPI1: called once per byte with MOSI, returns MISO; NULL loops MOSI back
+// runs on the main thread with interrupts blocked; chip selects are GPIO outputs, see host_emu_gpio_output()
+void host_emu_spi_attach(uint8_t (*device)(uint8_t mosi));
+
+uint64_t host_emu_time_ns(void);
+void host_emu_get_stats(host_emu_stats_t *stats);
+
+// the handler an interrupt dispatches to: the one installed here, else the named <name>_Handler (NULL if
+// there is none). The host side of vectors_set_handler() (vectors.h); NULL goes back to the named handler
+void (*host_emu_get_handler(IRQn_Type irq))(void);
+void host_emu_set_handler(IRQn_Type irq, void (*handler)(void));
+
+/* emulator internals, shared between host_emu.c and host_periph.c */
+
+// model view of a register: always readable and writable, never traps
+#define HOST_REG(addr) (*host_emu_shadow((uint32_t)(uintptr_t)(addr)))
+volatile uint32_t *host_emu_shadow(uint32_t addr);
+
+void host_emu_set_pending(IRQn_Type irq);
+void host_emu_kick(void);
+void host_emu_wake_service(void);
+
+// all callbacks get the absolute register address and run on the main thread with interrupts blocked
+typedef struct host_periph_model_
+{
+    uint32_t base;
+    uint32_t size;
+    void (*reset)(void);
+    uint32_t (*read)(uint32_t reg);             // value presented to the firmware before it reads reg
+    void (*read_done)(uint32_t reg);            // side effects of the read (e.g. DR clears RXNE)
+    void (*write)(uint32_t reg, uint32_t value); // after the firmware wrote value to reg
+    void (*poll)(void);                         // fold in asynchronous input (received bytes, drained TX)
+} host_periph_model_t;
+
+extern const host_periph_model_t host_periph_models[];
+extern const size_t host_periph_model_count;
+
+// USART2 line rings, filled and drained by the service thread
+size_t host_uart_rx_space(void);
+void host_uart_rx_push(const uint8_t *data, size_t len);
+size_t host_uart_tx_peek(const uint8_t **data);
+void host_uart_tx_consume(size_t len);
+void host_uart_get_counts(uint64_t *tx_bytes, uint64_t *rx_bytes);
+
+#endif /* B4E07C19_2F6A_4D83_9E51_C8A3D27F0B64 */
@@ -0,0 +1,1064 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include "../Include/host_emu.h"
+
+#define HOST_PAGE_SIZE (0x1000UL)
+#define HOST_TRAP_FLAG (0x100UL) // EFLAGS.TF: trap after the next instruction
+#define HOST_PF_WRITE (0x2UL)    // page fault error code: the access was a write
+
+#define HOST_PERIPH_SIZE (0x80000UL) // APB1, APB2 and AHB1
+#define HOST_BITBAND_SIZE (HOST_PERIPH_SIZE * 32UL)
+#define HOST_PPB_BASE (0xE0000000UL) // private peripheral bus: DWT, SysTick, NVIC, SCB
+#define HOST_PPB_SIZE (0x10000UL)
+
+#define HOST_NVIC_WORDS (3U) // ISER[0..2] cover every STM32F401 interrupt
+#define HOST_NO_IRQ (-100)
+#define HOST_WAIT_SLICE_NS (100000000L)
+
+// every vector in the STM32F401 table; the handlers are the weak aliases of startup.s
+#define HOST_IRQ_LIST(X)                                                                                     \
+    X(PendSV) X(SysTick) X(WWDG) X(PVD) X(TAMP_STAMP) X(RTC_WKUP) X(FLASH) X(RCC) X(EXTI0) X(EXTI1) X(EXTI2) \
+    X(EXTI3) X(EXTI4) X(DMA1_Stream0) X(DMA1_Stream1) X(DMA1_Stream2) X(DMA1_Stream3) X(DMA1_Stream4)        \
+    X(DMA1_Stream5) X(DMA1_Stream6) X(ADC) X(EXTI9_5) X(TIM1_BRK_TIM9) X(TIM1_UP_TIM10)                       \
+    X(TIM1_TRG_COM_TIM11) X(TIM1_CC) X(TIM2) X(TIM3) X(TIM4) X(I2C1_EV) X(I2C1_ER) X(I2C2_EV) X(I2C2_ER)      \
+    X(SPI1) X(SPI2) X(USART1) X(USART2) X(EXTI15_10) X(RTC_Alarm) X(OTG_FS_WKUP) X(DMA1_Stream7) X(SDIO)      \
+    X(TIM5) X(SPI3) X(DMA2_Stream0) X(DMA2_Stream1) X(DMA2_Stream2) X(DMA2_Stream3) X(DMA2_Stream4)          \
+    X(OTG_FS) X(DMA2_Stream5) X(DMA2_Stream6) X(DMA2_Stream7) X(USART6) X(I2C3_EV) X(I2C3_ER) X(FPU) X(SPI4)
+
+#define HOST_DECLARE_HANDLER(name) extern void name##_Handler(void) __attribute__((weak));
+HOST_IRQ_LIST(HOST_DECLARE_HANDLER)
+
+typedef struct host_vector_
+{
+    IRQn_Type irq;
+    void (*handler)(void);
+    const char *name;
+} host_vector_t;
+
+#define HOST_VECTOR(name) {name##_IRQn, name##_Handler, #name},
+static const host_vector_t host_vectors[] = {HOST_IRQ_LIST(HOST_VECTOR)};
+
+// handlers installed at run time (host_emu_set_handler), indexed by IRQn + 16; NULL means the named one
+#define HOST_VECTOR_SLOTS (16 + SPI4_IRQn + 1)
+static void (*volatile host_installed[HOST_VECTOR_SLOTS])(void);
+
+typedef struct host_region_
+{
+    uint32_t base;
+    uint32_t size;
+    uint8_t *shadow; // second mapping of the same memory; never protected
+    bool *trapped;   // one flag per page
+} host_region_t;
+
+static bool periph_trapped[HOST_PERIPH_SIZE / HOST_PAGE_SIZE];
+static bool ppb_trapped[HOST_PPB_SIZE / HOST_PAGE_SIZE];
+static host_region_t regions[] = {
+    {PERIPH_BASE, HOST_PERIPH_SIZE, NULL, periph_trapped},
+    {HOST_PPB_BASE, HOST_PPB_SIZE, NULL, ppb_trapped},
+};
+
+// the access that is currently being single-stepped
+typedef struct host_access_
+{
+    bool active;
+    bool bitband;
+    bool write;
+    bool irq_was_blocked;
+    uintptr_t page;
+    uintptr_t alias; // bit-band alias word
+    uint32_t reg;
+    uint32_t bit;
+    uint32_t before; // value presented to the instruction
+} host_access_t;
+
+static host_access_t access_state;
+
+static pthread_t main_thread;
+static sigset_t irq_set;
+static int wake_pipe[2] = {-1, -1};
+static _Atomic int uart_fd = -1;
+static _Atomic uint64_t systick_deadline_ns = UINT64_MAX;
+
+// interrupt state; only ever touched by the main thread
+static volatile uint32_t primask = 0;
+static volatile uint32_t isr_depth = 0;
+static volatile bool dispatching = false;
+static volatile bool event_register = false;
+static volatile int active_irq = HOST_NO_IRQ;
+static volatile uint32_t nvic_enabled[HOST_NVIC_WORDS];
+static volatile uint32_t nvic_pending[HOST_NVIC_WORDS];
+static volatile bool systick_pending = false;
+static volatile bool pendsv_pending = false;
+
+static uint64_t systick_base_ns;    // time of the last reload
+static uint32_t systick_reload = 0;  // LOAD as sampled at the last reload
+static uint32_t systick_frozen_val = 0; // VAL while the counter is disabled
+static bool systick_enabled = false;
+static bool systick_countflag = false;
+
+static host_emu_stats_t stats;
+
+// written by Reset_Handler on the target (startup.h); there is none on the host
+uint32_t startup_cycles = 0;
+
+static void host_poll_models(void);
+
+static void host_fatal(const char *message)
+{
+    (void)write(STDERR_FILENO, message, strlen(message));
+    abort();
+}
+
+uint64_t host_emu_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static host_region_t *host_find_region(uintptr_t addr)
+{
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++)
+    {
+        if (addr >= regions[i].base && addr < (uintptr_t)regions[i].base + regions[i].size)
+        {
+            return &regions[i];
+        }
+    }
+    return NULL;
+}
+
+volatile uint32_t *host_emu_shadow(uint32_t addr)
+{
+    host_region_t *region = host_find_region(addr);
+    if (!region)
+    {
+        host_fatal("host_emu: model access outside the emulated regions\n");
+    }
+    return (volatile uint32_t *)(region->shadow + ((addr & ~3U) - region->base));
+}
+
+static volatile uint8_t *host_shadow8(uint32_t addr)
+{
+    host_region_t *region = host_find_region(addr);
+    return region->shadow + (addr - region->base);
+}
+
+void host_emu_wake_service(void)
+{
+    const uint8_t wake = 1;
+    (void)write(wake_pipe[1], &wake, 1);
+}
+
+void host_emu_kick(void)
+{
+    // the dispatch loop re-checks everything anyway, no need to queue another signal from inside it
+    if (!dispatching)
+    {
+        pthread_kill(main_thread, HOST_IRQ_SIGNAL);
+    }
+}
+
+void host_emu_set_pending(IRQn_Type irq)
+{
+    if (irq == SysTick_IRQn)
+    {
+        systick_pending = true;
+    }
+    else if (irq == PendSV_IRQn)
+    {
+        pendsv_pending = true;
+    }
+    else if (irq >= 0 && (uint32_t)irq < HOST_NVIC_WORDS * 32U)
+    {
+        nvic_pending[(uint32_t)irq >> 5] |= (1UL << ((uint32_t)irq & 0x1FU));
+    }
+    host_emu_kick();
+}
+
+/* SysTick: counts host time at HOST_CORE_CLOCK (or HOST_CORE_CLOCK / 8 with CLKSOURCE = 0)
+
+   Like the real counter, LOAD is only sampled when the counter reloads (on a wrap, or on the first clock after
+   VAL was cleared), and VAL holds still while the counter is disabled. systick_suppress_ticks() relies on both. */
+
+static uint64_t systick_clock(void)
+{
+    return (HOST_REG(&SysTick->CTRL) & SysTick_CTRL_CLKSOURCE_Msk) ? HOST_CORE_CLOCK : (HOST_CORE_CLOCK / 8U);
+}
+
+static uint64_t systick_cycles_to_ns(uint64_t cycles)
+{
+    return (cycles * 1000000000ULL) / systick_clock();
+}
+
+static bool systick_running(void)
+{
+    return systick_enabled && systick_reload != 0U;
+}
+
+static void systick_latch_reload(uint64_t now)
+{
+    systick_base_ns = now;
+    systick_reload = HOST_REG(&SysTick->LOAD) & SysTick_LOAD_RELOAD_Msk;
+}
+
+static void systick_publish_deadline(uint64_t deadline)
+{
+    if (atomic_exchange(&systick_deadline_ns, deadline) != deadline)
+    {
+        host_emu_wake_service();
+    }
+}
+
+static void systick_poll(void)
+{
+    if (!systick_running())
+    {
+        systick_publish_deadline(UINT64_MAX);
+        return;
+    }
+
+    uint64_t now = host_emu_time_ns();
+    uint64_t period = systick_cycles_to_ns((uint64_t)systick_reload + 1U);
+    if (now - systick_base_ns >= period)
+    {
+        // the wrap picks up the current LOAD; several missed wraps collapse into one pending SysTick
+        systick_latch_reload(systick_base_ns + period);
+        period = systick_cycles_to_ns((uint64_t)systick_reload + 1U);
+        if (period && now - systick_base_ns >= period)
+        {
+            systick_base_ns += ((now - systick_base_ns) / period) * period;
+        }
+
+        systick_countflag = true;
+        if (HOST_REG(&SysTick->CTRL) & SysTick_CTRL_TICKINT_Msk)
+        {
+            host_emu_set_pending(SysTick_IRQn);
+        }
+    }
+    systick_publish_deadline(systick_running() ? systick_base_ns + period : UINT64_MAX);
+}
+
+static uint32_t systick_current_value(void)
+{
+    if (!systick_running())
+    {
+        return systick_frozen_val;
+    }
+    uint64_t cycles = ((host_emu_time_ns() - systick_base_ns) * systick_clock()) / 1000000000ULL;
+    return systick_reload - (uint32_t)(cycles % ((uint64_t)systick_reload + 1U));
+}
+
+static uint32_t systick_read(uint32_t reg)
+{
+    systick_poll();
+    if (reg == (uint32_t)(uintptr_t)&SysTick->CTRL)
+    {
+        return (HOST_REG(reg) & ~SysTick_CTRL_COUNTFLAG_Msk) | (systick_countflag ? SysTick_CTRL_COUNTFLAG_Msk : 0U);
+    }
+    if (reg == (uint32_t)(uintptr_t)&SysTick->VAL)
+    {
+        return systick_current_value();
+    }
+    return HOST_REG(reg);
+}
+
+static void systick_read_done(uint32_t reg)
+{
+    if (reg == (uint32_t)(uintptr_t)&SysTick->CTRL)
+    {
+        systick_countflag = false;
+    }
+}
+
+static void systick_write(uint32_t reg, uint32_t value)
+{
+    uint64_t now = host_emu_time_ns();
+
+    if (reg == (uint32_t)(uintptr_t)&SysTick->CTRL)
+    {
+        bool enable = (value & SysTick_CTRL_ENABLE_Msk) != 0U;
+        if (enable && !systick_enabled)
+        {
+            if (systick_frozen_val == 0U)
+            {
+                systick_latch_reload(now); // a cleared counter reloads on the first clock
+            }
+            else
+            {
+                // carry on from where the counter stopped
+                systick_base_ns = now - systick_cycles_to_ns((uint64_t)(systick_reload - systick_frozen_val));
+            }
+        }
+        else if (!enable && systick_enabled)
+        {
+            systick_poll();
+            systick_frozen_val = systick_current_value();
+        }
+        systick_enabled = enable;
+    }
+    else if (reg == (uint32_t)(uintptr_t)&SysTick->VAL)
+    {
+        // any write clears the counter and COUNTFLAG
+        systick_frozen_val = 0U;
+        systick_countflag = false;
+        if (systick_enabled)
+        {
+            systick_latch_reload(now);
+        }
+        HOST_REG(reg) = 0;
+    }
+    systick_poll();
+}
+
+static void systick_reset(void)
+{
+    HOST_REG(&SysTick->CALIB) = (HOST_CORE_CLOCK / 8U / 100U) - 1U; // TENMS for the external (HCLK / 8) clock
+}
+
+/* NVIC: enable and pending bits live in the model; ISER/ICER and ISPR/ICPR are set/clear views of them */
+
+#define NVIC_REG_INDEX(reg, array) (((reg) - (uint32_t)(uintptr_t)&NVIC->array[0]) / 4U)
+#define NVIC_REG_IN(reg, array) ((reg) >= (uint32_t)(uintptr_t)&NVIC->array[0] && (reg) < (uint32_t)(uintptr_t)&NVIC->array[8])
+
+static uint32_t nvic_read(uint32_t reg)
+{
+    if (NVIC_REG_IN(reg, ISER) || NVIC_REG_IN(reg, ICER))
+    {
+        uint32_t index = NVIC_REG_IN(reg, ISER) ? NVIC_REG_INDEX(reg, ISER) : NVIC_REG_INDEX(reg, ICER);
+        return (index < HOST_NVIC_WORDS) ? nvic_enabled[index] : 0U;
+    }
+    if (NVIC_REG_IN(reg, ISPR) || NVIC_REG_IN(reg, ICPR))
+    {
+        host_poll_models();
+        uint32_t index = NVIC_REG_IN(reg, ISPR) ? NVIC_REG_INDEX(reg, ISPR) : NVIC_REG_INDEX(reg, ICPR);
+        return (index < HOST_NVIC_WORDS) ? nvic_pending[index] : 0U;
+    }
+    if (NVIC_REG_IN(reg, IABR))
+    {
+        uint32_t index = NVIC_REG_INDEX(reg, IABR);
+        return (active_irq >= 0 && (uint32_t)active_irq / 32U == index) ? (1UL << ((uint32_t)active_irq & 0x1FU)) : 0U;
+    }
+    return HOST_REG(reg);
+}
+
+static void nvic_write(uint32_t reg, uint32_t value)
+{
+    if (reg == (uint32_t)(uintptr_t)&NVIC->STIR)
+    {
+        host_emu_set_pending((IRQn_Type)(value & 0x1FFU));
+        return;
+    }
+
+    volatile uint32_t *target = NULL;
+    uint32_t index = 0;
+    bool set = false;
+    if (NVIC_REG_IN(reg, ISER) || NVIC_REG_IN(reg, ICER))
+    {
+        set = NVIC_REG_IN(reg, ISER);
+        index = set ? NVIC_REG_INDEX(reg, ISER) : NVIC_REG_INDEX(reg, ICER);
+        target = nvic_enabled;
+    }
+    else if (NVIC_REG_IN(reg, ISPR) || NVIC_REG_IN(reg, ICPR))
+    {
+        set = NVIC_REG_IN(reg, ISPR);
+        index = set ? NVIC_REG_INDEX(reg, ISPR) : NVIC_REG_INDEX(reg, ICPR);
+        target = nvic_pending;
+    }
+
+    if (target && index < HOST_NVIC_WORDS)
+    {
+        target[index] = set ? (target[index] | value) : (target[index] & ~value);
+        host_emu_kick();
+    }
+}
+
+/* SCB: ICSR pends SysTick / PendSV, AIRCR can reset the system */
+
+static uint32_t scb_read(uint32_t reg)
+{
+    if (reg == (uint32_t)(uintptr_t)&SCB->ICSR)
+    {
+        uint32_t icsr = (active_irq != HOST_NO_IRQ) ? (uint32_t)(active_irq + 16) & SCB_ICSR_VECTACTIVE_Msk : 0U;
+        systick_poll();
+        icsr |= systick_pending ? SCB_ICSR_PENDSTSET_Msk : 0U;
+        icsr |= pendsv_pending ? SCB_ICSR_PENDSVSET_Msk : 0U;
+        return icsr;
+    }
+    if (reg == (uint32_t)(uintptr_t)&SCB->AIRCR)
+    {
+        return (0xFA05UL << SCB_AIRCR_VECTKEY_Pos) | (HOST_REG(reg) & SCB_AIRCR_PRIGROUP_Msk);
+    }
+    return HOST_REG(reg);
+}
+
+static void scb_write(uint32_t reg, uint32_t value)
+{
+    if (reg == (uint32_t)(uintptr_t)&SCB->ICSR)
+    {
+        if (value & SCB_ICSR_PENDSTSET_Msk)
+        {
+            host_emu_set_pending(SysTick_IRQn);
+        }
+        if (value & SCB_ICSR_PENDSTCLR_Msk)
+        {
+            systick_pending = false;
+        }
+        if (value & SCB_ICSR_PENDSVSET_Msk)
+        {
+            host_emu_set_pending(PendSV_IRQn);
+        }
+        if (value & SCB_ICSR_PENDSVCLR_Msk)
+        {
+            pendsv_pending = false;
+        }
+    }
+    else if (reg == (uint32_t)(uintptr_t)&SCB->AIRCR)
+    {
+        if (((value & SCB_AIRCR_VECTKEY_Msk) >> SCB_AIRCR_VECTKEY_Pos) == 0x05FAUL && (value & SCB_AIRCR_SYSRESETREQ_Msk))
+        {
+            static const char message[] = "host_emu: system reset requested\n";
+            (void)write(STDERR_FILENO, message, sizeof(message) - 1U);
+            _exit(0);
+        }
+    }
+}
+
+static void scb_reset(void)
+{
+    HOST_REG(&SCB->CPUID) = 0x410FC241UL; // Cortex-M4 r0p1
+    HOST_REG(&SCB->CCR) = SCB_CCR_STKALIGN_Msk;
+}
+
+// SCB and SysTick sit inside the address range of NVIC_Type, so they have to be matched first
+static const host_periph_model_t host_core_models[] = {
+    {SCB_BASE, sizeof(SCB_Type), scb_reset, scb_read, NULL, scb_write, NULL},
+    {SysTick_BASE, sizeof(SysTick_Type), systick_reset, systick_read, systick_read_done, systick_write, systick_poll},
+    {NVIC_BASE, sizeof(NVIC_Type), NULL, nvic_read, NULL, nvic_write, NULL},
+};
+
+static const host_periph_model_t *host_find_model(uint32_t reg)
+{
+    for (size_t i = 0; i < sizeof(host_core_models) / sizeof(host_core_models[0]); i++)
+    {
+        if (reg >= host_core_models[i].base && reg < host_core_models[i].base + host_core_models[i].size)
+        {
+            return &host_core_models[i];
+        }
+    }
+    for (size_t i = 0; i < host_periph_model_count; i++)
+    {
+        if (reg >= host_periph_models[i].base && reg < host_periph_models[i].base + host_periph_models[i].size)
+        {
+            return &host_periph_models[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t host_model_read(uint32_t reg)
+{
+    const host_periph_model_t *model = host_find_model(reg);
+    return (model && model->read) ? model->read(reg) : HOST_REG(reg);
+}
+
+static void host_model_read_done(uint32_t reg)
+{
+    const host_periph_model_t *model = host_find_model(reg);
+    if (model && model->read_done)
+    {
+        model->read_done(reg);
+    }
+}
+
+static void host_model_write(uint32_t reg, uint32_t value)
+{
+    const host_periph_model_t *model = host_find_model(reg);
+    if (model && model->write)
+    {
+        model->write(reg, value);
+    }
+}
+
+static void host_poll_models(void)
+{
+    systick_poll();
+    for (size_t i = 0; i < host_periph_model_count; i++)
+    {
+        if (host_periph_models[i].poll)
+        {
+            host_periph_models[i].poll();
+        }
+    }
+}
+
+/* interrupt dispatch */
+
+static uint8_t host_priority(int irq)
+{
+    if (irq < 0)
+    {
+        // exception n (SysTick is 15, PendSV 14) takes its priority from SHP[n - 4]
+        return *host_shadow8((uint32_t)(uintptr_t)&SCB->SHP[(((uint32_t)irq) & 0xFU) - 4U]);
+    }
+    return *host_shadow8((uint32_t)(uintptr_t)&NVIC->IP[irq]);
+}
+
+// highest priority pending interrupt; enabled_only = false also reports disabled ones (SEVONPEND)
+static int host_next_irq(bool enabled_only)
+{
+    int best = HOST_NO_IRQ;
+    uint32_t best_priority = UINT32_MAX;
+
+    host_poll_models();
+
+    // lower exception numbers win ties, so scan in exception number order
+    if (pendsv_pending && host_priority(PendSV_IRQn) < best_priority)
+    {
+        best = PendSV_IRQn;
+        best_priority = host_priority(PendSV_IRQn);
+    }
+    if (systick_pending && host_priority(SysTick_IRQn) < best_priority)
+    {
+        best = SysTick_IRQn;
+        best_priority = host_priority(SysTick_IRQn);
+    }
+    for (uint32_t word = 0; word < HOST_NVIC_WORDS; word++)
+    {
+        uint32_t candidates = nvic_pending[word] & (enabled_only ? nvic_enabled[word] : 0xFFFFFFFFUL);
+        while (candidates)
+        {
+            int irq = (int)(word * 32U + (uint32_t)__builtin_ctz(candidates));
+            candidates &= candidates - 1U;
+            if (host_priority(irq) < best_priority)
+            {
+                best = irq;
+                best_priority = host_priority(irq);
+            }
+        }
+    }
+    return best;
+}
+
+static void host_clear_pending(int irq)
+{
+    if (irq == SysTick_IRQn)
+    {
+        systick_pending = false;
+    }
+    else if (irq == PendSV_IRQn)
+    {
+        pendsv_pending = false;
+    }
+    else
+    {
+        nvic_pending[(uint32_t)irq >> 5] &= ~(1UL << ((uint32_t)irq & 0x1FU));
+    }
+}
+
+static void (*host_handler(int irq))(void)
+{
+    if (irq + 16 >= 0 && irq + 16 < HOST_VECTOR_SLOTS && host_installed[irq + 16])
+    {
+        return host_installed[irq + 16];
+    }
+
+    for (size_t i = 0; i < sizeof(host_vectors) / sizeof(host_vectors[0]); i++)
+    {
+        if (host_vectors[i].irq == irq)
+        {
+            return host_vectors[i].handler;
+        }
+    }
+    return NULL;
+}
+
+void (*host_emu_get_handler(IRQn_Type irq))(void)
+{
+    return host_handler(irq);
+}
+
+void host_emu_set_handler(IRQn_Type irq, void (*handler)(void))
+{
+    if ((int)irq + 16 < 0 || (int)irq + 16 >= HOST_VECTOR_SLOTS)
+    {
+        host_fatal("host_emu: host_emu_set_handler() with an unknown IRQn\n");
+    }
+    host_installed[(int)irq + 16] = handler;
+}
+
+static void host_dispatch(void)
+{
+    int irq;
+    dispatching = true;
+    while ((irq = host_next_irq(true)) != HOST_NO_IRQ)
+    {
+        void (*handler)(void) = host_handler(irq);
+        if (!handler)
+        {
+            // the real Default_Handler spins forever; stop instead
+            char message[64];
+            int length = snprintf(message, sizeof(message), "host_emu: unhandled interrupt %d\n", irq);
+            (void)write(STDERR_FILENO, message, (size_t)length);
+            abort();
+        }
+
+        host_clear_pending(irq);
+        active_irq = irq;
+        isr_depth++;
+        stats.interrupts++;
+        dispatching = false;
+        handler();
+        dispatching = true;
+        isr_depth--;
+        active_irq = HOST_NO_IRQ;
+    }
+    dispatching = false;
+}
+
+static void host_on_irq_signal(int sig, siginfo_t *info, void *context)
+{
+    (void)sig;
+    (void)info;
+    (void)context;
+    int saved_errno = errno;
+    host_dispatch();
+    errno = saved_errno;
+}
+
+/* PRIMASK, WFI and WFE (see cmsis_host.h) */
+
+void host_emu_disable_irq(void)
+{
+    primask = 1U;
+    if (isr_depth == 0U)
+    {
+        pthread_sigmask(SIG_BLOCK, &irq_set, NULL);
+    }
+}
+
+void host_emu_enable_irq(void)
+{
+    primask = 0U;
+    if (isr_depth == 0U)
+    {
+        pthread_sigmask(SIG_UNBLOCK, &irq_set, NULL);
+    }
+}
+
+uint32_t host_emu_get_primask(void)
+{
+    return primask;
+}
+
+void host_emu_set_primask(uint32_t value)
+{
+    if (value & 1U)
+    {
+        host_emu_disable_irq();
+    }
+    else
+    {
+        host_emu_enable_irq();
+    }
+}
+
+uint32_t host_emu_get_ipsr(void)
+{
+    return (active_irq != HOST_NO_IRQ) ? (uint32_t)(active_irq + 16) : 0U;
+}
+
+static bool host_wakeup_pending(bool wfe)
+{
+    if (host_next_irq(true) != HOST_NO_IRQ)
+    {
+        return true;
+    }
+    // with SEVONPEND even a disabled interrupt becoming pending is a wake-up event
+    return wfe && (HOST_REG(&SCB->SCR) & SCB_SCR_SEVONPEND_Msk) && host_next_irq(false) != HOST_NO_IRQ;
+}
+
+static void host_wait(bool wfe)
+{
+    if (isr_depth != 0U)
+    {
+        return; // sleep-on-exit is not modelled
+    }
+    if (wfe && event_register)
+    {
+        event_register = false;
+        return;
+    }
+
+    uint64_t start = host_emu_time_ns();
+    pthread_sigmask(SIG_BLOCK, &irq_set, NULL);
+    while (!host_wakeup_pending(wfe))
+    {
+        struct timespec slice = {0, HOST_WAIT_SLICE_NS};
+        (void)sigtimedwait(&irq_set, NULL, &slice);
+    }
+    event_register = false;
+    stats.sleep_ns += host_emu_time_ns() - start;
+
+    if (primask == 0U)
+    {
+        // take the interrupt right away, as the core would when it wakes up unmasked
+        pthread_kill(main_thread, HOST_IRQ_SIGNAL);
+        pthread_sigmask(SIG_UNBLOCK, &irq_set, NULL);
+    }
+    else
+    {
+        // stays pending until __enable_irq()
+        pthread_kill(main_thread, HOST_IRQ_SIGNAL);
+    }
+}
+
+void host_emu_wfi(void)
+{
+    host_wait(false);
+}
+
+void host_emu_wfe(void)
+{
+    host_wait(true);
+}
+
+void host_emu_sev(void)
+{
+    event_register = true;
+}
+
+/* register access traps */
+
+static bool host_is_bitband(uintptr_t addr)
+{
+    return addr >= PERIPH_BB_BASE && addr < PERIPH_BB_BASE + HOST_BITBAND_SIZE;
+}
+
+static void host_on_segv(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    host_region_t *region = host_find_region(addr);
+    bool bitband = host_is_bitband(addr);
+
+    if (access_state.active || (!bitband && (!region || !region->trapped[(addr - region->base) / HOST_PAGE_SIZE])))
+    {
+        // a genuine crash: let it happen with the default action
+        char message[80];
+        int length = snprintf(message, sizeof(message), "host_emu: invalid access to 0x%08lx\n", (unsigned long)addr);
+        (void)write(STDERR_FILENO, message, (size_t)length);
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    int saved_errno = errno;
+    access_state.active = true;
+    access_state.bitband = bitband;
+    access_state.write = (uc->uc_mcontext.gregs[REG_ERR] & HOST_PF_WRITE) != 0;
+    access_state.page = addr & ~(HOST_PAGE_SIZE - 1U);
+    stats.register_accesses++;
+
+    if (bitband)
+    {
+        // alias = PERIPH_BB_BASE + byte_offset * 32 + bit * 4
+        uint32_t byte_offset = (uint32_t)(addr - PERIPH_BB_BASE) >> 5;
+        access_state.alias = addr & ~(uintptr_t)3U;
+        access_state.reg = PERIPH_BASE + (byte_offset & ~3U);
+        access_state.bit = (byte_offset & 3U) * 8U + (((uint32_t)(addr - PERIPH_BB_BASE) >> 2) & 7U);
+        access_state.before = (host_model_read(access_state.reg) >> access_state.bit) & 1U;
+        mprotect((void *)access_state.page, HOST_PAGE_SIZE, PROT_READ | PROT_WRITE);
+        *(volatile uint32_t *)access_state.alias = access_state.before;
+    }
+    else
+    {
+        access_state.reg = (uint32_t)addr & ~3U;
+        access_state.before = host_model_read(access_state.reg);
+        HOST_REG(access_state.reg) = access_state.before;
+        mprotect((void *)access_state.page, HOST_PAGE_SIZE, PROT_READ | PROT_WRITE);
+    }
+
+    // execute just the faulting instruction, with the interrupt signal held off until it has been modelled
+    access_state.irq_was_blocked = sigismember(&uc->uc_sigmask, HOST_IRQ_SIGNAL);
+    sigaddset(&uc->uc_sigmask, HOST_IRQ_SIGNAL);
+    uc->uc_mcontext.gregs[REG_EFL] |= HOST_TRAP_FLAG;
+    errno = saved_errno;
+}
+
+static void host_on_trap(int sig, siginfo_t *info, void *context)
+{
+    (void)sig;
+    (void)info;
+    ucontext_t *uc = (ucontext_t *)context;
+    if (!access_state.active)
+    {
+        return;
+    }
+
+    int saved_errno = errno;
+    uc->uc_mcontext.gregs[REG_EFL] &= ~HOST_TRAP_FLAG;
+
+    if (access_state.bitband)
+    {
+        uint32_t after = *(volatile uint32_t *)access_state.alias & 1U;
+        mprotect((void *)access_state.page, HOST_PAGE_SIZE, PROT_NONE);
+        if (access_state.write || after != access_state.before)
+        {
+            // the bus does a read-modify-write of the whole register
+            uint32_t value = host_model_read(access_state.reg);
+            value = after ? (value | (1UL << access_state.bit)) : (value & ~(1UL << access_state.bit));
+            HOST_REG(access_state.reg) = value;
+            host_model_write(access_state.reg, value);
+        }
+        else
+        {
+            host_model_read_done(access_state.reg);
+        }
+    }
+    else
+    {
+        uint32_t after = HOST_REG(access_state.reg);
+        mprotect((void *)access_state.page, HOST_PAGE_SIZE, PROT_NONE);
+        if (access_state.write || after != access_state.before)
+        {
+            host_model_write(access_state.reg, after);
+        }
+        else
+        {
+            host_model_read_done(access_state.reg);
+        }
+    }
+
+    if (!access_state.irq_was_blocked)
+    {
+        sigdelset(&uc->uc_sigmask, HOST_IRQ_SIGNAL);
+    }
+    access_state.active = false;
+    errno = saved_errno;
+}
+
+/* service thread: the USART line and the SysTick deadline */
+
+void host_emu_uart_attach(int fd)
+{
+    atomic_store(&uart_fd, fd);
+    host_emu_wake_service();
+}
+
+static void *host_service(void *arg)
+{
+    (void)arg;
+    uint8_t buffer[512];
+    uint64_t kicked_deadline = UINT64_MAX;
+
+    for (;;)
+    {
+        int fd = atomic_load(&uart_fd);
+        const uint8_t *tx_data = NULL;
+        struct pollfd fds[2] = {
+            {wake_pipe[0], POLLIN, 0},
+            {fd, (short)((host_uart_rx_space() ? POLLIN : 0) | (host_uart_tx_peek(&tx_data) ? POLLOUT : 0)), 0},
+        };
+
+        // sleep until the next SysTick is due, unless the main thread has already been told about it
+        uint64_t deadline = atomic_load(&systick_deadline_ns);
+        struct timespec timeout = {0, 0};
+        struct timespec *timeout_ptr = NULL;
+        if (deadline != UINT64_MAX && deadline != kicked_deadline)
+        {
+            uint64_t now = host_emu_time_ns();
+            uint64_t remaining = (deadline > now) ? deadline - now : 0U;
+            timeout.tv_sec = (time_t)(remaining / 1000000000ULL);
+            timeout.tv_nsec = (long)(remaining % 1000000000ULL);
+            timeout_ptr = &timeout;
+        }
+
+        if (ppoll(fds, (fd >= 0) ? 2U : 1U, timeout_ptr, NULL) < 0 && errno != EINTR)
+        {
+            host_fatal("host_emu: service poll failed\n");
+        }
+
+        bool kick = false;
+        if (fds[0].revents & POLLIN)
+        {
+            while (read(wake_pipe[0], buffer, sizeof(buffer)) > 0)
+            {
+            }
+        }
+
+        if (fd >= 0 && (fds[1].revents & POLLIN))
+        {
+            size_t space = host_uart_rx_space();
+            ssize_t received = read(fd, buffer, (space < sizeof(buffer)) ? space : sizeof(buffer));
+            if (received > 0)
+            {
+                host_uart_rx_push(buffer, (size_t)received);
+                kick = true;
+            }
+        }
+
+        if (fd >= 0 && (fds[1].revents & POLLOUT))
+        {
+            size_t pending = host_uart_tx_peek(&tx_data);
+            ssize_t sent = pending ? write(fd, tx_data, pending) : 0;
+            if (sent > 0)
+            {
+                host_uart_tx_consume((size_t)sent);
+                kick = true;
+            }
+        }
+
+        if (fd >= 0 && (fds[1].revents & (POLLHUP | POLLERR | POLLNVAL)) && !(fds[1].revents & POLLIN))
+        {
+            // the other end went away; the line goes quiet, like an unplugged cable
+            atomic_compare_exchange_strong(&uart_fd, &fd, -1);
+        }
+
+        deadline = atomic_load(&systick_deadline_ns);
+        if (deadline != UINT64_MAX && deadline != kicked_deadline && host_emu_time_ns() >= deadline)
+        {
+            kicked_deadline = deadline;
+            kick = true;
+        }
+
+        if (kick)
+        {
+            pthread_kill(main_thread, HOST_IRQ_SIGNAL);
+        }
+    }
+    return NULL;
+}
+
+__attribute__((weak)) void host_emu_board_setup(void)
+{
+    const char *path = host_pty_open();
+    if (path)
+    {
+        fprintf(stderr, "host_emu: USART2 is on %s\n", path);
+    }
+}
+
+void host_emu_get_stats(host_emu_stats_t *out)
+{
+    *out = stats;
+    host_uart_get_counts(&out->uart_tx_bytes, &out->uart_rx_bytes);
+}
+
+static uint8_t *host_map_region(host_region_t *region)
+{
+    int fd = memfd_create("stm32f401", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, region->size) < 0)
+    {
+        host_fatal("host_emu: memfd_create failed\n");
+    }
+
+    uint8_t *shadow = mmap(NULL, region->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    void *device = mmap((void *)(uintptr_t)region->base, region->size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (shadow == MAP_FAILED || device != (void *)(uintptr_t)region->base)
+    {
+        host_fatal("host_emu: can't map the peripheral region at its real address\n");
+    }
+    close(fd);
+
+    for (uint32_t page = 0; page < region->size / HOST_PAGE_SIZE; page++)
+    {
+        if (region->trapped[page])
+        {
+            mprotect((uint8_t *)device + page * HOST_PAGE_SIZE, HOST_PAGE_SIZE, PROT_NONE);
+        }
+    }
+    return shadow;
+}
+
+static void host_trap_model_pages(const host_periph_model_t *model)
+{
+    host_region_t *region = host_find_region(model->base);
+    for (uint32_t addr = model->base & ~(uint32_t)(HOST_PAGE_SIZE - 1U); addr < model->base + model->size; addr += HOST_PAGE_SIZE)
+    {
+        region->trapped[(addr - region->base) / HOST_PAGE_SIZE] = true;
+    }
+}
+
+static void host_install(int sig, void (*handler)(int, siginfo_t *, void *), int flags)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handler;
+    action.sa_flags = SA_SIGINFO | flags;
+    sigemptyset(&action.sa_mask);
+    sigaction(sig, &action, NULL);
+}
+
+__attribute__((constructor(101))) static void host_emu_start(void)
+{
+    main_thread = pthread_self();
+    sigemptyset(&irq_set);
+    sigaddset(&irq_set, HOST_IRQ_SIGNAL);
+
+    for (size_t i = 0; i < sizeof(host_core_models) / sizeof(host_core_models[0]); i++)
+    {
+        host_trap_model_pages(&host_core_models[i]);
+    }
+    for (size_t i = 0; i < host_periph_model_count; i++)
+    {
+        host_trap_model_pages(&host_periph_models[i]);
+    }
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++)
+    {
+        regions[i].shadow = host_map_region(&regions[i]);
+    }
+    if (mmap((void *)PERIPH_BB_BASE, HOST_BITBAND_SIZE, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0) != (void *)PERIPH_BB_BASE)
+    {
+        host_fatal("host_emu: can't map the bit-band alias region\n");
+    }
+
+    for (size_t i = 0; i < sizeof(host_core_models) / sizeof(host_core_models[0]); i++)
+    {
+        if (host_core_models[i].reset)
+        {
+            host_core_models[i].reset();
+        }
+    }
+    for (size_t i = 0; i < host_periph_model_count; i++)
+    {
+        if (host_periph_models[i].reset)
+        {
+            host_periph_models[i].reset();
+        }
+    }
+
+    host_install(SIGSEGV, host_on_segv, 0);
+    host_install(SIGTRAP, host_on_trap, 0);
+    host_install(HOST_IRQ_SIGNAL, host_on_irq_signal, SA_RESTART);
+
+    if (pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        host_fatal("host_emu: pipe2 failed\n");
+    }
+
+    host_emu_board_setup();
+
+    // the service thread must never take the interrupt signal itself
+    pthread_t service;
+    sigset_t previous;
+    pthread_sigmask(SIG_BLOCK, &irq_set, &previous);
+    if (pthread_create(&service, NULL, host_service, NULL) != 0)
+    {
+        host_fatal("host_emu: can't start the service thread\n");
+    }
+    pthread_detach(service);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
@@ -0,0 +1,532 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "../Include/host_emu.h"
+
+#define HOST_UART_RING_MASK (HOST_UART_RING_SIZE - 1U)
+#define HOST_GPIO_PORTS (8U)
+#define HOST_GPIO_STRIDE (0x400U)
+
+#define USART2_REG(member) ((uint32_t)(USART2_BASE + offsetof(USART_TypeDef, member)))
+#define GPIO_REG(port, member) ((uint32_t)(GPIOA_BASE + (port) * HOST_GPIO_STRIDE + offsetof(GPIO_TypeDef, member)))
+#define RCC_REG(member) ((uint32_t)(RCC_BASE + offsetof(RCC_TypeDef, member)))
+#define SPI1_REG(member) ((uint32_t)(SPI1_BASE + offsetof(SPI_TypeDef, member)))
+#define DMA2_REG(member) ((uint32_t)(DMA2_BASE + offsetof(DMA_TypeDef, member)))
+#define DMA2_STREAM_REG(n, member) \
+    ((uint32_t)(DMA2_Stream0_BASE + (n) * sizeof(DMA_Stream_TypeDef) + offsetof(DMA_Stream_TypeDef, member)))
+
+#define HOST_DMA_STREAMS (8U)
+#define HOST_DMA_SPI1_CHANNEL (3U)
+
+/* USART2 */
+
+// single producer / single consumer; the service thread owns rx_head and tx_tail, the main thread the other two
+static uint8_t rx_ring[HOST_UART_RING_SIZE];
+static _Atomic size_t rx_head = 0;
+static _Atomic size_t rx_tail = 0;
+static uint8_t tx_ring[HOST_UART_RING_SIZE];
+static _Atomic size_t tx_head = 0;
+static _Atomic size_t tx_tail = 0;
+static _Atomic uint64_t rx_count = 0;
+static _Atomic uint64_t tx_count = 0;
+
+static uint32_t usart_sr;
+static uint8_t usart_rx_data;
+static bool usart_tx_busy; // a byte went out since TC was last set
+
+size_t host_uart_rx_space(void)
+{
+    return HOST_UART_RING_SIZE - 1U - ((atomic_load(&rx_head) - atomic_load(&rx_tail)) & HOST_UART_RING_MASK);
+}
+
+void host_uart_rx_push(const uint8_t *data, size_t len)
+{
+    size_t head = atomic_load(&rx_head);
+    for (size_t i = 0; i < len; i++)
+    {
+        rx_ring[head] = data[i];
+        head = (head + 1U) & HOST_UART_RING_MASK;
+    }
+    atomic_store(&rx_head, head);
+    atomic_fetch_add(&rx_count, len);
+}
+
+size_t host_uart_tx_peek(const uint8_t **data)
+{
+    size_t head = atomic_load(&tx_head);
+    size_t tail = atomic_load(&tx_tail);
+    *data = &tx_ring[tail];
+    // contiguous part only; the rest follows on the next call
+    return (head >= tail) ? head - tail : HOST_UART_RING_SIZE - tail;
+}
+
+void host_uart_tx_consume(size_t len)
+{
+    atomic_store(&tx_tail, (atomic_load(&tx_tail) + len) & HOST_UART_RING_MASK);
+    atomic_fetch_add(&tx_count, len);
+}
+
+void host_uart_get_counts(uint64_t *tx_bytes, uint64_t *rx_bytes)
+{
+    *tx_bytes = atomic_load(&tx_count);
+    *rx_bytes = atomic_load(&rx_count);
+}
+
+static size_t usart_tx_queued(void)
+{
+    return (atomic_load(&tx_head) - atomic_load(&tx_tail)) & HOST_UART_RING_MASK;
+}
+
+static void usart_update_irq(void)
+{
+    uint32_t cr1 = HOST_REG(USART2_REG(CR1));
+    if (!(cr1 & USART_CR1_UE))
+    {
+        return;
+    }
+
+    if (((cr1 & USART_CR1_RXNEIE) && (usart_sr & (USART_SR_RXNE | USART_SR_ORE))) ||
+        ((cr1 & USART_CR1_TXEIE) && (usart_sr & USART_SR_TXE)) ||
+        ((cr1 & USART_CR1_TCIE) && (usart_sr & USART_SR_TC)) ||
+        ((cr1 & USART_CR1_IDLEIE) && (usart_sr & USART_SR_IDLE)))
+    {
+        host_emu_set_pending(USART2_IRQn);
+    }
+}
+
+static void usart_poll(void)
+{
+    uint32_t cr1 = HOST_REG(USART2_REG(CR1));
+
+    // the next received byte moves into DR once the firmware has read the previous one
+    size_t tail = atomic_load(&rx_tail);
+    if ((cr1 & USART_CR1_UE) && (cr1 & USART_CR1_RE) && !(usart_sr & USART_SR_RXNE) && tail != atomic_load(&rx_head))
+    {
+        bool was_full = (host_uart_rx_space() == 0U);
+        usart_rx_data = rx_ring[tail];
+        atomic_store(&rx_tail, (tail + 1U) & HOST_UART_RING_MASK);
+        usart_sr |= USART_SR_RXNE;
+        if (was_full)
+        {
+            host_emu_wake_service();
+        }
+    }
+
+    // TXE: room for another byte on the line; TC: everything handed to the line has left
+    size_t queued = usart_tx_queued();
+    usart_sr = (queued < HOST_UART_RING_SIZE - 1U) ? (usart_sr | USART_SR_TXE) : (usart_sr & ~USART_SR_TXE);
+    if (usart_tx_busy && queued == 0U)
+    {
+        usart_tx_busy = false;
+        usart_sr |= USART_SR_TC;
+    }
+
+    HOST_REG(USART2_REG(SR)) = usart_sr;
+    usart_update_irq();
+}
+
+static uint32_t usart_read(uint32_t reg)
+{
+    usart_poll();
+    if (reg == USART2_REG(SR))
+    {
+        return usart_sr;
+    }
+    if (reg == USART2_REG(DR))
+    {
+        return usart_rx_data;
+    }
+    return HOST_REG(reg);
+}
+
+static void usart_read_done(uint32_t reg)
+{
+    if (reg == USART2_REG(DR))
+    {
+        // reading DR clears RXNE (and, after an SR read, the error flags)
+        usart_sr &= ~(USART_SR_RXNE | USART_SR_ORE | USART_SR_IDLE);
+        usart_poll();
+    }
+}
+
+static void usart_write(uint32_t reg, uint32_t value)
+{
+    uint32_t cr1 = HOST_REG(USART2_REG(CR1));
+
+    if (reg == USART2_REG(SR))
+    {
+        // rc_w0: writing 0 clears, writing 1 leaves the flag as it is
+        const uint32_t clearable = USART_SR_RXNE | USART_SR_TC | USART_SR_LBD | USART_SR_CTS;
+        usart_sr &= (value | ~clearable);
+    }
+    else if (reg == USART2_REG(DR) && (cr1 & USART_CR1_UE) && (cr1 & USART_CR1_TE))
+    {
+        size_t head = atomic_load(&tx_head);
+        if (usart_tx_queued() < HOST_UART_RING_SIZE - 1U)
+        {
+            bool was_empty = (usart_tx_queued() == 0U);
+            tx_ring[head] = (uint8_t)value;
+            atomic_store(&tx_head, (head + 1U) & HOST_UART_RING_MASK);
+            usart_tx_busy = true;
+            usart_sr &= ~USART_SR_TC;
+            if (was_empty)
+            {
+                host_emu_wake_service();
+            }
+        }
+    }
+    usart_poll();
+}
+
+static void usart_reset(void)
+{
+    usart_sr = USART_SR_TXE | USART_SR_TC;
+    HOST_REG(USART2_REG(SR)) = usart_sr;
+}
+
+/* GPIO */
+
+static uint16_t gpio_inputs[HOST_GPIO_PORTS] = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+static uint16_t gpio_last_odr[HOST_GPIO_PORTS];
+static bool gpio_trace = false;
+
+static uint32_t gpio_port_of(uint32_t reg)
+{
+    return (reg - GPIOA_BASE) / HOST_GPIO_STRIDE;
+}
+
+static uint16_t gpio_output_mask(uint32_t port)
+{
+    uint32_t moder = HOST_REG(GPIO_REG(port, MODER));
+    uint16_t mask = 0;
+    for (uint32_t pin = 0; pin < 16U; pin++)
+    {
+        if (((moder >> (pin * 2U)) & 0x3U) == 0x1U)
+        {
+            mask |= (uint16_t)(1U << pin);
+        }
+    }
+    return mask;
+}
+
+static void gpio_check_odr(uint32_t port)
+{
+    uint16_t odr = (uint16_t)HOST_REG(GPIO_REG(port, ODR));
+    if (odr != gpio_last_odr[port])
+    {
+        if (gpio_trace)
+        {
+            char message[96];
+            int length = snprintf(message, sizeof(message), "host_emu: %12.3f ms GPIO%c ODR %04x -> %04x\n",
+                                  (double)host_emu_time_ns() / 1e6, 'A' + port, gpio_last_odr[port], odr);
+            (void)write(STDERR_FILENO, message, (size_t)length);
+        }
+        gpio_last_odr[port] = odr;
+    }
+}
+
+static uint32_t gpio_read(uint32_t reg)
+{
+    uint32_t port = gpio_port_of(reg);
+    if (reg == GPIO_REG(port, IDR))
+    {
+        uint16_t outputs = gpio_output_mask(port);
+        return (HOST_REG(GPIO_REG(port, ODR)) & outputs) | (gpio_inputs[port] & (uint16_t)~outputs);
+    }
+    if (reg == GPIO_REG(port, BSRR))
+    {
+        return 0; // write-only
+    }
+    return HOST_REG(reg);
+}
+
+static void gpio_write(uint32_t reg, uint32_t value)
+{
+    uint32_t port = gpio_port_of(reg);
+    if (reg == GPIO_REG(port, BSRR))
+    {
+        // BSx has priority over BRx when both are set
+        uint32_t odr = HOST_REG(GPIO_REG(port, ODR));
+        HOST_REG(GPIO_REG(port, ODR)) = ((odr & ~(value >> 16)) | (value & 0xFFFFU)) & 0xFFFFU;
+        HOST_REG(reg) = 0;
+    }
+    gpio_check_odr(port);
+}
+
+static void gpio_reset(void)
+{
+    const char *trace = getenv("HOST_EMU_TRACE_GPIO");
+    gpio_trace = trace && trace[0] == '1';
+
+    // the debug pins (PA13/14/15, PB3/4) come out of reset in their alternate function
+    HOST_REG(GPIO_REG(0U, MODER)) = 0xA8000000UL;
+    HOST_REG(GPIO_REG(0U, OSPEEDR)) = 0x0C000000UL;
+    HOST_REG(GPIO_REG(0U, PUPDR)) = 0x64000000UL;
+    HOST_REG(GPIO_REG(1U, MODER)) = 0x00000280UL;
+    HOST_REG(GPIO_REG(1U, OSPEEDR)) = 0x000000C0UL;
+    HOST_REG(GPIO_REG(1U, PUPDR)) = 0x00000100UL;
+}
+
+void host_emu_gpio_set_input(uint8_t port, uint8_t pin, bool level)
+{
+    if (port < HOST_GPIO_PORTS && pin < 16U)
+    {
+        gpio_inputs[port] = level ? (uint16_t)(gpio_inputs[port] | (1U << pin)) : (uint16_t)(gpio_inputs[port] & ~(1U << pin));
+    }
+}
+
+uint16_t host_emu_gpio_output(uint8_t port)
+{
+    return (port < HOST_GPIO_PORTS) ? (uint16_t)HOST_REG(GPIO_REG(port, ODR)) : 0U;
+}
+
+/* RCC: oscillators and PLLs are ready as soon as they are switched on, clock switches are immediate */
+
+static void rcc_write(uint32_t reg, uint32_t value)
+{
+    if (reg == RCC_REG(CR))
+    {
+        uint32_t ready = 0;
+        ready |= (value & RCC_CR_HSION) ? RCC_CR_HSIRDY : 0U;
+        ready |= (value & RCC_CR_HSEON) ? RCC_CR_HSERDY : 0U;
+        ready |= (value & RCC_CR_PLLON) ? RCC_CR_PLLRDY : 0U;
+        ready |= (value & RCC_CR_PLLI2SON) ? RCC_CR_PLLI2SRDY : 0U;
+        HOST_REG(reg) = (value & ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY | RCC_CR_PLLI2SRDY)) | ready;
+    }
+    else if (reg == RCC_REG(CFGR))
+    {
+        HOST_REG(reg) = (value & ~RCC_CFGR_SWS) | ((value & RCC_CFGR_SW) << 2);
+    }
+}
+
+static void rcc_reset(void)
+{
+    HOST_REG(RCC_REG(CR)) = 0x00000083UL;
+    HOST_REG(RCC_REG(PLLCFGR)) = 0x24003010UL;
+    HOST_REG(RCC_REG(CSR)) = 0x0E000000UL;
+}
+
+/* SPI1 and DMA2: a transfer runs to completion the moment both its streams are set up (a memory copy the moment
+   its stream is enabled), timing isn't modelled */
+
+static uint8_t (*spi_device)(uint8_t mosi) = NULL; // NULL: MISO wired to MOSI
+static uint32_t spi_sr;
+static uint8_t spi_rx_data;
+
+void host_emu_spi_attach(uint8_t (*device)(uint8_t mosi))
+{
+    spi_device = device;
+}
+
+static uint8_t spi_exchange(uint8_t mosi)
+{
+    return spi_device ? spi_device(mosi) : mosi;
+}
+
+// LISR/HISR: six flag bits per stream at 0, 6, 16 and 22
+static uint32_t dma_flag_shift(uint32_t stream)
+{
+    static const uint8_t shifts[4] = {0U, 6U, 16U, 22U};
+    return shifts[stream & 3U];
+}
+
+static uint32_t dma_isr_reg(uint32_t stream)
+{
+    return (stream < 4U) ? DMA2_REG(LISR) : DMA2_REG(HISR);
+}
+
+static IRQn_Type dma_irqn(uint32_t stream)
+{
+    static const IRQn_Type irqs[HOST_DMA_STREAMS] = {DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn,
+                                                      DMA2_Stream3_IRQn, DMA2_Stream4_IRQn, DMA2_Stream5_IRQn,
+                                                      DMA2_Stream6_IRQn, DMA2_Stream7_IRQn};
+    return irqs[stream];
+}
+
+static void dma_complete(uint32_t stream)
+{
+    uint32_t cr = HOST_REG(DMA2_STREAM_REG(stream, CR));
+    HOST_REG(DMA2_STREAM_REG(stream, CR)) = cr & ~DMA_SxCR_EN;
+    HOST_REG(dma_isr_reg(stream)) |= (DMA_LISR_TCIF0 << dma_flag_shift(stream));
+    if (cr & DMA_SxCR_TCIE)
+    {
+        host_emu_set_pending(dma_irqn(stream));
+    }
+}
+
+// the enabled stream serving an SPI1 request: RX on streams 0 and 2, TX on 3 and 5, all on channel 3
+static int dma_spi1_stream(bool tx)
+{
+    const uint32_t candidates[2] = {tx ? 3U : 0U, tx ? 5U : 2U};
+    for (uint32_t i = 0; i < 2U; i++)
+    {
+        uint32_t cr = HOST_REG(DMA2_STREAM_REG(candidates[i], CR));
+        bool to_peripheral = ((cr & DMA_SxCR_DIR) == DMA_SxCR_DIR_0);
+        if ((cr & DMA_SxCR_EN) && ((cr & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) == HOST_DMA_SPI1_CHANNEL &&
+            to_peripheral == tx && HOST_REG(DMA2_STREAM_REG(candidates[i], PAR)) == SPI1_REG(DR))
+        {
+            return (int)candidates[i];
+        }
+    }
+    return -1;
+}
+
+// buffers are addressed through their 32 bit M0AR, which is only valid for memory below 4GB (static buffers)
+static volatile uint8_t *dma_memory(uint32_t stream, uint32_t index)
+{
+    uint32_t cr = HOST_REG(DMA2_STREAM_REG(stream, CR));
+    uint32_t address = HOST_REG(DMA2_STREAM_REG(stream, M0AR)) + ((cr & DMA_SxCR_MINC) ? index : 0U);
+    return (volatile uint8_t *)(uintptr_t)address;
+}
+
+// memory to memory: PAR is the source, M0AR the destination, both through their 32 bit addresses as above
+static void dma_memory_run(uint32_t stream)
+{
+    uint32_t cr = HOST_REG(DMA2_STREAM_REG(stream, CR));
+    uint32_t width = 1UL << ((cr & DMA_SxCR_PSIZE) >> DMA_SxCR_PSIZE_Pos);
+    uint32_t source = HOST_REG(DMA2_STREAM_REG(stream, PAR));
+    uint32_t length = (HOST_REG(DMA2_STREAM_REG(stream, NDTR)) & 0xFFFFU) * width;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint32_t offset = (cr & DMA_SxCR_PINC) ? i : (i % width);
+        *dma_memory(stream, i) = *(volatile const uint8_t *)(uintptr_t)(source + offset);
+    }
+    HOST_REG(DMA2_STREAM_REG(stream, NDTR)) = 0;
+    dma_complete(stream);
+}
+
+static void spi_receive(uint8_t miso)
+{
+    spi_sr |= (spi_sr & SPI_SR_RXNE) ? SPI_SR_OVR : 0U;
+    spi_rx_data = miso;
+    spi_sr |= SPI_SR_RXNE;
+}
+
+static void spi_dma_run(void)
+{
+    uint32_t cr1 = HOST_REG(SPI1_REG(CR1));
+    uint32_t cr2 = HOST_REG(SPI1_REG(CR2));
+    if (!(cr1 & SPI_CR1_SPE) || !(cr1 & SPI_CR1_MSTR) || !(cr2 & SPI_CR2_TXDMAEN))
+    {
+        return;
+    }
+
+    int tx = dma_spi1_stream(true);
+    int rx = (cr2 & SPI_CR2_RXDMAEN) ? dma_spi1_stream(false) : -1;
+    if (tx < 0)
+    {
+        return;
+    }
+
+    uint32_t length = HOST_REG(DMA2_STREAM_REG(tx, NDTR)) & 0xFFFFU;
+    uint32_t rx_length = (rx >= 0) ? HOST_REG(DMA2_STREAM_REG(rx, NDTR)) & 0xFFFFU : 0U;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint8_t miso = spi_exchange(*dma_memory((uint32_t)tx, i));
+        if (i < rx_length)
+        {
+            *dma_memory((uint32_t)rx, i) = miso;
+            HOST_REG(DMA2_STREAM_REG(rx, NDTR)) = rx_length - i - 1U;
+        }
+        else
+        {
+            spi_receive(miso); // nothing takes it out of DR
+        }
+    }
+
+    HOST_REG(DMA2_STREAM_REG(tx, NDTR)) = 0;
+    dma_complete((uint32_t)tx);
+    if (rx >= 0 && HOST_REG(DMA2_STREAM_REG(rx, NDTR)) == 0U)
+    {
+        dma_complete((uint32_t)rx);
+    }
+    HOST_REG(SPI1_REG(SR)) = spi_sr;
+}
+
+static uint32_t spi_read(uint32_t reg)
+{
+    if (reg == SPI1_REG(SR))
+    {
+        return spi_sr;
+    }
+    if (reg == SPI1_REG(DR))
+    {
+        return spi_rx_data;
+    }
+    return HOST_REG(reg);
+}
+
+static void spi_read_done(uint32_t reg)
+{
+    if (reg == SPI1_REG(DR))
+    {
+        // reading DR clears RXNE, and OVR if SR was read before
+        spi_sr &= ~(SPI_SR_RXNE | SPI_SR_OVR);
+        HOST_REG(SPI1_REG(SR)) = spi_sr;
+    }
+}
+
+static void spi_write(uint32_t reg, uint32_t value)
+{
+    uint32_t cr1 = HOST_REG(SPI1_REG(CR1));
+    if (reg == SPI1_REG(DR) && (cr1 & SPI_CR1_SPE) && (cr1 & SPI_CR1_MSTR))
+    {
+        spi_receive(spi_exchange((uint8_t)value));
+        HOST_REG(SPI1_REG(SR)) = spi_sr;
+    }
+    else if (reg == SPI1_REG(CR1) || reg == SPI1_REG(CR2))
+    {
+        spi_dma_run();
+    }
+}
+
+static void spi_reset(void)
+{
+    spi_sr = SPI_SR_TXE;
+    HOST_REG(SPI1_REG(SR)) = spi_sr;
+}
+
+static uint32_t dma_read(uint32_t reg)
+{
+    if (reg == DMA2_REG(LIFCR) || reg == DMA2_REG(HIFCR))
+    {
+        return 0; // write-only
+    }
+    return HOST_REG(reg);
+}
+
+static void dma_write(uint32_t reg, uint32_t value)
+{
+    if (reg == DMA2_REG(LIFCR) || reg == DMA2_REG(HIFCR))
+    {
+        uint32_t isr = (reg == DMA2_REG(LIFCR)) ? DMA2_REG(LISR) : DMA2_REG(HISR);
+        HOST_REG(isr) &= ~value;
+        HOST_REG(reg) = 0;
+    }
+    else if (reg >= DMA2_Stream0_BASE && ((reg - DMA2_Stream0_BASE) % sizeof(DMA_Stream_TypeDef)) == 0U && (value & DMA_SxCR_EN))
+    {
+        if ((value & DMA_SxCR_DIR) == DMA_SxCR_DIR_1)
+        {
+            dma_memory_run((reg - DMA2_Stream0_BASE) / sizeof(DMA_Stream_TypeDef));
+        }
+        else
+        {
+            spi_dma_run();
+        }
+    }
+}
+
+const host_periph_model_t host_periph_models[] = {
+    {USART2_BASE, sizeof(USART_TypeDef), usart_reset, usart_read, usart_read_done, usart_write, usart_poll},
+    {GPIOA_BASE, HOST_GPIO_PORTS * HOST_GPIO_STRIDE, gpio_reset, gpio_read, NULL, gpio_write, NULL},
+    {RCC_BASE, sizeof(RCC_TypeDef), rcc_reset, NULL, NULL, rcc_write, NULL},
+    {SPI1_BASE, sizeof(SPI_TypeDef), spi_reset, spi_read, spi_read_done, spi_write, NULL},
+    {DMA2_BASE, DMA2_Stream7_BASE + sizeof(DMA_Stream_TypeDef) - DMA2_BASE, NULL, dma_read, NULL, dma_write, NULL},
+};
+
+const size_t host_periph_model_count = sizeof(host_periph_models) / sizeof(host_periph_models[0]);
@@ -0,0 +1,48 @@
+#define _GNU_SOURCE
+#include "../Include/host_emu.h" // first: <termios.h> defines CR1, CR2, ... which are register names in STM32F401.h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+static char slave_path[64];
+
+const char *host_pty_open(void)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0 || ptsname_r(master, slave_path, sizeof(slave_path)) != 0)
+    {
+        perror("host_emu: can't open a pty");
+        return NULL;
+    }
+
+    // keep our own handle on the slave: without one, the master reports a hangup every time the reader closes it
+    int slave = open(slave_path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (slave < 0)
+    {
+        perror("host_emu: can't open the pty slave");
+        return NULL;
+    }
+
+    // a serial line passes bytes through untouched: no echo, no line buffering, no CR/LF translation
+    struct termios settings;
+    tcgetattr(slave, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(slave, TCSANOW, &settings);
+
+    // optional stable name for tools, e.g. HOST_EMU_UART_LINK=/tmp/ttyNUCLEO
+    const char *link = getenv("HOST_EMU_UART_LINK");
+    if (link && link[0])
+    {
+        unlink(link);
+        if (symlink(slave_path, link) < 0)
+        {
+            perror("host_emu: can't create HOST_EMU_UART_LINK");
+        }
+    }
+
+    host_emu_uart_attach(master);
+    return slave_path;
+}
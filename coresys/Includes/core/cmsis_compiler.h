@@ -27,10 +27,17 @@
 
 #include <stdint.h>
 
+/*
+ * Host build against the peripheral emulator (any host compiler)
+ */
+#if   defined ( HOST_EMULATION )
+  #include "cmsis_host.h"
+
+
 /*
  * Arm Compiler 4/5
  */
-#if   defined ( __CC_ARM )
+#elif defined ( __CC_ARM )
   #include "cmsis_armcc.h"
 
 
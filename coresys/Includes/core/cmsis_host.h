@@ -0,0 +1,123 @@
+/**************************************************************************//**
+ * @file     cmsis_host.h
+ * @brief    CMSIS compiler specific macros and intrinsics for host builds
+ *           against the peripheral emulator (coresys/Host)
+ ******************************************************************************/
+
+#ifndef __CMSIS_HOST_H
+#define __CMSIS_HOST_H
+
+#include <stdint.h>
+
+/*
+ * The firmware is compiled with the host gcc and runs as a Linux process. The core intrinsics that
+ * cmsis_gcc.h implements with Cortex-M instructions are forwarded to the emulator instead:
+ * PRIMASK is the process signal mask for the emulated interrupt line, WFI/WFE block until an
+ * interrupt is pending, and the barriers only stop the compiler from reordering.
+ */
+
+/* CMSIS compiler specific defines */
+#ifndef   __ASM
+  #define __ASM                                  __asm
+#endif
+#ifndef   __INLINE
+  #define __INLINE                               inline
+#endif
+#ifndef   __STATIC_INLINE
+  #define __STATIC_INLINE                        static inline
+#endif
+#ifndef   __STATIC_FORCEINLINE
+  #define __STATIC_FORCEINLINE                   __attribute__((always_inline)) static inline
+#endif
+#ifndef   __NO_RETURN
+  #define __NO_RETURN                            __attribute__((__noreturn__))
+#endif
+#ifndef   __USED
+  #define __USED                                 __attribute__((used))
+#endif
+#ifndef   __WEAK
+  #define __WEAK                                 __attribute__((weak))
+#endif
+#ifndef   __PACKED
+  #define __PACKED                               __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __PACKED_STRUCT
+  #define __PACKED_STRUCT                        struct __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __PACKED_UNION
+  #define __PACKED_UNION                         union __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __ALIGNED
+  #define __ALIGNED(x)                           __attribute__((aligned(x)))
+#endif
+#ifndef   __RESTRICT
+  #define __RESTRICT                             __restrict
+#endif
+#ifndef   __COMPILER_BARRIER
+  #define __COMPILER_BARRIER()                   __ASM volatile("":::"memory")
+#endif
+
+/* implemented in coresys/Host/Source/host_emu.c */
+void host_emu_enable_irq(void);
+void host_emu_disable_irq(void);
+uint32_t host_emu_get_primask(void);
+void host_emu_set_primask(uint32_t primask);
+uint32_t host_emu_get_ipsr(void);
+void host_emu_wfi(void);
+void host_emu_wfe(void);
+void host_emu_sev(void);
+
+__STATIC_FORCEINLINE void __enable_irq(void)
+{
+  host_emu_enable_irq();
+}
+
+__STATIC_FORCEINLINE void __disable_irq(void)
+{
+  host_emu_disable_irq();
+}
+
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void)
+{
+  return host_emu_get_primask();
+}
+
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t priMask)
+{
+  host_emu_set_primask(priMask);
+}
+
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void)
+{
+  return host_emu_get_ipsr();
+}
+
+#define __NOP()                                  __COMPILER_BARRIER()
+#define __WFI()                                  host_emu_wfi()
+#define __WFE()                                  host_emu_wfe()
+#define __SEV()                                  host_emu_sev()
+#define __ISB()                                  __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __DSB()                                  __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __DMB()                                  __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __BKPT(value)                            __builtin_trap()
+
+#define __REV(value)                             __builtin_bswap32(value)
+#define __REV16(value)                           ((uint32_t)(((value) & 0xFF00FF00UL) >> 8) | (((value) & 0x00FF00FFUL) << 8))
+#define __REVSH(value)                           ((int16_t)__builtin_bswap16((uint16_t)(value)))
+
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value)
+{
+  return (value == 0U) ? 32U : (uint8_t)__builtin_clz(value);
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+  uint32_t result = 0U;
+  for (uint32_t i = 0U; i < 32U; i++)
+  {
+    result = (result << 1U) | ((value >> i) & 1U);
+  }
+  return result;
+}
+
+#endif /* __CMSIS_HOST_H */
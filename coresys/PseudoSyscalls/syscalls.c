@@ -34,6 +34,11 @@
 /* Variables */
 extern int __io_putchar(int ch) __attribute__((weak));
 extern int __io_getchar(void) __attribute__((weak));
+/* whole-span versions, preferred when linked in (e.g. from a project's uart.c):
+   __io_write queues len bytes and returns how many it consumed, __io_read returns
+   how many it copied, 0 if nothing has arrived */
+extern int __io_write(const char *ptr, int len) __attribute__((weak));
+extern int __io_read(char *ptr, int len) __attribute__((weak));
 
 
 char *__env[1] = { 0 };
@@ -69,6 +74,23 @@ __attribute__((weak)) int _read(int file, char *ptr, int len)
   (void)file;
   int DataIdx;
 
+  if (__io_read)
+  {
+    DataIdx = __io_read(ptr, len);
+    if (DataIdx == 0 && len > 0)
+    {
+      /* not end of file, just nothing received yet */
+      errno = EAGAIN;
+      return -1;
+    }
+    return DataIdx;
+  }
+
+  if (!__io_getchar)
+  {
+    return 0;
+  }
+
   for (DataIdx = 0; DataIdx < len; DataIdx++)
   {
     *ptr++ = __io_getchar();
@@ -82,6 +104,17 @@ __attribute__((weak)) int _write(int file, char *ptr, int len)
   (void)file;
   int DataIdx;
 
+  if (__io_write)
+  {
+    return __io_write(ptr, len);
+  }
+
+  /* nothing to write to: discard rather than call through a null pointer */
+  if (!__io_putchar)
+  {
+    return len;
+  }
+
   for (DataIdx = 0; DataIdx < len; DataIdx++)
   {
     __io_putchar(*ptr++);
@@ -35,35 +35,33 @@ static uint8_t *__sbrk_heap_end = NULL;
  *        and others from the C library
  *
  * @verbatim
- * ############################################################################
- * #  .data  #  .bss  #       newlib heap       #          MSP stack          #
- * #         #        #                         # Reserved by _Min_Stack_Size #
- * ############################################################################
- * ^-- RAM start      ^-- _end                             _estack, RAM end --^
+ * #####################################################################################
+ * #  .data  #  .bss  # .noinit #     newlib heap     # guard #        MSP stack        #
+ * #         #        #         #                     #       # __Min_Stack_Size      #
+ * #####################################################################################
+ * ^-- RAM start                ^-- __heap_base       ^-- __heap_limit  _estack, RAM end --^
  * @endverbatim
  *
- * This implementation starts allocating at the '_end' linker symbol
- * The '_Min_Stack_Size' linker symbol reserves a memory for the MSP stack
- * The implementation considers '_estack' linker symbol to be RAM end
+ * This implementation starts allocating at the '__heap_base' linker symbol
+ * and never goes past '__heap_limit', the bottom of the stack guard
+ * (see coresys/Drivers/Include/memstat.h)
  * NOTE: If the MSP stack, at any point during execution, grows larger than the
- * reserved size, please increase the '_Min_Stack_Size'.
+ * reserved size, please increase the '__Min_Stack_Size'.
  *
  * @param incr Memory size
  * @return Pointer to allocated memory
  */
 void *_sbrk(ptrdiff_t incr)
 {
-  extern uint8_t _end; /* Symbol defined in the linker script */
-  extern uint8_t _estack; /* Symbol defined in the linker script */
-  extern uint32_t _Min_Stack_Size; /* Symbol defined in the linker script */
-  const uint32_t stack_limit = (uint32_t)&_estack - (uint32_t)&_Min_Stack_Size;
-  const uint8_t *max_heap = (uint8_t *)stack_limit;
+  extern uint8_t __heap_base; /* Symbol defined in the linker script */
+  extern uint8_t __heap_limit; /* Symbol defined in the linker script */
+  const uint8_t *max_heap = &__heap_limit;
   uint8_t *prev_heap_end;
 
   /* Initialize heap end at first call */
   if (NULL == __sbrk_heap_end)
   {
-    __sbrk_heap_end = &_end;
+    __sbrk_heap_end = &__heap_base;
   }
 
   /* Protect heap from growing into the reserved MSP stack */
@@ -78,3 +76,18 @@ void *_sbrk(ptrdiff_t incr)
 
   return (void *)prev_heap_end;
 }
+
+/**
+ * @brief Bytes the heap has been extended by so far; it never shrinks, so
+ *        this is also its high-water mark (used by memstat.c)
+ */
+size_t sysmem_heap_used(void)
+{
+  extern uint8_t __heap_base; /* Symbol defined in the linker script */
+
+  if (NULL == __sbrk_heap_end)
+  {
+    return 0;
+  }
+  return (size_t)(__sbrk_heap_end - &__heap_base);
+}
@@ -0,0 +1,290 @@
+// raw serial capture to a binary log, and the offline decoder for it
+//
+// printing every byte as it arrives can't keep up with a device that talks continuously at a few Mbaud, and
+// once the kernel's tty buffer overflows the bytes are gone. So capture does as little as possible while the
+// data is flowing: one thread reads the port and hands whole chunks, each stamped with the time the read
+// returned, to a second thread that appends them to the log through a large buffered writer. All the
+// interpretation happens later in decode, which can take as long as it likes.
+//
+// log format, all integers little-endian:
+//
+//   header   "UARTCAP\x01", u32 baud rate, u64 capture start (ns since the Unix epoch)
+//   record   varint ns since the previous record (the first one: since the start), varint byte count, bytes
+//
+// varints are LEB128 (7 bits per byte, high bit set on all but the last), so a typical record costs 3-4 bytes
+// on top of its data. Only the end of each chunk is timestamped; decode spreads the bytes of a chunk backwards
+// from that time at one byte per 10 bit times. The writer is flushed every FLUSH_INTERVAL, so stopping a
+// capture with Ctrl+C loses at most that much, and decode accepts a log whose last record is cut short.
+
+use crate::comms::{Frame, FrameAssembler, COMMS_BYTE_TIMEOUT};
+use std::fs::File;
+use std::io::{self, BufWriter, Error, ErrorKind, Read, Write};
+use std::sync::mpsc;
+use std::thread;
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+const MAGIC: &[u8; 8] = b"UARTCAP\x01";
+const HEADER_LENGTH: usize = 8 + 4 + 8;
+
+const READ_CHUNK: usize = 64 * 1024;
+const WRITE_BUFFER: usize = 1024 * 1024;
+const FLUSH_INTERVAL: Duration = Duration::from_millis(250);
+const STATUS_INTERVAL: Duration = Duration::from_secs(1);
+
+fn write_varint(out: &mut impl Write, mut value: u64) -> io::Result<()> {
+    let mut bytes = [0u8; 10];
+    let mut count = 0;
+    loop {
+        let low = (value & 0x7F) as u8;
+        value >>= 7;
+        if value == 0 {
+            bytes[count] = low;
+            count += 1;
+            break;
+        }
+        bytes[count] = low | 0x80;
+        count += 1;
+    }
+    out.write_all(&bytes[..count])
+}
+
+fn read_varint(data: &[u8], position: &mut usize) -> Option<u64> {
+    let mut value = 0u64;
+    for shift in (0..64).step_by(7) {
+        let byte = *data.get(*position)?;
+        *position += 1;
+        value |= ((byte & 0x7F) as u64) << shift;
+        if byte & 0x80 == 0 {
+            return Some(value);
+        }
+    }
+    None
+}
+
+pub fn capture(port_name: &str, baud_rate: u32, path: &str, duration: Option<Duration>) -> io::Result<()> {
+    let mut port = serialport::new(port_name, baud_rate)
+        .timeout(Duration::from_millis(10))
+        .open()
+        .map_err(io::Error::from)?;
+
+    let mut log = BufWriter::with_capacity(WRITE_BUFFER, File::create(path)?);
+    let epoch_ns = SystemTime::now().duration_since(UNIX_EPOCH).map(|d| d.as_nanos() as u64).unwrap_or(0);
+    log.write_all(MAGIC)?;
+    log.write_all(&baud_rate.to_le_bytes())?;
+    log.write_all(&epoch_ns.to_le_bytes())?;
+    log.flush()?;
+
+    println!("capturing {} at {} baud to {}{}", port_name, baud_rate, path,
+        if duration.is_some() { "" } else { ", Ctrl+C to stop" });
+
+    // (ns since start, bytes) from the reader to the writer; the reader never touches the disk
+    let (chunks, received) = mpsc::channel::<(u64, Vec<u8>)>();
+    let started = Instant::now();
+
+    let writer = thread::spawn(move || -> io::Result<u64> {
+        let mut previous_ns = 0u64;
+        let mut total = 0u64;
+        let mut last_flush = Instant::now();
+        let mut last_status = Instant::now();
+
+        loop {
+            match received.recv_timeout(FLUSH_INTERVAL) {
+                Ok((time_ns, bytes)) => {
+                    write_varint(&mut log, time_ns - previous_ns)?;
+                    write_varint(&mut log, bytes.len() as u64)?;
+                    log.write_all(&bytes)?;
+                    previous_ns = time_ns;
+                    total += bytes.len() as u64;
+                }
+                Err(mpsc::RecvTimeoutError::Timeout) => (),
+                Err(mpsc::RecvTimeoutError::Disconnected) => break,
+            }
+
+            if last_flush.elapsed() >= FLUSH_INTERVAL {
+                log.flush()?;
+                last_flush = Instant::now();
+            }
+            if last_status.elapsed() >= STATUS_INTERVAL {
+                print!("\r{} bytes", total);
+                let _ = io::stdout().flush();
+                last_status = Instant::now();
+            }
+        }
+
+        log.flush()?;
+        Ok(total)
+    });
+
+    let mut buffer = vec![0u8; READ_CHUNK];
+    while duration.map_or(true, |limit| started.elapsed() < limit) {
+        match port.read(&mut buffer) {
+            Ok(count) if count > 0 => {
+                let time_ns = started.elapsed().as_nanos() as u64;
+                if chunks.send((time_ns, buffer[..count].to_vec())).is_err() {
+                    break;
+                }
+            }
+            Ok(_) => (),
+            Err(ref e) if e.kind() == io::ErrorKind::TimedOut => (),
+            Err(e) => {
+                eprintln!("\nError: {}", e);
+                break;
+            }
+        }
+    }
+
+    drop(chunks);
+    let total = writer.join().map_err(|_| Error::new(ErrorKind::Other, "capture writer panicked"))??;
+    println!("\r{} bytes captured in {:.1} s", total, started.elapsed().as_secs_f64());
+    Ok(())
+}
+
+fn format_ms(ns: u64) -> String {
+    format!("{:.3} ms", ns as f64 / 1e6)
+}
+
+fn percentile(sorted: &[u64], fraction: f64) -> u64 {
+    sorted[((sorted.len() - 1) as f64 * fraction).round() as usize]
+}
+
+pub fn decode(path: &str, dump: bool) -> io::Result<()> {
+    let data = std::fs::read(path)?;
+    if data.len() < HEADER_LENGTH || &data[..8] != MAGIC {
+        return Err(Error::new(ErrorKind::InvalidData, "not a uart_reader capture"));
+    }
+    let baud_rate = u32::from_le_bytes(data[8..12].try_into().unwrap());
+    let byte_ns = if baud_rate > 0 { 10_000_000_000u64 / baud_rate as u64 } else { 0 };
+    let gap_ns = COMMS_BYTE_TIMEOUT.as_nanos() as u64;
+
+    let stdout = io::stdout();
+    let mut out = io::BufWriter::new(stdout.lock());
+
+    let mut assembler = FrameAssembler::new();
+    let mut position = HEADER_LENGTH;
+    let mut time_ns = 0u64;
+    let mut last_byte_ns: Option<u64> = None;
+    let mut first_byte_ns: Option<u64> = None;
+    let mut truncated = false;
+
+    let mut reads = 0u64;
+    let mut bytes = 0u64;
+    let mut data_packets = 0u64;
+    let mut acks = 0u64;
+    let mut retxs = 0u64;
+    let mut crc_errors = 0u64;
+    let mut gaps = 0u64;
+    let mut longest_gap = (0u64, 0u64); // (length, where)
+    let mut previous_frame_ns: Option<u64> = None;
+    let mut intervals: Vec<u64> = Vec::new();
+
+    while position < data.len() {
+        let record = read_varint(&data, &mut position).zip(read_varint(&data, &mut position));
+        let (delta, length) = match record {
+            Some(record) => record,
+            None => {
+                truncated = true;
+                break;
+            }
+        };
+        let length = length as usize;
+        let available = length.min(data.len() - position);
+        truncated |= available < length;
+
+        time_ns += delta;
+        reads += 1;
+
+        let chunk = &data[position..position + available];
+        position += available;
+
+        for (i, &byte) in chunk.iter().enumerate() {
+            // the read returned when the last byte of the chunk was in; the others came one byte time apart
+            let mut at = time_ns.saturating_sub((chunk.len() - 1 - i) as u64 * byte_ns);
+            if let Some(last) = last_byte_ns {
+                at = at.max(last);
+                if at - last >= gap_ns {
+                    gaps += 1;
+                    if at - last > longest_gap.0 {
+                        longest_gap = (at - last, last);
+                    }
+                }
+            }
+            first_byte_ns.get_or_insert(at);
+            last_byte_ns = Some(at);
+            bytes += 1;
+
+            let frame = match assembler.push(byte, at) {
+                None => continue,
+                Some(frame) => frame,
+            };
+            let start = assembler.frame_start_ns();
+
+            let label = match frame {
+                Frame::BadCrc => {
+                    crc_errors += 1;
+                    "CRC ERROR"
+                }
+                Frame::Ack => {
+                    acks += 1;
+                    "ACK"
+                }
+                Frame::Retx => {
+                    retxs += 1;
+                    "RETX"
+                }
+                Frame::Control(_) => "CONTROL",
+                Frame::Good(_) => {
+                    data_packets += 1;
+                    "DATA"
+                }
+            };
+
+            if let Some(previous) = previous_frame_ns {
+                intervals.push(start.saturating_sub(previous));
+            }
+            previous_frame_ns = Some(start);
+
+            if dump {
+                write!(out, "{:>14.6}  {:<9}", start as f64 / 1e9, label)?;
+                match frame {
+                    Frame::Good(packet) => {
+                        write!(out, " len {:>2} ", packet.length)?;
+                        for value in packet.data.iter() {
+                            write!(out, " {:02X}", value)?;
+                        }
+                    }
+                    Frame::Control(kind) => write!(out, " type {:02X}", kind)?,
+                    _ => (),
+                }
+                writeln!(out)?;
+            }
+        }
+    }
+
+    let first = first_byte_ns.unwrap_or(0);
+    let last = last_byte_ns.unwrap_or(0);
+    let seconds = (last - first) as f64 / 1e9;
+    writeln!(out, "{}: {} bytes in {} reads over {:.3} s at {} baud{}", path, bytes, reads, seconds, baud_rate,
+        if truncated { " (last record cut short)" } else { "" })?;
+    if seconds > 0.0 {
+        let rate = bytes as f64 / seconds;
+        writeln!(out, "  average {:.0} B/s, {:.1}% of the line", rate, 100.0 * rate * 10.0 / baud_rate.max(1) as f64)?;
+    }
+    writeln!(out, "  packets: {} data, {} ACK, {} RETX, {} CRC errors", data_packets, acks, retxs, crc_errors)?;
+    writeln!(out, "  partial packets dropped by the byte timeout: {}", assembler.byte_timeouts)?;
+    writeln!(out, "  quiet gaps of {} or more: {}{}", format_ms(gap_ns), gaps,
+        if gaps > 0 {
+            format!(", longest {} at {:.6} s", format_ms(longest_gap.0), longest_gap.1 as f64 / 1e9)
+        } else {
+            String::new()
+        })?;
+
+    if !intervals.is_empty() {
+        intervals.sort_unstable();
+        writeln!(out, "  packet start to start: min {}, median {}, p99 {}, max {}",
+            format_ms(intervals[0]), format_ms(percentile(&intervals, 0.5)), format_ms(percentile(&intervals, 0.99)),
+            format_ms(intervals[intervals.len() - 1]))?;
+    }
+
+    out.flush()
+}
+
@@ -0,0 +1,120 @@
+// the packet format of Bootloader/Include/comms.h, seen from the PC side
+//
+// a data packet is 18 bytes on the wire: a length byte, 16 data bytes and a CRC-8 (polynomial 0x07, initial
+// value 0) over the first 17. ACK and RETX are 3 byte control frames: a type byte with the top bit set (which
+// no length byte has), a sequence byte and a CRC-8 over both. The device always sends sequence 0.
+
+use std::time::Duration;
+
+pub const PACKET_DATA_LENGTH: usize = 16;
+pub const PACKET_LENGTH: usize = PACKET_DATA_LENGTH + 2;
+
+pub const PACKET_CONTROL_FLAG: u8 = 0x80;
+pub const PACKET_ACK_TYPE: u8 = PACKET_CONTROL_FLAG | 0x15;
+pub const PACKET_RETX_TYPE: u8 = PACKET_CONTROL_FLAG | 0x19;
+pub const PACKET_CONTROL_LENGTH: usize = 3;
+
+// same values as the device (COMMS_*_MS in comms.h)
+pub const COMMS_ACK_TIMEOUT: Duration = Duration::from_millis(100);
+pub const COMMS_BYTE_TIMEOUT: Duration = Duration::from_millis(20);
+pub const COMMS_MAX_RETRANSMITS: u32 = 5;
+
+pub fn crc8(data: &[u8]) -> u8 {
+    let mut crc = 0u8;
+    for &byte in data {
+        crc ^= byte;
+        for _ in 0..8 {
+            crc = if crc & 0x80 != 0 { (crc << 1) ^ 0x07 } else { crc << 1 };
+        }
+    }
+    crc
+}
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct Packet {
+    pub length: u8,
+    pub data: [u8; PACKET_DATA_LENGTH],
+}
+
+impl Packet {
+    // a data packet; unused bytes are zero
+    pub fn new(payload: &[u8]) -> Packet {
+        assert!(payload.len() <= PACKET_DATA_LENGTH);
+        let mut data = [0u8; PACKET_DATA_LENGTH];
+        data[..payload.len()].copy_from_slice(payload);
+        Packet { length: payload.len() as u8, data }
+    }
+
+    pub fn to_bytes(&self) -> [u8; PACKET_LENGTH] {
+        let mut bytes = [0u8; PACKET_LENGTH];
+        bytes[0] = self.length;
+        bytes[1..=PACKET_DATA_LENGTH].copy_from_slice(&self.data);
+        bytes[PACKET_LENGTH - 1] = crc8(&bytes[..PACKET_LENGTH - 1]);
+        bytes
+    }
+}
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum Frame {
+    Good(Packet),
+    Ack,
+    Retx,
+    Control(u8), // a control frame with a good CRC but a type we don't know
+    BadCrc,
+}
+
+// cuts a byte stream into frames the same way comms_update() does, including the byte timeout that drops a
+// partial packet once the line has been quiet for COMMS_BYTE_TIMEOUT; times are in nanoseconds from any origin
+pub struct FrameAssembler {
+    bytes: [u8; PACKET_LENGTH],
+    count: usize,
+    first_byte_ns: u64,
+    last_byte_ns: u64,
+    pub byte_timeouts: u64,
+}
+
+impl FrameAssembler {
+    pub fn new() -> FrameAssembler {
+        FrameAssembler { bytes: [0u8; PACKET_LENGTH], count: 0, first_byte_ns: 0, last_byte_ns: 0, byte_timeouts: 0 }
+    }
+
+    pub fn push(&mut self, byte: u8, now_ns: u64) -> Option<Frame> {
+        if self.count > 0 && now_ns.saturating_sub(self.last_byte_ns) >= COMMS_BYTE_TIMEOUT.as_nanos() as u64 {
+            self.count = 0;
+            self.byte_timeouts += 1;
+        }
+        self.last_byte_ns = now_ns;
+        if self.count == 0 {
+            self.first_byte_ns = now_ns;
+        }
+
+        self.bytes[self.count] = byte;
+        self.count += 1;
+        let length = if self.bytes[0] & PACKET_CONTROL_FLAG != 0 { PACKET_CONTROL_LENGTH } else { PACKET_LENGTH };
+        if self.count < length {
+            return None;
+        }
+        self.count = 0;
+
+        if crc8(&self.bytes[..length - 1]) != self.bytes[length - 1] {
+            return Some(Frame::BadCrc);
+        }
+
+        if length == PACKET_CONTROL_LENGTH {
+            return Some(match self.bytes[0] {
+                PACKET_ACK_TYPE => Frame::Ack,
+                PACKET_RETX_TYPE => Frame::Retx,
+                kind => Frame::Control(kind),
+            });
+        }
+
+        let mut data = [0u8; PACKET_DATA_LENGTH];
+        data.copy_from_slice(&self.bytes[1..=PACKET_DATA_LENGTH]);
+        Some(Frame::Good(Packet { length: self.bytes[0], data }))
+    }
+
+    // when the first byte of the frame push() last returned arrived
+    pub fn frame_start_ns(&self) -> u64 {
+        self.first_byte_ns
+    }
+}
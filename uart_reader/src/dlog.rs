@@ -0,0 +1,230 @@
+// the PC side of coresys/Drivers/Include/dlog.h: turns the binary log records the firmware sends back into text
+//
+// the format strings never leave the PC. They sit in the .dlog section of the ELF file the firmware was built
+// from, and each record only carries the string's address in that section, millis() and the raw arguments:
+//
+//   0x00, COBS(varint id, varint timestamp ms, varint argument...), 0x00
+//
+// the stream is cut at 0x00 bytes and every piece is COBS-decoded and matched against the format strings. A
+// piece only counts as a record if its id is known and it holds exactly as many arguments as the format asks
+// for; everything else (a project's own text output, or a record damaged on the line) is shown as text.
+
+use crate::image;
+use std::collections::HashMap;
+use std::io::{self, Error, ErrorKind, Read, Write};
+use std::time::Duration;
+
+pub const DLOG_SECTION: &str = ".dlog";
+
+pub struct Formats {
+    strings: HashMap<u32, String>,
+}
+
+impl Formats {
+    pub fn load(elf_path: &str) -> io::Result<Formats> {
+        let (address, contents) = image::elf_section(elf_path, DLOG_SECTION)?;
+
+        // the section is nothing but NUL terminated strings, possibly with some alignment padding in between
+        let mut strings = HashMap::new();
+        let mut start = 0usize;
+        for (i, &byte) in contents.iter().enumerate() {
+            if byte != 0 {
+                continue;
+            }
+            if i > start {
+                let text = String::from_utf8_lossy(&contents[start..i]).into_owned();
+                strings.insert((address + start as u64) as u32, text);
+            }
+            start = i + 1;
+        }
+
+        if strings.is_empty() {
+            return Err(Error::new(ErrorKind::InvalidData, format!("{} section of {} is empty", DLOG_SECTION, elf_path)));
+        }
+        Ok(Formats { strings })
+    }
+
+    pub fn len(&self) -> usize {
+        self.strings.len()
+    }
+
+    // the text of a record (the bytes between two delimiters), or None if it isn't one
+    pub fn decode(&self, frame: &[u8]) -> Option<(u32, String)> {
+        let raw = cobs_decode(frame)?;
+        let mut position = 0usize;
+        let id = read_varint(&raw, &mut position)?;
+        let timestamp = read_varint(&raw, &mut position)?;
+        let format = self.strings.get(&id)?;
+
+        let mut args = Vec::new();
+        while position < raw.len() {
+            args.push(read_varint(&raw, &mut position)?);
+        }
+
+        format_record(format, &args).map(|text| (timestamp, text))
+    }
+}
+
+fn cobs_decode(frame: &[u8]) -> Option<Vec<u8>> {
+    let mut out = Vec::with_capacity(frame.len());
+    let mut position = 0usize;
+    while position < frame.len() {
+        let code = frame[position] as usize;
+        if code == 0 || position + code > frame.len() {
+            return None;
+        }
+        out.extend_from_slice(&frame[position + 1..position + code]);
+        position += code;
+        // a code below 0xFF stands for a zero, except at the very end of the frame
+        if code < 0xFF && position < frame.len() {
+            out.push(0);
+        }
+    }
+    Some(out)
+}
+
+// LEB128, at most 5 bytes for the 32-bit values the firmware sends
+fn read_varint(data: &[u8], position: &mut usize) -> Option<u32> {
+    let mut value = 0u32;
+    for shift in (0..35).step_by(7) {
+        let byte = *data.get(*position)?;
+        *position += 1;
+        value |= ((byte & 0x7F) as u32).checked_shl(shift).unwrap_or(0);
+        if byte & 0x80 == 0 {
+            return Some(value);
+        }
+    }
+    None
+}
+
+// the printf subset dlog.h documents: %d %i %u %x %X %c %%, flags 0 and -, a width, and h/hh/l which change nothing
+// because every argument was sent as 32 bits; None if the argument count doesn't match
+fn format_record(format: &str, args: &[u32]) -> Option<String> {
+    let mut out = String::with_capacity(format.len() + args.len() * 4);
+    let mut args = args.iter();
+    let mut chars = format.chars().peekable();
+
+    while let Some(c) = chars.next() {
+        if c != '%' {
+            out.push(c);
+            continue;
+        }
+
+        let mut zero = false;
+        let mut left = false;
+        while let Some(&flag) = chars.peek() {
+            match flag {
+                '0' => zero = true,
+                '-' => left = true,
+                _ => break,
+            }
+            chars.next();
+        }
+
+        let mut width = 0usize;
+        while let Some(digit) = chars.peek().and_then(|c| c.to_digit(10)) {
+            width = width * 10 + digit as usize;
+            chars.next();
+        }
+
+        while let Some('h') | Some('l') = chars.peek() {
+            chars.next();
+        }
+
+        let text = match chars.next()? {
+            '%' => {
+                out.push('%');
+                continue;
+            }
+            'd' | 'i' => (*args.next()? as i32).to_string(),
+            'u' => args.next()?.to_string(),
+            'x' => format!("{:x}", args.next()?),
+            'X' => format!("{:X}", args.next()?),
+            'c' => char::from_u32(*args.next()?).unwrap_or('?').to_string(),
+            _ => return None,
+        };
+
+        let padding = width.saturating_sub(text.chars().count());
+        if left {
+            out.push_str(&text);
+            out.extend(std::iter::repeat(' ').take(padding));
+        } else if zero {
+            // the zeros go after a minus sign
+            let (sign, digits) = if let Some(digits) = text.strip_prefix('-') { ("-", digits) } else { ("", &text[..]) };
+            out.push_str(sign);
+            out.extend(std::iter::repeat('0').take(padding));
+            out.push_str(digits);
+        } else {
+            out.extend(std::iter::repeat(' ').take(padding));
+            out.push_str(&text);
+        }
+    }
+
+    if args.next().is_some() {
+        return None;
+    }
+    Some(out)
+}
+
+fn print_frame(out: &mut impl Write, formats: &Formats, frame: &[u8]) -> io::Result<()> {
+    match formats.decode(frame) {
+        Some((timestamp, text)) => writeln!(out, "[{:>6}.{:03}] {}", timestamp / 1000, timestamp % 1000, text),
+        None => {
+            // not a record: show what was sent as text, one output line per line of it
+            let text: String = frame
+                .iter()
+                .map(|&byte| if byte.is_ascii_graphic() || byte == b' ' || byte == b'\n' { byte as char } else { '.' })
+                .collect();
+            for line in text.split('\n').filter(|line| !line.is_empty()) {
+                writeln!(out, "{:>12} {}", "|", line)?;
+            }
+            Ok(())
+        }
+    }
+}
+
+pub fn run(port_name: &str, baud_rate: u32, elf_path: &str) -> io::Result<()> {
+    let formats = Formats::load(elf_path)?;
+    let mut port = serialport::new(port_name, baud_rate)
+        .timeout(Duration::from_millis(10))
+        .open()
+        .map_err(io::Error::from)?;
+
+    println!("{} format strings from {}, reading {} at {} baud, Ctrl+C to stop", formats.len(), elf_path, port_name,
+        baud_rate);
+
+    let mut buffer = [0u8; 1024];
+    let mut frame: Vec<u8> = Vec::with_capacity(256);
+
+    loop {
+        let count = match port.read(&mut buffer) {
+            Ok(count) => count,
+            Err(ref e) if e.kind() == io::ErrorKind::TimedOut => 0,
+            Err(e) => return Err(e),
+        };
+
+        let stdout = io::stdout();
+        let mut out = stdout.lock();
+        if count == 0 {
+            // a record goes out back to back, so bytes followed by silence are plain output; show them now
+            // rather than when the next record's delimiter comes in
+            if !frame.is_empty() {
+                print_frame(&mut out, &formats, &frame)?;
+                frame.clear();
+                out.flush()?;
+            }
+            continue;
+        }
+        for &byte in &buffer[..count] {
+            if byte != 0 {
+                frame.push(byte);
+                continue;
+            }
+            if !frame.is_empty() {
+                print_frame(&mut out, &formats, &frame)?;
+                frame.clear();
+            }
+        }
+        out.flush()?;
+    }
+}
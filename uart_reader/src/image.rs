@@ -0,0 +1,136 @@
+// loads the firmware to upload: either a raw .bin or the .elf the Makefiles produce
+//
+// for an ELF the PT_LOAD segments are placed at their load (physical) addresses and the gaps between them are
+// filled with 0xFF, the value of erased flash. That is the same image `arm-none-eabi-objcopy -O binary` writes,
+// including the .data initializers that the startup code copies to RAM.
+
+use std::fs;
+use std::io::{self, Error, ErrorKind};
+
+// where a raw .bin is assumed to go: right after the 32K bootloader (MAIN_APP_START_ADDR in bootloader.c)
+pub const DEFAULT_LOAD_ADDRESS: u32 = 0x0800_8000;
+
+const PT_LOAD: u32 = 1;
+
+pub struct Image {
+    pub base: u32,
+    pub data: Vec<u8>,
+}
+
+pub fn load(path: &str) -> io::Result<Image> {
+    let file = fs::read(path)?;
+    if file.starts_with(b"\x7fELF") {
+        load_elf(&file)
+    } else {
+        Ok(Image { base: DEFAULT_LOAD_ADDRESS, data: file })
+    }
+}
+
+fn invalid(message: &str) -> Error {
+    Error::new(ErrorKind::InvalidData, message.to_string())
+}
+
+fn read_u16(file: &[u8], offset: usize) -> io::Result<u16> {
+    file.get(offset..offset + 2)
+        .map(|b| u16::from_le_bytes([b[0], b[1]]))
+        .ok_or_else(|| invalid("truncated ELF file"))
+}
+
+fn read_u32(file: &[u8], offset: usize) -> io::Result<u32> {
+    file.get(offset..offset + 4)
+        .map(|b| u32::from_le_bytes([b[0], b[1], b[2], b[3]]))
+        .ok_or_else(|| invalid("truncated ELF file"))
+}
+
+fn read_u64(file: &[u8], offset: usize) -> io::Result<u64> {
+    Ok(read_u32(file, offset)? as u64 | (read_u32(file, offset + 4)? as u64) << 32)
+}
+
+// (address, contents) of a named section; works on the 32-bit target ELF and on a 64-bit host build (make host)
+pub fn elf_section(path: &str, name: &str) -> io::Result<(u64, Vec<u8>)> {
+    let file = fs::read(path)?;
+    if !file.starts_with(b"\x7fELF") || file.len() < 64 || file[5] != 1 {
+        return Err(invalid("not a little-endian ELF file"));
+    }
+    let wide = file[4] == 2;
+
+    // e_shoff, e_shentsize, e_shnum, e_shstrndx
+    let (shoff, shentsize, shnum, shstrndx) = if wide {
+        (read_u64(&file, 0x28)? as usize, read_u16(&file, 0x3A)? as usize, read_u16(&file, 0x3C)? as usize,
+            read_u16(&file, 0x3E)? as usize)
+    } else {
+        (read_u32(&file, 0x20)? as usize, read_u16(&file, 0x2E)? as usize, read_u16(&file, 0x30)? as usize,
+            read_u16(&file, 0x32)? as usize)
+    };
+
+    // sh_name, sh_addr, sh_offset, sh_size of section i
+    let section = |i: usize| -> io::Result<(u32, u64, usize, usize)> {
+        let header = shoff + i * shentsize;
+        if wide {
+            Ok((read_u32(&file, header)?, read_u64(&file, header + 0x10)?, read_u64(&file, header + 0x18)? as usize,
+                read_u64(&file, header + 0x20)? as usize))
+        } else {
+            Ok((read_u32(&file, header)?, read_u32(&file, header + 0x0C)? as u64,
+                read_u32(&file, header + 0x10)? as usize, read_u32(&file, header + 0x14)? as usize))
+        }
+    };
+
+    let (_, _, names_offset, names_size) = section(shstrndx)?;
+    let names = file.get(names_offset..names_offset + names_size).ok_or_else(|| invalid("truncated ELF file"))?;
+
+    for i in 0..shnum {
+        let (name_offset, address, offset, size) = section(i)?;
+        let section_name = names.get(name_offset as usize..).and_then(|n| n.split(|&b| b == 0).next());
+        if section_name == Some(name.as_bytes()) {
+            let contents = file.get(offset..offset + size).ok_or_else(|| invalid("ELF section outside the file"))?;
+            return Ok((address, contents.to_vec()));
+        }
+    }
+
+    Err(Error::new(ErrorKind::NotFound, format!("no {} section in {}", name, path)))
+}
+
+fn load_elf(file: &[u8]) -> io::Result<Image> {
+    // e_ident: ELFCLASS32, ELFDATA2LSB, as for every Cortex-M image
+    if file.len() < 52 || file[4] != 1 || file[5] != 1 {
+        return Err(invalid("not a 32-bit little-endian ELF file"));
+    }
+
+    let phoff = read_u32(file, 0x1C)? as usize;
+    let phentsize = read_u16(file, 0x2A)? as usize;
+    let phnum = read_u16(file, 0x2C)? as usize;
+
+    // (load address, file contents) of every segment that puts bytes into flash
+    let mut segments: Vec<(u32, &[u8])> = Vec::new();
+    for i in 0..phnum {
+        let header = phoff + i * phentsize;
+        let p_type = read_u32(file, header)?;
+        let p_offset = read_u32(file, header + 4)? as usize;
+        let p_paddr = read_u32(file, header + 12)?;
+        let p_filesz = read_u32(file, header + 16)? as usize;
+        if p_type != PT_LOAD || p_filesz == 0 {
+            continue;
+        }
+
+        let contents = file
+            .get(p_offset..p_offset + p_filesz)
+            .ok_or_else(|| invalid("ELF segment outside the file"))?;
+        segments.push((p_paddr, contents));
+    }
+
+    if segments.is_empty() {
+        return Err(invalid("ELF file has nothing to load"));
+    }
+
+    segments.sort_by_key(|&(address, _)| address);
+    let base = segments[0].0;
+    let end = segments.iter().map(|&(address, contents)| address as u64 + contents.len() as u64).max().unwrap();
+
+    let mut data = vec![0xFFu8; (end - base as u64) as usize];
+    for (address, contents) in segments {
+        let start = (address - base) as usize;
+        data[start..start + contents.len()].copy_from_slice(contents);
+    }
+
+    Ok(Image { base, data })
+}
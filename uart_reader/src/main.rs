@@ -1,5 +1,12 @@
+mod capture;
+mod comms;
+mod dlog;
+mod image;
+mod upload;
+
 use serialport;
-use std::io::{self, Read};
+use std::io::{self, Read, Write};
+use std::process;
 use std::time::Duration;
 
 const PREDEFINED_BYTES: [u8; 18] = [
@@ -8,13 +15,146 @@ const PREDEFINED_BYTES: [u8; 18] = [
     0xFF, 0x38
 ];
 
+// the ST-Link bridge by default; pass the pty printed by a host build (make host) to talk to the emulator
+const DEFAULT_PORT: &str = "/dev/ttyACM0";
+const DEFAULT_BAUD: u32 = 115_200;
+
+fn usage() -> ! {
+    eprintln!("usage: uart_reader [port]");
+    eprintln!("           send a test packet and dump whatever comes back");
+    eprintln!("       uart_reader upload <image.elf|image.bin> [port] [--window N] [--baud B]");
+    eprintln!("           upload an image with up to N packets in flight (1..={}, default {})",
+        upload::MAX_WINDOW, upload::DEFAULT_WINDOW);
+    eprintln!("       uart_reader capture <log> [port] [--baud B] [--seconds S]");
+    eprintln!("           record raw bytes with timestamps to a binary log, for S seconds or until Ctrl+C");
+    eprintln!("       uart_reader decode <log> [--dump]");
+    eprintln!("           reassemble the packets in a capture and report CRC errors, gaps and timing");
+    eprintln!("       uart_reader log <firmware.elf> [port] [--baud B]");
+    eprintln!("           print the DLOG() records of a firmware, using the format strings in its ELF file");
+    process::exit(2);
+}
+
 fn main() -> io::Result<()> {
-    // Port settings
-    let port_name = "/dev/ttyACM0";  // Adjust as needed
-    let baud_rate = 115_200;
+    let args: Vec<String> = std::env::args().skip(1).collect();
+
+    match args.first().map(String::as_str) {
+        Some("upload") => upload_command(&args[1..]),
+        Some("capture") => capture_command(&args[1..]),
+        Some("decode") => decode_command(&args[1..]),
+        Some("log") => log_command(&args[1..]),
+        Some("-h") | Some("--help") => usage(),
+        _ => monitor(args.first().map(String::as_str).unwrap_or(DEFAULT_PORT)),
+    }
+}
+
+fn upload_command(args: &[String]) -> io::Result<()> {
+    let mut image = None;
+    let mut port_name = DEFAULT_PORT.to_string();
+    let mut window = upload::DEFAULT_WINDOW;
+    let mut baud_rate = DEFAULT_BAUD;
+    let mut positional = 0;
+
+    let mut args = args.iter();
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--window" => {
+                window = args.next().and_then(|v| v.parse().ok()).unwrap_or_else(|| usage());
+            }
+            "--baud" => {
+                baud_rate = args.next().and_then(|v| v.parse().ok()).unwrap_or_else(|| usage());
+            }
+            _ if positional == 0 => {
+                image = Some(arg.clone());
+                positional += 1;
+            }
+            _ if positional == 1 => {
+                port_name = arg.clone();
+                positional += 1;
+            }
+            _ => usage(),
+        }
+    }
+
+    let image = image.unwrap_or_else(|| usage());
+    if window == 0 || window > upload::MAX_WINDOW {
+        usage();
+    }
+
+    upload::run(&port_name, baud_rate, &image, window)
+}
+
+fn capture_command(args: &[String]) -> io::Result<()> {
+    let mut log = None;
+    let mut port_name = DEFAULT_PORT.to_string();
+    let mut baud_rate = DEFAULT_BAUD;
+    let mut duration = None;
+    let mut positional = 0;
+
+    let mut args = args.iter();
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--baud" => {
+                baud_rate = args.next().and_then(|v| v.parse().ok()).unwrap_or_else(|| usage());
+            }
+            "--seconds" => {
+                let seconds: f64 = args.next().and_then(|v| v.parse().ok()).unwrap_or_else(|| usage());
+                duration = Some(Duration::from_secs_f64(seconds));
+            }
+            _ if positional == 0 => {
+                log = Some(arg.clone());
+                positional += 1;
+            }
+            _ if positional == 1 => {
+                port_name = arg.clone();
+                positional += 1;
+            }
+            _ => usage(),
+        }
+    }
+
+    let log = log.unwrap_or_else(|| usage());
+    capture::capture(&port_name, baud_rate, &log, duration)
+}
+
+fn decode_command(args: &[String]) -> io::Result<()> {
+    match args {
+        [log] => capture::decode(log, false),
+        [log, flag] if flag == "--dump" => capture::decode(log, true),
+        _ => usage(),
+    }
+}
 
+fn log_command(args: &[String]) -> io::Result<()> {
+    let mut elf = None;
+    let mut port_name = DEFAULT_PORT.to_string();
+    let mut baud_rate = DEFAULT_BAUD;
+    let mut positional = 0;
+
+    let mut args = args.iter();
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--baud" => {
+                baud_rate = args.next().and_then(|v| v.parse().ok()).unwrap_or_else(|| usage());
+            }
+            _ if positional == 0 => {
+                elf = Some(arg.clone());
+                positional += 1;
+            }
+            _ if positional == 1 => {
+                port_name = arg.clone();
+                positional += 1;
+            }
+            _ => usage(),
+        }
+    }
+
+    let elf = elf.unwrap_or_else(|| usage());
+    dlog::run(&port_name, baud_rate, &elf)
+}
+
+fn monitor(port_name: &str) -> io::Result<()> {
     // Open and configure the port
-    let mut port = serialport::new(port_name, baud_rate)
+    let mut port = serialport::new(port_name, DEFAULT_BAUD)
         .timeout(Duration::from_millis(10))
         .open()
         .expect("Failed to open serial port");
@@ -34,26 +174,28 @@ fn main() -> io::Result<()> {
     loop {
         match port.read(&mut buffer) {
             Ok(bytes_read) if bytes_read > 0 => {
-                // Print received data in both hex and ASCII format
-                print!("Hex: ");
+                // Print received data in both hex and ASCII format, one write per chunk
+                let mut text = String::with_capacity(bytes_read * 4 + 24);
+                text.push_str("Hex: ");
                 for byte in &buffer[..bytes_read] {
-                    print!("{:02X} ", byte);
+                    text.push_str(&format!("{:02X} ", byte));
                 }
-                println!();
 
-                print!("ASCII: ");
+                text.push_str("\nASCII: ");
                 for byte in &buffer[..bytes_read] {
-                    if byte.is_ascii_control() {
-                        print!("{}", *byte as char);
+                    if byte.is_ascii_graphic() || *byte == b' ' {
+                        text.push(*byte as char);
                     } else {
-                        print!(".");
+                        text.push('.');
                     }
                 }
-                println!("\n");
+                text.push_str("\n\n");
+
+                io::stdout().lock().write_all(text.as_bytes())?;
             }
             Ok(_) => (), // No data received
             Err(ref e) if e.kind() == io::ErrorKind::TimedOut => (),
             Err(e) => eprintln!("Error: {}", e),
         }
     }
-}
\ No newline at end of file
+}
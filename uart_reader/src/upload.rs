@@ -0,0 +1,263 @@
+// firmware upload over the comms protocol
+//
+// the image is cut into data packets of one sequence byte followed by up to 15 image bytes. Waiting for the
+// ACK of every packet before sending the next one leaves the line idle for a whole round trip per packet, so
+// instead up to `window` packets are kept in flight. The device answers every complete packet it receives
+// with exactly one ACK or RETX, in order, so the n-th answer belongs to the n-th packet still in flight:
+//
+// - ACK: the packet is done
+// - RETX, an answer that fails its own CRC, or nothing for COMMS_ACK_TIMEOUT: either a bit flipped or a byte
+//   got lost. We can't tell which, and after a lost byte the framing on one side is shifted, so every packet
+//   that follows back to back would fail as well. So in all three cases we keep the line quiet for a few byte
+//   timeouts until both state machines have dropped their partial packets, throw away whatever answers are
+//   still arriving and send everything that was in flight again, oldest first.
+//
+// A resent packet can overtake packets sent after it, and a packet whose ACK got lost arrives twice. The
+// sequence byte lets the receiver put every chunk at its place and drop duplicates: the chunk with sequence s
+// belongs at offset 15 * n, where n is the packet number that has s as its low byte and is closest to the
+// packets already received. That is unambiguous because no packet is sent more than 128 packets ahead of the
+// oldest one that hasn't been acked yet.
+//
+// On the device, bootloader.c takes every packet off the receive queue as it arrives and tracks how far the
+// image has got; it doesn't program the flash yet.
+//
+// A dedicated thread drains the serial port and turns bytes into answers, so the window is refilled as soon as
+// an ACK arrives no matter how long printing the progress line takes.
+
+use crate::comms::{
+    Frame, FrameAssembler, Packet, COMMS_ACK_TIMEOUT, COMMS_BYTE_TIMEOUT, COMMS_MAX_RETRANSMITS,
+    PACKET_DATA_LENGTH, PACKET_LENGTH,
+};
+use crate::image;
+use std::collections::VecDeque;
+use std::io::{self, Error, ErrorKind, Read, Write};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::mpsc::{self, Receiver, RecvTimeoutError, Sender};
+use std::sync::Arc;
+use std::thread;
+use std::time::{Duration, Instant};
+
+pub const UPLOAD_CHUNK: usize = PACKET_DATA_LENGTH - 1;
+
+// the device's RX ring (RX_BUFFER_SIZE in uart.c) holds 128 bytes, i.e. 7 packets
+pub const MAX_WINDOW: usize = 7;
+pub const DEFAULT_WINDOW: usize = 4;
+
+// never run further ahead of the oldest unacked packet than the sequence byte can tell apart
+const MAX_SEQUENCE_SPAN: usize = 128;
+
+const PROGRESS_INTERVAL: Duration = Duration::from_millis(200);
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum Answer {
+    Ack,
+    Retx,
+    Corrupt,     // failed the CRC, could have been either
+    Unexpected,  // a good frame that is neither ACK nor RETX
+}
+
+#[derive(Default)]
+struct UploadStats {
+    packets_sent: u64,
+    resent: u64,
+    retx_answers: u64,
+    corrupt_answers: u64,
+    timeouts: u64,
+}
+
+fn reader_thread(mut port: Box<dyn serialport::SerialPort>, answers: Sender<Answer>, stop: Arc<AtomicBool>) {
+    let origin = Instant::now();
+    let mut assembler = FrameAssembler::new();
+    let mut buffer = [0u8; 1024];
+
+    while !stop.load(Ordering::Relaxed) {
+        match port.read(&mut buffer) {
+            Ok(count) if count > 0 => {
+                let now_ns = origin.elapsed().as_nanos() as u64;
+                for &byte in &buffer[..count] {
+                    let answer = match assembler.push(byte, now_ns) {
+                        None => continue,
+                        Some(Frame::BadCrc) => Answer::Corrupt,
+                        Some(Frame::Ack) => Answer::Ack,
+                        Some(Frame::Retx) => Answer::Retx,
+                        Some(Frame::Good(_)) | Some(Frame::Control(_)) => Answer::Unexpected,
+                    };
+                    if answers.send(answer).is_err() {
+                        return;
+                    }
+                }
+            }
+            Ok(_) => (),
+            Err(ref e) if e.kind() == io::ErrorKind::TimedOut => (),
+            Err(e) => {
+                eprintln!("\nError: {}", e);
+                return;
+            }
+        }
+    }
+}
+
+fn data_packet(data: &[u8], index: usize) -> [u8; PACKET_LENGTH] {
+    let start = index * UPLOAD_CHUNK;
+    let chunk = &data[start..(start + UPLOAD_CHUNK).min(data.len())];
+
+    let mut payload = [0u8; PACKET_DATA_LENGTH];
+    payload[0] = index as u8;
+    payload[1..=chunk.len()].copy_from_slice(chunk);
+    Packet::new(&payload[..=chunk.len()]).to_bytes()
+}
+
+fn print_progress(done: usize, total: usize, started: Instant, stats: &UploadStats, finished: bool) {
+    let seconds = started.elapsed().as_secs_f64().max(1e-6);
+    print!(
+        "\r{:>8} / {} bytes ({:5.1}%), {:8.0} B/s, {} resent",
+        done,
+        total,
+        100.0 * done as f64 / total.max(1) as f64,
+        done as f64 / seconds,
+        stats.resent
+    );
+    if finished {
+        println!();
+    }
+    let _ = io::stdout().flush();
+}
+
+pub fn run(port_name: &str, baud_rate: u32, path: &str, window: usize) -> io::Result<()> {
+    let image = image::load(path)?;
+    if image.data.is_empty() {
+        return Err(Error::new(ErrorKind::InvalidData, "image is empty"));
+    }
+    let total_packets = (image.data.len() + UPLOAD_CHUNK - 1) / UPLOAD_CHUNK;
+    println!(
+        "{}: {} bytes at 0x{:08X}, {} packets, window {}",
+        path,
+        image.data.len(),
+        image.base,
+        total_packets,
+        window
+    );
+
+    let mut port = serialport::new(port_name, baud_rate)
+        .timeout(Duration::from_millis(10))
+        .open()
+        .map_err(io::Error::from)?;
+    let reader_port = port.try_clone().map_err(io::Error::from)?;
+
+    let (answer_sender, answers): (Sender<Answer>, Receiver<Answer>) = mpsc::channel();
+    let stop = Arc::new(AtomicBool::new(false));
+    let reader = {
+        let stop = Arc::clone(&stop);
+        thread::spawn(move || reader_thread(reader_port, answer_sender, stop))
+    };
+
+    let mut acked = vec![false; total_packets];
+    let mut resends = vec![0u32; total_packets];
+    let mut in_flight: VecDeque<usize> = VecDeque::with_capacity(MAX_WINDOW);
+    let mut resend_queue: VecDeque<usize> = VecDeque::new();
+    let mut next_new = 0usize;
+    let mut oldest_unacked = 0usize;
+    let mut acked_count = 0usize;
+    let mut stats = UploadStats::default();
+
+    let started = Instant::now();
+    let mut last_progress = started;
+    let mut result = Ok(());
+
+    while acked_count < total_packets {
+        // fill the window, resends first
+        while in_flight.len() < window {
+            let index = if let Some(index) = resend_queue.pop_front() {
+                index
+            } else if next_new < total_packets && next_new - oldest_unacked < MAX_SEQUENCE_SPAN {
+                next_new += 1;
+                next_new - 1
+            } else {
+                break;
+            };
+
+            port.write_all(&data_packet(&image.data, index))?;
+            in_flight.push_back(index);
+            stats.packets_sent += 1;
+        }
+
+        let answer = match answers.recv_timeout(COMMS_ACK_TIMEOUT) {
+            Ok(answer) => Some(answer),
+            Err(RecvTimeoutError::Timeout) => None,
+            Err(RecvTimeoutError::Disconnected) => {
+                result = Err(Error::new(ErrorKind::BrokenPipe, "serial port reader stopped"));
+                break;
+            }
+        };
+
+        let mut retry: Vec<usize> = Vec::new();
+        match answer {
+            Some(Answer::Ack) => {
+                if let Some(index) = in_flight.pop_front() {
+                    if !acked[index] {
+                        acked[index] = true;
+                        acked_count += 1;
+                    }
+                }
+            }
+            Some(Answer::Unexpected) => (),
+            Some(Answer::Retx) | Some(Answer::Corrupt) | None => {
+                match answer {
+                    Some(Answer::Retx) => stats.retx_answers += 1,
+                    Some(Answer::Corrupt) => stats.corrupt_answers += 1,
+                    _ => stats.timeouts += 1,
+                }
+
+                // resync: let both sides drop their partial packets, then start over from the oldest
+                thread::sleep(COMMS_BYTE_TIMEOUT * 3);
+                while answers.try_recv().is_ok() {}
+                stats.resent += in_flight.len() as u64;
+                retry.extend(in_flight.drain(..));
+            }
+        }
+
+        for &index in retry.iter().rev() {
+            if acked[index] {
+                continue;
+            }
+            resends[index] += 1;
+            if resends[index] > COMMS_MAX_RETRANSMITS {
+                result = Err(Error::new(
+                    ErrorKind::TimedOut,
+                    format!("packet {} not acknowledged after {} resends", index, COMMS_MAX_RETRANSMITS),
+                ));
+                break;
+            }
+            resend_queue.push_front(index);
+        }
+        if result.is_err() {
+            break;
+        }
+
+        while oldest_unacked < total_packets && acked[oldest_unacked] {
+            oldest_unacked += 1;
+        }
+
+        if last_progress.elapsed() >= PROGRESS_INTERVAL {
+            last_progress = Instant::now();
+            print_progress((acked_count * UPLOAD_CHUNK).min(image.data.len()), image.data.len(), started, &stats, false);
+        }
+    }
+
+    stop.store(true, Ordering::Relaxed);
+    let _ = reader.join();
+
+    let done = (acked_count * UPLOAD_CHUNK).min(image.data.len());
+    print_progress(done, image.data.len(), started, &stats, true);
+    println!(
+        "{} packets sent for {}, {} resent after {} RETX, {} corrupt answers and {} timeouts",
+        stats.packets_sent,
+        total_packets,
+        stats.resent,
+        stats.retx_answers,
+        stats.corrupt_answers,
+        stats.timeouts
+    );
+
+    result
+}